@@ -91,4 +91,39 @@ function(embed_binary INPUT_PATH INPUT_FILE OUTPUT_OBJ_VAR)
   # Set symbol prefix variables for C/C++ code
   # set(${SYM_PREFIX}_START "_binary_${OUTPUT_OBJ_VAR}_start" PARENT_SCOPE)
   # set(${SYM_PREFIX}_END "_binary_${OUTPUT_OBJ_VAR}_end" PARENT_SCOPE)
+endfunction()
+
+# Pack files into the library, uncompressed and indexed by a perfect hash (see pack_assets.cmake and embedded_pack.h)
+#   FILES     Files packed under their own name
+#   ARCHIVES  Zip archives whose files are packed under their path in the archive
+# Sets OUTPUT_SOURCES_VAR to the generated sources to add to the library along with embedded_pack.c
+function(embed_pack OUTPUT_SOURCES_VAR)
+  cmake_parse_arguments(PACK "" "" "FILES;ARCHIVES" ${ARGN})
+
+  set(pack_asm "${CMAKE_CURRENT_BINARY_DIR}/embedded_pack.S")
+  set(pack_index "${CMAKE_CURRENT_BINARY_DIR}/embedded_pack_index.c")
+  set(pack_script "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/pack_assets.cmake")
+
+  # Lists are passed with another separator, ';' would split the arguments
+  string(REPLACE ";" "|" pack_files "${PACK_FILES}")
+  string(REPLACE ";" "|" pack_archives "${PACK_ARCHIVES}")
+
+  add_custom_command(
+          OUTPUT ${pack_asm} ${pack_index}
+          COMMAND ${CMAKE_COMMAND}
+          -DPACK_FILES=${pack_files}
+          -DPACK_ARCHIVES=${pack_archives}
+          -DPACK_STAGING=${CMAKE_CURRENT_BINARY_DIR}/embedded_pack
+          -DPACK_ASM=${pack_asm}
+          -DPACK_INDEX=${pack_index}
+          -P ${pack_script}
+          DEPENDS ${PACK_FILES} ${PACK_ARCHIVES} ${pack_script}
+          COMMENT "Packing embedded files into ${pack_asm}"
+          VERBATIM
+  )
+
+  # The assembler includes the packed files from the staging directory, rebuild when they change
+  set_source_files_properties(${pack_asm} PROPERTIES OBJECT_DEPENDS "${PACK_FILES};${PACK_ARCHIVES}")
+
+  set(${OUTPUT_SOURCES_VAR} ${pack_asm} ${pack_index} PARENT_SCOPE)
 endfunction()
\ No newline at end of file
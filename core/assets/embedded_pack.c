@@ -0,0 +1,93 @@
+#include <string.h>
+
+#include "embedded_pack.h"
+
+#ifdef HAS_EMBEDDED_DATA
+
+// Must match pack_assets.cmake
+#define EMBEDDED_PACK_FNV_OFFSET 0x811C9DC5U
+#define EMBEDDED_PACK_FNV_PRIME 16777619U
+#define EMBEDDED_PACK_BUCKET_SEED 0U
+#define EMBEDDED_PACK_SLOT_SEED 0x9E3779B9U
+
+// Generated by pack_assets.cmake
+extern const EmbeddedPackIndex embedded_pack_index;
+
+// Mix the bits of a hash so that its low bits depend on the whole path
+static uint32_t pack_mix(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x7FEB352DU;
+    hash ^= hash >> 15;
+    return hash;
+}
+
+// Both hashes of a path are seeded FNV-1a, computed in a single pass
+static void pack_hash(const char *path, uint32_t *out_bucket_hash, uint32_t *out_slot_hash) {
+    uint32_t bucket_hash = EMBEDDED_PACK_FNV_OFFSET ^ EMBEDDED_PACK_BUCKET_SEED;
+    uint32_t slot_hash = EMBEDDED_PACK_FNV_OFFSET ^ EMBEDDED_PACK_SLOT_SEED;
+    for (const unsigned char *c = (const unsigned char *)path; *c; c++) {
+        bucket_hash = (bucket_hash ^ *c) * EMBEDDED_PACK_FNV_PRIME;
+        slot_hash = (slot_hash ^ *c) * EMBEDDED_PACK_FNV_PRIME;
+    }
+    *out_bucket_hash = pack_mix(bucket_hash);
+    *out_slot_hash = pack_mix(slot_hash);
+}
+
+const char* embedded_pack_find(const char *path, size_t *out_size) {
+    const EmbeddedPackIndex *index = &embedded_pack_index;
+    if (!path || index->count == 0) return NULL;
+
+    uint32_t bucket_hash = 0;
+    uint32_t slot_hash = 0;
+    pack_hash(path, &bucket_hash, &slot_hash);
+    const uint64_t displacement = index->displacements[bucket_hash % index->bucket_count];
+    const uint64_t step = bucket_hash % (index->slot_count - 1) + 1;
+    const uint32_t slot = (uint32_t)((slot_hash + displacement * step) % index->slot_count);
+
+    // Any path lands on some slot, only the one of the entry holds it
+    const uint32_t entry_index = index->slots[slot];
+    if (entry_index == 0) return NULL;
+
+    const EmbeddedPackEntry *entry = &index->entries[entry_index - 1];
+    if (strcmp(index->paths + entry->path, path) != 0) return NULL;
+
+    if (out_size) *out_size = entry->size;
+    return index->data + entry->offset;
+}
+
+size_t embedded_pack_count(void) {
+    return embedded_pack_index.count;
+}
+
+const char* embedded_pack_entry(size_t index, const char **out_path, size_t *out_size) {
+    if (index >= embedded_pack_index.count) return NULL;
+
+    const EmbeddedPackEntry *entry = &embedded_pack_index.entries[index];
+    if (out_path) *out_path = embedded_pack_index.paths + entry->path;
+    if (out_size) *out_size = entry->size;
+    return embedded_pack_index.data + entry->offset;
+}
+
+uint64_t embedded_pack_fingerprint(void) {
+    return embedded_pack_index.fingerprint;
+}
+
+#else // !HAS_EMBEDDED_DATA
+
+const char* embedded_pack_find(const char *path, size_t *out_size) {
+    return NULL;
+}
+
+size_t embedded_pack_count(void) {
+    return 0;
+}
+
+const char* embedded_pack_entry(size_t index, const char **out_path, size_t *out_size) {
+    return NULL;
+}
+
+uint64_t embedded_pack_fingerprint(void) {
+    return 0;
+}
+
+#endif // HAS_EMBEDDED_DATA
@@ -0,0 +1,82 @@
+#ifndef EMBEDDED_PACK_H
+#define EMBEDDED_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Files embedded uncompressed in the read-only data of the library.
+ *
+ * The pack is generated at build time by pack_assets.cmake (see embed_pack() in embed_binary.cmake):
+ * the standard library archive is unpacked into it along with fifo_interpreter.rb. Every file is a
+ * null-terminated range of the pack, found through a perfect hash of its path: a lookup is two hashes
+ * and one comparison, and the content is used in place, without any copy nor inflate.
+ * Paths are relative to the root of the pack, the same as the ones installed to the install directory.
+ */
+
+/**
+ * A file of the pack
+ */
+typedef struct {
+    uint32_t path;          // Offset of the null-terminated path in EmbeddedPackIndex.paths
+    uint32_t offset;        // Offset of the content in EmbeddedPackIndex.data
+    uint32_t size;          // Size of the content, followed by a null byte
+} EmbeddedPackEntry;
+
+/**
+ * Index of the pack, generated along with its content
+ */
+typedef struct {
+    const char *data;                  // Content of every file, page aligned
+    const char *paths;
+    const EmbeddedPackEntry *entries;  // Sorted by path
+    uint32_t count;
+    const uint32_t *displacements;     // Displacement of each bucket of the perfect hash
+    uint32_t bucket_count;
+    const uint32_t *slots;             // Index of the entry in each slot plus one, 0 for a free slot
+    uint32_t slot_count;
+    uint64_t fingerprint;              // Hash of the packed files, changes whenever one of them does
+} EmbeddedPackIndex;
+
+/**
+ * Find a file of the pack.
+ *
+ * @param path Path relative to the root of the pack (e.g. "ruby/3.1.0/set.rb")
+ * @param out_size Receives the size of the content, not counting the terminating null byte, may be NULL
+ * @return The null-terminated content, valid for the lifetime of the program, or NULL if the pack has no such file
+ */
+const char* embedded_pack_find(const char *path, size_t *out_size);
+
+/**
+ * Number of entries of the pack, directories included (their path ends with '/').
+ *
+ * @return The number of entries, 0 without embedded data
+ */
+size_t embedded_pack_count(void);
+
+/**
+ * Get an entry of the pack, in path order.
+ *
+ * @param index Index of the entry, below embedded_pack_count()
+ * @param out_path Receives the path of the entry
+ * @param out_size Receives the size of the content, may be NULL
+ * @return The null-terminated content, NULL if index is out of range
+ */
+const char* embedded_pack_entry(size_t index, const char **out_path, size_t *out_size);
+
+/**
+ * Identify the packed files, e.g. to notice an install made from another build.
+ *
+ * @return Hash of every packed file, 0 without embedded data
+ */
+uint64_t embedded_pack_fingerprint(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EMBEDDED_PACK_H
@@ -0,0 +1,47 @@
+#include <string.h>
+
+#include "embedded_vfs.h"
+#include "embedded_pack.h"
+
+// Root of the standard library in the pack, other files (fifo_interpreter.rb) are not part of the VFS
+#define EMBEDDED_VFS_STDLIB_DIRECTORY "ruby/"
+// Ruby sources below this directory are loaded by RubyGems from disk
+#define EMBEDDED_VFS_GEMS_DIRECTORY "ruby/gems/"
+#define EMBEDDED_VFS_SOURCE_EXTENSION ".rb"
+
+// Sources the standard library reads through File instead of requiring them
+static const char *const EMBEDDED_VFS_DISK_SOURCES[] = {
+    "/rubygems/core_ext/kernel_require.rb",
+    NULL
+};
+
+static int has_suffix(const char *path, size_t length, const char *suffix) {
+    const size_t suffix_length = strlen(suffix);
+    return length > suffix_length && strcmp(path + length - suffix_length, suffix) == 0;
+}
+
+int embedded_vfs_serves(const char *path) {
+    const size_t length = strlen(path);
+    if (!has_suffix(path, length, EMBEDDED_VFS_SOURCE_EXTENSION) ||
+        strncmp(path, EMBEDDED_VFS_STDLIB_DIRECTORY, sizeof(EMBEDDED_VFS_STDLIB_DIRECTORY) - 1) != 0 ||
+        strncmp(path, EMBEDDED_VFS_GEMS_DIRECTORY, sizeof(EMBEDDED_VFS_GEMS_DIRECTORY) - 1) == 0) {
+        return 0;
+    }
+    for (const char *const *source = EMBEDDED_VFS_DISK_SOURCES; *source; source++) {
+        if (has_suffix(path, length, *source)) return 0;
+    }
+    return 1;
+}
+
+int embedded_vfs_init(void) {
+    return embedded_pack_count() > 0 ? 0 : -1;
+}
+
+int embedded_vfs_contains(const char *path) {
+    return embedded_vfs_map(path, NULL) != NULL;
+}
+
+const char* embedded_vfs_map(const char *path, size_t *out_size) {
+    // Directories of the pack end with '/' and are never served
+    return path && embedded_vfs_serves(path) ? embedded_pack_find(path, out_size) : NULL;
+}
@@ -0,0 +1,59 @@
+#ifndef EMBEDDED_VFS_H
+#define EMBEDDED_VFS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Read-only view of the Ruby sources of the embedded standard library.
+ *
+ * The sources are files of the embedded pack (see embedded_pack.h): looking one up is a perfect
+ * hash lookup, and its content is read in place. Nothing is written to disk nor opened.
+ * Paths are relative to the root of the standard library archive, the same as the ones
+ * install_embedded_files() extracts to the install directory.
+ */
+
+/**
+ * Check if a path of the archive is served from memory rather than extracted.
+ *
+ * Only Ruby sources of the standard library (below ruby/) are: data files are read through File by the library itself, and the gems
+ * directory (ruby/gems/) is walked by RubyGems, so both still go to disk.
+ *
+ * @param path Path relative to the root of the archive
+ * @return 1 if served by the VFS, 0 otherwise
+ */
+int embedded_vfs_serves(const char *path);
+
+/**
+ * Check that the VFS is available. The index of the pack is generated at build time,
+ * there is nothing to build.
+ *
+ * @return 0 on success, -1 if there is no embedded data
+ */
+int embedded_vfs_init(void);
+
+/**
+ * Check if the VFS holds a file.
+ *
+ * @param path Path relative to the root of the archive (e.g. "ruby/3.1.0/set.rb")
+ * @return 1 if the file exists, 0 otherwise
+ */
+int embedded_vfs_contains(const char *path);
+
+/**
+ * Get the content of a file of the VFS, without any copy.
+ *
+ * @param path Path relative to the root of the archive
+ * @param out_size Receives the size of the content, not counting the terminating null byte, may be NULL
+ * @return The null-terminated content, read-only and valid for the lifetime of the program, or NULL if the file is missing
+ */
+const char* embedded_vfs_map(const char *path, size_t *out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EMBEDDED_VFS_H
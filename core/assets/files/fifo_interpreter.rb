@@ -3,10 +3,601 @@
 #
 # Usage: ruby fifo_interpreter.rb <socket_fd>
 #
-# Protocol:
-# 1. C side sends: "<length>\n<script_content>"
-# 2. Ruby side executes the full script
-# 3. Ruby side responds: "<exit_code>\n"
+# Protocol (see ruby-wire-protocol.h, both sides must stay in sync):
+# Every frame is a 40 bytes little-endian header followed by a payload
+#   magic "RBVM" | version u16 | flags u16 | request_id u64 | status i32 | aux u32 | payload_length u64
+#   | content_hash u64
+# 1. C side sends a frame whose payload is the script content.
+#    Several requests may be streamed before the first one is answered.
+# 2. Ruby side executes each script in order
+# 3. Ruby side responds with a frame carrying the same request_id and the exit code as status
+# A batch frame (WIRE_FLAG_BATCH, aux = script count) carries a table of (u64 length, u64 content hash)
+# pairs followed by the scripts, and is answered by one frame whose payload holds one i32 status per script
+# A ring frame (WIRE_FLAG_RING) only carries the position and length of the script inside the shared
+# payload ring, handed over beforehand by a WIRE_FLAG_RING_ATTACH frame (aux = memfd, payload = capacity)
+# Prepared scripts (aux = id chosen by the C side): WIRE_FLAG_PREPARE evaluates the payload once into a callable,
+# WIRE_FLAG_INVOKE calls it with the typed arguments of the payload, WIRE_FLAG_RELEASE forgets it
+# A script or invocation carrying WIRE_FLAG_RESULT is answered with the same flag and a payload holding
+# its value encoded in MessagePack by RubyVMHost.pack_result (the error message when status is not 0)
+# A script carrying WIRE_FLAG_RACTOR runs on the Ractor lane (see RactorLane): its reply may come before
+# those of the scripts sent earlier
+# A script carrying WIRE_FLAG_IO (aux = stream, 0 for none) runs on the I/O thread pool (see IoPool), its reply
+# may come early too; the scripts of a stream still run in order
+# Requests already sent are cancelled out of band (RubyVMHost.next_cancellation): a cancelled script is
+# interrupted, or skipped if it has not started, and answered with the status given by the C side
+# In a zygote (see ruby-zygote.h), <socket_fd> is the control socket: the VM boots once, then forks a worker
+# serving the protocol above for each commands channel the host sends
+
+WIRE_MAGIC = "RBVM".b
+WIRE_VERSION = 2
+WIRE_HEADER_SIZE = 40
+WIRE_HEADER_FORMAT = "a4S<S<Q<l<L<Q<Q<"
+WIRE_FLAG_BATCH = 0x0001
+WIRE_FLAG_RING = 0x0002
+WIRE_FLAG_RING_ATTACH = 0x0004
+WIRE_FLAG_PREPARE = 0x0008
+WIRE_FLAG_INVOKE = 0x0010
+WIRE_FLAG_RELEASE = 0x0020
+WIRE_FLAG_RESULT = 0x0040
+WIRE_FLAG_RACTOR = 0x0080
+WIRE_FLAG_IO = 0x0100
+
+# Argument type tags of invocations, see RubyArgType (ruby-prepared-script.h)
+ARG_NIL = 0
+ARG_INT64 = 1
+ARG_DOUBLE = 2
+ARG_BOOL = 3
+ARG_UTF8 = 4
+ARG_BYTES = 5
+
+# Callables of the prepared scripts, by id
+PREPARED_SCRIPTS = {}
+
+# Held while evaluating anything, so that synchronous evaluations (ruby_vm_eval_sync)
+# never run concurrently with a script of the queue
+EVAL_LOCK = Mutex.new
+
+# Statuses of cancelled requests, see RubyVMErrorCode (ruby-vm-error.h)
+STATUS_TIMEOUT = -7
+STATUS_CANCELLED = -9
+STATUS_RACTOR_ISOLATION = -10
+
+# Held while writing a reply: the Ractor lane and the I/O pool answer from their own threads
+REPLY_LOCK = Mutex.new
+
+# Raised in the main thread to interrupt the script of a cancelled request.
+# Not a StandardError, so that scripts rescuing errors do not swallow it.
+class RequestCancelled < Exception
+  attr_reader :status
+
+  def initialize(request_id, status)
+    @status = status
+    super(status == STATUS_TIMEOUT ? "Request ##{request_id} timed out" : "Request ##{request_id} cancelled")
+  end
+end
+
+# Tracks the requests being evaluated, so that cancellations can interrupt them.
+# On the main thread, request ids grow in execution order: the cancellation of a request that has not started
+# yet is kept until it starts, the cancellation of an older request arrived too late and is ignored.
+# The requests of the I/O pool start and complete in any order: each one is tracked from its submission.
+# The main loop and the IoPool threads defer RequestCancelled, it is only delivered inside 'run' and 'run_io'.
+class RequestGuard
+  def initialize(thread)
+    @thread = thread
+    @lock = Mutex.new
+    @running = nil
+    @last_started = 0
+    @cancelled = {}
+    # I/O pool requests: the thread running each one, or the status of its cancellation (nil) until it starts
+    @io_requests = {}
+  end
+
+  # Run the block as 'request_id' and return its [status, value], or the status and message of the cancellation
+  def run(request_id, &block)
+    interruptible(request_id, @lock.synchronize { start(request_id) }, &block)
+  ensure
+    @lock.synchronize { @running = nil }
+    discard_late_cancellation
+  end
+
+  # Declare a request handed to the I/O pool, before the main loop reads the next one
+  def submit_io(request_id)
+    @lock.synchronize { @io_requests[request_id] = @cancelled.delete(request_id) }
+  end
+
+  # Same as 'run', for a request declared with 'submit_io', from the IoPool thread running it
+  def run_io(request_id, &block)
+    status = @lock.synchronize do
+      cancelled = @io_requests[request_id]
+      @io_requests[request_id] = Thread.current
+      cancelled
+    end
+    interruptible(request_id, status, &block)
+  ensure
+    @lock.synchronize { @io_requests.delete(request_id) }
+    discard_late_cancellation
+  end
+
+  def cancel(request_id, status)
+    @lock.synchronize do
+      if @io_requests.key?(request_id)
+        running = @io_requests[request_id]
+        if running.is_a?(Thread)
+          running.raise(RequestCancelled.new(request_id, status))
+        else
+          @io_requests[request_id] = status
+        end
+      elsif @running == request_id
+        @running = nil
+        @thread.raise(RequestCancelled.new(request_id, status))
+      elsif request_id > @last_started
+        @cancelled[request_id] = status
+      end
+    end
+  end
+
+  private
+
+  def interruptible(request_id, status)
+    raise RequestCancelled.new(request_id, status) if status
+
+    Thread.handle_interrupt(RequestCancelled => :immediate) { yield }
+  rescue RequestCancelled => error
+    STDERR.puts "[Ruby VM] #{error.message}"
+    [error.status, error.message]
+  end
+
+  # A cancellation raised while the request was finishing must not reach the next one
+  def discard_late_cancellation
+    Thread.handle_interrupt(RequestCancelled => :immediate) {} if Thread.pending_interrupt?(RequestCancelled)
+  rescue RequestCancelled
+    nil
+  end
+
+  # Returns the status of a cancellation received before the request started, nil if none
+  def start(request_id)
+    @last_started = request_id
+    @running = request_id
+    return nil if @cancelled.empty?
+
+    status = @cancelled.delete(request_id)
+    # Requests that never go through 'run' (ring attachment, prepared script release) cannot be interrupted
+    @cancelled.delete_if { |id, _| id < request_id }
+    status
+  end
+end
+
+REQUEST_GUARD = RequestGuard.new(Thread.current)
+
+# Compiled scripts, keyed by the content hash computed once by the C side (0 = no hash).
+# Mirrors RubyIseqCacheEvent (ruby-iseq-cache.h); capacity and counters are shared with the host
+# through RubyVMHost so that they can be tuned and observed without a round trip.
+class IseqCache
+  HIT = 0
+  MISS = 1
+  BYPASS = 2
+  EVICTION = 3
+
+  # Locals of this file live in TOPLEVEL_BINDING too: any extra one was defined by a script
+  BASE_LOCALS = TOPLEVEL_BINDING.local_variables.size
+
+  def initialize
+    # Insertion ordered, the least recently used entry comes first
+    @entries = {}
+    # The main thread and the IoPool threads fetch concurrently: one at a time keeps the entries and the
+    # counters of the host exact, compiling holds the GVL anyway
+    @lock = Thread::Mutex.new
+  end
+
+  # Instruction sequence to run for this script, nil when it must go through eval instead
+  def fetch(source, content_hash)
+    @lock.synchronize do
+      capacity = defined?(RubyVMHost) ? RubyVMHost.iseq_cache_capacity : 0
+      # A compiled script cannot see locals defined by a previous eval, nor define new ones
+      if content_hash == 0 || capacity == 0 || TOPLEVEL_BINDING.local_variables.size != BASE_LOCALS
+        return record(BYPASS, capacity)
+      end
+
+      entry = @entries.delete(content_hash)
+      if entry && entry[0] == source
+        @entries[content_hash] = entry
+        return record(BYPASS, capacity) if entry[1].nil?
+        record(HIT, capacity)
+        return entry[1]
+      end
+
+      iseq = RubyVM::InstructionSequence.compile(source, "<socket-script>", "<socket-script>", 1)
+      # Index 10 of the array form is the local table: such scripts are remembered as eval only
+      iseq = nil unless iseq.to_a[10].empty?
+      @entries[content_hash] = [source.frozen? ? source : source.dup.freeze, iseq]
+      record(MISS, capacity)
+      iseq
+    end
+  end
+
+  private
+
+  def record(event, capacity)
+    while @entries.size > capacity
+      @entries.shift
+      RubyVMHost.iseq_cache_record(EVICTION, @entries.size) if defined?(RubyVMHost)
+    end
+    RubyVMHost.iseq_cache_record(event, @entries.size) if defined?(RubyVMHost)
+    nil
+  end
+end
+
+ISEQ_CACHE = IseqCache.new
+
+# Runs the scripts flagged WIRE_FLAG_RACTOR on RubyVMHost::RACTOR_LANE_SIZE Ractors, in parallel with each other
+# and with the main thread, instead of taking turns on the GVL. Created with the first such script.
+# A Ractor only sees shareable objects: no Ruby global, no constant holding a mutable object, no top-level
+# local, no C method of a native extension not marked Ractor-safe. Breaking that raises
+# Ractor::IsolationError or Ractor::UnsafeError, answered with STATUS_RACTOR_ISOLATION rather than 1.
+# Scripts are dispatched to the first idle Ractor, their replies are written by a thread of the main Ractor
+# as soon as they complete. They cannot be cancelled, and do not hold EVAL_LOCK.
+# The lane must be closed before the VM exits: Ruby cannot terminate a Ractor waiting for work.
+class RactorLane
+  SIZE = defined?(RubyVMHost::RACTOR_LANE_SIZE) ? RubyVMHost::RACTOR_LANE_SIZE : 0
+
+  def self.enabled?
+    SIZE > 0
+  end
+
+  def initialize(socket)
+    experimental = Warning[:experimental]
+    Warning[:experimental] = false
+    begin
+      # Every script goes through this one, the first Ractor taking it gets it
+      @inbox = Ractor.new { loop { Ractor.yield(Ractor.receive) } }
+      @ractors = Array.new(SIZE) { |index| Ractor.new(@inbox, name: "ractor-lane-#{index}") { |inbox| RactorLane.serve(inbox) } }
+    ensure
+      Warning[:experimental] = experimental
+    end
+    @replier = Thread.new { reply_loop(socket) }
+  end
+
+  # The source is copied: a String read from the socket may share its buffer, it cannot be moved
+  def submit(request_id, flags, source)
+    @inbox.send([request_id, flags, source])
+  end
+
+  # Stop every Ractor once the scripts already submitted are answered
+  def close
+    @ractors.size.times { @inbox.send(nil) }
+    @replier.join
+    @inbox.close_incoming
+  end
+
+  # Body of every Ractor of the lane
+  def self.serve(inbox)
+    loop do
+      request = inbox.take
+      break if request.nil?
+
+      request_id, flags, source = request
+      status, value = run(source)
+      begin
+        Ractor.yield([request_id, flags, status, value])
+      rescue TypeError
+        # The value cannot be copied out of the Ractor (Proc, Method...): send its string form
+        Ractor.yield([request_id, flags, status, value.to_s])
+      end
+    end
+  end
+
+  # Evaluate one script against a fresh object, returns its exit code and its value (the error message on failure)
+  def self.run(source)
+    [0, eval(source, Object.new.instance_eval { binding }, "<ractor-script>")]
+  rescue Ractor::IsolationError, Ractor::UnsafeError => error
+    log_error(error)
+    [STATUS_RACTOR_ISOLATION, "#{error.class}: #{error.message}"]
+  rescue ScriptError, StandardError => error
+    log_error(error)
+    [1, "#{error.class}: #{error.message}"]
+  end
+
+  # Same as log_script_error, through the $stderr of the Ractor: STDERR is not shareable
+  def self.log_error(error)
+    $stderr.puts "[Ruby Error] #{error.class}: #{error.message}"
+    (error.backtrace || []).each { |line| $stderr.puts "  #{line}" }
+    $stderr.flush
+  end
+
+  private
+
+  # Until every Ractor stopped, nil being the value a stopped Ractor leaves
+  def reply_loop(socket)
+    running = @ractors.dup
+    until running.empty?
+      ractor, reply = Ractor.select(*running)
+      if reply.nil?
+        running.delete(ractor)
+        next
+      end
+
+      request_id, flags, status, value = reply
+      begin
+        send_result_reply(socket, request_id, flags, status, value)
+      rescue IOError, SystemCallError
+        # The host is gone, keep draining the Ractors so that they can stop
+        nil
+      end
+      count_completed_scripts(1)
+    end
+  end
+end
+
+# Runs the scripts flagged WIRE_FLAG_IO on RubyVMHost::IO_POOL_SIZE Ruby threads while the main loop keeps
+# reading requests: a script blocked on a file, a pipe or a sleep releases the GVL to the other scripts instead
+# of holding the queue. Created with the first such script. Scripts without a stream run in any order; those of
+# a stream run one after the other, the next one being handed to the threads once the previous one is answered.
+# Replies are written as soon as a script completes. Scripts are evaluated in TOPLEVEL_BINDING like those of the
+# main thread, but do not hold EVAL_LOCK. They are cancelled on their own thread (see RequestGuard).
+class IoPool
+  SIZE = defined?(RubyVMHost::IO_POOL_SIZE) ? RubyVMHost::IO_POOL_SIZE : 0
+
+  def self.enabled?
+    SIZE > 0
+  end
+
+  def initialize(socket)
+    @socket = socket
+    @ready = Queue.new
+    @lock = Mutex.new
+    @drained = ConditionVariable.new
+    @pending = 0
+    # Scripts waiting for the one of their stream to complete, by stream with a script running
+    @streams = {}
+    @threads = Array.new(SIZE) { Thread.new { work } }
+  end
+
+  def submit(request_id, flags, stream, source, content_hash)
+    REQUEST_GUARD.submit_io(request_id)
+    request = [request_id, flags, stream, source, content_hash]
+    @lock.synchronize do
+      @pending += 1
+      if stream != 0
+        waiting = @streams[stream]
+        return waiting << request if waiting
+
+        @streams[stream] = []
+      end
+    end
+    @ready << request
+  end
+
+  # Stop every thread once the scripts already submitted are answered
+  def close
+    @lock.synchronize { @drained.wait(@lock) while @pending > 0 }
+    @ready.close
+    @threads.each(&:join)
+  end
+
+  private
+
+  # Cancellations only interrupt the evaluations, like in the main loop
+  def work
+    Thread.handle_interrupt(RequestCancelled => :never) do
+      while (request = @ready.pop)
+        request_id, flags, stream, source, content_hash = request
+        status, value = run(request_id, source, content_hash)
+        begin
+          send_result_reply(@socket, request_id, flags, status, value)
+        rescue IOError, SystemCallError
+          # The host is gone, keep answering so that the pool can be closed
+          nil
+        end
+        count_completed_scripts(1)
+        finish(stream)
+      end
+    end
+  end
+
+  # Every request is answered: even 'exit' or an Exception completes the script instead of ending the thread
+  def run(request_id, source, content_hash)
+    REQUEST_GUARD.run_io(request_id) { run_script(source, content_hash) }
+  rescue Exception => error
+    log_script_error(error)
+    [1, "#{error.class}: #{error.message}"]
+  end
+
+  # Hand the next script of the stream to the threads, if any
+  def finish(stream)
+    following = @lock.synchronize do
+      @pending -= 1
+      @drained.broadcast if @pending == 0
+      waiting = @streams[stream]
+      request = waiting&.shift
+      @streams.delete(stream) if waiting && request.nil?
+      request
+    end
+    @ready << following if following
+  end
+end
+
+# Completed scripts end the recording of the preload profile (see ruby-preload-profile.h)
+PRELOAD_PROFILE = defined?(RubyVMHost) && RubyVMHost.respond_to?(:preload_profile_start)
+
+def count_completed_scripts(count)
+  count.times { RubyVMHost.preload_profile_script_done } if PRELOAD_PROFILE
+end
+
+ZYGOTE = defined?(RubyVMHost) && RubyVMHost.respond_to?(:zygote_next_worker)
+
+# Warm the VM up once, then fork a worker for each commands channel the host sends.
+# Only returns in a worker, with the file descriptor of its commands channel.
+def serve_zygote
+  features = RubyVMHost::ZYGOTE_PRELOAD
+  features += RubyVMHost.preload_profile_read if PRELOAD_PROFILE
+  features.each do |feature|
+    require(feature)
+  rescue ScriptError, StandardError => error
+    STDERR.puts "[Ruby VM] Cannot preload #{feature}: #{error.message}"
+  end
+
+  # Leave the workers a heap without garbage nor holes: the pages they share stay shared longer
+  GC.start
+  begin
+    GC.compact
+  rescue NotImplementedError
+    nil
+  end
+  STDOUT.puts "[Ruby VM] Zygote ready, #{features.size} features preloaded"
+  STDOUT.flush
+
+  while (fd = RubyVMHost.zygote_next_worker)
+    pid = Process.fork
+    if pid.nil?
+      RubyVMHost.zygote_worker_started
+      return fd
+    end
+    Process.detach(pid)
+    RubyVMHost.zygote_worker_forked(fd, pid)
+  end
+
+  STDOUT.puts "[Ruby VM] Zygote closed by peer, shutting down"
+  exit(0)
+end
+
+# Write a whole frame at once, so that the replies of the Ractor lane never interleave with the others
+def write_frame(socket, frame)
+  REPLY_LOCK.synchronize { socket.write(frame) }
+end
+
+def send_reply(socket, request_id, status)
+  write_frame(socket, [WIRE_MAGIC, WIRE_VERSION, 0, request_id, status, 0, 0, 0].pack(WIRE_HEADER_FORMAT))
+end
+
+# Reply to a script or an invocation, with its value if the request asked for it
+def send_result_reply(socket, request_id, flags, status, value)
+  return send_reply(socket, request_id, status) if flags & WIRE_FLAG_RESULT == 0 || !defined?(RubyVMHost)
+
+  payload = begin
+    RubyVMHost.pack_result(value)
+  rescue StandardError => error
+    # Only raised by a failing to_s, the status still tells whether the script succeeded
+    log_script_error(error)
+    RubyVMHost.pack_result(nil)
+  end
+  write_frame(socket, [WIRE_MAGIC, WIRE_VERSION, WIRE_FLAG_RESULT, request_id, status, 0, payload.bytesize, 0].pack(WIRE_HEADER_FORMAT) + payload)
+end
+
+def send_batch_reply(socket, request_id, statuses)
+  status = statuses.all?(&:zero?) ? 0 : 1
+  payload = statuses.pack("l<*")
+  write_frame(socket, [WIRE_MAGIC, WIRE_VERSION, WIRE_FLAG_BATCH, request_id, status, statuses.size, payload.bytesize, 0].pack(WIRE_HEADER_FORMAT) + payload)
+end
+
+def log_script_error(error)
+  # Log the error to stderr (visible in logcat on Android)
+  STDERR.puts "[Ruby Error] #{error.class}: #{error.message}"
+  (error.backtrace || []).each { |line| STDERR.puts "  #{line}" }
+  STDERR.flush
+end
+
+# Evaluate one script, returns its exit code and its value (the error message on failure)
+def run_script(script_content, content_hash = 0)
+  iseq = ISEQ_CACHE.fetch(script_content, content_hash)
+  value = if iseq
+    iseq.eval
+  else
+    # Use TOPLEVEL_BINDING so code has access to top-level context
+    eval(script_content, TOPLEVEL_BINDING, "<socket-script>")
+  end
+  [0, value]
+rescue ScriptError, StandardError => error
+  log_script_error(error)
+  [1, "#{error.class}: #{error.message}"]
+end
+
+# Evaluate a prepared script once and keep the callable it returns, returns its exit code
+def prepare_script(id, source)
+  callable = eval(source, TOPLEVEL_BINDING, "<prepared-script-#{id}>")
+  unless callable.respond_to?(:call)
+    raise TypeError, "prepared script ##{id} must evaluate to a callable, got #{callable.class}"
+  end
+  PREPARED_SCRIPTS[id] = callable
+  0
+rescue ScriptError, StandardError => error
+  PREPARED_SCRIPTS.delete(id)
+  log_script_error(error)
+  1
+end
+
+# Decode the typed arguments of an invocation
+def decode_args(payload)
+  args = []
+  offset = 0
+  while offset < payload.bytesize
+    type = payload.getbyte(offset)
+    offset += 1
+    case type
+    when ARG_NIL
+      args << nil
+      next
+    when ARG_INT64, ARG_DOUBLE
+      value = payload.unpack1(type == ARG_INT64 ? "q<" : "E", offset: offset)
+      offset += 8
+    when ARG_BOOL
+      value = payload.getbyte(offset)
+      value = value != 0 unless value.nil?
+      offset += 1
+    when ARG_UTF8, ARG_BYTES
+      length = payload.unpack1("Q<", offset: offset)
+      offset += 8
+      value = length && payload.byteslice(offset, length)
+      value = nil if value && value.bytesize != length
+      value&.force_encoding(type == ARG_UTF8 ? Encoding::UTF_8 : Encoding::BINARY)
+      offset += length || 0
+    else
+      raise ArgumentError, "Unknown argument type #{type}"
+    end
+    raise ArgumentError, "Truncated arguments" if value.nil? || offset > payload.bytesize
+    args << value
+  end
+  args
+end
+
+# Call a prepared script, returns its exit code and its value (the error message on failure)
+def invoke_script(id, payload)
+  callable = PREPARED_SCRIPTS.fetch(id) { raise ArgumentError, "Unknown prepared script ##{id}" }
+  [0, callable.call(*decode_args(payload))]
+rescue ScriptError, StandardError => error
+  log_script_error(error)
+  [1, "#{error.class}: #{error.message}"]
+end
+
+# Map the payload ring shared by the C side, nil if it cannot be used
+def attach_payload_ring(fd, capacity)
+  # IO::Buffer is flagged as experimental until Ruby 3.3, don't let that warning reach the logs
+  experimental = Warning[:experimental]
+  Warning[:experimental] = false
+  begin
+    IO::Buffer.map(File.for_fd(fd, autoclose: false), capacity, 0, IO::Buffer::READONLY)
+  ensure
+    Warning[:experimental] = experimental
+  end
+rescue NameError, StandardError => error
+  STDERR.puts "[Ruby VM] Payload ring unavailable (#{error.class}: #{error.message}), scripts stay inline"
+  nil
+end
+
+# Split a batch payload into [script, content_hash] pairs, nil if the table does not match the payload
+def split_batch(payload, count)
+  table_size = count * 16
+  return nil if payload.bytesize < table_size
+
+  table = payload.unpack("Q<#{count * 2}").each_slice(2).to_a
+  return nil if table_size + table.sum(&:first) != payload.bytesize
+
+  offset = table_size
+  table.map do |length, content_hash|
+    script = payload.byteslice(offset, length).force_encoding(Encoding::UTF_8)
+    offset += length
+    [script, content_hash]
+  end
+end
 
 begin
   # Get socket file descriptor from command-line argument
@@ -20,86 +611,146 @@ begin
     raise ArgumentError, "Invalid socket file descriptor: #{ARGV[0]}"
   end
 
+  ruby_fd = serve_zygote if ZYGOTE
+
   # Wrap the file descriptor in an IO object (bidirectional)
   socket = IO.for_fd(ruby_fd, "r+")
+  socket.binmode
   socket.sync = true  # Disable buffering - critical for real-time communication!
 
+  # Serve ruby_vm_eval_sync requests and cancellations from their own threads: they wait outside of the GVL
+  if defined?(RubyVMHost)
+    Thread.new { RubyVMHost.serve_sync_evals(EVAL_LOCK) }
+    Thread.new do
+      while (cancellation = RubyVMHost.next_cancellation)
+        REQUEST_GUARD.cancel(*cancellation)
+      end
+    end
+  end
+
+  # Load what the previous start required while the first scripts are on their way
+  RubyVMHost.preload_profile_start if PRELOAD_PROFILE
+
   # Log startup (useful for debugging)
   STDOUT.puts "[Ruby VM] FIFO interpreter started on fd=#{ruby_fd}"
   STDOUT.flush
+  RubyVMHost.startup_ready if defined?(RubyVMHost)
 
-  # Main REPL loop
-  loop do
-    # Read the length prefix (format: "<bytes>\n")
-    length_line = socket.gets
+  payload_ring = nil
+  ractor_lane = nil
+  io_pool = nil
 
-    # EOF means the C side closed the socket - time to exit
-    if length_line.nil?
-      STDOUT.puts "[Ruby VM] Socket closed by peer, shutting down"
-      break
-    end
+  # Main REPL loop, cancellations only interrupt the evaluations (see RequestGuard)
+  Thread.handle_interrupt(RequestCancelled => :never) do
+    loop do
+      # Read the fixed size frame header
+      raw_header = socket.read(WIRE_HEADER_SIZE)
 
-    length_str = length_line.strip
+      # EOF means the C side closed the socket - time to exit
+      if raw_header.nil? || raw_header.bytesize != WIRE_HEADER_SIZE
+        STDOUT.puts "[Ruby VM] Socket closed by peer, shutting down"
+        break
+      end
 
-    # Skip empty lines
-    next if length_str.empty?
+      magic, version, flags, request_id, _status, aux, script_length, content_hash = raw_header.unpack(WIRE_HEADER_FORMAT)
 
-    # Parse the length
-    begin
-      script_length = Integer(length_str)
-    rescue ArgumentError
-      STDERR.puts "[Ruby Error] Invalid length prefix: '#{length_str}'"
-      socket.write("1\n")
-      socket.flush
-      next
-    end
+      # A bad header means the stream is out of sync: there is no way to find the next frame
+      if magic != WIRE_MAGIC || version != WIRE_VERSION
+        STDERR.puts "[Ruby Error] Invalid frame header (magic=#{magic.inspect}, version=#{version}), closing channel"
+        break
+      end
 
-    # Validate length
-    if script_length <= 0 || script_length > 10_000_000  # 10MB max
-      STDERR.puts "[Ruby Error] Invalid script length: #{script_length}"
-      socket.write("1\n")
-      socket.flush
-      next
-    end
+      # Read exactly script_length bytes
+      script_content = script_length > 0 ? socket.read(script_length) : "".b
 
-    # Read exactly script_length bytes
-    script_content = socket.read(script_length)
+      if script_content.nil? || script_content.bytesize != script_length
+        STDERR.puts "[Ruby Error] Failed to read complete script (expected #{script_length} bytes)"
+        break
+      end
 
-    if script_content.nil? || script_content.bytesize != script_length
-      STDERR.puts "[Ruby Error] Failed to read complete script (expected #{script_length} bytes)"
-      socket.write("1\n")
-      socket.flush
-      next
-    end
+      if flags & WIRE_FLAG_RING_ATTACH != 0
+        payload_ring = attach_payload_ring(aux, script_content.unpack1("Q<"))
+        send_reply(socket, request_id, payload_ring ? 0 : 1)
+        next
+      end
 
-    STDOUT.puts "[Ruby VM] Executing script (#{script_length} bytes)"
-    STDOUT.flush
+      if flags & WIRE_FLAG_RING != 0
+        position, script_length = script_content.unpack("Q<Q<")
+        if payload_ring.nil? || position + script_length > payload_ring.size
+          STDERR.puts "[Ruby Error] Invalid ring script ##{request_id} (#{script_length} bytes at #{position})"
+          send_reply(socket, request_id, 1)
+          next
+        end
+        # Single copy, straight from the shared mapping into the String given to eval
+        script_content = payload_ring.get_string(position, script_length)
+      end
 
-    # Execute the Ruby script
-    begin
-      # Use TOPLEVEL_BINDING so code has access to top-level context
-      result = eval(script_content, TOPLEVEL_BINDING, "<socket-script>")
+      if flags & WIRE_FLAG_PREPARE != 0
+        script_content.force_encoding(Encoding::UTF_8)
+        send_reply(socket, request_id, EVAL_LOCK.synchronize { prepare_script(aux, script_content) })
+        next
+      end
 
-      # Send success exit code
-      socket.write("0\n")
-      STDOUT.puts "[Ruby VM] Script executed successfully"
-      STDOUT.flush
+      if flags & WIRE_FLAG_INVOKE != 0
+        status, value = REQUEST_GUARD.run(request_id) { EVAL_LOCK.synchronize { invoke_script(aux, script_content) } }
+        send_result_reply(socket, request_id, flags, status, value)
+        count_completed_scripts(1)
+        next
+      end
 
-    rescue ScriptError, StandardError => error
-      # Log the error to stderr (visible in logcat on Android)
-      STDERR.puts "[Ruby Error] #{error.class}: #{error.message}"
-      error.backtrace.each { |line| STDERR.puts "  #{line}" }
-      STDERR.flush
+      if flags & WIRE_FLAG_RELEASE != 0
+        PREPARED_SCRIPTS.delete(aux)
+        send_reply(socket, request_id, 0)
+        next
+      end
 
-      # Send failure exit code
-      socket.write("1\n")
-    end
+      if flags & WIRE_FLAG_BATCH != 0
+        scripts = split_batch(script_content, aux)
+        if scripts.nil?
+          STDERR.puts "[Ruby Error] Malformed batch ##{request_id} (#{aux} scripts, #{script_length} bytes)"
+          send_batch_reply(socket, request_id, Array.new(aux, 1))
+          next
+        end
+
+        # Scripts run back to back, a failing script does not stop the following ones
+        statuses = EVAL_LOCK.synchronize { scripts.map { |script, hash| run_script(script, hash).first } }
+        send_batch_reply(socket, request_id, statuses)
+        count_completed_scripts(statuses.size)
+        next
+      end
+
+      script_content.force_encoding(Encoding::UTF_8)
+
+      # Without a lane, the script runs on the main thread like the others
+      if flags & WIRE_FLAG_RACTOR != 0 && RactorLane.enabled?
+        ractor_lane ||= RactorLane.new(socket)
+        ractor_lane.submit(request_id, flags, script_content)
+        next
+      end
 
-    # Flush to ensure exit code is sent immediately
-    socket.flush
+      if flags & WIRE_FLAG_IO != 0 && IoPool.enabled?
+        io_pool ||= IoPool.new(socket)
+        io_pool.submit(request_id, flags, aux, script_content, content_hash)
+        next
+      end
+
+      STDOUT.puts "[Ruby VM] Executing script ##{request_id} (#{script_length} bytes)"
+      STDOUT.flush
+
+      # Execute the Ruby script and send its exit code
+      status, value = REQUEST_GUARD.run(request_id) { EVAL_LOCK.synchronize { run_script(script_content, content_hash) } }
+      send_result_reply(socket, request_id, flags, status, value)
+      count_completed_scripts(1)
+      if status == 0
+        STDOUT.puts "[Ruby VM] Script ##{request_id} executed successfully"
+        STDOUT.flush
+      end
+    end
   end
 
   # Clean shutdown
+  ractor_lane&.close
+  io_pool&.close
   socket.close
   STDOUT.puts "[Ruby VM] Shutdown complete"
 
@@ -113,4 +764,4 @@ rescue => error
   error.backtrace.each { |line| STDERR.puts "  #{line}" }
   STDERR.flush
   exit(1)
-end
\ No newline at end of file
+end
\ No newline at end of file
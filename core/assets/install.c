@@ -1,10 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <errno.h>
 #include <unistd.h>
-#include <libgen.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "install.h"
+#include "embedded_vfs.h"
+#include "embedded_pack.h"
 
 #ifdef HAS_EMBEDDED_DATA
 #include "mz.h"
@@ -12,207 +19,1032 @@
 #include "mz_strm.h"
 #include "mz_strm_mem.h"
 #include "mz_zip_rw.h"
+#include "mz_crypt.h"
 
 // External symbols from embedded files (generated by objcopy)
-extern const char _binary_ruby_stdlib_zip_start[];
-extern const char _binary_ruby_stdlib_zip_end[];
 extern const char _binary_ruby_stdlib_ext_zip_start[];
 extern const char _binary_ruby_stdlib_ext_zip_end[];
-extern const char _binary_fifo_interpreter_rb_start[];
-extern const char _binary_fifo_interpreter_rb_end[];
 
-// Helper function to create directories recursively
-static int create_directories(const char *path) {
+// Written in the install directory once every file is in place, see installation_needed()
+#define INSTALL_MANIFEST_NAME ".install-manifest"
+#define INSTALL_MANIFEST_VERSION 1
+
+// Set by the build to the target the embedded archives were made for
+#ifndef INSTALL_ABI
+#define INSTALL_ABI "unknown"
+#endif
+
+// Extraction workers, at most one per core
+#define INSTALL_MAX_WORKERS 8
+// Files per worker below which fewer workers are started
+#define INSTALL_MIN_FILES_PER_WORKER 16
+// Cost of creating a file, in bytes of extraction, when spreading files over the workers
+#define INSTALL_FILE_COST (16 * 1024)
+// Buffer of each worker between the inflater and the file
+#define INSTALL_EXTRACT_BUFFER_SIZE (64 * 1024)
+
+// Suffix of the native extensions in the platform specific archive
+#ifdef __APPLE__
+#define INSTALL_NATIVE_EXTENSION ".bundle"
+#else
+#define INSTALL_NATIVE_EXTENSION ".so"
+#endif
+
+#define FNV64_OFFSET 0xCBF29CE484222325ULL
+#define FNV64_PRIME 0x100000001B3ULL
+
+// Written by the workers, read by any thread, see install_get_archive_completion()
+static uint64_t g_archive_completion[INSTALL_ARCHIVE_COUNT];
+
+/**
+ * A file installed from the embedded data, as recorded in the manifest
+ */
+typedef struct {
+    char *path;        // Relative to the install directory
+    int64_t size;
+    uint32_t crc;
+} InstallManifestEntry;
+
+typedef struct {
+    InstallManifestEntry *entries;
+    size_t count;
+    size_t capacity;
+} InstallManifest;
+
+static uint64_t monotonic_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Keep the time the last worker got past an archive
+static void archive_completed(size_t archive, uint64_t now_ns) {
+    if (archive >= INSTALL_ARCHIVE_COUNT) return;
+
+    uint64_t current = __atomic_load_n(&g_archive_completion[archive], __ATOMIC_RELAXED);
+    while (current < now_ns &&
+           !__atomic_compare_exchange_n(&g_archive_completion[archive], &current, now_ns, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void reset_archive_completion(void) {
+    for (size_t a = 0; a < INSTALL_ARCHIVE_COUNT; a++) {
+        __atomic_store_n(&g_archive_completion[a], 0, __ATOMIC_RELAXED);
+    }
+}
+
+static uint64_t fnv1a64(uint64_t hash, const unsigned char *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * FNV64_PRIME;
+    }
+    return hash;
+}
+
+static uint32_t read_le32(const unsigned char *in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+/**
+ * Identify an embedded archive without reading all of it: the central directory holds the name,
+ * size and CRC of every entry, so hashing it is enough to notice any change of content.
+ * Falls back to hashing the whole archive when no central directory can be found.
+ */
+static uint64_t archive_fingerprint(const char *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    const uint64_t seed = FNV64_OFFSET ^ (uint64_t)size;
+
+    // The end of central directory record is 22 bytes, followed by a comment of up to 64 KB
+    if (size >= 22) {
+        const size_t lowest = size > 22 + 0xFFFF ? size - 22 - 0xFFFF : 0;
+        for (size_t i = size - 22; ; i--) {
+            if (read_le32(bytes + i) == 0x06054B50) {
+                const uint64_t cd_size = read_le32(bytes + i + 12);
+                const uint64_t cd_offset = read_le32(bytes + i + 16);
+                if (cd_offset + cd_size <= i) {
+                    return fnv1a64(seed, bytes + cd_offset, (size_t)cd_size);
+                }
+                break;
+            }
+            if (i == lowest) break;
+        }
+    }
+    return fnv1a64(seed, bytes, size);
+}
+
+static uint32_t data_crc32(const char *data, size_t size) {
+    uint32_t crc = 0;
+    while (size > 0) {
+        const int32_t chunk = size > INT32_MAX ? INT32_MAX : (int32_t)size;
+        crc = mz_crypt_crc32_update(crc, (const uint8_t *)data, chunk);
+        data += chunk;
+        size -= (size_t)chunk;
+    }
+    return crc;
+}
+
+/**
+ * Header of the manifest: everything the installed files depend on.
+ * A manifest starting with any other header describes another build, or another install mode.
+ *
+ * @param vfs 1 when the Ruby sources of the standard library are left to the embedded VFS
+ */
+static int build_manifest_header(char *out, size_t capacity, int vfs) {
+    const size_t stdlib_ext_size = _binary_ruby_stdlib_ext_zip_end - _binary_ruby_stdlib_ext_zip_start;
+
+    const int length = snprintf(out, capacity,
+            "ruby-vm-install-manifest %d\n"
+            "abi %s %zu\n"
+            "%s embedded-pack %zu %016" PRIx64 "\n"
+            "archive ruby-stdlib-ext.zip %zu %016" PRIx64 "\n"
+            "end\n",
+            INSTALL_MANIFEST_VERSION,
+            INSTALL_ABI, sizeof(void *) * 8,
+            vfs ? "vfs" : "pack", embedded_pack_count(), embedded_pack_fingerprint(),
+            stdlib_ext_size, archive_fingerprint(_binary_ruby_stdlib_ext_zip_start, stdlib_ext_size));
+    return (length > 0 && (size_t)length < capacity) ? length : -1;
+}
+
+static void manifest_free(InstallManifest *manifest) {
+    for (size_t i = 0; i < manifest->count; i++) {
+        free(manifest->entries[i].path);
+    }
+    free(manifest->entries);
+    memset(manifest, 0, sizeof(*manifest));
+}
+
+static int manifest_add(InstallManifest *manifest, const char *path, int64_t size, uint32_t crc) {
+    if (manifest->count == manifest->capacity) {
+        const size_t capacity = manifest->capacity ? manifest->capacity * 2 : 1024;
+        InstallManifestEntry *entries = realloc(manifest->entries, capacity * sizeof(InstallManifestEntry));
+        if (!entries) return -1;
+        manifest->entries = entries;
+        manifest->capacity = capacity;
+    }
+
     char *path_copy = strdup(path);
-    char *dir = dirname(path_copy);
+    if (!path_copy) return -1;
 
-    struct stat st = {0};
-    if (stat(dir, &st) == -1) {
-        // Try to create parent directories first
-        if (create_directories(dir) != 0) {
-            free(path_copy);
-            return -1;
+    manifest->entries[manifest->count].path = path_copy;
+    manifest->entries[manifest->count].size = size;
+    manifest->entries[manifest->count].crc = crc;
+    manifest->count++;
+    return 0;
+}
+
+static int compare_manifest_entries(const void *left, const void *right) {
+    return strcmp(((const InstallManifestEntry *)left)->path, ((const InstallManifestEntry *)right)->path);
+}
+
+static const InstallManifestEntry* manifest_find(const InstallManifest *manifest, const char *path) {
+    if (!manifest || manifest->count == 0) return NULL;
+
+    const InstallManifestEntry key = { .path = (char *)path, .size = 0, .crc = 0 };
+    return bsearch(&key, manifest->entries, manifest->count, sizeof(InstallManifestEntry), compare_manifest_entries);
+}
+
+static char* read_manifest_file(const char *install_dir, size_t *out_size) {
+    char manifest_path[1024];
+    snprintf(manifest_path, sizeof(manifest_path), "%s/" INSTALL_MANIFEST_NAME, install_dir);
+
+    FILE *file = fopen(manifest_path, "rb");
+    if (!file) return NULL;
+
+    char *content = NULL;
+    size_t size = 0;
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0 && st.st_size > 0) {
+        content = malloc((size_t)st.st_size + 1);
+        if (content) {
+            size = fread(content, 1, (size_t)st.st_size, file);
+            content[size] = '\0';
         }
+    }
+    fclose(file);
 
-        if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
-            fprintf(stderr, "Failed to create directory %s: %s\n", dir, strerror(errno));
-            free(path_copy);
-            return -1;
+    *out_size = size;
+    return content;
+}
+
+// Whether the manifest in 'install_dir' starts with 'header'
+static int manifest_matches(const char *install_dir, const char *header, size_t header_length) {
+    char manifest_header[1024];
+    char manifest_path[1024];
+
+    if (header_length > sizeof(manifest_header)) return 0;
+
+    snprintf(manifest_path, sizeof(manifest_path), "%s/" INSTALL_MANIFEST_NAME, install_dir);
+    FILE *file = fopen(manifest_path, "rb");
+    if (!file) return 0;
+
+    const size_t bytes_read = fread(manifest_header, 1, header_length, file);
+    fclose(file);
+
+    return bytes_read == header_length && memcmp(manifest_header, header, header_length) == 0;
+}
+
+/**
+ * Load the entries of the manifest left by a previous install, whatever build it came from,
+ * so that files it recorded with the same content are not extracted again
+ */
+static void manifest_load(const char *install_dir, InstallManifest *out_manifest) {
+    size_t size = 0;
+    char *content = read_manifest_file(install_dir, &size);
+    if (!content) return;
+
+    char version_line[64];
+    snprintf(version_line, sizeof(version_line), "ruby-vm-install-manifest %d\n", INSTALL_MANIFEST_VERSION);
+    char *entries = strstr(content, "\nend\n");
+    if (strncmp(content, version_line, strlen(version_line)) != 0 || !entries) {
+        free(content);
+        return;
+    }
+
+    // Each entry is "<crc> <size> <path>", the path runs until the end of the line
+    char *line = entries + strlen("\nend\n");
+    while (*line) {
+        char *line_end = strchr(line, '\n');
+        if (!line_end) break;
+        *line_end = '\0';
+
+        char *cursor = NULL;
+        const uint32_t crc = (uint32_t)strtoul(line, &cursor, 16);
+        if (cursor && *cursor == ' ') {
+            const int64_t entry_size = strtoll(cursor + 1, &cursor, 10);
+            if (cursor && *cursor == ' ' && cursor[1] != '\0') {
+                manifest_add(out_manifest, cursor + 1, entry_size, crc);
+            }
         }
+        line = line_end + 1;
     }
+    free(content);
 
-    free(path_copy);
+    qsort(out_manifest->entries, out_manifest->count, sizeof(InstallManifestEntry), compare_manifest_entries);
+}
+
+/**
+ * Write the manifest of a complete install. Written aside then renamed, so that
+ * an interrupted install never leaves a manifest behind.
+ */
+static int manifest_write(const char *install_dir, const char *header, const InstallManifest *manifest) {
+    char manifest_path[1024];
+    char temp_path[1024];
+    snprintf(manifest_path, sizeof(manifest_path), "%s/" INSTALL_MANIFEST_NAME, install_dir);
+    snprintf(temp_path, sizeof(temp_path), "%s/" INSTALL_MANIFEST_NAME ".tmp", install_dir);
+
+    FILE *file = fopen(temp_path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to create %s: %s\n", temp_path, strerror(errno));
+        return -1;
+    }
+
+    int failed = fputs(header, file) < 0;
+    for (size_t i = 0; i < manifest->count && !failed; i++) {
+        const InstallManifestEntry *entry = &manifest->entries[i];
+        failed = fprintf(file, "%08" PRIx32 " %" PRId64 " %s\n", entry->crc, entry->size, entry->path) < 0;
+    }
+    failed |= fclose(file) != 0;
+
+    if (failed || rename(temp_path, manifest_path) != 0) {
+        fprintf(stderr, "Failed to write install manifest %s: %s\n", manifest_path, strerror(errno));
+        unlink(temp_path);
+        return -1;
+    }
     return 0;
 }
 
-// Extract a zip file from memory to a directory
-static int extract_zip_from_memory(const char *zip_data, size_t zip_size, const char *extract_dir) {
-    void *zip_handle = NULL;
-    void *stream = NULL;
-    int32_t err = MZ_OK;
-    mz_zip_file *file_info = NULL;
-    char extract_path[1024];
-    FILE *output_file = NULL;
-    void *buf = NULL;
-    int32_t buf_size = 8192;
-    int32_t bytes_read = 0;
+// Whether the file at 'path' has exactly 'size' bytes with the given CRC
+static int file_has_content(const char *path, int64_t size, uint32_t crc) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) || (int64_t)st.st_size != size) return 0;
+
+    FILE *file = fopen(path, "rb");
+    if (!file) return 0;
+
+    unsigned char buf[16384];
+    uint32_t file_crc = 0;
+    size_t bytes_read;
+    while ((bytes_read = fread(buf, 1, sizeof(buf), file)) > 0) {
+        file_crc = mz_crypt_crc32_update(file_crc, buf, (int32_t)bytes_read);
+    }
+    const int read_error = ferror(file);
+    fclose(file);
+
+    return !read_error && file_crc == crc;
+}
+
+/**
+ * Whether an entry is already installed at 'path'. A file the previous manifest recorded with
+ * the same content is trusted when its size matches, any other file is checked against the CRC.
+ */
+static int entry_installed(const char *path, const char *name, int64_t size, uint32_t crc,
+                           const InstallManifest *previous) {
+    const InstallManifestEntry *known = manifest_find(previous, name);
+    if (known && known->size == size && known->crc == crc) {
+        struct stat st;
+        return stat(path, &st) == 0 && S_ISREG(st.st_mode) && (int64_t)st.st_size == size;
+    }
+    return file_has_content(path, size, crc);
+}
 
-    // Create memory stream
-    stream = mz_stream_mem_create();
+/**
+ * An embedded zip archive, or the embedded pack
+ */
+typedef struct {
+    const char *name;
+    const char *data;
+    size_t size;
+    int packed;             // Files come from the embedded pack, data and size are unused
+    int vfs_served;         // Files served by the embedded VFS are left in the archive
+} EmbeddedArchive;
+
+typedef enum {
+    EXTRACTION_PENDING = 0,
+    EXTRACTION_DONE,        // Extracted, or already installed
+    EXTRACTION_FAILED,
+    EXTRACTION_IGNORED,     // Directory, file overwritten by a later archive or served by the embedded VFS
+    EXTRACTION_RUNNING      // Deferred entry claimed by a worker or by a thread waiting for it
+} ExtractionStatus;
+
+/**
+ * A file of the archives, in central directory order, archive after archive
+ */
+typedef struct {
+    char *path;
+    const char *data;       // Content of a file of the pack, NULL for a zip entry
+    int64_t size;
+    uint32_t crc;           // Computed by the worker for a file of the pack
+    size_t archive;
+    size_t worker;
+    int deferred;           // Extracted after every other file, see is_deferred_entry()
+    ExtractionStatus status; // Atomic for a deferred entry: other threads may claim it
+} ExtractionEntry;
+
+typedef struct {
+    const EmbeddedArchive *archives;
+    size_t archive_count;
+    ExtractionEntry *entries;
+    size_t count;
+    size_t capacity;
+    const char *extract_dir;
+    const InstallManifest *previous;
+    size_t worker_count;
+} ExtractionPlan;
+
+/**
+ * Progress of the install running in this process, for the threads waiting on its files (see install_wait)
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int running;
+    int sources_ready;          // Every file but the deferred ones is in place
+    int files_ready;            // Every file is in place
+    int failed;
+    ExtractionPlan *plan;       // Extraction in progress, NULL outside of extract_archives()
+    size_t workers_past_sources;
+    size_t helpers;             // Waiting threads extracting a deferred entry of 'plan' themselves
+} InstallProgress;
+
+static InstallProgress g_progress = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .changed = PTHREAD_COND_INITIALIZER
+};
+
+/**
+ * Arguments of the install thread started by install_embedded_files_start()
+ */
+typedef struct {
+    char *install_dir;
+    int vfs;
+    InstallCompletion on_complete;
+    void *user_data;
+} InstallThreadArgs;
+
+typedef struct {
+    ExtractionPlan *plan;
+    size_t id;
+    size_t skipped;
+    pthread_t thread;
+} ExtractionWorker;
+
+/**
+ * Open a reader on an embedded archive. Readers only share the read-only archive data,
+ * so each thread can have its own.
+ *
+ * @param out_stream Receives the memory stream, to delete after the reader
+ * @return The reader, NULL on failure
+ */
+static void* open_archive_reader(const EmbeddedArchive *archive, void **out_stream) {
+    void *stream = mz_stream_mem_create();
     if (!stream) {
         fprintf(stderr, "Failed to create memory stream\n");
-        return -1;
+        return NULL;
     }
 
-    mz_stream_mem_set_buffer(stream, (void*)zip_data, zip_size);
+    mz_stream_mem_set_buffer(stream, (void*)archive->data, (int32_t)archive->size);
 
-    // Create zip reader
-    zip_handle = mz_zip_reader_create();
+    void *zip_handle = mz_zip_reader_create();
     if (!zip_handle) {
         fprintf(stderr, "Failed to create zip reader\n");
-        goto cleanup;
+        mz_stream_mem_delete(&stream);
+        return NULL;
     }
 
-    // Open zip from memory stream
-    err = mz_zip_reader_open(zip_handle, stream);
+    const int32_t err = mz_zip_reader_open(zip_handle, stream);
     if (err != MZ_OK) {
-        fprintf(stderr, "Failed to open zip from memory: %d\n", err);
-        goto cleanup;
+        fprintf(stderr, "Failed to open zip %s from memory: %d\n", archive->name, err);
+        mz_zip_reader_delete(&zip_handle);
+        mz_stream_mem_delete(&stream);
+        return NULL;
     }
 
-    // Go to first entry
-    err = mz_zip_reader_goto_first_entry(zip_handle);
-    if (err != MZ_OK && err != MZ_END_OF_LIST) {
-        fprintf(stderr, "Failed to go to first zip entry: %d\n", err);
-        goto cleanup;
+    *out_stream = stream;
+    return zip_handle;
+}
+
+static void close_archive_reader(void *zip_handle, void *stream) {
+    mz_zip_reader_close(zip_handle);
+    mz_zip_reader_delete(&zip_handle);
+    mz_stream_mem_delete(&stream);
+}
+
+static int is_directory_entry(const char *name) {
+    const size_t length = strlen(name);
+    return length == 0 || name[length - 1] == '/';
+}
+
+/**
+ * Native extensions are only loaded by 'require', which waits for them (see install_wait_file):
+ * they are extracted last, while Ruby starts. Encodings and transcoders are loaded by the VM itself,
+ * they stay with the other files.
+ */
+static int is_deferred_entry(const char *name) {
+    const size_t length = strlen(name);
+    const size_t extension_length = strlen(INSTALL_NATIVE_EXTENSION);
+    return length > extension_length &&
+           strcmp(name + length - extension_length, INSTALL_NATIVE_EXTENSION) == 0 &&
+           strstr(name, "/enc/") == NULL;
+}
+
+// Create a directory and its missing parents
+static int make_directory_tree(char *path) {
+    if (mkdir(path, 0755) == 0 || errno == EEXIST) return 0;
+    if (errno != ENOENT) return -1;
+
+    char *separator = strrchr(path, '/');
+    if (!separator || separator == path) return -1;
+
+    *separator = '\0';
+    const int result = make_directory_tree(path);
+    *separator = '/';
+    return (result == 0 && (mkdir(path, 0755) == 0 || errno == EEXIST)) ? 0 : -1;
+}
+
+static int compare_strings(const void *left, const void *right) {
+    return strcmp(*(char * const *)left, *(char * const *)right);
+}
+
+static int compare_entry_paths(const void *left, const void *right) {
+    return strcmp((*(ExtractionEntry * const *)left)->path, (*(ExtractionEntry * const *)right)->path);
+}
+
+static int compare_entry_sizes(const void *left, const void *right) {
+    const int64_t left_size = (*(ExtractionEntry * const *)left)->size;
+    const int64_t right_size = (*(ExtractionEntry * const *)right)->size;
+    return (left_size < right_size) - (left_size > right_size);
+}
+
+static int plan_add(ExtractionPlan *plan, size_t archive, const char *path, const char *data, int64_t size,
+                    uint32_t crc) {
+    if (plan->count == plan->capacity) {
+        const size_t capacity = plan->capacity ? plan->capacity * 2 : 2048;
+        ExtractionEntry *entries = realloc(plan->entries, capacity * sizeof(ExtractionEntry));
+        if (!entries) return -1;
+        plan->entries = entries;
+        plan->capacity = capacity;
     }
 
-    buf = malloc(buf_size);
-    if (!buf) {
-        fprintf(stderr, "Failed to allocate buffer\n");
-        err = MZ_MEM_ERROR;
-        goto cleanup;
+    ExtractionEntry *entry = &plan->entries[plan->count];
+    entry->path = strdup(path);
+    if (!entry->path) return -1;
+    entry->data = data;
+    entry->size = size;
+    entry->crc = crc;
+    entry->archive = archive;
+    entry->worker = 0;
+    entry->deferred = !plan->archives[archive].packed && is_deferred_entry(path);
+    entry->status = is_directory_entry(path) || (plan->archives[archive].vfs_served && embedded_vfs_serves(path)) ?
+                    EXTRACTION_IGNORED : EXTRACTION_PENDING;
+    plan->count++;
+    return 0;
+}
+
+static void plan_free(ExtractionPlan *plan) {
+    for (size_t i = 0; i < plan->count; i++) {
+        free(plan->entries[i].path);
     }
+    free(plan->entries);
+    plan->entries = NULL;
+    plan->count = 0;
+    plan->capacity = 0;
+}
 
-    // Extract all entries
-    do {
-        err = mz_zip_reader_entry_get_info(zip_handle, &file_info);
-        if (err != MZ_OK) {
-            fprintf(stderr, "Failed to get zip entry info: %d\n", err);
-            goto cleanup;
+// List the entries of the pack from its index, and of every zip archive from its central directory
+static int plan_read_entries(ExtractionPlan *plan) {
+    for (size_t a = 0; a < plan->archive_count; a++) {
+        if (plan->archives[a].packed) {
+            for (size_t i = 0; i < embedded_pack_count(); i++) {
+                const char *path = NULL;
+                size_t size = 0;
+                const char *data = embedded_pack_entry(i, &path, &size);
+                if (plan_add(plan, a, path, data, (int64_t)size, 0) != 0) return -1;
+            }
+            continue;
         }
 
-        // Skip directories (check if filename ends with '/')
-        if (file_info->filename[strlen(file_info->filename) - 1] == '/') {
-            snprintf(extract_path, sizeof(extract_path), "%s/%s", extract_dir, file_info->filename);
-            // Remove trailing slash
-            extract_path[strlen(extract_path) - 1] = '\0';
-            if (mkdir(extract_path, 0755) != 0 && errno != EEXIST) {
-                fprintf(stderr, "Failed to create directory %s: %s\n", extract_path, strerror(errno));
-                // Continue with other files
-            }
-        } else {
-            // Extract file
-            snprintf(extract_path, sizeof(extract_path), "%s/%s", extract_dir, file_info->filename);
+        void *stream = NULL;
+        void *zip_handle = open_archive_reader(&plan->archives[a], &stream);
+        if (!zip_handle) return -1;
 
-            // Create parent directories
-            if (create_directories(extract_path) != 0) {
-                fprintf(stderr, "Failed to create parent directories for %s\n", extract_path);
-                goto next_entry;
+        mz_zip_file *file_info = NULL;
+        int32_t err = mz_zip_reader_goto_first_entry(zip_handle);
+        while (err == MZ_OK) {
+            err = mz_zip_reader_entry_get_info(zip_handle, &file_info);
+            if (err != MZ_OK) break;
+            if (plan_add(plan, a, file_info->filename, NULL, file_info->uncompressed_size, file_info->crc) != 0) {
+                err = MZ_MEM_ERROR;
+                break;
             }
+            err = mz_zip_reader_goto_next_entry(zip_handle);
+        }
+        close_archive_reader(zip_handle, stream);
 
-            // Open entry for reading
-            err = mz_zip_reader_entry_open(zip_handle);
-            if (err != MZ_OK) {
-                fprintf(stderr, "Failed to open zip entry %s: %d\n", file_info->filename, err);
-                goto next_entry;
-            }
+        if (err != MZ_END_OF_LIST) {
+            fprintf(stderr, "Failed to list zip entries of %s: %d\n", plan->archives[a].name, err);
+            return -1;
+        }
+    }
+    return 0;
+}
 
-            // Open output file
-            output_file = fopen(extract_path, "wb");
-            if (!output_file) {
-                fprintf(stderr, "Failed to create file %s: %s\n", extract_path, strerror(errno));
-                mz_zip_reader_entry_close(zip_handle);
-                goto next_entry;
-            }
+/**
+ * Archives are extracted concurrently: when several of them hold the same file,
+ * only the last one writes it, as if they were extracted in order
+ */
+static int plan_ignore_overwritten(ExtractionPlan *plan) {
+    ExtractionEntry **sorted = malloc(sizeof(ExtractionEntry *) * (plan->count ? plan->count : 1));
+    if (!sorted) return -1;
 
-            // Read and write file data
-            do {
-                bytes_read = mz_zip_reader_entry_read(zip_handle, buf, buf_size);
-                if (bytes_read < 0) {
-                    fprintf(stderr, "Error reading from zip entry: %d\n", bytes_read);
-                    break;
-                }
-                if (bytes_read > 0) {
-                    if (fwrite(buf, 1, bytes_read, output_file) != (size_t)bytes_read) {
-                        fprintf(stderr, "Error writing to file %s: %s\n", extract_path, strerror(errno));
-                        break;
-                    }
-                }
-            } while (bytes_read > 0);
+    for (size_t i = 0; i < plan->count; i++) {
+        sorted[i] = &plan->entries[i];
+    }
+    qsort(sorted, plan->count, sizeof(ExtractionEntry *), compare_entry_paths);
+
+    // Within a run of the same path, the entry furthest in the plan comes from the last archive
+    for (size_t i = 0; i < plan->count;) {
+        size_t end = i + 1;
+        ExtractionEntry *last = sorted[i];
+        for (; end < plan->count && strcmp(sorted[end]->path, sorted[i]->path) == 0; end++) {
+            if (sorted[end] > last) last = sorted[end];
+        }
+        for (size_t j = i; j < end; j++) {
+            if (sorted[j] != last) sorted[j]->status = EXTRACTION_IGNORED;
+        }
+        i = end;
+    }
+    free(sorted);
+    return 0;
+}
 
-            fclose(output_file);
-            output_file = NULL;
+/**
+ * Create every directory the archives need, once and before any worker starts:
+ * the workers then only create files
+ */
+static int plan_create_directories(const ExtractionPlan *plan) {
+    char **directories = malloc(sizeof(char *) * (plan->count ? plan->count : 1));
+    if (!directories) return -1;
 
-            mz_zip_reader_entry_close(zip_handle);
+    size_t count = 0;
+    int result = 0;
+    for (size_t i = 0; i < plan->count && result == 0; i++) {
+        const char *path = plan->entries[i].path;
+        const char *separator = strrchr(path, '/');
+        // Directory entries end with a separator, files only need their parent
+        if (!separator) continue;
 
+        const size_t length = (size_t)(separator - path);
+        directories[count] = malloc(strlen(plan->extract_dir) + length + 2);
+        if (!directories[count]) {
+            result = -1;
+            break;
         }
+        sprintf(directories[count], "%s/%.*s", plan->extract_dir, (int)length, path);
+        count++;
+    }
 
-next_entry:
-        err = mz_zip_reader_goto_next_entry(zip_handle);
-    } while (err == MZ_OK);
+    // Sorted, parents come before their children and duplicates are adjacent
+    qsort(directories, count, sizeof(char *), compare_strings);
+    for (size_t i = 0; i < count && result == 0; i++) {
+        if (i > 0 && strcmp(directories[i], directories[i - 1]) == 0) continue;
+        if (make_directory_tree(directories[i]) != 0) {
+            fprintf(stderr, "Failed to create directory %s: %s\n", directories[i], strerror(errno));
+            result = -1;
+        }
+    }
 
-    if (err == MZ_END_OF_LIST) {
-        err = MZ_OK; // Normal end of entries
+    for (size_t i = 0; i < count; i++) {
+        free(directories[i]);
     }
+    free(directories);
+    return result;
+}
 
-cleanup:
-    if (buf) free(buf);
-    if (zip_handle) {
-        mz_zip_reader_close(zip_handle);
-        mz_zip_reader_delete(&zip_handle);
+/**
+ * Spread the files over the workers, largest first to the least loaded worker.
+ * Creating a file costs about as much as extracting INSTALL_FILE_COST bytes.
+ */
+static void plan_assign_workers(ExtractionPlan *plan, size_t worker_count) {
+    ExtractionEntry **sorted = malloc(sizeof(ExtractionEntry *) * (plan->count ? plan->count : 1));
+    int64_t loads[INSTALL_MAX_WORKERS] = {0};
+
+    if (!sorted) {
+        // Round robin is still a fair split
+        for (size_t i = 0; i < plan->count; i++) {
+            plan->entries[i].worker = i % worker_count;
+        }
+        return;
     }
-    mz_stream_mem_delete(&stream);
 
-    return (err == MZ_OK) ? 0 : -1;
+    size_t count = 0;
+    for (size_t i = 0; i < plan->count; i++) {
+        if (plan->entries[i].status == EXTRACTION_PENDING) {
+            sorted[count++] = &plan->entries[i];
+        }
+    }
+    qsort(sorted, count, sizeof(ExtractionEntry *), compare_entry_sizes);
+
+    for (size_t i = 0; i < count; i++) {
+        size_t least_loaded = 0;
+        for (size_t w = 1; w < worker_count; w++) {
+            if (loads[w] < loads[least_loaded]) least_loaded = w;
+        }
+        sorted[i]->worker = least_loaded;
+        loads[least_loaded] += sorted[i]->size + INSTALL_FILE_COST;
+    }
+    free(sorted);
 }
 
-// Write binary data to a file
-static int write_binary_file(const char *filename, const char *data, size_t size) {
-    // Create parent directories
-    if (create_directories(filename) != 0) {
+// Inflate the current entry of the reader into 'path'
+static int extract_entry(void *zip_handle, const char *path, void *buf, int32_t buf_size) {
+    int32_t err = mz_zip_reader_entry_open(zip_handle);
+    if (err != MZ_OK) {
+        fprintf(stderr, "Failed to open zip entry for %s: %d\n", path, err);
         return -1;
     }
 
-    FILE *file = fopen(filename, "wb");
-    if (!file) {
-        fprintf(stderr, "Failed to create file %s: %s\n", filename, strerror(errno));
+    FILE *output_file = fopen(path, "wb");
+    if (!output_file) {
+        fprintf(stderr, "Failed to create file %s: %s\n", path, strerror(errno));
+        mz_zip_reader_entry_close(zip_handle);
         return -1;
     }
 
-    size_t written = fwrite(data, 1, size, file);
-    fclose(file);
+    int failed = 0;
+    int32_t bytes_read = 0;
+    do {
+        bytes_read = mz_zip_reader_entry_read(zip_handle, buf, buf_size);
+        if (bytes_read < 0) {
+            fprintf(stderr, "Error reading from zip entry: %d\n", bytes_read);
+            failed = 1;
+            break;
+        }
+        if (bytes_read > 0 && fwrite(buf, 1, bytes_read, output_file) != (size_t)bytes_read) {
+            fprintf(stderr, "Error writing to file %s: %s\n", path, strerror(errno));
+            failed = 1;
+            break;
+        }
+    } while (bytes_read > 0);
 
-    if (written != size) {
-        fprintf(stderr, "Failed to write complete data to %s\n", filename);
+    failed |= fclose(output_file) != 0;
+    mz_zip_reader_entry_close(zip_handle);
+    return failed ? -1 : 0;
+}
+
+// Write a file of the pack into 'path', straight from the embedded data
+static int write_entry(const char *path, const char *data, size_t size) {
+    FILE *output_file = fopen(path, "wb");
+    if (!output_file) {
+        fprintf(stderr, "Failed to create file %s: %s\n", path, strerror(errno));
         return -1;
     }
 
-    printf("Created: %s (%zu bytes)\n", filename, size);
-    return 0;
+    int failed = fwrite(data, 1, size, output_file) != size;
+    failed |= fclose(output_file) != 0;
+    if (failed) {
+        fprintf(stderr, "Error writing to file %s: %s\n", path, strerror(errno));
+    }
+    return failed ? -1 : 0;
 }
 
-// Main installation function
-int install_embedded_files(const char *install_dir) {
-    char full_path[1024];
+/**
+ * Install one entry, from the current entry of the reader for a zip archive.
+ * A deferred entry may be loaded as soon as it exists: it is extracted aside then renamed.
+ *
+ * @param out_skipped Set to 1 when the entry was already installed
+ * @return EXTRACTION_DONE or EXTRACTION_FAILED
+ */
+static ExtractionStatus install_entry(const ExtractionPlan *plan, ExtractionEntry *entry, void *zip_handle, void *buf,
+                                      int *out_skipped) {
+    char extract_path[1024];
+    char temp_path[1040];
+
+    snprintf(extract_path, sizeof(extract_path), "%s/%s", plan->extract_dir, entry->path);
+    if (entry->data) {
+        entry->crc = data_crc32(entry->data, (size_t)entry->size);
+    }
+
+    if (entry_installed(extract_path, entry->path, entry->size, entry->crc, plan->previous)) {
+        *out_skipped = 1;
+        return EXTRACTION_DONE;
+    }
+    if (entry->data) {
+        return write_entry(extract_path, entry->data, (size_t)entry->size) == 0 ? EXTRACTION_DONE : EXTRACTION_FAILED;
+    }
+    if (!entry->deferred) {
+        return extract_entry(zip_handle, extract_path, buf, INSTALL_EXTRACT_BUFFER_SIZE) == 0
+                ? EXTRACTION_DONE : EXTRACTION_FAILED;
+    }
+
+    snprintf(temp_path, sizeof(temp_path), "%s.part", extract_path);
+    if (extract_entry(zip_handle, temp_path, buf, INSTALL_EXTRACT_BUFFER_SIZE) != 0 || rename(temp_path, extract_path) != 0) {
+        unlink(temp_path);
+        return EXTRACTION_FAILED;
+    }
+    return EXTRACTION_DONE;
+}
+
+// Take a deferred entry for the calling thread, unless a worker or a waiting thread already did
+static int claim_deferred_entry(ExtractionEntry *entry) {
+    ExtractionStatus pending = EXTRACTION_PENDING;
+    return __atomic_compare_exchange_n(&entry->status, &pending, EXTRACTION_RUNNING, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+// Publish the status of a deferred entry to the threads waiting for it
+static void finish_deferred_entry(ExtractionEntry *entry, ExtractionStatus status) {
+    pthread_mutex_lock(&g_progress.lock);
+    __atomic_store_n(&entry->status, status, __ATOMIC_RELEASE);
+    g_progress.failed |= status == EXTRACTION_FAILED;
+    pthread_cond_broadcast(&g_progress.changed);
+    pthread_mutex_unlock(&g_progress.lock);
+}
+
+// Install one entry assigned to the worker, from the current entry of the reader for a zip archive
+static void extraction_worker_install(ExtractionWorker *worker, ExtractionEntry *entry, void *zip_handle, void *buf) {
+    int skipped = 0;
+    if (entry->deferred) {
+        if (!claim_deferred_entry(entry)) return;
+        const ExtractionStatus status = install_entry(worker->plan, entry, zip_handle, buf, &skipped);
+        worker->skipped += (size_t)skipped;
+        finish_deferred_entry(entry, status);
+        return;
+    }
+
+    entry->status = install_entry(worker->plan, entry, zip_handle, buf, &skipped);
+    worker->skipped += (size_t)skipped;
+}
+
+// Once every worker is done with the other files, only deferred entries are left
+static void extraction_worker_past_sources(ExtractionWorker *worker) {
+    const ExtractionPlan *plan = worker->plan;
+    int failed = 0;
+    for (size_t i = 0; i < plan->count; i++) {
+        const ExtractionEntry *entry = &plan->entries[i];
+        failed |= entry->worker == worker->id && !entry->deferred && entry->status == EXTRACTION_FAILED;
+    }
+
+    pthread_mutex_lock(&g_progress.lock);
+    g_progress.failed |= failed;
+    if (++g_progress.workers_past_sources == plan->worker_count) {
+        g_progress.sources_ready = 1;
+        pthread_cond_broadcast(&g_progress.changed);
+    }
+    pthread_mutex_unlock(&g_progress.lock);
+}
+
+/**
+ * Walk every archive with a reader of its own and extract the files assigned to this worker,
+ * the deferred ones in a second walk. Walking a central directory only parses headers, it is cheap
+ * next to inflating. The files of the pack are written straight from memory.
+ */
+static void* extraction_worker_run(void *arg) {
+    ExtractionWorker *worker = arg;
+    ExtractionPlan *plan = worker->plan;
+
+    void *buf = malloc(INSTALL_EXTRACT_BUFFER_SIZE);
+    if (!buf) {
+        fprintf(stderr, "Failed to allocate buffer\n");
+        extraction_worker_past_sources(worker);
+        return NULL;
+    }
+
+    for (int deferred = 0; deferred <= 1; deferred++) {
+        size_t index = 0;
+        for (size_t a = 0; a < plan->archive_count; a++) {
+            // The entries of an archive are contiguous in the plan
+            while (index < plan->count && plan->entries[index].archive < a) {
+                index++;
+            }
+
+            // Only zip entries are deferred
+            if (plan->archives[a].packed) {
+                for (; !deferred && index < plan->count && plan->entries[index].archive == a; index++) {
+                    ExtractionEntry *entry = &plan->entries[index];
+                    if (entry->worker == worker->id && entry->status == EXTRACTION_PENDING) {
+                        extraction_worker_install(worker, entry, NULL, buf);
+                    }
+                }
+                if (!deferred) {
+                    archive_completed(a, monotonic_now_ns());
+                }
+                continue;
+            }
+
+            void *stream = NULL;
+            void *zip_handle = open_archive_reader(&plan->archives[a], &stream);
+            int32_t err = zip_handle ? mz_zip_reader_goto_first_entry(zip_handle) : MZ_STREAM_ERROR;
+
+            // Entries left pending if the archive cannot be walked fail the install
+            for (; err == MZ_OK && index < plan->count && plan->entries[index].archive == a;
+                   index++, err = mz_zip_reader_goto_next_entry(zip_handle)) {
+                ExtractionEntry *entry = &plan->entries[index];
+                // The status of an entry is only touched by its worker, check the owner first
+                if (entry->worker != worker->id || entry->deferred != deferred) continue;
+                if (__atomic_load_n(&entry->status, __ATOMIC_ACQUIRE) != EXTRACTION_PENDING) continue;
+
+                extraction_worker_install(worker, entry, zip_handle, buf);
+            }
+
+            if (zip_handle) {
+                close_archive_reader(zip_handle, stream);
+            }
+            archive_completed(a, monotonic_now_ns());
+        }
+
+        if (!deferred) {
+            extraction_worker_past_sources(worker);
+        }
+    }
+
+    free(buf);
+    return NULL;
+}
+
+/**
+ * Extract a deferred entry on the calling thread, claimed while its worker had not reached it yet
+ */
+static void install_deferred_entry(ExtractionPlan *plan, ExtractionEntry *entry) {
+    ExtractionStatus status = EXTRACTION_FAILED;
+    int skipped = 0;
+    void *buf = malloc(INSTALL_EXTRACT_BUFFER_SIZE);
+    void *stream = NULL;
+    void *zip_handle = buf ? open_archive_reader(&plan->archives[entry->archive], &stream) : NULL;
+
+    if (zip_handle && mz_zip_reader_locate_entry(zip_handle, entry->path, 0) == MZ_OK) {
+        status = install_entry(plan, entry, zip_handle, buf, &skipped);
+    }
+
+    if (zip_handle) {
+        close_archive_reader(zip_handle, stream);
+    }
+    free(buf);
+    finish_deferred_entry(entry, status);
+}
+
+static ExtractionEntry* find_deferred_entry(ExtractionPlan *plan, const char *path) {
+    for (size_t i = 0; i < plan->count; i++) {
+        ExtractionEntry *entry = &plan->entries[i];
+        if (entry->deferred && strcmp(entry->path, path) == 0) return entry;
+    }
+    return NULL;
+}
+
+static size_t extraction_worker_count(size_t file_count) {
+    const long online = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t count = online > 0 ? (size_t)online : 1;
+    if (count > INSTALL_MAX_WORKERS) count = INSTALL_MAX_WORKERS;
+    // Below a few files per worker, starting threads costs more than it saves
+    const size_t useful = file_count / INSTALL_MIN_FILES_PER_WORKER;
+    if (count > useful) count = useful;
+    return count > 0 ? count : 1;
+}
+
+/**
+ * Extract the archives into a directory with a pool of workers, skipping the files already installed
+ *
+ * The central directories are read first to create every directory up front and to spread
+ * the files over the workers. Each worker then reads the archives through its own readers.
+ *
+ * @param previous Manifest of the previous install, NULL to check every file against its CRC
+ * @param installed Receives every file present once extraction is done
+ * @return 0 on success, -1 if an archive could not be read or any file could not be extracted
+ */
+static int extract_archives(const EmbeddedArchive *archives, size_t archive_count, const char *extract_dir,
+                            const InstallManifest *previous, InstallManifest *installed) {
+    ExtractionPlan plan = {
+        .archives = archives,
+        .archive_count = archive_count,
+        .entries = NULL,
+        .count = 0,
+        .capacity = 0,
+        .extract_dir = extract_dir,
+        .previous = previous,
+        .worker_count = 1
+    };
+    ExtractionWorker workers[INSTALL_MAX_WORKERS];
     int result = 0;
 
-    if (!install_dir) {
-        fprintf(stderr, "Install directory cannot be NULL\n");
+    if (plan_read_entries(&plan) != 0 || plan_ignore_overwritten(&plan) != 0 || plan_create_directories(&plan) != 0) {
+        plan_free(&plan);
         return -1;
     }
 
-    printf("Installing embedded files to: %s\n", install_dir);
+    size_t file_count = 0;
+    for (size_t i = 0; i < plan.count; i++) {
+        file_count += plan.entries[i].status == EXTRACTION_PENDING;
+    }
+
+    size_t worker_count = extraction_worker_count(file_count);
+    plan_assign_workers(&plan, worker_count);
+    plan.worker_count = worker_count;
+
+    // Threads waiting for a deferred entry may now look it up, or extract it themselves
+    pthread_mutex_lock(&g_progress.lock);
+    g_progress.plan = &plan;
+    g_progress.workers_past_sources = 0;
+    pthread_mutex_unlock(&g_progress.lock);
+
+    // The calling thread is the first worker, it also takes the share of any worker that could not start
+    size_t started = 1;
+    for (size_t w = 0; w < worker_count; w++) {
+        workers[w] = (ExtractionWorker){ .plan = &plan, .id = w, .skipped = 0 };
+    }
+    for (; started < worker_count; started++) {
+        if (pthread_create(&workers[started].thread, NULL, extraction_worker_run, &workers[started]) != 0) {
+            break;
+        }
+    }
+    for (size_t w = 0; w < worker_count; w++) {
+        if (w == 0 || w >= started) {
+            extraction_worker_run(&workers[w]);
+        }
+    }
+
+    size_t skipped = 0;
+    for (size_t w = 0; w < worker_count; w++) {
+        if (w > 0 && w < started) {
+            pthread_join(workers[w].thread, NULL);
+        }
+        skipped += workers[w].skipped;
+    }
+
+    // Every file is in place once the waiting threads are done with the entries they claimed
+    pthread_mutex_lock(&g_progress.lock);
+    while (g_progress.helpers > 0) {
+        pthread_cond_wait(&g_progress.changed, &g_progress.lock);
+    }
+    g_progress.plan = NULL;
+    g_progress.files_ready = 1;
+    pthread_cond_broadcast(&g_progress.changed);
+    pthread_mutex_unlock(&g_progress.lock);
+
+    for (size_t i = 0; i < plan.count; i++) {
+        const ExtractionEntry *entry = &plan.entries[i];
+        if (entry->status == EXTRACTION_DONE) {
+            if (installed && manifest_add(installed, entry->path, entry->size, entry->crc) != 0) {
+                result = -1;
+            }
+        } else if (entry->status != EXTRACTION_IGNORED) {
+            result = -1;
+        }
+    }
+
+    printf("%zu files extracted by %zu workers, %zu already installed\n", file_count - skipped, started, skipped);
+
+    plan_free(&plan);
+    return result;
+}
+
+/**
+ * Extract and write every embedded file that is missing or differs, then record the install
+ *
+ * @param previous Manifest of the previous install, NULL to check every file against its CRC
+ * @param vfs 1 to leave the Ruby sources of the standard library to the embedded VFS
+ */
+static int install_missing_files(const char *install_dir, const char *header, const InstallManifest *previous, int vfs) {
+    int result = 0;
+    InstallManifest installed = {0};
 
     // Create base installation directory
     if (mkdir(install_dir, 0755) != 0 && errno != EEXIST) {
@@ -220,34 +1052,36 @@ int install_embedded_files(const char *install_dir) {
         return -1;
     }
 
-    // Extract Ruby standard library ZIP
-    printf("Extracting Ruby standard library...\n");
-    size_t ruby_stdlib_size = _binary_ruby_stdlib_zip_end - _binary_ruby_stdlib_zip_start;
-    if (mkdir(install_dir, 0755) != 0 && errno != EEXIST) {
-        fprintf(stderr, "Failed to create ruby-stdlib directory: %s\n", strerror(errno));
-        result = -1;
-    } else {
-        if (extract_zip_from_memory(_binary_ruby_stdlib_zip_start, ruby_stdlib_size, install_dir) != 0) {
-            fprintf(stderr, "Failed to extract Ruby standard library\n");
-            result = -1;
+    // Write the pack (Ruby standard library and FIFO interpreter) and extract the platform specifics together,
+    // the latter wins on common files
+    printf("Extracting Ruby standard library and platform specifics...\n");
+    // In InstallArchive order
+    const EmbeddedArchive archives[] = {
+        {
+            .name = "embedded pack",
+            .data = NULL,
+            .size = 0,
+            .packed = 1,
+            .vfs_served = vfs
+        },
+        {
+            .name = "ruby-stdlib-ext.zip",
+            .data = _binary_ruby_stdlib_ext_zip_start,
+            .size = (size_t)(_binary_ruby_stdlib_ext_zip_end - _binary_ruby_stdlib_ext_zip_start),
+            .packed = 0,
+            .vfs_served = 0
         }
-    }
-
-    printf("Extracting Ruby standard library platform specifics...\n");
-    size_t ruby_stdlib_ext_size = _binary_ruby_stdlib_ext_zip_end - _binary_ruby_stdlib_ext_zip_start;
-    if (extract_zip_from_memory(_binary_ruby_stdlib_ext_zip_start, ruby_stdlib_ext_size, install_dir) != 0) {
-        fprintf(stderr, "Failed to extract Ruby standard library extensions\n");
+    };
+    if (extract_archives(archives, sizeof(archives) / sizeof(archives[0]), install_dir, previous, &installed) != 0) {
+        fprintf(stderr, "Failed to extract Ruby standard library\n");
         result = -1;
     }
 
-    // Write FIFO interpreter Ruby file
-    printf("Installing FIFO interpreter...\n");
-    size_t fifo_interpreter_size = _binary_fifo_interpreter_rb_end - _binary_fifo_interpreter_rb_start;
-    snprintf(full_path, sizeof(full_path), "%s/fifo_interpreter.rb", install_dir);
-    if (write_binary_file(full_path, _binary_fifo_interpreter_rb_start, fifo_interpreter_size) != 0) {
-        fprintf(stderr, "Failed to install FIFO interpreter\n");
-        result = -1;
+    // Without a manifest, the next start checks the files again and only redoes what is still missing
+    if (result == 0) {
+        result = manifest_write(install_dir, header, &installed);
     }
+    manifest_free(&installed);
 
     if (result == 0) {
         printf("Installation completed successfully!\n");
@@ -258,6 +1092,190 @@ int install_embedded_files(const char *install_dir) {
     return result;
 }
 
+// Start publishing the progress of an install, see install_wait()
+static void progress_start(void) {
+    pthread_mutex_lock(&g_progress.lock);
+    g_progress.running = 1;
+    g_progress.sources_ready = 0;
+    g_progress.files_ready = 0;
+    g_progress.failed = 0;
+    pthread_mutex_unlock(&g_progress.lock);
+}
+
+static void progress_finish(int result) {
+    pthread_mutex_lock(&g_progress.lock);
+    g_progress.running = 0;
+    g_progress.sources_ready = 1;
+    g_progress.files_ready = 1;
+    g_progress.failed |= result != 0;
+    pthread_cond_broadcast(&g_progress.changed);
+    pthread_mutex_unlock(&g_progress.lock);
+}
+
+static int install_embedded_locked(const char *install_dir, int vfs) {
+    char header[1024];
+
+    if (!install_dir) {
+        fprintf(stderr, "Install directory cannot be NULL\n");
+        return -1;
+    }
+
+    const int header_length = build_manifest_header(header, sizeof(header), vfs);
+    if (header_length < 0) {
+        fprintf(stderr, "Failed to build the install manifest header\n");
+        return -1;
+    }
+
+    reset_archive_completion();
+
+    // Warm start: a single read of the manifest header
+    if (manifest_matches(install_dir, header, (size_t)header_length)) {
+        const uint64_t checked_ns = monotonic_now_ns();
+        for (size_t a = 0; a < INSTALL_ARCHIVE_COUNT; a++) {
+            archive_completed(a, checked_ns);
+        }
+        printf("Embedded files already installed in: %s\n", install_dir);
+        return 0;
+    }
+
+    printf("Installing embedded files to: %s\n", install_dir);
+
+    InstallManifest previous = {0};
+    manifest_load(install_dir, &previous);
+    const int result = install_missing_files(install_dir, header, &previous, vfs);
+    manifest_free(&previous);
+    return result;
+}
+
+static int install_embedded(const char *install_dir, int vfs) {
+    progress_start();
+    const int result = install_embedded_locked(install_dir, vfs);
+    progress_finish(result);
+    return result;
+}
+
+// Main installation function
+int install_embedded_files(const char *install_dir) {
+    return install_embedded(install_dir, 0);
+}
+
+int install_embedded_files_except_vfs(const char *install_dir) {
+    return install_embedded(install_dir, 1);
+}
+
+static void* install_thread_run(void *arg) {
+    InstallThreadArgs *args = arg;
+    const int result = install_embedded_locked(args->install_dir, args->vfs);
+    progress_finish(result);
+
+    if (args->on_complete) {
+        args->on_complete(result, args->user_data);
+    }
+    free(args->install_dir);
+    free(args);
+    return NULL;
+}
+
+int install_embedded_files_start(const char *install_dir, int vfs, InstallCompletion on_complete, void *user_data) {
+    InstallThreadArgs *args = malloc(sizeof(InstallThreadArgs));
+    if (!args || !install_dir || !(args->install_dir = strdup(install_dir))) {
+        free(args);
+        return -1;
+    }
+    args->vfs = vfs;
+    args->on_complete = on_complete;
+    args->user_data = user_data;
+
+    // Running before the thread even starts: a wait right after this call cannot miss the install
+    progress_start();
+
+    pthread_t thread;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    const int created = pthread_create(&thread, &attributes, install_thread_run, args) == 0;
+    pthread_attr_destroy(&attributes);
+
+    if (!created) {
+        progress_finish(-1);
+        free(args->install_dir);
+        free(args);
+        return -1;
+    }
+    return 0;
+}
+
+int install_wait(InstallStage stage) {
+    pthread_mutex_lock(&g_progress.lock);
+    while (g_progress.running && (stage != INSTALL_STAGE_SOURCES || !g_progress.sources_ready)) {
+        pthread_cond_wait(&g_progress.changed, &g_progress.lock);
+    }
+    const int result = g_progress.failed ? -1 : 0;
+    pthread_mutex_unlock(&g_progress.lock);
+    return result;
+}
+
+int install_wait_file(const char *path) {
+    pthread_mutex_lock(&g_progress.lock);
+    while (g_progress.running && !g_progress.files_ready) {
+        ExtractionEntry *entry = g_progress.plan && path ? find_deferred_entry(g_progress.plan, path) : NULL;
+        if (!entry) {
+            // Not deferred, or not part of the install: in place with the other files
+            if (g_progress.sources_ready) break;
+        } else {
+            const ExtractionStatus status = __atomic_load_n(&entry->status, __ATOMIC_ACQUIRE);
+            if (status != EXTRACTION_PENDING && status != EXTRACTION_RUNNING) {
+                pthread_mutex_unlock(&g_progress.lock);
+                return status == EXTRACTION_FAILED ? -1 : 0;
+            }
+
+            // Not reached by its worker yet: extract it now rather than after the files before it
+            if (status == EXTRACTION_PENDING && claim_deferred_entry(entry)) {
+                ExtractionPlan *plan = g_progress.plan;
+                g_progress.helpers++;
+                pthread_mutex_unlock(&g_progress.lock);
+                install_deferred_entry(plan, entry);
+                pthread_mutex_lock(&g_progress.lock);
+                g_progress.helpers--;
+                pthread_cond_broadcast(&g_progress.changed);
+                continue;
+            }
+        }
+        pthread_cond_wait(&g_progress.changed, &g_progress.lock);
+    }
+    const int result = g_progress.failed ? -1 : 0;
+    pthread_mutex_unlock(&g_progress.lock);
+    return result;
+}
+
+int install_pending(void) {
+    pthread_mutex_lock(&g_progress.lock);
+    const int running = g_progress.running && !g_progress.files_ready;
+    pthread_mutex_unlock(&g_progress.lock);
+    return running;
+}
+
+int repair_embedded_files(const char *install_dir) {
+    char header[1024];
+
+    if (!install_dir) {
+        fprintf(stderr, "Install directory cannot be NULL\n");
+        return -1;
+    }
+
+    if (build_manifest_header(header, sizeof(header), 0) < 0) {
+        fprintf(stderr, "Failed to build the install manifest header\n");
+        return -1;
+    }
+
+    reset_archive_completion();
+    printf("Verifying embedded files in: %s\n", install_dir);
+    progress_start();
+    const int result = install_missing_files(install_dir, header, NULL, 0);
+    progress_finish(result);
+    return result;
+}
+
 // Convenience function to get default install directory (can be customized)
 const char* get_default_install_dir(void) {
     static char install_dir[1024];
@@ -278,21 +1296,21 @@ const char* get_default_install_dir(void) {
     return install_dir;
 }
 
-// Function to check if installation is needed (files exist and are valid)
+uint64_t install_get_archive_completion(InstallArchive archive) {
+    if ((unsigned)archive >= INSTALL_ARCHIVE_COUNT) return 0;
+    return __atomic_load_n(&g_archive_completion[archive], __ATOMIC_RELAXED);
+}
+
+// Installation is up to date when the manifest was written by this very build
 int installation_needed(const char *install_dir) {
-    char check_path[1024];
-    struct stat st;
+    char header[1024];
 
-    // Check if key files exist
-    snprintf(check_path, sizeof(check_path), "%s/fifo_interpreter.rb", install_dir);
-    if (stat(check_path, &st) != 0) return 1;
+    if (!install_dir) return -1;
 
-    // TODO modify this (this check is not working)
-    snprintf(check_path, sizeof(check_path), "%s/ruby-stdlib", install_dir);
-    if (stat(check_path, &st) != 0) return 1;
+    const int header_length = build_manifest_header(header, sizeof(header), 0);
+    if (header_length < 0) return -1;
 
-    // TODO change to 0
-    return 1; // Installation not needed
+    return manifest_matches(install_dir, header, (size_t)header_length) ? 0 : 1;
 }
 
 #else // !HAS_EMBEDDED_DATA
@@ -302,6 +1320,14 @@ int install_embedded_files(const char *install_dir) {
     return -1;
 }
 
+int install_embedded_files_except_vfs(const char *install_dir) {
+    return install_embedded_files(install_dir);
+}
+
+int repair_embedded_files(const char *install_dir) {
+    return install_embedded_files(install_dir);
+}
+
 const char* get_default_install_dir(void) {
     return NULL;
 }
@@ -310,4 +1336,24 @@ int installation_needed(const char *install_dir) {
     return -1;
 }
 
+uint64_t install_get_archive_completion(InstallArchive archive) {
+    return 0;
+}
+
+int install_embedded_files_start(const char *install_dir, int vfs, InstallCompletion on_complete, void *user_data) {
+    return -1;
+}
+
+int install_wait(InstallStage stage) {
+    return 0;
+}
+
+int install_wait_file(const char *path) {
+    return 0;
+}
+
+int install_pending(void) {
+    return 0;
+}
+
 #endif // HAS_EMBEDDED_DATA
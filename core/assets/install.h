@@ -1,6 +1,8 @@
 #ifndef INSTALL_H
 #define INSTALL_H
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -9,14 +11,92 @@ extern "C" {
  * Install all embedded files to the specified directory.
  *
  * This function will:
- * 1. Extract the Ruby standard library ZIP to <install_dir>/ruby-stdlib/
- * 2. Write fifo_interpreter.rb to <install_dir>/fifo_interpreter.rb
+ * 1. Write the files of the embedded pack (the Ruby standard library and fifo_interpreter.rb,
+ *    see embedded_pack.h) to <install_dir>
+ * 2. Extract the platform specific ZIP of the standard library to <install_dir>
+ * 3. Record the install in <install_dir>/.install-manifest
+ *
+ * Nothing is extracted when the manifest matches the embedded files (see installation_needed).
+ * Otherwise only the files that are missing or differ are written: files recorded by the previous
+ * manifest with the same size and CRC are kept, any other file is checked against its CRC.
  *
  * @param install_dir The directory where files should be installed
  * @return 0 on success, -1 on error
  */
 int install_embedded_files(const char *install_dir);
 
+/**
+ * Same as install_embedded_files, except for the Ruby sources of the standard library:
+ * they stay in memory, served by the embedded VFS (see embedded_vfs.h). Its other files,
+ * the platform specific archive and fifo_interpreter.rb are still written.
+ *
+ * @param install_dir The directory where files should be installed
+ * @return 0 on success, -1 on error
+ */
+int install_embedded_files_except_vfs(const char *install_dir);
+
+/**
+ * Called on the install thread once an install started by install_embedded_files_start is over
+ *
+ * @param result 0 on success, -1 on error
+ * @param user_data Pointer given to install_embedded_files_start
+ */
+typedef void (*InstallCompletion)(int result, void *user_data);
+
+/**
+ * Run install_embedded_files, or install_embedded_files_except_vfs when 'vfs' is 1, on a thread
+ * of its own and return at once: the caller waits for the files it needs with install_wait and
+ * install_wait_file.
+ *
+ * The files are extracted in two stages. First every file but the native extensions loaded by
+ * 'require' (INSTALL_STAGE_SOURCES): the Ruby sources, rbconfig.rb, the encodings and transcoders
+ * the VM loads by itself. Then those native extensions, each one written aside and renamed so that
+ * it is never seen partially written.
+ *
+ * @param install_dir The directory where files should be installed
+ * @param vfs 1 to leave the Ruby sources of the standard library to the embedded VFS
+ * @param on_complete Called once the install is over, NULL for none
+ * @param user_data Passed to 'on_complete'
+ * @return 0 if the install started, -1 if its thread could not be created (nothing was installed)
+ */
+int install_embedded_files_start(const char *install_dir, int vfs, InstallCompletion on_complete, void *user_data);
+
+typedef enum {
+    INSTALL_STAGE_SOURCES = 0,   // Every file but the native extensions loaded by 'require'
+    INSTALL_STAGE_COMPLETE       // Install over, its manifest written
+} InstallStage;
+
+/**
+ * Wait until the install running in this process reached a stage. Returns at once when none is running.
+ *
+ * @return 0 once reached, -1 if a file could not be installed
+ */
+int install_wait(InstallStage stage);
+
+/**
+ * Wait until a file of the running install is in place. When it is a native extension no worker
+ * reached yet, the calling thread extracts it: it does not wait for the files before it.
+ * Other files are waited for as INSTALL_STAGE_SOURCES. Returns at once when no install is running.
+ *
+ * @param path Path relative to the install directory, e.g. "ruby/3.3.0/x86_64-linux/digest.so"
+ * @return 0 once in place (or not part of the install), -1 if it could not be installed
+ */
+int install_wait_file(const char *path);
+
+/**
+ * @return 1 while an install is running and some of its files are not in place yet, 0 otherwise
+ */
+int install_pending(void);
+
+/**
+ * Check every installed file against the CRC of its embedded copy, rewrite the ones that differ
+ * and record the install again. Slower than install_embedded_files, which trusts the manifest.
+ *
+ * @param install_dir The directory where files are installed
+ * @return 0 on success, -1 on error
+ */
+int repair_embedded_files(const char *install_dir);
+
 /**
  * Get a default installation directory.
  *
@@ -29,10 +109,34 @@ int install_embedded_files(const char *install_dir);
  */
 const char* get_default_install_dir(void);
 
+/**
+ * Archives written by install_embedded_files, in the order each worker extracts them
+ */
+typedef enum {
+    INSTALL_ARCHIVE_PACK = 0,        // Embedded pack: Ruby standard library and fifo_interpreter.rb
+    INSTALL_ARCHIVE_STDLIB_EXT = 1,  // ruby-stdlib-ext.zip: platform specific files
+    INSTALL_ARCHIVE_COUNT
+} InstallArchive;
+
+/**
+ * Time at which every file of an archive was in place, during the last install of this process.
+ *
+ * The archives are extracted together by the same workers, each one going through the pack first:
+ * this is when the last worker got past the archive. When the manifest matched, nothing is extracted
+ * and this is when it was checked.
+ *
+ * @param archive Archive to look up
+ * @return CLOCK_MONOTONIC time in nanoseconds, 0 if no install completed it
+ */
+uint64_t install_get_archive_completion(InstallArchive archive);
+
 /**
  * Check if installation is needed.
  *
- * Checks if the key files already exist in the install directory.
+ * Reads the header of the install manifest: it names the ABI and identifies the embedded pack
+ * (count and hash of its files) and archive (size and hash of its central directory).
+ * Only a complete install writes the manifest.
+ * Answers for install_embedded_files: an install made by install_embedded_files_except_vfs needs one.
  *
  * @param install_dir Directory to check
  * @return 1 if installation is needed, 0 if files already exist, -1 on error
@@ -0,0 +1,287 @@
+# Pack embedded files into a single uncompressed blob, indexed by a perfect hash of their paths.
+# Run by embed_pack() (see embed_binary.cmake) with cmake -P and the following definitions:
+#   PACK_FILES     Files added under their own name, separated by '|'
+#   PACK_ARCHIVES  Zip archives unpacked into the pack, their files keep their path in the archive, separated by '|'
+#   PACK_STAGING   Directory the archives are unpacked into
+#   PACK_ASM       Assembly file to write, holding the content of every file
+#   PACK_INDEX     C file to write, defining the embedded_pack_index (see embedded_pack.h)
+#
+# The content starts on a page boundary and every file on a 16 bytes boundary, followed by a null byte:
+# in the read-only data of the library, a file is directly usable from its pointer and size.
+# Directories of the archives are packed as empty entries whose path ends with '/'.
+cmake_minimum_required(VERSION 3.19)
+
+# Must match embedded_pack.c
+set(PACK_FNV_OFFSET 0x811C9DC5)
+set(PACK_FNV_PRIME 16777619)
+set(PACK_BUCKET_SEED 0)
+set(PACK_SLOT_SEED 0x9E3779B9)
+# Alignment of the whole pack, then of each file
+set(PACK_ALIGNMENT 4096)
+set(PACK_ENTRY_ALIGNMENT 16)
+# Average number of paths per bucket of the perfect hash, and at most how many displacements are tried for one
+set(PACK_KEYS_PER_BUCKET 4)
+set(PACK_MAX_DISPLACEMENT 65536)
+
+foreach(variable PACK_STAGING PACK_ASM PACK_INDEX)
+  if(NOT DEFINED ${variable})
+    message(FATAL_ERROR "pack_assets.cmake: ${variable} is not set")
+  endif()
+endforeach()
+
+# Hash of 'path' for both the bucket and the slot: seeded FNV-1a, then mixed
+function(pack_hash path out_bucket_hash out_slot_hash)
+  string(HEX "${path}" hex)
+  string(LENGTH "${hex}" hex_length)
+  math(EXPR bucket_hash "${PACK_FNV_OFFSET} ^ ${PACK_BUCKET_SEED}")
+  math(EXPR slot_hash "${PACK_FNV_OFFSET} ^ ${PACK_SLOT_SEED}")
+  set(position 0)
+  while(position LESS hex_length)
+    string(SUBSTRING "${hex}" ${position} 2 byte)
+    math(EXPR bucket_hash "((${bucket_hash} ^ 0x${byte}) * ${PACK_FNV_PRIME}) & 0xFFFFFFFF")
+    math(EXPR slot_hash "((${slot_hash} ^ 0x${byte}) * ${PACK_FNV_PRIME}) & 0xFFFFFFFF")
+    math(EXPR position "${position} + 2")
+  endwhile()
+  foreach(hash bucket_hash slot_hash)
+    math(EXPR ${hash} "${${hash}} ^ (${${hash}} >> 16)")
+    math(EXPR ${hash} "(${${hash}} * 0x7FEB352D) & 0xFFFFFFFF")
+    math(EXPR ${hash} "${${hash}} ^ (${${hash}} >> 15)")
+  endforeach()
+  set(${out_bucket_hash} ${bucket_hash} PARENT_SCOPE)
+  set(${out_slot_hash} ${slot_hash} PARENT_SCOPE)
+endfunction()
+
+function(pack_is_prime number out_var)
+  set(divisor 2)
+  set(prime TRUE)
+  math(EXPR square "${divisor} * ${divisor}")
+  while(NOT square GREATER number)
+    math(EXPR remainder "${number} % ${divisor}")
+    if(remainder EQUAL 0)
+      set(prime FALSE)
+      break()
+    endif()
+    math(EXPR divisor "${divisor} + 1")
+    math(EXPR square "${divisor} * ${divisor}")
+  endwhile()
+  set(${out_var} ${prime} PARENT_SCOPE)
+endfunction()
+
+# Collect the files: name -> source path. A file of a later input replaces one of the same name.
+string(REPLACE "|" ";" pack_files "${PACK_FILES}")
+string(REPLACE "|" ";" pack_archives "${PACK_ARCHIVES}")
+set(names "")
+set(fingerprint_input "embedded-pack 1\n")
+
+file(REMOVE_RECURSE "${PACK_STAGING}")
+set(archive_index 0)
+foreach(archive IN LISTS pack_archives)
+  set(destination "${PACK_STAGING}/${archive_index}")
+  file(ARCHIVE_EXTRACT INPUT "${archive}" DESTINATION "${destination}")
+  file(GLOB_RECURSE archive_paths LIST_DIRECTORIES true RELATIVE "${destination}" "${destination}/*")
+  foreach(name IN LISTS archive_paths)
+    if(IS_DIRECTORY "${destination}/${name}")
+      set(name "${name}/")
+      set(SOURCE_${name} "")
+    else()
+      set(SOURCE_${name} "${destination}/${name}")
+    endif()
+    list(APPEND names "${name}")
+  endforeach()
+  file(SHA256 "${archive}" archive_hash)
+  get_filename_component(archive_name "${archive}" NAME)
+  string(APPEND fingerprint_input "archive ${archive_name} ${archive_hash}\n")
+  math(EXPR archive_index "${archive_index} + 1")
+endforeach()
+
+foreach(source IN LISTS pack_files)
+  get_filename_component(name "${source}" NAME)
+  set(SOURCE_${name} "${source}")
+  list(APPEND names "${name}")
+  file(SHA256 "${source}" source_hash)
+  string(APPEND fingerprint_input "file ${name} ${source_hash}\n")
+endforeach()
+
+list(REMOVE_DUPLICATES names)
+list(SORT names)
+list(LENGTH names count)
+foreach(name IN LISTS names)
+  if(name MATCHES "[\"\\\\]|[^ -~]")
+    message(FATAL_ERROR "pack_assets.cmake: unsupported character in the path ${name}")
+  endif()
+endforeach()
+
+# Perfect hash (hash and displace): the paths are split into buckets by a first hash, then each bucket,
+# largest first, gets the smallest displacement placing all its paths in free slots of the table:
+#   slot = (slot_hash + displacement * (bucket_hash % (slot_count - 1) + 1)) % slot_count
+math(EXPR bucket_count "(${count} + ${PACK_KEYS_PER_BUCKET} - 1) / ${PACK_KEYS_PER_BUCKET}")
+if(bucket_count LESS 1)
+  set(bucket_count 1)
+endif()
+# A prime table at most 80% full
+math(EXPR slot_count "(${count} * 5 + 3) / 4")
+if(slot_count LESS 3)
+  set(slot_count 3)
+endif()
+pack_is_prime(${slot_count} prime)
+while(NOT prime)
+  math(EXPR slot_count "${slot_count} + 1")
+  pack_is_prime(${slot_count} prime)
+endwhile()
+math(EXPR step_modulo "${slot_count} - 1")
+
+set(largest_bucket 0)
+set(key 0)
+foreach(name IN LISTS names)
+  pack_hash("${name}" bucket_hash slot_hash)
+  math(EXPR bucket "${bucket_hash} % ${bucket_count}")
+  math(EXPR KEY_STEP_${key} "${bucket_hash} % ${step_modulo} + 1")
+  set(KEY_SLOT_HASH_${key} ${slot_hash})
+  list(APPEND BUCKET_${bucket} ${key})
+  list(LENGTH BUCKET_${bucket} bucket_size)
+  if(bucket_size GREATER largest_bucket)
+    set(largest_bucket ${bucket_size})
+  endif()
+  math(EXPR key "${key} + 1")
+endforeach()
+
+math(EXPR last_bucket "${bucket_count} - 1")
+set(size ${largest_bucket})
+while(size GREATER 0)
+  foreach(bucket RANGE ${last_bucket})
+    list(LENGTH BUCKET_${bucket} bucket_size)
+    if(NOT bucket_size EQUAL size)
+      continue()
+    endif()
+    set(displacement 0)
+    while(TRUE)
+      set(taken "")
+      set(fits TRUE)
+      foreach(key IN LISTS BUCKET_${bucket})
+        math(EXPR slot "(${KEY_SLOT_HASH_${key}} + ${displacement} * ${KEY_STEP_${key}}) % ${slot_count}")
+        if(DEFINED SLOT_${slot} OR slot IN_LIST taken)
+          set(fits FALSE)
+          break()
+        endif()
+        list(APPEND taken ${slot})
+      endforeach()
+      if(fits)
+        break()
+      endif()
+      math(EXPR displacement "${displacement} + 1")
+      if(NOT displacement LESS PACK_MAX_DISPLACEMENT)
+        message(FATAL_ERROR "pack_assets.cmake: no perfect hash found for bucket ${bucket}, change the seeds")
+      endif()
+    endwhile()
+    set(DISPLACEMENT_${bucket} ${displacement})
+    foreach(key slot IN ZIP_LISTS BUCKET_${bucket} taken)
+      math(EXPR SLOT_${slot} "${key} + 1")
+    endforeach()
+  endforeach()
+  math(EXPR size "${size} - 1")
+endwhile()
+
+# Content: one .incbin per file, padded with at least one null byte up to the alignment of the next file
+set(asm "/* Generated by pack_assets.cmake, do not edit */\n")
+string(APPEND asm "    .section .rodata.embedded_pack,\"a\"\n")
+string(APPEND asm "    .balign ${PACK_ALIGNMENT}\n")
+string(APPEND asm "    .globl embedded_pack_data\n")
+string(APPEND asm "    .hidden embedded_pack_data\n")
+string(APPEND asm "    .type embedded_pack_data, %object\n")
+string(APPEND asm "embedded_pack_data:\n")
+
+set(entries "")
+set(paths "")
+set(offset 0)
+set(path_offset 0)
+foreach(name IN LISTS names)
+  set(source "${SOURCE_${name}}")
+  if(NOT source STREQUAL "")
+    file(SIZE "${source}" size)
+    string(APPEND asm "    .incbin \"${source}\"\n")
+  else()
+    set(size 0)
+  endif()
+  math(EXPR padding "${PACK_ENTRY_ALIGNMENT} - ${size} % ${PACK_ENTRY_ALIGNMENT}")
+  string(APPEND asm "    .zero ${padding}\n")
+  string(APPEND entries "    { ${path_offset}, ${offset}, ${size} },\n")
+  string(APPEND paths "    \"${name}\\0\"\n")
+  string(LENGTH "${name}" name_length)
+  math(EXPR path_offset "${path_offset} + ${name_length} + 1")
+  math(EXPR offset "${offset} + ${size} + ${padding}")
+endforeach()
+
+# A file that changed since it was measured would shift every following one
+string(APPEND asm "    .size embedded_pack_data, ${offset}\n")
+string(APPEND asm "    .if . - embedded_pack_data - ${offset}\n")
+string(APPEND asm "    .error \"embedded pack files changed while packing\"\n")
+string(APPEND asm "    .endif\n")
+string(APPEND asm "    .section .note.GNU-stack,\"\",%progbits\n")
+
+set(displacements "")
+foreach(bucket RANGE ${last_bucket})
+  if(NOT DEFINED DISPLACEMENT_${bucket})
+    set(DISPLACEMENT_${bucket} 0)
+  endif()
+  string(APPEND displacements " ${DISPLACEMENT_${bucket}},")
+  math(EXPR column "(${bucket} + 1) % 16")
+  if(column EQUAL 0)
+    string(APPEND displacements "\n   ")
+  endif()
+endforeach()
+
+set(slots "")
+math(EXPR last_slot "${slot_count} - 1")
+foreach(slot RANGE ${last_slot})
+  if(NOT DEFINED SLOT_${slot})
+    set(SLOT_${slot} 0)
+  endif()
+  string(APPEND slots " ${SLOT_${slot}},")
+  math(EXPR column "(${slot} + 1) % 16")
+  if(column EQUAL 0)
+    string(APPEND slots "\n   ")
+  endif()
+endforeach()
+
+if(count EQUAL 0)
+  set(entries "    { 0, 0, 0 }\n")
+  set(paths "    \"\"\n")
+endif()
+
+string(SHA256 fingerprint "${fingerprint_input}")
+string(SUBSTRING "${fingerprint}" 0 16 fingerprint)
+
+file(WRITE "${PACK_INDEX}"
+"/* Generated by pack_assets.cmake, do not edit */
+#include \"embedded_pack.h\"
+
+extern const char embedded_pack_data[];
+
+static const char embedded_pack_paths[] =
+${paths};
+
+static const EmbeddedPackEntry embedded_pack_entries[] = {
+${entries}};
+
+static const uint32_t embedded_pack_displacements[${bucket_count}] = {
+   ${displacements}
+};
+
+// Index of the entry in each slot, plus one, 0 for a free slot
+static const uint32_t embedded_pack_slots[${slot_count}] = {
+   ${slots}
+};
+
+const EmbeddedPackIndex embedded_pack_index = {
+    .data = embedded_pack_data,
+    .paths = embedded_pack_paths,
+    .entries = embedded_pack_entries,
+    .count = ${count},
+    .displacements = embedded_pack_displacements,
+    .bucket_count = ${bucket_count},
+    .slots = embedded_pack_slots,
+    .slot_count = ${slot_count},
+    .fingerprint = 0x${fingerprint}ULL
+};
+")
+file(WRITE "${PACK_ASM}" "${asm}")
@@ -10,12 +10,12 @@ extern "C" {
 /**
  * Get the content of an embedded file directly from memory.
  *
- * This function provides access to files that were embedded at compile time
- * using objcopy. The returned pointer points to read-only memory and should
- * not be modified or freed.
+ * This function provides access to files that were packed at compile time
+ * (see embedded_pack.h). The returned pointer points to read-only memory and
+ * should not be modified or freed.
  *
- * The content is guaranteed to be null-terminated if it was embedded as a
- * text file, or you must know the size for binary files.
+ * The content is always followed by a null byte, binary files may still hold
+ * null bytes of their own: use get_in_memory_file_size() for those.
  *
  * @param filename Name of the embedded file (e.g., "fifo_interpreter.rb")
  * @return Pointer to the file content in memory, or NULL if not found
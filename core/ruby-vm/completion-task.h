@@ -1,6 +1,8 @@
 #ifndef COMPLETION_TASK_H
 #define COMPLETION_TASK_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -50,6 +52,55 @@ static inline void ruby_completion_task_invoke(RubyCompletionTask* task, int res
     }
 }
 
+/**
+ * Result callback function signature.
+ * @param user_data Context data provided when the task was created
+ * @param result Completion result code (0 = success, non-zero = error)
+ * @param value MessagePack encoding of the value returned by the script, or of its error message
+ *              when 'result' is not 0. Only valid during the call, NULL if no value is available.
+ * @param length Length of 'value' in bytes
+ */
+typedef void (*RubyResultCallback)(void* user_data, int result, const void* value, size_t length);
+
+/**
+ * Completion task that also receives the value returned by the script
+ */
+typedef struct {
+    RubyResultCallback callback;  // Function to call on completion
+    void* user_data;              // Context data to pass to callback
+} RubyResultTask;
+
+/**
+ * Helper to create a result task.
+ * @param callback Function to call on completion (can be NULL)
+ * @param user_data Context data to pass to callback (can be NULL)
+ * @return Initialized RubyResultTask
+ */
+static inline RubyResultTask ruby_result_task_create(
+        RubyResultCallback callback,
+        void* user_data
+) {
+    RubyResultTask task = {
+            .callback = callback,
+            .user_data = user_data
+    };
+    return task;
+}
+
+/**
+ * Helper to invoke a result task.
+ * Safe to call even if callback is NULL.
+ * @param task The task to invoke
+ * @param result The completion result code
+ * @param value Encoded value (can be NULL)
+ * @param length Length of 'value' in bytes
+ */
+static inline void ruby_result_task_invoke(RubyResultTask* task, int result, const void* value, size_t length) {
+    if (task && task->callback) {
+        task->callback(task->user_data, result, value, length);
+    }
+}
+
 #ifdef __cplusplus
 }
 #endif
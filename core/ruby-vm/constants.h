@@ -5,6 +5,48 @@
 #define MAX_PATH_LENGTH 512
 #define MAX_CONTENT_SIZE 65536
 
+// Maximum number of scripts waiting to be sent to the VM before enqueue blocks
+#define DISPATCH_QUEUE_CAPACITY 1024
+
+// Maximum number of scripts sent to the VM and still waiting for their reply
+#define MAX_IN_FLIGHT_REQUESTS 256
+
+// Scripts smaller than this are cheaper to send inline than through the payload ring
+#define PAYLOAD_RING_MIN_SCRIPT_SIZE 4096
+
+// Default number of compiled scripts kept by the VM, see ruby_vm_set_iseq_cache_capacity
+#define ISEQ_CACHE_DEFAULT_CAPACITY 512
+
+// Default bytes of compiled application sources kept on disk, see ruby_vm_enable_compile_cache
+#define COMPILE_CACHE_DEFAULT_CAPACITY (64 * 1024 * 1024)
+
+// The load path map of the compile cache is started over past this size
+#define COMPILE_CACHE_LOAD_PATH_MAX_SIZE (256 * 1024)
+
+// Default recording window of the preload profile, see ruby_vm_enable_preload_profile
+#define PRELOAD_PROFILE_DEFAULT_SECONDS 10
+#define PRELOAD_PROFILE_DEFAULT_SCRIPTS 32
+
+// Features recorded in a preload profile past this count are left out
+#define PRELOAD_PROFILE_MAX_FEATURES 2048
+
+// Upper bound of the number of workers of a VM pool, see ruby_vm_pool_create. At most 64: the running
+// workers are a bit mask, see ruby_vm_pool_shard_owner
+#define VM_POOL_MAX_WORKERS 64
+
+// Requests a worker of a VM pool holds at once, the others wait in the pool for an idle worker
+#define VM_POOL_WORKER_WINDOW 1
+
+// Upper bound of the number of Ractors of the Ractor lane, see ruby_vm_set_ractor_lane_size
+#define RACTOR_LANE_MAX_SIZE 64
+
+// Threads of the I/O thread pool, see ruby_vm_set_io_pool_size
+#define IO_POOL_DEFAULT_SIZE 8
+#define IO_POOL_MAX_SIZE 256
+
+// Containers nested deeper than this in a script result are encoded as nil (guards against cycles)
+#define RESULT_PACK_MAX_DEPTH 64
+
 #define ENV_RUBY_VM_ADDITIONAL_PARAM "RUBY_VM_ADDITIONAL_PARAM"
 
 #define FIFO_INTERPRETER_SCRIPT "fifo_interpreter.rb"
@@ -13,6 +13,14 @@
 #include "exec-main-vm.h"
 #include "ruby-vm.h"
 #include "install.h"
+#include "embedded_vfs.h"
+#include "ruby-host-module.h"
+#include "ruby-install-wait.h"
+#include "ruby-vfs-loader.h"
+#include "ruby-compile-cache.h"
+#include "ruby-preload-profile.h"
+#include "ruby-startup-profile.h"
+#include "ruby-zygote.h"
 
 #include "ruby/config.h"
 #include "ruby/version.h"
@@ -179,9 +187,12 @@ static int run_main_vm_node(const char* baseDirectory,
                             const char* rubyExtraLoadPath,
                             const char* scriptContent,
                             int fromFilename,
-                            int socket_fd)
+                            int socket_fd,
+                            const ExecMainOptions* options)
 {
+    ruby_startup_profile_begin(RUBY_STARTUP_SETUP_ENV);
     SetupRubyEnv(baseDirectory, rubyExtraLoadPath);
+    ruby_startup_profile_end(RUBY_STARTUP_SETUP_ENV);
 
     // Step 1: Save Android's original signal handlers
     SaveOriginalSignalHandlers();
@@ -194,13 +205,18 @@ static int run_main_vm_node(const char* baseDirectory,
                                      1, socket_fd_str);  // 1 extra arg
 
     // Step 2: Initialize Ruby (this will overwrite signal handlers)
+    ruby_startup_profile_begin(RUBY_STARTUP_SYSINIT);
     ruby_sysinit(&argc, &argv);
+    ruby_startup_profile_end(RUBY_STARTUP_SYSINIT);
 
     {
         RUBY_INIT_STACK;
+        ruby_startup_profile_begin(RUBY_STARTUP_INIT);
         ruby_init();
+        ruby_startup_profile_end(RUBY_STARTUP_INIT);
 
         // Step 3: Restore critical handlers that Android needs
+        ruby_startup_profile_begin(RUBY_STARTUP_SIGNALS);
         RestoreCriticalSignalHandlers();
 
         // Step 4: Setup compromise handlers for shared signals
@@ -211,8 +227,58 @@ static int run_main_vm_node(const char* baseDirectory,
         rb_eval_string(
                 "Signal.trap('PIPE', 'SYSTEM_DEFAULT')\n"  // Let system handle SIGPIPE
         );
+        ruby_startup_profile_end(RUBY_STARTUP_SIGNALS);
+
+        // Step 6: Expose the host entry points (synchronous evaluation...) to the main script
+        ruby_startup_profile_begin(RUBY_STARTUP_HOST_SETUP);
+        ruby_host_module_define(options->ractor_lane_size, options->io_pool_size);
+        if (options->zygote && ruby_zygote_define(socket_fd, options->zygote_preload, options->zygote_preload_count) != 0) {
+            fprintf(stderr, "Failed to set up the zygote\n");
+            free_ruby_argv(argv, argc);
+            return -1;
+        }
+
+        // Step 7: Wait for the files Ruby loads by itself, the native extensions keep installing behind 'require'.
+        // A zygote waits for the whole install: its install threads do not survive the forks.
+        if (install_wait(options->zygote ? INSTALL_STAGE_COMPLETE : INSTALL_STAGE_SOURCES) != 0) {
+            fprintf(stderr, "Error while installing ruby standard files\n");
+            free_ruby_argv(argv, argc);
+            return -1;
+        }
+        if (install_pending() && ruby_install_wait_define(baseDirectory) != 0) {
+            fprintf(stderr, "Failed to wait for the native extensions, waiting for the whole install\n");
+            if (install_wait(INSTALL_STAGE_COMPLETE) != 0) {
+                fprintf(stderr, "Error while installing ruby standard files\n");
+                free_ruby_argv(argv, argc);
+                return -1;
+            }
+        }
+
+        // Step 8: Load the pure Ruby standard library from memory, starting with RubyGems
+        if (options->embedded_stdlib && ruby_vfs_loader_define(baseDirectory) != 0) {
+            fprintf(stderr, "Failed to serve the Ruby standard library from memory\n");
+        }
 
+        // Step 9: Load the application sources from their compiled form, once compiled by a previous start
+        if (options->compile_cache_capacity > 0 &&
+            ruby_compile_cache_define(baseDirectory, options->compile_cache_capacity) != 0) {
+            fprintf(stderr, "Failed to set up the compile cache\n");
+        }
+
+        // Step 10: Record the requires of this start, preload those of the previous one
+        if ((options->preload_profile_seconds > 0 || options->preload_profile_scripts > 0) &&
+            ruby_preload_profile_define(baseDirectory, options->preload_profile_seconds,
+                                        options->preload_profile_scripts) != 0) {
+            fprintf(stderr, "Failed to set up the preload profile\n");
+        }
+        ruby_startup_profile_end(RUBY_STARTUP_HOST_SETUP);
+
+        ruby_startup_profile_begin(RUBY_STARTUP_OPTIONS);
         void* options = ruby_options(argc, argv);
+        ruby_startup_profile_end(RUBY_STARTUP_OPTIONS);
+
+        // Ends once the main script serves the commands channel (RubyVMHost.startup_ready)
+        ruby_startup_profile_begin(RUBY_STARTUP_INTERPRETER_READY);
         const int result = ruby_run_node(options);
 
         free_ruby_argv(argv, argc);
@@ -220,14 +286,46 @@ static int run_main_vm_node(const char* baseDirectory,
     }
 }
 
-int ExecMainRubyVM(const char* scriptContent, int commandsFd,
-                   const char* rubyDirectoryPath, const char* nativeLibsDirLocation)
+// Only one VM runs in a process, and so only one install
+static uint64_t g_install_start;
+
+static void on_install_complete(int result, void* user_data)
 {
-    if (install_embedded_files(rubyDirectoryPath) != 0) {
+    (void) user_data;
+    ruby_startup_profile_record(RUBY_STARTUP_INSTALL_PACK, g_install_start,
+                                install_get_archive_completion(INSTALL_ARCHIVE_PACK));
+    ruby_startup_profile_record(RUBY_STARTUP_INSTALL_STDLIB_EXT, g_install_start,
+                                install_get_archive_completion(INSTALL_ARCHIVE_STDLIB_EXT));
+    if (result != 0) {
         fprintf(stderr, "Error while installing ruby standard files\n");
-        return -1;
+    } else {
+        printf( "Installation of ruby standard library success!\n");
+    }
+}
+
+int ExecMainRubyVM(const char* scriptContent, int commandsFd,
+                   const char* rubyDirectoryPath, const char* nativeLibsDirLocation,
+                   const ExecMainOptions* options)
+{
+    ExecMainOptions effectiveOptions = *options;
+    g_install_start = ruby_startup_profile_now();
+
+    // Without a readable embedded archive, the whole standard library goes to disk as usual
+    if (effectiveOptions.embedded_stdlib && embedded_vfs_init() != 0) {
+        fprintf(stderr, "Embedded standard library unavailable, installing it to disk\n");
+        effectiveOptions.embedded_stdlib = 0;
+    }
+
+    // The VM starts while the files are extracted, it waits for those it needs (see run_main_vm_node)
+    if (install_embedded_files_start(rubyDirectoryPath, effectiveOptions.embedded_stdlib, on_install_complete, NULL) != 0) {
+        const int installResult = effectiveOptions.embedded_stdlib ? install_embedded_files_except_vfs(rubyDirectoryPath) :
+                                  install_embedded_files(rubyDirectoryPath);
+        on_install_complete(installResult, NULL);
+        if (installResult != 0) {
+            return -1;
+        }
     }
 
-    printf( "Installation of ruby standard library success!\n");
-    return run_main_vm_node(rubyDirectoryPath, nativeLibsDirLocation, scriptContent, 0, commandsFd);
+    return run_main_vm_node(rubyDirectoryPath, nativeLibsDirLocation, scriptContent, 0, commandsFd,
+                            &effectiveOptions);
 }
@@ -1,12 +1,31 @@
 #ifndef EXEC_MAIN_VM_H
 #define EXEC_MAIN_VM_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Optional features of the VM set up before the main script runs (see the ruby_vm_enable_* functions)
+ */
+typedef struct {
+    int embedded_stdlib;
+    size_t compile_cache_capacity;      // 0 when disabled
+    uint32_t preload_profile_seconds;   // Both 0 when disabled
+    uint32_t preload_profile_scripts;
+    int zygote;                         // 1 to serve worker requests on the commands fd instead (see ruby-zygote.h)
+    const char** zygote_preload;        // Required by the zygote before the first fork
+    size_t zygote_preload_count;
+    size_t ractor_lane_size;            // 0 for one Ractor per core
+    size_t io_pool_size;                // 0 for IO_POOL_DEFAULT_SIZE
+} ExecMainOptions;
+
 int ExecMainRubyVM(const char* scriptContent, int commandsFd,
-                   const char* rubyDirectoryPath, const char* nativeLibsDirLocation);
+                   const char* rubyDirectoryPath, const char* nativeLibsDirLocation,
+                   const ExecMainOptions* options);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "constants.h"
+#include "ruby-cache-files.h"
+
+#pragma GCC diagnostic push
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#else
+#ifdef __clang__
+#pragma clang diagnostic ignored "-Wdefault-const-init-field-unsafe"
+#pragma clang diagnostic ignored "-Wunused-parameter"
+#endif
+#endif
+#include "ruby/ruby.h"
+#pragma GCC diagnostic pop
+
+/**
+ * A binary written by another Ruby, or a truncated one, raises: the source is compiled again
+ */
+static const char* CACHE_LOADER_SCRIPT =
+        "module RubyVMHost\n"
+        "  def self.cache_load_or_compile(binary, store)\n"
+        "    begin\n"
+        "      return RubyVM::InstructionSequence.load_from_binary(binary) if binary\n"
+        "    rescue StandardError\n"
+        "      # Not loadable by this Ruby, compiled again below\n"
+        "    end\n"
+        "    iseq = yield\n"
+        "    begin\n"
+        "      store.call(iseq.to_binary)\n"
+        "    rescue StandardError\n"
+        "      # Only a later start is slower\n"
+        "    end\n"
+        "    iseq\n"
+        "  end\n"
+        "end\n";
+
+int ruby_cache_make_parents(char* path) {
+    for (char* separator = strchr(path + 1, '/'); separator; separator = strchr(separator + 1, '/')) {
+        *separator = '\0';
+        const int failed = mkdir(path, 0755) != 0 && errno != EEXIST;
+        *separator = '/';
+        if (failed) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Call 'visit' on every entry of a directory but "." and "..", with its full path and lstat
+static void for_each_entry(const char* path, void (*visit)(const char*, const struct stat*, void*), void* user_data) {
+    DIR* directory = opendir(path);
+    if (!directory) {
+        return;
+    }
+
+    char child[MAX_PATH_LENGTH];
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        const int length = snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        struct stat st;
+        if (length > 0 && length < (int)sizeof(child) && lstat(child, &st) == 0) {
+            visit(child, &st, user_data);
+        }
+    }
+    closedir(directory);
+}
+
+static void remove_entry(const char* path, const struct stat* st, void* user_data) {
+    (void) user_data;
+    if (S_ISDIR(st->st_mode)) {
+        ruby_cache_remove_tree(path);
+    } else {
+        unlink(path);
+    }
+}
+
+void ruby_cache_remove_tree(const char* path) {
+    for_each_entry(path, remove_entry, NULL);
+    rmdir(path);
+}
+
+void ruby_cache_remove_stale(const char* parent, const char* current) {
+    DIR* directory = opendir(parent);
+    if (!directory) {
+        return;
+    }
+
+    char path[MAX_PATH_LENGTH];
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL) {
+        if (entry->d_name[0] == '.' || strcmp(entry->d_name, current) == 0) continue;
+        const int length = snprintf(path, sizeof(path), "%s/%s", parent, entry->d_name);
+        struct stat st;
+        if (length > 0 && length < (int)sizeof(path) && lstat(path, &st) == 0) {
+            remove_entry(path, &st, NULL);
+        }
+    }
+    closedir(directory);
+}
+
+int ruby_cache_write_file(const char* path, const void* header, size_t header_size, const void* data, size_t size) {
+    char temp_path[MAX_PATH_LENGTH];
+
+    // Unique per process: concurrent writers of the same file each rename their own copy
+    const int length = snprintf(temp_path, sizeof(temp_path), "%s.%ld.tmp", path, (long)getpid());
+    if (length <= 0 || length >= (int)sizeof(temp_path)) {
+        return -1;
+    }
+
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        return -1;
+    }
+    int failed = header_size > 0 && fwrite(header, 1, header_size, file) != header_size;
+    failed |= size > 0 && fwrite(data, 1, size, file) != size;
+    failed |= fclose(file) != 0;
+    if (failed || rename(temp_path, path) != 0) {
+        unlink(temp_path);
+        return -1;
+    }
+    return 0;
+}
+
+static void add_entry_size(const char* path, const struct stat* st, void* user_data) {
+    uint64_t* total = user_data;
+    if (S_ISDIR(st->st_mode)) {
+        *total += ruby_cache_directory_size(path);
+    } else if (S_ISREG(st->st_mode)) {
+        *total += (uint64_t)st->st_size;
+    }
+}
+
+uint64_t ruby_cache_directory_size(const char* path) {
+    uint64_t total = 0;
+    for_each_entry(path, add_entry_size, &total);
+    return total;
+}
+
+typedef struct {
+    int64_t latest;
+    const char* skip;
+} LatestMtime;
+
+static void add_entry_mtime(const char* path, const struct stat* st, void* user_data) {
+    LatestMtime* state = user_data;
+    const char* name = strrchr(path, '/') + 1;
+    if (S_ISDIR(st->st_mode) && name[0] != '.' && (!state->skip || strcmp(path, state->skip) != 0)) {
+        const int64_t mtime = ruby_cache_latest_mtime(path, state->skip);
+        state->latest = mtime > state->latest ? mtime : state->latest;
+    }
+}
+
+int64_t ruby_cache_latest_mtime(const char* path, const char* skip) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return 0;
+    }
+    LatestMtime state = { (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec, skip };
+    for_each_entry(path, add_entry_mtime, &state);
+    return state.latest;
+}
+
+typedef struct {
+    const char* script;
+    const char* name;
+} HostScript;
+
+static VALUE eval_host_script(VALUE arg) {
+    const HostScript* host_script = (const HostScript*)arg;
+    VALUE binding = rb_const_get(rb_cObject, rb_intern("TOPLEVEL_BINDING"));
+    return rb_funcall(rb_mKernel, rb_intern("eval"), 3, rb_str_new_cstr(host_script->script), binding,
+                      rb_str_new_cstr(host_script->name));
+}
+
+int ruby_cache_eval_script(const char* script, const char* name) {
+    HostScript host_script = { script, name };
+    int state = 0;
+    rb_protect(eval_host_script, (VALUE)&host_script, &state);
+    if (state != 0) {
+        rb_set_errinfo(Qnil);
+        return -1;
+    }
+    return 0;
+}
+
+int ruby_cache_define_loader(void) {
+    VALUE host_module = rb_define_module("RubyVMHost");
+    if (rb_respond_to(host_module, rb_intern("cache_load_or_compile"))) {
+        return 0;
+    }
+    return ruby_cache_eval_script(CACHE_LOADER_SCRIPT, "<ruby-vm-cache-loader>");
+}
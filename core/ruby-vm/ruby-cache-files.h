@@ -0,0 +1,87 @@
+#ifndef RUBY_CACHE_FILES_H
+#define RUBY_CACHE_FILES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * File helpers of the caches kept below the Ruby base directory (compiled sources, load path).
+ *
+ * Cache files are only ever replaced whole: a reader running concurrently, in this process
+ * or another one, sees either the previous file or the new one, never a partial write.
+ *
+ * Also the Ruby side shared by the loaders built on these caches (embedded standard library,
+ * compile cache, preload profile, install wait): the scripts installing their hooks, and the
+ * loading of a kept instruction sequence.
+ */
+
+/**
+ * Create the missing parent directories of a file
+ *
+ * @param path Absolute path of the file, modified during the call and restored
+ * @return 0 on success, -1 if a directory could not be created
+ */
+int ruby_cache_make_parents(char* path);
+
+/**
+ * Remove a directory and everything below it, symbolic links are not followed
+ */
+void ruby_cache_remove_tree(const char* path);
+
+/**
+ * Remove every entry of 'parent' but 'current' and the hidden ones: caches of another Ruby version,
+ * platform or build, which are never read again
+ */
+void ruby_cache_remove_stale(const char* parent, const char* current);
+
+/**
+ * Write a cache file atomically: written aside, then renamed over 'path'
+ *
+ * @param header Written first, may be NULL when header_size is 0
+ * @return 0 on success, -1 on error (nothing is left behind)
+ */
+int ruby_cache_write_file(const char* path, const void* header, size_t header_size, const void* data, size_t size);
+
+/**
+ * Total size of the regular files below a directory
+ *
+ * @return The size in bytes, 0 if the directory does not exist
+ */
+uint64_t ruby_cache_directory_size(const char* path);
+
+/**
+ * Latest modification time of a directory and of the directories below it, which changes whenever
+ * a file is added, removed or renamed anywhere in the tree. Hidden directories (caches) are not walked.
+ *
+ * @param skip Directory of the tree not walked either, may be NULL
+ * @return The time in nanoseconds, 0 if the directory does not exist
+ */
+int64_t ruby_cache_latest_mtime(const char* path, const char* skip);
+
+/**
+ * Evaluate a script installing host hooks at the top level, the exception it raises is cleared
+ *
+ * @param script Ruby source
+ * @param name File name of the script in backtraces
+ * @return 0 on success, -1 if the script raised
+ */
+int ruby_cache_eval_script(const char* script, const char* name);
+
+/**
+ * Define RubyVMHost.cache_load_or_compile(binary, store) { compile }: the instruction sequence of 'binary'
+ * when this Ruby can load it, otherwise the one returned by the block, whose binary is then given to
+ * store.call (its errors are ignored, only a later start is slower). Defined once, by the first caller.
+ *
+ * @return 0 on success, -1 on error
+ */
+int ruby_cache_define_loader(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_CACHE_FILES_H
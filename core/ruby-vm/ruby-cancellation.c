@@ -0,0 +1,85 @@
+#include <stddef.h>
+#include <pthread.h>
+
+#include "constants.h"
+#include "ruby-cancellation.h"
+
+typedef struct {
+    uint64_t request_id;
+    int status;
+} Cancellation;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_posted = PTHREAD_COND_INITIALIZER;
+
+static Cancellation g_mailbox[MAX_IN_FLIGHT_REQUESTS];
+static size_t g_head = 0;
+static size_t g_count = 0;
+static int g_closed = 1;
+static int g_interrupted = 0;
+
+void ruby_cancellation_open(void) {
+    pthread_mutex_lock(&g_lock);
+    g_closed = 0;
+    g_head = 0;
+    g_count = 0;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void ruby_cancellation_close(void) {
+    pthread_mutex_lock(&g_lock);
+    g_closed = 1;
+    g_count = 0;
+    pthread_cond_broadcast(&g_posted);
+    pthread_mutex_unlock(&g_lock);
+}
+
+int ruby_cancellation_post(uint64_t request_id, int status) {
+    const size_t capacity = sizeof(g_mailbox) / sizeof(g_mailbox[0]);
+    pthread_mutex_lock(&g_lock);
+
+    if (g_closed || g_count == capacity) {
+        pthread_mutex_unlock(&g_lock);
+        return -1;
+    }
+
+    g_mailbox[(g_head + g_count) % capacity] = (Cancellation) { request_id, status };
+    g_count++;
+    pthread_cond_signal(&g_posted);
+
+    pthread_mutex_unlock(&g_lock);
+    return 0;
+}
+
+int ruby_cancellation_wait(uint64_t* out_request_id, int* out_status) {
+    const size_t capacity = sizeof(g_mailbox) / sizeof(g_mailbox[0]);
+    pthread_mutex_lock(&g_lock);
+
+    while (g_count == 0 && !g_closed && !g_interrupted) {
+        pthread_cond_wait(&g_posted, &g_lock);
+    }
+
+    int result;
+    if (g_closed) {
+        result = -1;
+    } else if (g_interrupted) {
+        g_interrupted = 0;
+        result = 1;
+    } else {
+        *out_request_id = g_mailbox[g_head].request_id;
+        *out_status = g_mailbox[g_head].status;
+        g_head = (g_head + 1) % capacity;
+        g_count--;
+        result = 0;
+    }
+
+    pthread_mutex_unlock(&g_lock);
+    return result;
+}
+
+void ruby_cancellation_interrupt(void) {
+    pthread_mutex_lock(&g_lock);
+    g_interrupted = 1;
+    pthread_cond_broadcast(&g_posted);
+    pthread_mutex_unlock(&g_lock);
+}
@@ -0,0 +1,53 @@
+#ifndef RUBY_CANCELLATION_H
+#define RUBY_CANCELLATION_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Mailbox of the in-flight requests to interrupt, shared by the host and a Ruby thread of the VM.
+ *
+ * A request already sent cannot be recalled through the commands channel: the Ruby side only reads
+ * it between two scripts. Cancellations go through this process-wide mailbox instead, like the
+ * synchronous evaluations (see ruby-sync-eval.h), and the Ruby thread waiting on it raises in the
+ * script being evaluated. Holds up to MAX_IN_FLIGHT_REQUESTS cancellations.
+ */
+
+/**
+ * Accept cancellations (called when the VM starts)
+ */
+void ruby_cancellation_open(void);
+
+/**
+ * Refuse new cancellations and drop the ones not picked up yet
+ */
+void ruby_cancellation_close(void);
+
+/**
+ * Host side: ask the VM to interrupt a request
+ *
+ * @param status Status the request must complete with
+ * @return 0 on success, -1 if the mailbox is closed or full
+ */
+int ruby_cancellation_post(uint64_t request_id, int status);
+
+/**
+ * Ruby side: wait for the next cancellation
+ *
+ * @return 0 when a cancellation was taken, 1 if interrupted by ruby_cancellation_interrupt, -1 once closed
+ */
+int ruby_cancellation_wait(uint64_t* out_request_id, int* out_status);
+
+/**
+ * Ruby side: wake up ruby_cancellation_wait without a cancellation
+ */
+void ruby_cancellation_interrupt(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_CANCELLATION_H
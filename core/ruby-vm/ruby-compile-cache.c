@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "constants.h"
+#include "ruby-compile-cache.h"
+#include "ruby-cache-files.h"
+#include "ruby-content-hash.h"
+#include "embedded_pack.h"
+#include "debug.h"
+
+#pragma GCC diagnostic push
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#else
+#ifdef __clang__
+#pragma clang diagnostic ignored "-Wdefault-const-init-field-unsafe"
+#pragma clang diagnostic ignored "-Wunused-parameter"
+#endif
+#endif
+#include "ruby/ruby.h"
+#pragma GCC diagnostic pop
+
+// Kept in <base directory>/COMPILE_CACHE_DIRECTORY/<Ruby version>-<platform>
+#define COMPILE_CACHE_DIRECTORY ".compile-cache"
+#define COMPILE_CACHE_ISEQ_DIRECTORY "iseq"
+#define COMPILE_CACHE_LOAD_PATH_FILE "load-path"
+
+#define COMPILE_CACHE_MAGIC "RVMC"
+#define COMPILE_CACHE_FORMAT_VERSION 1
+
+// Load path directories whose tree modification time is remembered for the rest of the run
+#define COMPILE_CACHE_MAX_STAMPS 64
+
+/**
+ * Header of a kept instruction sequence, followed by the path of its source then by the binary
+ */
+typedef struct {
+    char magic[4];                  // COMPILE_CACHE_MAGIC
+    uint32_t version;               // COMPILE_CACHE_FORMAT_VERSION
+    uint64_t source_size;
+    int64_t source_mtime_sec;
+    int64_t source_mtime_nsec;
+    uint32_t path_length;
+    uint32_t binary_size;
+} CompileCacheHeader;
+
+typedef struct {
+    uint64_t directory;             // Hash of the expanded path
+    int64_t stamp;                  // See ruby_cache_latest_mtime
+} DirectoryStamp;
+
+static char g_iseq_directory[MAX_PATH_LENGTH];
+static char g_load_path_file[MAX_PATH_LENGTH];
+
+// The installed standard library only changes along with the pack, its directories are not watched
+static char g_stdlib_root[MAX_PATH_LENGTH];
+static size_t g_stdlib_root_length = 0;
+
+static size_t g_capacity = 0;
+static int64_t g_usage = -1;        // Bytes taken by the instruction sequences, -1 until the first store
+
+static DirectoryStamp g_stamps[COMPILE_CACHE_MAX_STAMPS];
+static size_t g_stamp_count = 0;
+
+/**
+ * Every source loaded from disk goes through RubyVM::InstructionSequence.load_iseq, nil lets Ruby
+ * compile it as usual (and report its syntax errors).
+ * Requires of a feature by name go to the path it was found at the last time $LOAD_PATH had the
+ * same signature; features are resolved before being required, while $LOAD_PATH is the one they
+ * are found with, and only recorded once required.
+ */
+static const char* COMPILE_CACHE_SCRIPT =
+        "module RubyVMHost\n"
+        "  def self.compile_cache_load(path)\n"
+        "    stat = nil\n"
+        "    cache_load_or_compile(compile_cache_fetch(path), ->(binary) { compile_cache_store(path, binary, stat) }) do\n"
+        "      stat = File.stat(path)\n"
+        "      RubyVM::InstructionSequence.compile_file(path)\n"
+        "    end\n"
+        "  rescue SyntaxError, SystemCallError\n"
+        "    nil\n"
+        "  end\n"
+        "\n"
+        "  def self.load_path_signature\n"
+        "    load_path = $LOAD_PATH\n"
+        "    unless @load_path_snapshot == load_path\n"
+        "      @load_path_signature = compile_cache_signature(load_path)\n"
+        "      @load_path_snapshot = load_path.dup\n"
+        "    end\n"
+        "    @load_path_signature\n"
+        "  end\n"
+        "\n"
+        "  def self.resolve_feature(feature)\n"
+        "    (respond_to?(:vfs_resolve) && vfs_resolve(feature)) || $LOAD_PATH.resolve_feature_path(feature)&.last\n"
+        "  rescue LoadError\n"
+        "    nil\n"
+        "  end\n"
+        "end\n"
+        "\n"
+        "class RubyVM::InstructionSequence\n"
+        "  def self.load_iseq(path)\n"
+        "    RubyVMHost.compile_cache_load(path)\n"
+        "  end\n"
+        "end\n"
+        "\n"
+        "module Kernel\n"
+        "  alias_method :ruby_vm_uncached_require, :require\n"
+        "\n"
+        "  def require(feature)\n"
+        "    feature = File.path(feature)\n"
+        "    return ruby_vm_uncached_require(feature) if feature.start_with?('/', '.', '~') || feature.match?(/[\\t\\n]/)\n"
+        "\n"
+        "    key = \"#{RubyVMHost.load_path_signature}\\t#{feature}\"\n"
+        "    path = RubyVMHost::LOAD_PATH_CACHE[key]\n"
+        "    if path\n"
+        "      begin\n"
+        "        return ruby_vm_uncached_require(path)\n"
+        "      rescue LoadError => e\n"
+        "        raise unless e.path == path\n"
+        "        RubyVMHost::LOAD_PATH_CACHE.delete(key)\n"
+        "      end\n"
+        "    end\n"
+        "\n"
+        "    path = RubyVMHost.resolve_feature(feature)\n"
+        "    result = ruby_vm_uncached_require(feature)\n"
+        "    if path\n"
+        "      RubyVMHost::LOAD_PATH_CACHE[key] = path\n"
+        "      RubyVMHost.compile_cache_record(key, path)\n"
+        "    end\n"
+        "    result\n"
+        "  end\n"
+        "\n"
+        "  private :require, :ruby_vm_uncached_require\n"
+        "end\n";
+
+// Where the instruction sequence of a source is kept, 0 if the path does not fit
+static int iseq_entry_path(const char* path, size_t path_length, char* entry_path) {
+    const uint64_t hash = ruby_content_hash(path, path_length);
+    const int length = snprintf(entry_path, MAX_PATH_LENGTH, "%s/%02x/%014" PRIx64, g_iseq_directory,
+                                (unsigned)(hash >> 56), hash & UINT64_C(0x00FFFFFFFFFFFFFF));
+    return length > 0 && length < MAX_PATH_LENGTH;
+}
+
+static VALUE host_compile_cache_fetch(VALUE self, VALUE path) {
+    (void) self;
+    char entry_path[MAX_PATH_LENGTH];
+    char stored_path[MAX_PATH_LENGTH];
+    struct stat source;
+    struct stat entry;
+
+    const char* source_path = StringValueCStr(path);
+    const size_t path_length = strlen(source_path);
+    if (path_length >= MAX_PATH_LENGTH || !iseq_entry_path(source_path, path_length, entry_path) ||
+        stat(source_path, &source) != 0) {
+        return Qnil;
+    }
+    FILE* file = fopen(entry_path, "rb");
+    if (!file) {
+        return Qnil;
+    }
+
+    VALUE binary = Qnil;
+    CompileCacheHeader header;
+    if (fstat(fileno(file), &entry) == 0 && fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, COMPILE_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == COMPILE_CACHE_FORMAT_VERSION &&
+        header.source_size == (uint64_t)source.st_size &&
+        header.source_mtime_sec == (int64_t)source.st_mtim.tv_sec &&
+        header.source_mtime_nsec == (int64_t)source.st_mtim.tv_nsec &&
+        header.path_length == path_length &&
+        (uint64_t)entry.st_size == sizeof(header) + header.path_length + (uint64_t)header.binary_size &&
+        fread(stored_path, 1, path_length, file) == path_length &&
+        memcmp(stored_path, source_path, path_length) == 0) {
+        binary = rb_str_new(NULL, (long)header.binary_size);
+        if (fread(RSTRING_PTR(binary), 1, header.binary_size, file) != header.binary_size) {
+            binary = Qnil;
+        }
+    }
+    fclose(file);
+    return binary;
+}
+
+/**
+ * 'stat' is taken before the source is compiled: a source modified since may have been compiled
+ * from either content, it is not kept
+ */
+static VALUE host_compile_cache_store(VALUE self, VALUE path, VALUE binary, VALUE stat_before) {
+    (void) self;
+    char entry_path[MAX_PATH_LENGTH];
+    unsigned char prefix[sizeof(CompileCacheHeader) + MAX_PATH_LENGTH];
+    struct stat source;
+
+    StringValue(binary);
+    const char* source_path = StringValueCStr(path);
+    const size_t path_length = strlen(source_path);
+    const size_t binary_size = (size_t)RSTRING_LEN(binary);
+    const uint64_t size_before = NUM2ULL(rb_funcall(stat_before, rb_intern("size"), 0));
+    const struct timespec mtime_before = rb_time_timespec(rb_funcall(stat_before, rb_intern("mtime"), 0));
+    if (path_length >= MAX_PATH_LENGTH || binary_size > UINT32_MAX ||
+        !iseq_entry_path(source_path, path_length, entry_path) || stat(source_path, &source) != 0 ||
+        (uint64_t)source.st_size != size_before || source.st_mtim.tv_sec != mtime_before.tv_sec ||
+        source.st_mtim.tv_nsec != mtime_before.tv_nsec) {
+        return Qfalse;
+    }
+
+    const size_t total = sizeof(CompileCacheHeader) + path_length + binary_size;
+    if (total > g_capacity) {
+        return Qfalse;
+    }
+    if (g_usage < 0) {
+        g_usage = (int64_t)ruby_cache_directory_size(g_iseq_directory);
+    }
+    if ((uint64_t)g_usage + total > g_capacity) {
+        DEBUG_LOG("compile cache: over %zu bytes, dropping the instruction sequences", g_capacity);
+        ruby_cache_remove_tree(g_iseq_directory);
+        g_usage = 0;
+    }
+
+    CompileCacheHeader header;
+    memcpy(header.magic, COMPILE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = COMPILE_CACHE_FORMAT_VERSION;
+    header.source_size = (uint64_t)source.st_size;
+    header.source_mtime_sec = (int64_t)source.st_mtim.tv_sec;
+    header.source_mtime_nsec = (int64_t)source.st_mtim.tv_nsec;
+    header.path_length = (uint32_t)path_length;
+    header.binary_size = (uint32_t)binary_size;
+    memcpy(prefix, &header, sizeof(header));
+    memcpy(prefix + sizeof(header), source_path, path_length);
+
+    if (ruby_cache_make_parents(entry_path) != 0 ||
+        ruby_cache_write_file(entry_path, prefix, sizeof(header) + path_length, RSTRING_PTR(binary), binary_size) != 0) {
+        return Qfalse;
+    }
+    g_usage += (int64_t)total;
+    return Qtrue;
+}
+
+static int is_stdlib_directory(const char* directory, size_t length) {
+    return length >= g_stdlib_root_length && memcmp(directory, g_stdlib_root, g_stdlib_root_length) == 0 &&
+           (directory[g_stdlib_root_length] == '/' || directory[g_stdlib_root_length] == '\0');
+}
+
+// Tree modification time of a directory, taken once per run. The base directory itself is on the
+// load path, its standard library and caches are left out
+static int64_t directory_stamp(const char* directory, uint64_t hash) {
+    for (size_t i = 0; i < g_stamp_count; i++) {
+        if (g_stamps[i].directory == hash) {
+            return g_stamps[i].stamp;
+        }
+    }
+    const int64_t stamp = ruby_cache_latest_mtime(directory, g_stdlib_root);
+    if (g_stamp_count < COMPILE_CACHE_MAX_STAMPS) {
+        g_stamps[g_stamp_count].directory = hash;
+        g_stamps[g_stamp_count].stamp = stamp;
+        g_stamp_count++;
+    }
+    return stamp;
+}
+
+static uint64_t signature_mix(uint64_t signature, uint64_t value) {
+    return (signature ^ value) * 0x100000001B3ULL;
+}
+
+static VALUE host_compile_cache_signature(VALUE self, VALUE load_path) {
+    (void) self;
+    char hex[17];
+
+    Check_Type(load_path, T_ARRAY);
+    uint64_t signature = signature_mix(0xCBF29CE484222325ULL, embedded_pack_fingerprint());
+    for (long i = 0; i < RARRAY_LEN(load_path); i++) {
+        VALUE directory = rb_file_expand_path(rb_get_path(RARRAY_AREF(load_path, i)), Qnil);
+        const char* name = RSTRING_PTR(directory);
+        const size_t length = (size_t)RSTRING_LEN(directory);
+        const uint64_t hash = ruby_content_hash(name, length);
+        signature = signature_mix(signature, hash);
+        if (!is_stdlib_directory(name, length)) {
+            signature = signature_mix(signature, (uint64_t)directory_stamp(StringValueCStr(directory), hash));
+        }
+    }
+    snprintf(hex, sizeof(hex), "%016" PRIx64, signature);
+    return rb_str_new_cstr(hex);
+}
+
+/**
+ * One write per line, appended: lines of concurrent writers never interleave, the last line
+ * of a key wins when the map is read back
+ */
+static VALUE host_compile_cache_record(VALUE self, VALUE key, VALUE path) {
+    (void) self;
+    char line[2 * MAX_PATH_LENGTH];
+
+    StringValue(key);
+    StringValue(path);
+    const int length = snprintf(line, sizeof(line), "%.*s\t%.*s\n", (int)RSTRING_LEN(key), RSTRING_PTR(key),
+                                (int)RSTRING_LEN(path), RSTRING_PTR(path));
+    if (length <= 0 || length >= (int)sizeof(line) || memchr(RSTRING_PTR(path), '\n', (size_t)RSTRING_LEN(path))) {
+        return Qfalse;
+    }
+
+    const int fd = open(g_load_path_file, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return Qfalse;
+    }
+    const int written = write(fd, line, (size_t)length) == length;
+    close(fd);
+    return written ? Qtrue : Qfalse;
+}
+
+// Read the load path map back into a Hash of "<signature>\t<feature>" => path
+static VALUE load_path_map_read(void) {
+    VALUE map = rb_hash_new();
+    FILE* file = fopen(g_load_path_file, "rb");
+    if (!file) {
+        return map;
+    }
+
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || st.st_size > COMPILE_CACHE_LOAD_PATH_MAX_SIZE) {
+        DEBUG_LOG("compile cache: load path map over %d bytes, starting over", COMPILE_CACHE_LOAD_PATH_MAX_SIZE);
+        fclose(file);
+        unlink(g_load_path_file);
+        return map;
+    }
+
+    char* content = malloc((size_t)st.st_size + 1);
+    const size_t size = content ? fread(content, 1, (size_t)st.st_size, file) : 0;
+    fclose(file);
+    if (!content) {
+        return map;
+    }
+
+    // A line without its newline is being appended, it is left out
+    const char* line = content;
+    const char* end = content + size;
+    const char* newline;
+    while (line < end && (newline = memchr(line, '\n', (size_t)(end - line))) != NULL) {
+        const char* tab = NULL;
+        for (const char* c = newline; c > line; c--) {
+            if (c[-1] == '\t') {
+                tab = c - 1;
+                break;
+            }
+        }
+        if (tab && tab > line && newline > tab + 1) {
+            rb_hash_aset(map, rb_utf8_str_new(line, tab - line), rb_utf8_str_new(tab + 1, newline - tab - 1));
+        }
+        line = newline + 1;
+    }
+    free(content);
+    return map;
+}
+
+int ruby_compile_cache_define(const char* base_directory, size_t capacity) {
+    char name[MAX_PATH_LENGTH];
+    char parent[MAX_PATH_LENGTH];
+
+    VALUE root_value = rb_file_expand_path(rb_str_new_cstr(base_directory), Qnil);
+    const char* root = StringValueCStr(root_value);
+    VALUE version = rb_const_get(rb_cObject, rb_intern("RUBY_VERSION"));
+    VALUE platform = rb_const_get(rb_cObject, rb_intern("RUBY_PLATFORM"));
+
+    const int name_length = snprintf(name, sizeof(name), "%s-%s", StringValueCStr(version), StringValueCStr(platform));
+    const int parent_length = snprintf(parent, sizeof(parent), "%s/" COMPILE_CACHE_DIRECTORY, root);
+    const int iseq_length = snprintf(g_iseq_directory, sizeof(g_iseq_directory), "%s/%s/" COMPILE_CACHE_ISEQ_DIRECTORY,
+                                     parent, name);
+    const int file_length = snprintf(g_load_path_file, sizeof(g_load_path_file), "%s/%s/" COMPILE_CACHE_LOAD_PATH_FILE,
+                                     parent, name);
+    const int stdlib_length = snprintf(g_stdlib_root, sizeof(g_stdlib_root), "%s/ruby", root);
+    if (name_length <= 0 || name_length >= (int)sizeof(name) || parent_length <= 0 ||
+        parent_length >= (int)sizeof(parent) || iseq_length <= 0 || iseq_length >= (int)sizeof(g_iseq_directory) ||
+        file_length <= 0 || file_length >= (int)sizeof(g_load_path_file) ||
+        stdlib_length <= 0 || stdlib_length >= (int)sizeof(g_stdlib_root)) {
+        DEBUG_LOG("ruby_compile_cache_define: base directory path too long");
+        return -1;
+    }
+    g_stdlib_root_length = (size_t)stdlib_length;
+
+    ruby_cache_remove_stale(parent, name);
+    if (ruby_cache_make_parents(g_load_path_file) != 0) {
+        DEBUG_LOG("ruby_compile_cache_define: cannot create %s", g_load_path_file);
+        return -1;
+    }
+    g_capacity = capacity;
+    g_usage = -1;
+
+    VALUE host_module = rb_define_module("RubyVMHost");
+    rb_define_module_function(host_module, "compile_cache_fetch", host_compile_cache_fetch, 1);
+    rb_define_module_function(host_module, "compile_cache_store", host_compile_cache_store, 3);
+    rb_define_module_function(host_module, "compile_cache_signature", host_compile_cache_signature, 1);
+    rb_define_module_function(host_module, "compile_cache_record", host_compile_cache_record, 2);
+    rb_const_set(host_module, rb_intern("LOAD_PATH_CACHE"), load_path_map_read());
+
+    if (ruby_cache_define_loader() != 0 ||
+        ruby_cache_eval_script(COMPILE_CACHE_SCRIPT, "<ruby-vm-compile-cache>") != 0) {
+        DEBUG_LOG("ruby_compile_cache_define: failed to install the cache");
+        return -1;
+    }
+
+    DEBUG_LOG("ruby_compile_cache_define: %zu bytes cache in %s/%s", capacity, parent, name);
+    return 0;
+}
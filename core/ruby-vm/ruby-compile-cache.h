@@ -0,0 +1,57 @@
+#ifndef RUBY_COMPILE_CACHE_H
+#define RUBY_COMPILE_CACHE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Keep what requiring the application sources costs across starts, below
+ * <base_directory>/.compile-cache/<RUBY_VERSION>-<RUBY_PLATFORM> (the directories of other Ruby
+ * versions or platforms are removed):
+ *
+ * - The binary instruction sequence of every Ruby source loaded from disk, through
+ *   RubyVM::InstructionSequence.load_iseq: a source is parsed and compiled once, then loaded from
+ *   its binary as long as its path, size and modification time are the ones it was compiled from.
+ *   A source modified while it was compiled is not kept.
+ *
+ * - The path each feature required by name was found at, for the $LOAD_PATH it was found with:
+ *   a later start requires that path directly instead of looking the feature up in every directory
+ *   of the load path. The directories of the load path outside of the installed standard library
+ *   are watched through the modification time of their tree, taken once per start: adding or removing
+ *   a file there resolves the features again. A path that disappeared is dropped and looked up again.
+ *
+ * Writers never conflict: entries are written aside then renamed, and the load path map only grows
+ * by single appended lines, so several processes may share the directory. When the instruction
+ * sequences would go past 'capacity' bytes they are all dropped and built again from there; the
+ * load path map is started over once above COMPILE_CACHE_LOAD_PATH_MAX_SIZE.
+ * Also defines:
+ *
+ *   RubyVMHost.compile_cache_fetch(path) -> String or nil
+ *     Binary instruction sequence kept for a source, nil when there is none or the source changed
+ *
+ *   RubyVMHost.compile_cache_store(path, binary, stat) -> true or false
+ *     Keep the binary instruction sequence of a source, unless it changed since 'stat' was taken
+ *
+ *   RubyVMHost.compile_cache_signature(load_path) -> String
+ *     Identifies a load path and the content of its directories
+ *
+ *   RubyVMHost.compile_cache_record(key, path) -> true or false
+ *     Append a "<signature>\t<feature>" key and the path it resolved to to the load path map
+ *
+ * Must be called on the VM thread, after ruby_vfs_loader_define() when the standard library is
+ * served from memory, and before ruby_options().
+ *
+ * @param base_directory Ruby base directory the cache is kept in
+ * @param capacity Bytes the instruction sequences may take on disk
+ * @return 0 on success, -1 if the cache could not be installed
+ */
+int ruby_compile_cache_define(const char* base_directory, size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_COMPILE_CACHE_H
@@ -0,0 +1,92 @@
+#include "ruby-content-hash.h"
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static uint64_t rotl64(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Little-endian loads, whatever the host byte order
+static uint64_t read_u64(const unsigned char* in) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+static uint32_t read_u32(const unsigned char* in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static uint64_t round64(uint64_t accumulator, uint64_t input) {
+    accumulator += input * PRIME64_2;
+    accumulator = rotl64(accumulator, 31);
+    return accumulator * PRIME64_1;
+}
+
+static uint64_t merge_round64(uint64_t accumulator, uint64_t value) {
+    accumulator ^= round64(0, value);
+    return accumulator * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t ruby_content_hash(const void* data, size_t length) {
+    const unsigned char* in = data;
+    const unsigned char* const end = in + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        const unsigned char* const limit = end - 32;
+        uint64_t v1 = PRIME64_1 + PRIME64_2;
+        uint64_t v2 = PRIME64_2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - PRIME64_1;
+
+        do {
+            v1 = round64(v1, read_u64(in));
+            v2 = round64(v2, read_u64(in + 8));
+            v3 = round64(v3, read_u64(in + 16));
+            v4 = round64(v4, read_u64(in + 24));
+            in += 32;
+        } while (in <= limit);
+
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = merge_round64(hash, v1);
+        hash = merge_round64(hash, v2);
+        hash = merge_round64(hash, v3);
+        hash = merge_round64(hash, v4);
+    } else {
+        hash = PRIME64_5;
+    }
+
+    hash += (uint64_t)length;
+
+    while (in + 8 <= end) {
+        hash ^= round64(0, read_u64(in));
+        hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+        in += 8;
+    }
+    if (in + 4 <= end) {
+        hash ^= (uint64_t)read_u32(in) * PRIME64_1;
+        hash = rotl64(hash, 23) * PRIME64_2 + PRIME64_3;
+        in += 4;
+    }
+    while (in < end) {
+        hash ^= (*in) * PRIME64_5;
+        hash = rotl64(hash, 11) * PRIME64_1;
+        in++;
+    }
+
+    // Avalanche
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+
+    return hash != 0 ? hash : 1;
+}
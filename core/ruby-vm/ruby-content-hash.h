@@ -0,0 +1,21 @@
+#ifndef RUBY_CONTENT_HASH_H
+#define RUBY_CONTENT_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 64-bit content hash (XXH64, seed 0) used to identify script bodies across requests.
+ * Never returns 0, which the wire protocol reserves for "no hash".
+ */
+uint64_t ruby_content_hash(const void* data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_CONTENT_HASH_H
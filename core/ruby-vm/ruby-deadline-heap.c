@@ -0,0 +1,64 @@
+#include <stdlib.h>
+
+#include "ruby-deadline-heap.h"
+
+void ruby_deadline_heap_init(RubyDeadlineHeap* heap) {
+    heap->entries = NULL;
+    heap->count = 0;
+    heap->capacity = 0;
+}
+
+void ruby_deadline_heap_destroy(RubyDeadlineHeap* heap) {
+    free(heap->entries);
+    ruby_deadline_heap_init(heap);
+}
+
+static void swap_entries(RubyDeadline* entries, size_t a, size_t b) {
+    const RubyDeadline entry = entries[a];
+    entries[a] = entries[b];
+    entries[b] = entry;
+}
+
+int ruby_deadline_heap_push(RubyDeadlineHeap* heap, uint64_t deadline_ns, uint64_t request_id) {
+    if (heap->count == heap->capacity) {
+        const size_t capacity = heap->capacity ? heap->capacity * 2 : 64;
+        RubyDeadline* entries = realloc(heap->entries, sizeof(RubyDeadline) * capacity);
+        if (!entries) return -1;
+        heap->entries = entries;
+        heap->capacity = capacity;
+    }
+
+    size_t index = heap->count++;
+    heap->entries[index] = (RubyDeadline) { deadline_ns, request_id };
+    while (index > 0) {
+        const size_t parent = (index - 1) / 2;
+        if (heap->entries[parent].deadline_ns <= heap->entries[index].deadline_ns) break;
+        swap_entries(heap->entries, parent, index);
+        index = parent;
+    }
+    return 0;
+}
+
+const RubyDeadline* ruby_deadline_heap_peek(const RubyDeadlineHeap* heap) {
+    return heap->count > 0 ? &heap->entries[0] : NULL;
+}
+
+int ruby_deadline_heap_pop(RubyDeadlineHeap* heap, RubyDeadline* out_deadline) {
+    if (heap->count == 0) return -1;
+
+    *out_deadline = heap->entries[0];
+    heap->entries[0] = heap->entries[--heap->count];
+
+    size_t index = 0;
+    for (;;) {
+        const size_t left = 2 * index + 1;
+        const size_t right = left + 1;
+        size_t earliest = index;
+        if (left < heap->count && heap->entries[left].deadline_ns < heap->entries[earliest].deadline_ns) earliest = left;
+        if (right < heap->count && heap->entries[right].deadline_ns < heap->entries[earliest].deadline_ns) earliest = right;
+        if (earliest == index) break;
+        swap_entries(heap->entries, index, earliest);
+        index = earliest;
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef RUBY_DEADLINE_HEAP_H
+#define RUBY_DEADLINE_HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Deadline of a request, as a CLOCK_MONOTONIC time in nanoseconds
+ */
+typedef struct {
+    uint64_t deadline_ns;
+    uint64_t request_id;
+} RubyDeadline;
+
+/**
+ * Binary min-heap of request deadlines, the earliest one on top. Not thread-safe.
+ *
+ * Requests completing before their deadline are not removed: their entry simply expires
+ * and cancelling a completed request does nothing.
+ */
+typedef struct {
+    RubyDeadline* entries;
+    size_t count;
+    size_t capacity;
+} RubyDeadlineHeap;
+
+void ruby_deadline_heap_init(RubyDeadlineHeap* heap);
+
+void ruby_deadline_heap_destroy(RubyDeadlineHeap* heap);
+
+/**
+ * @return 0 on success, -1 on allocation failure
+ */
+int ruby_deadline_heap_push(RubyDeadlineHeap* heap, uint64_t deadline_ns, uint64_t request_id);
+
+/**
+ * @return The earliest deadline, NULL if the heap is empty
+ */
+const RubyDeadline* ruby_deadline_heap_peek(const RubyDeadlineHeap* heap);
+
+/**
+ * Remove the earliest deadline
+ *
+ * @return 0 on success, -1 if the heap is empty
+ */
+int ruby_deadline_heap_pop(RubyDeadlineHeap* heap, RubyDeadline* out_deadline);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_DEADLINE_HEAP_H
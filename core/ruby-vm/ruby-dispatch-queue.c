@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ruby-dispatch-queue.h"
+
+RubyDispatchBatch* ruby_dispatch_batch_create(RubyScript** scripts, const RubyCompletionTask* on_complete, size_t count) {
+    if (!scripts || count == 0) return NULL;
+
+    RubyDispatchBatch* batch = malloc(sizeof(RubyDispatchBatch) +
+                                      sizeof(RubyScript*) * count +
+                                      sizeof(RubyCompletionTask) * count);
+    if (!batch) return NULL;
+
+    batch->count = count;
+    batch->on_complete = (RubyCompletionTask*)(batch + 1);
+    batch->scripts = (RubyScript**)(batch->on_complete + count);
+    memcpy(batch->scripts, scripts, sizeof(RubyScript*) * count);
+    if (on_complete) {
+        memcpy(batch->on_complete, on_complete, sizeof(RubyCompletionTask) * count);
+    } else {
+        memset(batch->on_complete, 0, sizeof(RubyCompletionTask) * count);
+    }
+    return batch;
+}
+
+void ruby_dispatch_batch_destroy(RubyDispatchBatch* batch) {
+    free(batch);
+}
+
+RubyDispatchCall* ruby_dispatch_call_create(uint16_t flags, uint32_t aux, size_t length) {
+    RubyDispatchCall* call = malloc(sizeof(RubyDispatchCall) + length);
+    if (!call) return NULL;
+
+    call->flags = flags;
+    call->aux = aux;
+    call->length = length;
+    call->payload = (unsigned char*)(call + 1);
+    return call;
+}
+
+void ruby_dispatch_call_destroy(RubyDispatchCall* call) {
+    free(call);
+}
+
+void ruby_dispatch_item_complete(RubyDispatchItem* item, int result) {
+    ruby_dispatch_item_complete_with_value(item, result, NULL, 0);
+}
+
+void ruby_dispatch_item_complete_with_value(RubyDispatchItem* item, int result, const void* value, size_t length) {
+    if (item->call) {
+        ruby_dispatch_call_destroy(item->call);
+        item->call = NULL;
+    }
+    if (!item->batch) {
+        if (item->on_result.callback) {
+            ruby_result_task_invoke(&item->on_result, result, value, length);
+        } else {
+            ruby_completion_task_invoke(&item->on_complete, result);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < item->batch->count; i++) {
+        ruby_completion_task_invoke(&item->batch->on_complete[i], result);
+    }
+    ruby_dispatch_batch_destroy(item->batch);
+    item->batch = NULL;
+}
+
+int ruby_dispatch_queue_init(RubyDispatchQueue* queue, size_t capacity) {
+    if (!queue || capacity == 0) return -1;
+
+    queue->items = malloc(sizeof(RubyDispatchItem) * capacity);
+    if (!queue->items) return -1;
+
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->next_request_id = 1;
+    queue->popped_request_id = 0;
+    queue->popped_cancel_status = 0;
+    queue->closed = 0;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    return 0;
+}
+
+void ruby_dispatch_queue_destroy(RubyDispatchQueue* queue) {
+    if (!queue || !queue->items) return;
+
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->items);
+    queue->items = NULL;
+}
+
+int ruby_dispatch_queue_push(RubyDispatchQueue* queue, const RubyDispatchItem* item, uint64_t* out_request_id) {
+    pthread_mutex_lock(&queue->lock);
+
+    while (queue->count == queue->capacity && !queue->closed) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+
+    if (queue->closed) {
+        pthread_mutex_unlock(&queue->lock);
+        return -1;
+    }
+
+    const size_t tail = (queue->head + queue->count) % queue->capacity;
+    queue->items[tail] = *item;
+    queue->items[tail].request_id = queue->next_request_id++;
+    queue->items[tail].cancelled = 0;
+    queue->count++;
+    if (out_request_id) {
+        *out_request_id = queue->items[tail].request_id;
+    }
+
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+}
+
+int ruby_dispatch_queue_pop(RubyDispatchQueue* queue, RubyDispatchItem* out_item) {
+    pthread_mutex_lock(&queue->lock);
+
+    for (;;) {
+        while (queue->count == 0 && !queue->closed) {
+            pthread_cond_wait(&queue->not_empty, &queue->lock);
+        }
+
+        if (queue->count == 0) {
+            // Closed and fully drained
+            pthread_mutex_unlock(&queue->lock);
+            return -1;
+        }
+
+        *out_item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+
+        if (!out_item->cancelled) {
+            break;
+        }
+    }
+
+    queue->popped_request_id = out_item->request_id;
+    queue->popped_cancel_status = 0;
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+}
+
+int ruby_dispatch_queue_hand_over(RubyDispatchQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    const int status = queue->popped_cancel_status;
+    queue->popped_request_id = 0;
+    queue->popped_cancel_status = 0;
+    pthread_mutex_unlock(&queue->lock);
+    return status;
+}
+
+int ruby_dispatch_queue_cancel(RubyDispatchQueue* queue, uint64_t request_id, int status, RubyDispatchItem* out_item) {
+    int result = -1;
+    pthread_mutex_lock(&queue->lock);
+
+    // Queued items hold the ids [next_request_id - count, next_request_id)
+    const uint64_t first_queued_id = queue->next_request_id - queue->count;
+    if (request_id != 0 && request_id == queue->popped_request_id) {
+        if (queue->popped_cancel_status == 0) {
+            queue->popped_cancel_status = status;
+        }
+        result = 0;
+    } else if (request_id >= first_queued_id && request_id < queue->next_request_id) {
+        RubyDispatchItem* item = &queue->items[(queue->head + (request_id - first_queued_id)) % queue->capacity];
+        if (!item->cancelled) {
+            *out_item = *item;
+            // The consumer only looks at the flag, resources now belong to 'out_item'
+            item->cancelled = 1;
+            item->script = NULL;
+            item->batch = NULL;
+            item->call = NULL;
+            result = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return result;
+}
+
+void ruby_dispatch_queue_close(RubyDispatchQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+}
@@ -0,0 +1,167 @@
+#ifndef RUBY_DISPATCH_QUEUE_H
+#define RUBY_DISPATCH_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "completion-task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct RubyScript;
+typedef struct RubyScript RubyScript;
+
+/**
+ * Scripts submitted together: they travel in a single frame and are answered by a single reply.
+ * Scripts and completion tasks are copied in the same allocation as the batch itself.
+ */
+typedef struct {
+    size_t count;
+    RubyScript** scripts;
+    RubyCompletionTask* on_complete;
+} RubyDispatchBatch;
+
+/**
+ * @param on_complete Array of 'count' tasks, one per script (can be NULL)
+ * @return A new batch, or NULL on allocation failure
+ */
+RubyDispatchBatch* ruby_dispatch_batch_create(RubyScript** scripts, const RubyCompletionTask* on_complete, size_t count);
+
+void ruby_dispatch_batch_destroy(RubyDispatchBatch* batch);
+
+/**
+ * A frame built by the host rather than from a script, such as the prepared script commands.
+ * The payload is stored in the same allocation as the call itself.
+ */
+typedef struct {
+    uint16_t flags;           // RUBY_WIRE_FLAG_* of the frame
+    uint32_t aux;
+    size_t length;
+    unsigned char* payload;
+} RubyDispatchCall;
+
+/**
+ * @param length Size of the payload, left uninitialized for the caller to fill
+ * @return A new call, or NULL on allocation failure
+ */
+RubyDispatchCall* ruby_dispatch_call_create(uint16_t flags, uint32_t aux, size_t length);
+
+void ruby_dispatch_call_destroy(RubyDispatchCall* call);
+
+/**
+ * A unit of work waiting to be sent to the Ruby VM: a single script, a batch or a call
+ */
+typedef struct {
+    uint64_t request_id;             // Assigned by ruby_dispatch_queue_push
+    RubyScript* script;              // NULL for a batch or a call
+    RubyCompletionTask on_complete;  // Unused for a batch
+    RubyResultTask on_result;        // Called instead of on_complete when set, single scripts and calls only
+    uint16_t wire_flags;             // Extra RUBY_WIRE_FLAG_* of a single script, e.g. RUBY_WIRE_FLAG_RACTOR
+    uint32_t stream;                 // Stream of a RUBY_WIRE_FLAG_IO script, 0 for none
+    RubyDispatchBatch* batch;        // NULL unless the item is a batch
+    RubyDispatchCall* call;          // NULL unless the item is a call
+    uint64_t payload_ring_end;       // Set by the dispatcher when the script went through the payload ring, 0 otherwise
+    int cancelled;                   // Already completed by ruby_dispatch_queue_cancel, left in the queue to be skipped
+} RubyDispatchItem;
+
+/**
+ * Complete every script carried by the item with the same result, in order,
+ * then release its batch or call if any
+ */
+void ruby_dispatch_item_complete(RubyDispatchItem* item, int result);
+
+/**
+ * Same as ruby_dispatch_item_complete, handing the encoded value to the result task if the item has one
+ */
+void ruby_dispatch_item_complete_with_value(RubyDispatchItem* item, int result, const void* value, size_t length);
+
+/**
+ * Bounded multi-producer / single-consumer FIFO queue.
+ *
+ * Any thread may push, only the VM dispatcher thread pops.
+ * Items are stored by value in a fixed ring buffer allocated once at init,
+ * so pushing never allocates.
+ *
+ * Request ids are allocated by push, in queue order starting from 1: the queued items always
+ * hold consecutive ids, which lets ruby_dispatch_queue_cancel find an item without searching.
+ */
+typedef struct {
+    RubyDispatchItem* items;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    uint64_t next_request_id;
+    uint64_t popped_request_id;   // Item handed to the consumer and not handed over yet, 0 if none
+    int popped_cancel_status;     // Cancellation requested for that item meanwhile, 0 if none
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} RubyDispatchQueue;
+
+/**
+ * Initialize a queue able to hold up to 'capacity' pending items
+ *
+ * @return 0 on success, -1 on allocation failure
+ */
+int ruby_dispatch_queue_init(RubyDispatchQueue* queue, size_t capacity);
+
+/**
+ * Release queue storage. The queue must not be used by any thread anymore.
+ */
+void ruby_dispatch_queue_destroy(RubyDispatchQueue* queue);
+
+/**
+ * Push an item at the back of the queue, blocking while the queue is full
+ *
+ * @param out_request_id Receives the request id given to the item (can be NULL)
+ * @return 0 on success, -1 if the queue has been closed
+ */
+int ruby_dispatch_queue_push(RubyDispatchQueue* queue, const RubyDispatchItem* item, uint64_t* out_request_id);
+
+/**
+ * Pop the item at the front of the queue, blocking while the queue is empty.
+ * Cancelled items are skipped.
+ *
+ * Items still queued when the queue is closed are handed out before
+ * the queue reports closure, so nothing is silently lost.
+ * The consumer must call ruby_dispatch_queue_hand_over once the item is tracked elsewhere.
+ *
+ * @return 0 on success, -1 if the queue is closed and empty
+ */
+int ruby_dispatch_queue_pop(RubyDispatchQueue* queue, RubyDispatchItem* out_item);
+
+/**
+ * Consumer side: the last popped item is now tracked elsewhere (the pending table),
+ * cancellations no longer go through the queue
+ *
+ * @return Status of a cancellation requested while the item was in the consumer's hands, 0 if none
+ */
+int ruby_dispatch_queue_hand_over(RubyDispatchQueue* queue);
+
+/**
+ * Cancel a request that has not been sent yet
+ *
+ * A queued item is marked as cancelled and copied to 'out_item': the caller completes it,
+ * the consumer will skip it. An item popped but not handed over yet gets 'status' recorded,
+ * for ruby_dispatch_queue_hand_over to report.
+ *
+ * @param status Status to complete the request with
+ * @return 1 if 'out_item' must be completed by the caller, 0 if the consumer will handle it,
+ *         -1 if the request is not in the queue
+ */
+int ruby_dispatch_queue_cancel(RubyDispatchQueue* queue, uint64_t request_id, int status, RubyDispatchItem* out_item);
+
+/**
+ * Close the queue: further pushes fail and blocked threads are woken up
+ */
+void ruby_dispatch_queue_close(RubyDispatchQueue* queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_DISPATCH_QUEUE_H
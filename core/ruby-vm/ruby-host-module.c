@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "ruby-host-module.h"
+#include "ruby-sync-eval.h"
+#include "ruby-iseq-cache.h"
+#include "ruby-cancellation.h"
+#include "ruby-startup-profile.h"
+
+#pragma GCC diagnostic push
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#else
+#ifdef __clang__
+#pragma clang diagnostic ignored "-Wdefault-const-init-field-unsafe"
+#pragma clang diagnostic ignored "-Wunused-parameter"
+#endif
+#endif
+#include "ruby/ruby.h"
+#include "ruby/encoding.h"
+#include "ruby/thread.h"
+#pragma GCC diagnostic pop
+
+typedef struct {
+    int result;
+    const char* source;
+    size_t length;
+} WaitRequestArgs;
+
+typedef struct {
+    VALUE lock;
+    VALUE code;
+} EvalCall;
+
+typedef struct {
+    int result;
+    uint64_t request_id;
+    int status;
+} WaitCancellationArgs;
+
+static void* wait_request_without_gvl(void* arg) {
+    WaitRequestArgs* args = (WaitRequestArgs*)arg;
+    args->result = ruby_sync_eval_wait_request(&args->source, &args->length);
+    return NULL;
+}
+
+static void interrupt_wait_request(void* arg) {
+    (void) arg;
+    ruby_sync_eval_interrupt();
+}
+
+static VALUE eval_in_toplevel(VALUE arg) {
+    EvalCall* call = (EvalCall*)arg;
+    VALUE binding = rb_const_get(rb_cObject, rb_intern("TOPLEVEL_BINDING"));
+    return rb_funcall(rb_mKernel, rb_intern("eval"), 3, call->code, binding, rb_str_new_cstr("<sync-script>"));
+}
+
+static VALUE synchronized_eval(VALUE arg) {
+    EvalCall* call = (EvalCall*)arg;
+    if (NIL_P(call->lock)) {
+        return eval_in_toplevel(arg);
+    }
+    return rb_mutex_synchronize(call->lock, eval_in_toplevel, arg);
+}
+
+static VALUE exception_message(VALUE error) {
+    return rb_funcall(error, rb_intern("message"), 0);
+}
+
+/**
+ * Evaluate one request and complete it.
+ * Every error fails the request, exit and Interrupt included: this thread is the only one serving
+ * ruby_vm_eval_sync, letting them propagate would leave the next callers waiting forever.
+ */
+static void run_sync_request(VALUE lock, const char* source, size_t length) {
+    EvalCall call = {
+            .lock = lock,
+            .code = rb_utf8_str_new(source, (long)length)
+    };
+
+    int state = 0;
+    rb_protect(synchronized_eval, (VALUE)&call, &state);
+    if (state == 0) {
+        ruby_sync_eval_finish(0, NULL);
+        return;
+    }
+
+    VALUE error = rb_errinfo();
+    char message[RUBY_EVAL_MESSAGE_SIZE];
+    rb_set_errinfo(Qnil);
+    if (!rb_obj_is_kind_of(error, rb_eException)) {
+        // Thread#kill and throw leave no exception behind
+        ruby_sync_eval_finish(1, "Evaluation interrupted");
+        return;
+    }
+
+    int message_state = 0;
+    VALUE error_message = rb_protect(exception_message, error, &message_state);
+    if (message_state != 0 || !RB_TYPE_P(error_message, T_STRING)) {
+        rb_set_errinfo(Qnil);
+        error_message = rb_str_new_cstr("");
+    }
+    snprintf(message, sizeof(message), "%s: %.*s", rb_obj_classname(error),
+             (int)RSTRING_LEN(error_message), RSTRING_PTR(error_message));
+    ruby_sync_eval_finish(1, message);
+}
+
+static VALUE host_serve_sync_evals(VALUE self, VALUE lock) {
+    (void) self;
+
+    for (;;) {
+        WaitRequestArgs args = { 0 };
+        rb_thread_call_without_gvl(wait_request_without_gvl, &args, interrupt_wait_request, NULL);
+
+        if (args.result < 0) {
+            break;
+        }
+        if (args.result > 0) {
+            // Woken up by Ruby itself (thread kill, VM shutdown...): let it act
+            rb_thread_check_ints();
+            continue;
+        }
+        run_sync_request(lock, args.source, args.length);
+    }
+    return Qnil;
+}
+
+static void* wait_cancellation_without_gvl(void* arg) {
+    WaitCancellationArgs* args = (WaitCancellationArgs*)arg;
+    args->result = ruby_cancellation_wait(&args->request_id, &args->status);
+    return NULL;
+}
+
+static void interrupt_wait_cancellation(void* arg) {
+    (void) arg;
+    ruby_cancellation_interrupt();
+}
+
+static VALUE host_next_cancellation(VALUE self) {
+    (void) self;
+
+    for (;;) {
+        WaitCancellationArgs args = { 0 };
+        rb_thread_call_without_gvl(wait_cancellation_without_gvl, &args, interrupt_wait_cancellation, NULL);
+
+        if (args.result < 0) {
+            return Qnil;
+        }
+        if (args.result > 0) {
+            // Woken up by Ruby itself (thread kill, VM shutdown...): let it act
+            rb_thread_check_ints();
+            continue;
+        }
+        return rb_assoc_new(ULL2NUM(args.request_id), INT2NUM(args.status));
+    }
+}
+
+static VALUE host_startup_ready(VALUE self) {
+    (void) self;
+    ruby_startup_profile_end(RUBY_STARTUP_INTERPRETER_READY);
+    return Qnil;
+}
+
+static VALUE host_iseq_cache_capacity(VALUE self) {
+    (void) self;
+    return SIZET2NUM(ruby_iseq_cache_get_capacity());
+}
+
+static VALUE host_iseq_cache_record(VALUE self, VALUE event, VALUE entries) {
+    (void) self;
+    ruby_iseq_cache_record((RubyIseqCacheEvent)NUM2INT(event), NUM2SIZET(entries));
+    return Qnil;
+}
+
+typedef struct {
+    VALUE buffer;
+    int depth;
+} PackContext;
+
+static void pack_value(PackContext* context, VALUE value);
+
+// MessagePack is big-endian: 'size' bytes of 'value' follow the type byte
+static void pack_tag(PackContext* context, unsigned char type, uint64_t value, int size) {
+    unsigned char encoded[9];
+    encoded[0] = type;
+    for (int i = 0; i < size; i++) {
+        encoded[1 + i] = (unsigned char)(value >> (8 * (size - 1 - i)));
+    }
+    rb_str_buf_cat(context->buffer, (const char*)encoded, 1 + size);
+}
+
+// Smallest of the fixed, 8, 16 and 32 bits length headers of a family
+static void pack_length(PackContext* context, unsigned char fix_type, uint64_t fix_max,
+                        unsigned char type8, unsigned char type16, unsigned char type32, uint64_t length) {
+    if (length <= fix_max) {
+        pack_tag(context, (unsigned char)(fix_type | length), 0, 0);
+    } else if (type8 && length <= UINT8_MAX) {
+        pack_tag(context, type8, length, 1);
+    } else if (length <= UINT16_MAX) {
+        pack_tag(context, type16, length, 2);
+    } else {
+        pack_tag(context, type32, length, 4);
+    }
+}
+
+static void pack_string(PackContext* context, VALUE string) {
+    const long length = RSTRING_LEN(string);
+    if (ENCODING_GET(string) == rb_ascii8bit_encindex()) {
+        // No fixed form for binary data: 0xC4 is only used as the 8 bits header
+        pack_length(context, 0xC4, 0, 0xC4, 0xC5, 0xC6, (uint64_t)length);
+    } else {
+        pack_length(context, 0xA0, 31, 0xD9, 0xDA, 0xDB, (uint64_t)length);
+    }
+    rb_str_buf_cat(context->buffer, RSTRING_PTR(string), length);
+}
+
+static void pack_unsigned(PackContext* context, uint64_t value) {
+    if (value <= 0x7F) {
+        pack_tag(context, (unsigned char)value, 0, 0);
+    } else if (value <= UINT8_MAX) {
+        pack_tag(context, 0xCC, value, 1);
+    } else if (value <= UINT16_MAX) {
+        pack_tag(context, 0xCD, value, 2);
+    } else if (value <= UINT32_MAX) {
+        pack_tag(context, 0xCE, value, 4);
+    } else {
+        pack_tag(context, 0xCF, value, 8);
+    }
+}
+
+static void pack_negative(PackContext* context, int64_t value) {
+    if (value >= -32) {
+        pack_tag(context, (unsigned char)value, 0, 0);
+    } else if (value >= INT8_MIN) {
+        pack_tag(context, 0xD0, (uint64_t)value, 1);
+    } else if (value >= INT16_MIN) {
+        pack_tag(context, 0xD1, (uint64_t)value, 2);
+    } else if (value >= INT32_MIN) {
+        pack_tag(context, 0xD2, (uint64_t)value, 4);
+    } else {
+        pack_tag(context, 0xD3, (uint64_t)value, 8);
+    }
+}
+
+static void pack_integer(PackContext* context, VALUE integer) {
+    // rb_integer_pack returns the sign of the integer, or +/-2 when it does not fit
+    int64_t signed_value;
+    const int sign = rb_integer_pack(integer, &signed_value, 1, sizeof(signed_value), 0,
+                                     INTEGER_PACK_LSWORD_FIRST | INTEGER_PACK_NATIVE_BYTE_ORDER | INTEGER_PACK_2COMP);
+    if (sign == -1) {
+        pack_negative(context, signed_value);
+        return;
+    }
+    if (sign == 0 || sign == 1) {
+        pack_unsigned(context, (uint64_t)signed_value);
+        return;
+    }
+
+    uint64_t unsigned_value;
+    if (sign == 2 && rb_integer_pack(integer, &unsigned_value, 1, sizeof(unsigned_value), 0,
+                                     INTEGER_PACK_LSWORD_FIRST | INTEGER_PACK_NATIVE_BYTE_ORDER) == 1) {
+        pack_unsigned(context, unsigned_value);
+        return;
+    }
+
+    // Does not fit in 64 bits
+    pack_string(context, rb_obj_as_string(integer));
+}
+
+static int pack_hash_pair(VALUE key, VALUE value, VALUE arg) {
+    PackContext* context = (PackContext*)arg;
+    pack_value(context, key);
+    pack_value(context, value);
+    return ST_CONTINUE;
+}
+
+static void pack_value(PackContext* context, VALUE value) {
+    if (NIL_P(value)) {
+        pack_tag(context, 0xC0, 0, 0);
+    } else if (value == Qfalse) {
+        pack_tag(context, 0xC2, 0, 0);
+    } else if (value == Qtrue) {
+        pack_tag(context, 0xC3, 0, 0);
+    } else if (RB_INTEGER_TYPE_P(value)) {
+        pack_integer(context, value);
+    } else if (RB_FLOAT_TYPE_P(value)) {
+        const double real = RFLOAT_VALUE(value);
+        uint64_t bits;
+        memcpy(&bits, &real, sizeof(bits));
+        pack_tag(context, 0xCB, bits, 8);
+    } else if (RB_TYPE_P(value, T_STRING)) {
+        pack_string(context, value);
+    } else if (RB_SYMBOL_P(value)) {
+        pack_string(context, rb_sym2str(value));
+    } else if ((RB_TYPE_P(value, T_ARRAY) || RB_TYPE_P(value, T_HASH)) && context->depth >= RESULT_PACK_MAX_DEPTH) {
+        pack_tag(context, 0xC0, 0, 0);
+    } else if (RB_TYPE_P(value, T_ARRAY)) {
+        const long length = RARRAY_LEN(value);
+        pack_length(context, 0x90, 15, 0, 0xDC, 0xDD, (uint64_t)length);
+        context->depth++;
+        for (long i = 0; i < length; i++) {
+            pack_value(context, rb_ary_entry(value, i));
+        }
+        context->depth--;
+    } else if (RB_TYPE_P(value, T_HASH)) {
+        pack_length(context, 0x80, 15, 0, 0xDE, 0xDF, (uint64_t)RHASH_SIZE(value));
+        context->depth++;
+        rb_hash_foreach(value, pack_hash_pair, (VALUE)context);
+        context->depth--;
+    } else {
+        pack_string(context, rb_obj_as_string(value));
+    }
+}
+
+static VALUE host_pack_result(VALUE self, VALUE value) {
+    (void) self;
+    PackContext context = { rb_str_buf_new(64), 0 };
+    pack_value(&context, value);
+    return context.buffer;
+}
+
+void ruby_host_module_define(size_t ractor_lane_size, size_t io_pool_size) {
+    if (ractor_lane_size == 0) {
+        const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        ractor_lane_size = cores > 1 ? (size_t)cores : 1;
+    }
+    if (ractor_lane_size > RACTOR_LANE_MAX_SIZE) {
+        ractor_lane_size = RACTOR_LANE_MAX_SIZE;
+    }
+    if (io_pool_size == 0) {
+        io_pool_size = IO_POOL_DEFAULT_SIZE;
+    }
+    if (io_pool_size > IO_POOL_MAX_SIZE) {
+        io_pool_size = IO_POOL_MAX_SIZE;
+    }
+
+    VALUE host_module = rb_define_module("RubyVMHost");
+    rb_define_const(host_module, "RACTOR_LANE_SIZE", SIZET2NUM(ractor_lane_size));
+    rb_define_const(host_module, "IO_POOL_SIZE", SIZET2NUM(io_pool_size));
+    rb_define_module_function(host_module, "serve_sync_evals", host_serve_sync_evals, 1);
+    rb_define_module_function(host_module, "next_cancellation", host_next_cancellation, 0);
+    rb_define_module_function(host_module, "startup_ready", host_startup_ready, 0);
+    rb_define_module_function(host_module, "iseq_cache_capacity", host_iseq_cache_capacity, 0);
+    rb_define_module_function(host_module, "iseq_cache_record", host_iseq_cache_record, 2);
+    rb_define_module_function(host_module, "pack_result", host_pack_result, 1);
+}
@@ -0,0 +1,48 @@
+#ifndef RUBY_HOST_MODULE_H
+#define RUBY_HOST_MODULE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Define the 'RubyVMHost' module, giving Ruby code access to the host side of the VM:
+ *
+ *   RubyVMHost.serve_sync_evals(lock) -> nil
+ *     Serve ruby_vm_eval_sync requests forever, evaluating each one in TOPLEVEL_BINDING
+ *     while holding 'lock' (a Mutex, or nil). Returns once the VM is being destroyed.
+ *
+ *   RubyVMHost.next_cancellation -> [request_id, status] or nil
+ *     Wait outside of the GVL for the next request to interrupt (see ruby-cancellation.h).
+ *     Returns nil once the VM is being destroyed.
+ *
+ *   RubyVMHost.startup_ready -> nil
+ *     Mark the main script as serving the commands channel (see RUBY_STARTUP_INTERPRETER_READY)
+ *
+ *   RubyVMHost.iseq_cache_capacity -> Integer
+ *   RubyVMHost.iseq_cache_record(event, entries) -> nil
+ *     Capacity and counters of the compiled script cache (see ruby-iseq-cache.h)
+ *
+ *   RubyVMHost.pack_result(value) -> String
+ *     MessagePack encoding of a script result, as described by ruby_vm_enqueue_with_result
+ *
+ *   RubyVMHost::RACTOR_LANE_SIZE -> Integer
+ *     Ractors running the scripts enqueued with RUBY_ENQUEUE_RACTOR
+ *
+ *   RubyVMHost::IO_POOL_SIZE -> Integer
+ *     Threads running the scripts enqueued with RUBY_ENQUEUE_IO or in a stream
+ *
+ * Must be called on the VM thread, after ruby_init().
+ *
+ * @param ractor_lane_size Size of the Ractor lane, 0 for one Ractor per core (up to RACTOR_LANE_MAX_SIZE)
+ * @param io_pool_size Size of the I/O thread pool, 0 for IO_POOL_DEFAULT_SIZE (up to IO_POOL_MAX_SIZE)
+ */
+void ruby_host_module_define(size_t ractor_lane_size, size_t io_pool_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_HOST_MODULE_H
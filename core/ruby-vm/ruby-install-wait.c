@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "constants.h"
+#include "ruby-install-wait.h"
+#include "ruby-cache-files.h"
+#include "install.h"
+#include "debug.h"
+
+#pragma GCC diagnostic push
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#else
+#ifdef __clang__
+#pragma clang diagnostic ignored "-Wdefault-const-init-field-unsafe"
+#pragma clang diagnostic ignored "-Wunused-parameter"
+#endif
+#endif
+#include "ruby/ruby.h"
+#include "ruby/thread.h"
+#include "ruby/version.h"
+#pragma GCC diagnostic pop
+
+// "<base directory>/", stripped from absolute features
+static char g_base_prefix[MAX_PATH_LENGTH];
+// "ruby/<version>/<platform>/", where the native extensions of the standard library are installed
+static char g_extension_dir[MAX_PATH_LENGTH];
+
+typedef struct {
+    const char* path;
+    int result;
+} WaitFileArgs;
+
+/**
+ * Checked before anything else: once the install is over, a require costs one call more.
+ * A feature that cannot be turned into a path is left to the original require to report.
+ */
+static const char* INSTALL_WAIT_SCRIPT =
+        "module Kernel\n"
+        "  alias_method :ruby_vm_uninstalled_require, :require\n"
+        "\n"
+        "  def require(feature)\n"
+        "    if RubyVMHost.install_pending\n"
+        "      path = File.path(feature) rescue nil\n"
+        "      RubyVMHost.install_wait_extension(path) if path\n"
+        "    end\n"
+        "    ruby_vm_uninstalled_require(feature)\n"
+        "  end\n"
+        "\n"
+        "  private :require, :ruby_vm_uninstalled_require\n"
+        "end\n";
+
+static int ends_with(const char* value, size_t length, const char* suffix) {
+    const size_t suffix_length = strlen(suffix);
+    return length >= suffix_length && memcmp(value + length - suffix_length, suffix, suffix_length) == 0;
+}
+
+/**
+ * Path relative to the base directory of the native extension a feature names
+ *
+ * @return 0 when the feature may name a native extension of the standard library, -1 otherwise
+ */
+static int extension_path(const char* feature, size_t length, char* path, size_t path_size) {
+    const size_t prefix_length = strlen(g_base_prefix);
+    int written;
+
+    if (feature[0] == '/') {
+        // Only the resolved path of an installed file (compile cache, RubyGems...) is worth a wait
+        if (length <= prefix_length || strncmp(feature, g_base_prefix, prefix_length) != 0 ||
+            !ends_with(feature, length, DLEXT)) {
+            return -1;
+        }
+        written = snprintf(path, path_size, "%s", feature + prefix_length);
+    } else {
+        if (ends_with(feature, length, ".rb")) {
+            return -1;
+        }
+        const char* extension = ends_with(feature, length, DLEXT) ? "" : DLEXT;
+        written = snprintf(path, path_size, "%s%s%s", g_extension_dir, feature, extension);
+    }
+    return written > 0 && (size_t)written < path_size ? 0 : -1;
+}
+
+static void* wait_file_without_gvl(void* arg) {
+    WaitFileArgs* args = (WaitFileArgs*)arg;
+    args->result = install_wait_file(args->path);
+    return NULL;
+}
+
+static VALUE host_install_pending(VALUE self) {
+    (void) self;
+    return install_pending() ? Qtrue : Qfalse;
+}
+
+static VALUE host_install_wait_extension(VALUE self, VALUE feature) {
+    (void) self;
+
+    Check_Type(feature, T_STRING);
+    char path[MAX_PATH_LENGTH];
+    const size_t length = (size_t)RSTRING_LEN(feature);
+    if (length == 0 || length >= sizeof(path) || memchr(RSTRING_PTR(feature), '\0', length) ||
+        extension_path(RSTRING_PTR(feature), length, path, sizeof(path)) != 0) {
+        return Qtrue;
+    }
+
+    // Bounded by the extraction of one file: not interruptible, like a blocking read of that file
+    WaitFileArgs args = { path, 0 };
+    rb_thread_call_without_gvl(wait_file_without_gvl, &args, NULL, NULL);
+    if (args.result != 0) {
+        DEBUG_LOG("ruby_install_wait: %s could not be installed", path);
+    }
+    return args.result == 0 ? Qtrue : Qfalse;
+}
+
+int ruby_install_wait_define(const char* base_directory) {
+    const int prefix_length = snprintf(g_base_prefix, sizeof(g_base_prefix), "%s/", base_directory);
+    const int dir_length = snprintf(g_extension_dir, sizeof(g_extension_dir), "ruby/%d.%d.%d/" RUBY_PLATFORM "/",
+                                    RUBY_API_VERSION_MAJOR, RUBY_API_VERSION_MINOR, RUBY_API_VERSION_TEENY);
+    if (prefix_length <= 0 || prefix_length >= (int)sizeof(g_base_prefix) ||
+        dir_length <= 0 || dir_length >= (int)sizeof(g_extension_dir)) {
+        return -1;
+    }
+
+    VALUE host_module = rb_define_module("RubyVMHost");
+    rb_define_module_function(host_module, "install_pending", host_install_pending, 0);
+    rb_define_module_function(host_module, "install_wait_extension", host_install_wait_extension, 1);
+
+    if (ruby_cache_eval_script(INSTALL_WAIT_SCRIPT, "<ruby-vm-install-wait>") != 0) {
+        DEBUG_LOG("ruby_install_wait_define: failed to wrap Kernel#require");
+        return -1;
+    }
+
+    DEBUG_LOG("ruby_install_wait_define: native extensions awaited in %s%s", g_base_prefix, g_extension_dir);
+    return 0;
+}
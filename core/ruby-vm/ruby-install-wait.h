@@ -0,0 +1,34 @@
+#ifndef RUBY_INSTALL_WAIT_H
+#define RUBY_INSTALL_WAIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Let the VM start while the native extensions of the standard library are still being installed.
+ *
+ * Kernel#require is wrapped so that, while the install started by install_embedded_files_start runs,
+ * a feature naming a native extension of the standard library ("digest", "json/ext/parser.so",
+ * or its absolute path) waits for that file first, the GVL released. A file no worker reached yet
+ * is extracted by the requiring thread itself. Once the install is over, the wrapper only checks a flag.
+ * Also defines:
+ *
+ *   RubyVMHost.install_pending -> true or false
+ *     Whether some files of the install are not in place yet
+ *
+ *   RubyVMHost.install_wait_extension(feature) -> true or false
+ *     Wait for the native extension a feature names, false if it could not be installed
+ *
+ * Must be called on the VM thread, after install_wait(INSTALL_STAGE_SOURCES) and before ruby_options().
+ *
+ * @param base_directory Ruby base directory the files are installed in
+ * @return 0 on success, -1 if the wrapper could not be installed
+ */
+int ruby_install_wait_define(const char* base_directory);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_INSTALL_WAIT_H
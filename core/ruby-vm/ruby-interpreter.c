@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <use_direct_memory.h>
 
 #include "constants.h"
@@ -8,11 +9,25 @@
 #include "ruby-vm.h"
 #include "ruby-script.h"
 #include "ruby-interpreter.h"
+#include "exec-main-vm.h"
 #include "debug.h"
 
 // Static global VM instance
 static RubyVM* g_global_vm = NULL;
 
+// Serializes the creation of the global VM: a prewarm and a first enqueue from another thread create it once
+static pthread_mutex_t g_global_vm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Preload script of a prewarm, released once it completed
+ */
+typedef struct {
+    RubyScript* script;
+    RubyCompletionTask on_ready;
+    size_t remaining;       // VMs still running the preload, one per worker of a pool
+    int result;             // First failure of a VM, 0 if none
+} PrewarmContext;
+
 RubyInterpreter* ruby_interpreter_create(const char* application_path,
                                        const char* ruby_base_directory,
                                        const char* native_libs_location,
@@ -25,6 +40,19 @@ RubyInterpreter* ruby_interpreter_create(const char* application_path,
     interpreter->native_libs_location = strdup(native_libs_location);
     interpreter->log_listener = listener;
     interpreter->vm = NULL;
+    interpreter->payload_ring_capacity = 0;
+    interpreter->embedded_stdlib = 0;
+    interpreter->compile_cache_capacity = 0;
+    interpreter->preload_profile = 0;
+    interpreter->preload_profile_seconds = 0;
+    interpreter->preload_profile_scripts = 0;
+    interpreter->ractor_lane_size = 0;
+    interpreter->io_pool_size = 0;
+    interpreter->zygote = NULL;
+    interpreter->worker_pool = 0;
+    interpreter->worker_pool_size = 0;
+    interpreter->worker_pool_zygote = NULL;
+    interpreter->pool = NULL;
 
     return interpreter;
 }
@@ -32,26 +60,109 @@ RubyInterpreter* ruby_interpreter_create(const char* application_path,
 void ruby_interpreter_destroy(RubyInterpreter* interpreter) {
     if (!interpreter) return;
 
+    // The global VM lives as long as the process, a worker of a zygote only as long as its interpreter
+    if (interpreter->pool) {
+        ruby_vm_pool_destroy(interpreter->pool);
+    } else if (interpreter->zygote && interpreter->vm) {
+        ruby_vm_destroy(interpreter->vm);
+    }
+    ruby_zygote_destroy(interpreter->worker_pool_zygote);
+
     free(interpreter->application_path);
     free(interpreter->ruby_base_directory);
     free(interpreter->native_libs_location);
     free(interpreter);
 }
 
-int ruby_interpreter_enqueue(RubyInterpreter* interpreter, RubyScript* script, RubyCompletionTask on_complete) {
+static RubyScript* create_main_script(void) {
+    DEBUG_LOG("Creating FIFO interpreter script");
+    return ruby_script_create_from_content(
+            get_in_memory_file_content(FIFO_INTERPRETER_SCRIPT),
+            get_in_memory_file_size(FIFO_INTERPRETER_SCRIPT)
+    );
+}
+
+/**
+ * Create and start the worker VM of an interpreter using a zygote, on first use
+ *
+ * @param completion_result Receives the result to complete the scripts with on failure
+ * @return 0 on success, non-zero on error
+ */
+static int acquire_zygote_vm_locked(RubyInterpreter* interpreter, int* completion_result) {
+    if (interpreter->vm) {
+        return 0;
+    }
+
+    DEBUG_LOG("Creating VM forked by the zygote");
+    RubyVM* vm = ruby_vm_create(interpreter->application_path, interpreter->zygote->main_script, interpreter->log_listener);
+    if (!vm) {
+        DEBUG_LOG("ruby_vm_create() failed");
+        *completion_result = 2;
+        return 2;
+    }
+
+    ruby_vm_use_zygote(vm, interpreter->zygote);
+    const int start_result = ruby_vm_start(vm, interpreter->ruby_base_directory, interpreter->native_libs_location);
+    if (start_result != 0) {
+        DEBUG_LOG("ruby_vm_start() failed with code: %d (%s)", start_result, ruby_vm_get_error_message(vm));
+        ruby_vm_destroy(vm);
+        *completion_result = 3;
+        return start_result;
+    }
+
+    interpreter->vm = vm;
+    return 0;
+}
+
+/**
+ * Create and start the worker pool of an interpreter on first use
+ *
+ * @param completion_result Receives the result to complete the scripts with on failure
+ * @return 0 on success, non-zero on error
+ */
+static int acquire_worker_pool_locked(RubyInterpreter* interpreter, int* completion_result) {
+    if (interpreter->pool) {
+        return 0;
+    }
+
+    RubyZygote* zygote = interpreter->zygote ? interpreter->zygote : interpreter->worker_pool_zygote;
+    DEBUG_LOG("Creating a pool of %zu VMs forked by the zygote", interpreter->worker_pool_size);
+    interpreter->pool = ruby_vm_pool_create(interpreter->worker_pool_size, zygote, interpreter->application_path,
+                                            interpreter->ruby_base_directory, interpreter->native_libs_location,
+                                            interpreter->log_listener);
+    if (!interpreter->pool) {
+        DEBUG_LOG("ruby_vm_pool_create() failed");
+        *completion_result = 3;
+        return 3;
+    }
+
+    // For the error message and the logging, which are not those of a particular worker
+    interpreter->vm = interpreter->pool->workers[0].vm;
+    return 0;
+}
+
+/**
+ * Create and start the global VM on first use, or attach it to the interpreter
+ *
+ * @param completion_result Receives the result to complete the scripts with on failure
+ * @return 0 on success, non-zero on error
+ */
+static int acquire_global_vm_locked(RubyInterpreter* interpreter, int* completion_result) {
+    if (interpreter->worker_pool) {
+        return acquire_worker_pool_locked(interpreter, completion_result);
+    }
+    if (interpreter->zygote) {
+        return acquire_zygote_vm_locked(interpreter, completion_result);
+    }
 
     if (g_global_vm == NULL) {
         DEBUG_LOG("Creating VM for first time");
 
         // Build main script
-        DEBUG_LOG("Creating FIFO interpreter script");
-        RubyScript* main_script = ruby_script_create_from_content(
-                get_in_memory_file_content(FIFO_INTERPRETER_SCRIPT),
-                get_in_memory_file_size(FIFO_INTERPRETER_SCRIPT)
-        );
+        RubyScript* main_script = create_main_script();
         if (!main_script) {
             DEBUG_LOG("Failed to create main script");
-            ruby_completion_task_invoke(&on_complete, 1);
+            *completion_result = 1;
             return 1;
         }
 
@@ -60,19 +171,41 @@ int ruby_interpreter_enqueue(RubyInterpreter* interpreter, RubyScript* script, R
         if (!g_global_vm) {
             DEBUG_LOG("ruby_vm_create() failed");
             ruby_script_destroy(main_script);
-            ruby_completion_task_invoke(&on_complete, 2);
+            *completion_result = 2;
             return 2;
         }
 
         // Store VM reference in interpreter for error access
         interpreter->vm = g_global_vm;
 
+        if (interpreter->payload_ring_capacity > 0 &&
+            ruby_vm_enable_payload_ring(g_global_vm, interpreter->payload_ring_capacity) != 0) {
+            DEBUG_LOG("Payload ring unavailable, continuing with inline scripts: %s", ruby_vm_get_error_message(g_global_vm));
+            ruby_vm_clear_error(g_global_vm);
+        }
+
+        if (interpreter->embedded_stdlib) {
+            ruby_vm_enable_embedded_stdlib(g_global_vm);
+        }
+
+        if (interpreter->compile_cache_capacity > 0) {
+            ruby_vm_enable_compile_cache(g_global_vm, interpreter->compile_cache_capacity);
+        }
+
+        if (interpreter->preload_profile) {
+            ruby_vm_enable_preload_profile(g_global_vm, interpreter->preload_profile_seconds,
+                                           interpreter->preload_profile_scripts);
+        }
+
+        ruby_vm_set_ractor_lane_size(g_global_vm, interpreter->ractor_lane_size);
+        ruby_vm_set_io_pool_size(g_global_vm, interpreter->io_pool_size);
+
         DEBUG_LOG("Calling ruby_vm_start()");
         int start_result = ruby_vm_start(g_global_vm, interpreter->ruby_base_directory, interpreter->native_libs_location);
         if (start_result != 0) {
             DEBUG_LOG("ruby_vm_start() failed with code: %d", start_result);
             DEBUG_LOG("Error message: %s", ruby_vm_get_error_message(g_global_vm));
-            ruby_completion_task_invoke(&on_complete, 3);
+            *completion_result = 3;
             return start_result;
         }
         DEBUG_LOG("VM started successfully");
@@ -81,13 +214,432 @@ int ruby_interpreter_enqueue(RubyInterpreter* interpreter, RubyScript* script, R
         g_global_vm->log_listener = interpreter->log_listener;
         interpreter->vm = g_global_vm;
     }
+    return 0;
+}
+
+static int acquire_global_vm(RubyInterpreter* interpreter, int* completion_result) {
+    pthread_mutex_lock(&g_global_vm_lock);
+    const int result = acquire_global_vm_locked(interpreter, completion_result);
+    pthread_mutex_unlock(&g_global_vm_lock);
+    return result;
+}
+
+/**
+ * Build the script requiring every preloaded feature. A feature that fails to load does not prevent
+ * the next ones, the script raises once all of them were tried.
+ *
+ * @return The script, NULL on allocation failure
+ */
+static RubyScript* create_preload_script(const char** preload_requires, size_t count) {
+    static const char header[] = "missing = [";
+    static const char footer[] =
+            "].reject do |feature|\n"
+            "  require(feature) || true\n"
+            "rescue ScriptError, StandardError => e\n"
+            "  warn(\"Cannot preload #{feature}: #{e.message}\")\n"
+            "  false\n"
+            "end\n"
+            "raise LoadError, \"cannot preload #{missing.join(', ')}\" unless missing.empty?\n";
+
+    // Every feature becomes a single-quoted literal, each character escaped at worst
+    size_t capacity = sizeof(header) + sizeof(footer);
+    for (size_t i = 0; i < count; i++) {
+        capacity += 2 * strlen(preload_requires[i]) + 4;
+    }
+    char* content = malloc(capacity);
+    if (!content) return NULL;
+
+    size_t length = 0;
+    memcpy(content, header, sizeof(header) - 1);
+    length += sizeof(header) - 1;
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) content[length++] = ',';
+        content[length++] = '\'';
+        for (const char* c = preload_requires[i]; *c; c++) {
+            if (*c == '\'' || *c == '\\') content[length++] = '\\';
+            content[length++] = *c;
+        }
+        content[length++] = '\'';
+    }
+    memcpy(content + length, footer, sizeof(footer) - 1);
+    length += sizeof(footer) - 1;
+
+    RubyScript* script = ruby_script_create_from_content(content, length);
+    free(content);
+    return script;
+}
+
+static void on_preload_complete(void* user_data, int result) {
+    PrewarmContext* context = user_data;
+    int none = 0;
+    if (result != 0) {
+        __atomic_compare_exchange_n(&context->result, &none, result, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+    if (__atomic_sub_fetch(&context->remaining, 1, __ATOMIC_ACQ_REL) > 0) {
+        return;
+    }
+
+    ruby_script_destroy(context->script);
+    ruby_completion_task_invoke(&context->on_ready, __atomic_load_n(&context->result, __ATOMIC_RELAXED));
+    free(context);
+}
+
+int ruby_interpreter_enqueue(RubyInterpreter* interpreter, RubyScript* script, RubyCompletionTask on_complete) {
+    return ruby_interpreter_enqueue_with_flags(interpreter, script, RUBY_ENQUEUE_DEFAULT, on_complete);
+}
+
+int ruby_interpreter_enqueue_with_flags(RubyInterpreter* interpreter, RubyScript* script, uint32_t flags, RubyCompletionTask on_complete) {
+    int completion_result = 0;
+    const int vm_result = acquire_global_vm(interpreter, &completion_result);
+    if (vm_result != 0) {
+        ruby_completion_task_invoke(&on_complete, completion_result);
+        return vm_result;
+    }
 
     DEBUG_LOG("Enqueueing script");
-    ruby_vm_enqueue(g_global_vm, script, on_complete);
+    if (interpreter->pool) {
+        ruby_vm_pool_enqueue(interpreter->pool, script, flags, on_complete);
+    } else {
+        ruby_vm_enqueue_with_flags(interpreter->vm, script, flags, on_complete);
+    }
     DEBUG_LOG("Script enqueued");
     return 0;
 }
 
+int ruby_interpreter_enqueue_sharded(RubyInterpreter* interpreter, uint64_t shard_key, RubyScript* script, RubyCompletionTask on_complete) {
+    int completion_result = 0;
+    const int vm_result = acquire_global_vm(interpreter, &completion_result);
+    if (vm_result != 0) {
+        ruby_completion_task_invoke(&on_complete, completion_result);
+        return vm_result;
+    }
+
+    // A single VM runs every key in order already
+    if (interpreter->pool) {
+        ruby_vm_pool_enqueue_sharded(interpreter->pool, shard_key, script, on_complete);
+    } else {
+        ruby_vm_enqueue(interpreter->vm, script, on_complete);
+    }
+    return 0;
+}
+
+int ruby_interpreter_enqueue_sharded_with_result(RubyInterpreter* interpreter, uint64_t shard_key, RubyScript* script, RubyResultTask on_result) {
+    int completion_result = 0;
+    const int vm_result = acquire_global_vm(interpreter, &completion_result);
+    if (vm_result != 0) {
+        ruby_result_task_invoke(&on_result, completion_result, NULL, 0);
+        return vm_result;
+    }
+
+    if (interpreter->pool) {
+        ruby_vm_pool_enqueue_sharded_with_result(interpreter->pool, shard_key, script, on_result);
+    } else {
+        ruby_vm_enqueue_with_result(interpreter->vm, script, on_result);
+    }
+    return 0;
+}
+
+int ruby_interpreter_prewarm(RubyInterpreter* interpreter, const char** preload_requires, size_t count, RubyCompletionTask on_ready) {
+    // Even without anything to preload, readiness is reported once the VM ran a script
+    PrewarmContext* context = malloc(sizeof(PrewarmContext));
+    RubyScript* script = create_preload_script(preload_requires, preload_requires ? count : 0);
+    if (!context || !script) {
+        free(context);
+        ruby_script_destroy(script);
+        ruby_completion_task_invoke(&on_ready, 1);
+        return -1;
+    }
+    context->script = script;
+    context->on_ready = on_ready;
+    context->remaining = 1;
+    context->result = 0;
+
+    // Enqueued along with the creation: when the prewarm starts the VM, no other script runs before the preload
+    int completion_result = 0;
+    pthread_mutex_lock(&g_global_vm_lock);
+    const int vm_result = acquire_global_vm_locked(interpreter, &completion_result);
+    if (vm_result == 0) {
+        DEBUG_LOG("Prewarming the VM with %zu preloaded features", preload_requires ? count : 0);
+        if (interpreter->pool) {
+            // Every worker preloads, whichever gets the next scripts
+            context->remaining = interpreter->pool->size;
+            for (size_t i = 0; i < interpreter->pool->size; i++) {
+                ruby_vm_enqueue(interpreter->pool->workers[i].vm, script, ruby_completion_task_create(on_preload_complete, context));
+            }
+        } else {
+            ruby_vm_enqueue(interpreter->vm, script, ruby_completion_task_create(on_preload_complete, context));
+        }
+    }
+    pthread_mutex_unlock(&g_global_vm_lock);
+
+    if (vm_result != 0) {
+        on_preload_complete(context, completion_result);
+    }
+    return vm_result;
+}
+
+int ruby_interpreter_enqueue_with_deadline(RubyInterpreter* interpreter, RubyScript* script, uint32_t timeout_ms, RubyCompletionTask on_complete, uint64_t* out_request_id) {
+    int completion_result = 0;
+    const int vm_result = acquire_global_vm(interpreter, &completion_result);
+    if (vm_result != 0) {
+        ruby_completion_task_invoke(&on_complete, completion_result);
+        return vm_result;
+    }
+
+    const uint64_t request_id = interpreter->pool
+                                ? ruby_vm_pool_enqueue_with_deadline(interpreter->pool, script, timeout_ms, on_complete)
+                                : ruby_vm_enqueue_with_deadline(interpreter->vm, script, timeout_ms, on_complete);
+    if (out_request_id) {
+        *out_request_id = request_id;
+    }
+    return 0;
+}
+
+int ruby_interpreter_cancel(RubyInterpreter* interpreter, uint64_t request_id) {
+    if (!interpreter || !interpreter->vm) return -1;
+    if (interpreter->pool) {
+        return ruby_vm_pool_cancel(interpreter->pool, request_id);
+    }
+    return ruby_vm_cancel(interpreter->vm, request_id);
+}
+
+int ruby_interpreter_enqueue_with_result(RubyInterpreter* interpreter, RubyScript* script, RubyResultTask on_result) {
+    return ruby_interpreter_enqueue_with_result_and_flags(interpreter, script, RUBY_ENQUEUE_DEFAULT, on_result);
+}
+
+int ruby_interpreter_enqueue_with_result_and_flags(RubyInterpreter* interpreter, RubyScript* script, uint32_t flags, RubyResultTask on_result) {
+    int completion_result = 0;
+    const int vm_result = acquire_global_vm(interpreter, &completion_result);
+    if (vm_result != 0) {
+        ruby_result_task_invoke(&on_result, completion_result, NULL, 0);
+        return vm_result;
+    }
+
+    if (interpreter->pool) {
+        ruby_vm_pool_enqueue_with_result(interpreter->pool, script, flags, on_result);
+    } else {
+        ruby_vm_enqueue_with_result_and_flags(interpreter->vm, script, flags, on_result);
+    }
+    return 0;
+}
+
+int ruby_interpreter_enqueue_in_stream(RubyInterpreter* interpreter, uint32_t stream, RubyScript* script, RubyCompletionTask on_complete) {
+    int completion_result = 0;
+    const int vm_result = acquire_global_vm(interpreter, &completion_result);
+    if (vm_result != 0) {
+        ruby_completion_task_invoke(&on_complete, completion_result);
+        return vm_result;
+    }
+
+    // A worker runs one request at a time: the worker of the shard of the stream keeps its order
+    if (!interpreter->pool) {
+        ruby_vm_enqueue_in_stream(interpreter->vm, stream, script, on_complete);
+    } else if (stream != 0) {
+        ruby_vm_pool_enqueue_sharded(interpreter->pool, stream, script, on_complete);
+    } else {
+        ruby_vm_pool_enqueue(interpreter->pool, script, RUBY_ENQUEUE_IO, on_complete);
+    }
+    return 0;
+}
+
+int ruby_interpreter_enqueue_in_stream_with_result(RubyInterpreter* interpreter, uint32_t stream, RubyScript* script, RubyResultTask on_result) {
+    int completion_result = 0;
+    const int vm_result = acquire_global_vm(interpreter, &completion_result);
+    if (vm_result != 0) {
+        ruby_result_task_invoke(&on_result, completion_result, NULL, 0);
+        return vm_result;
+    }
+
+    if (!interpreter->pool) {
+        ruby_vm_enqueue_in_stream_with_result(interpreter->vm, stream, script, on_result);
+    } else if (stream != 0) {
+        ruby_vm_pool_enqueue_sharded_with_result(interpreter->pool, stream, script, on_result);
+    } else {
+        ruby_vm_pool_enqueue_with_result(interpreter->pool, script, RUBY_ENQUEUE_IO, on_result);
+    }
+    return 0;
+}
+
+int ruby_interpreter_enqueue_batch(RubyInterpreter* interpreter, RubyScript** scripts, size_t count, RubyCompletionTask* on_complete) {
+    int completion_result = 0;
+    const int vm_result = acquire_global_vm(interpreter, &completion_result);
+    if (vm_result != 0) {
+        for (size_t i = 0; on_complete && i < count; i++) {
+            ruby_completion_task_invoke(&on_complete[i], completion_result);
+        }
+        return vm_result;
+    }
+
+    DEBUG_LOG("Enqueueing batch of %zu scripts", count);
+    if (interpreter->pool) {
+        ruby_vm_pool_enqueue_batch(interpreter->pool, scripts, count, on_complete);
+    } else {
+        ruby_vm_enqueue_batch(interpreter->vm, scripts, count, on_complete);
+    }
+    return 0;
+}
+
+void ruby_interpreter_enable_payload_ring(RubyInterpreter* interpreter, size_t capacity) {
+    if (!interpreter) return;
+    interpreter->payload_ring_capacity = capacity;
+}
+
+void ruby_interpreter_enable_embedded_stdlib(RubyInterpreter* interpreter) {
+    if (!interpreter) return;
+    interpreter->embedded_stdlib = 1;
+}
+
+void ruby_interpreter_enable_compile_cache(RubyInterpreter* interpreter, size_t capacity) {
+    if (!interpreter) return;
+    interpreter->compile_cache_capacity = capacity > 0 ? capacity : COMPILE_CACHE_DEFAULT_CAPACITY;
+}
+
+void ruby_interpreter_enable_preload_profile(RubyInterpreter* interpreter, uint32_t max_seconds, uint32_t max_scripts) {
+    if (!interpreter) return;
+    interpreter->preload_profile = 1;
+    interpreter->preload_profile_seconds = max_seconds;
+    interpreter->preload_profile_scripts = max_scripts;
+}
+
+void ruby_interpreter_set_ractor_lane_size(RubyInterpreter* interpreter, size_t size) {
+    if (!interpreter) return;
+    interpreter->ractor_lane_size = size;
+}
+
+void ruby_interpreter_set_io_pool_size(RubyInterpreter* interpreter, size_t size) {
+    if (!interpreter) return;
+    interpreter->io_pool_size = size;
+}
+
+RubyZygote* ruby_interpreter_create_zygote(const RubyInterpreter* interpreter, const char** preload_requires, size_t count) {
+    if (!interpreter) return NULL;
+
+    RubyScript* main_script = create_main_script();
+    if (!main_script) return NULL;
+
+    // Same defaults as ruby_vm_enable_preload_profile
+    const int profile_defaults = interpreter->preload_profile &&
+                                 interpreter->preload_profile_seconds == 0 && interpreter->preload_profile_scripts == 0;
+    const ExecMainOptions options = {
+        .embedded_stdlib = interpreter->embedded_stdlib,
+        .compile_cache_capacity = interpreter->compile_cache_capacity,
+        .preload_profile_seconds = profile_defaults ? PRELOAD_PROFILE_DEFAULT_SECONDS : interpreter->preload_profile_seconds,
+        .preload_profile_scripts = profile_defaults ? PRELOAD_PROFILE_DEFAULT_SCRIPTS : interpreter->preload_profile_scripts,
+        .ractor_lane_size = interpreter->ractor_lane_size,
+        .io_pool_size = interpreter->io_pool_size
+    };
+
+    RubyZygote* zygote = ruby_zygote_create(main_script, interpreter->ruby_base_directory, interpreter->native_libs_location,
+                                            &options, preload_requires, count);
+    if (!zygote) {
+        ruby_script_destroy(main_script);
+    }
+    return zygote;
+}
+
+void ruby_interpreter_use_zygote(RubyInterpreter* interpreter, RubyZygote* zygote) {
+    if (!interpreter) return;
+    interpreter->zygote = zygote;
+}
+
+int ruby_interpreter_enable_worker_pool(RubyInterpreter* interpreter, size_t size, const char** preload_requires, size_t count) {
+    if (!interpreter) return -1;
+
+    // Forked now rather than with the first script, while the host has few threads
+    if (!interpreter->zygote && !interpreter->worker_pool_zygote) {
+        interpreter->worker_pool_zygote = ruby_interpreter_create_zygote(interpreter, preload_requires, count);
+        if (!interpreter->worker_pool_zygote) {
+            DEBUG_LOG("Cannot create the zygote of the worker pool");
+            return -1;
+        }
+    }
+    interpreter->worker_pool = 1;
+    interpreter->worker_pool_size = size;
+    return 0;
+}
+
+size_t ruby_interpreter_get_shard_stats(const RubyInterpreter* interpreter, RubyVMPoolShardStats* out_stats, size_t capacity) {
+    if (!interpreter || !interpreter->pool) return 0;
+    return ruby_vm_pool_get_shard_stats(interpreter->pool, out_stats, capacity);
+}
+
+int ruby_interpreter_eval_sync(RubyInterpreter* interpreter, const char* source, size_t length, RubyEvalResult* out_result) {
+    int completion_result = 0;
+    const int vm_result = acquire_global_vm(interpreter, &completion_result);
+    if (vm_result != 0) {
+        out_result->status = -1;
+        snprintf(out_result->message, sizeof(out_result->message), "Ruby VM could not be started (error %d)", vm_result);
+        return -1;
+    }
+    if (interpreter->pool) {
+        return ruby_vm_pool_eval_sync(interpreter->pool, source, length, out_result);
+    }
+    return ruby_vm_eval_sync(interpreter->vm, source, length, out_result);
+}
+
+RubyPreparedScript* ruby_interpreter_prepare(RubyInterpreter* interpreter, RubyScript* script) {
+    int completion_result = 0;
+    if (acquire_global_vm(interpreter, &completion_result) != 0) {
+        return NULL;
+    }
+    if (interpreter->pool) {
+        return ruby_vm_pool_prepare(interpreter->pool, script);
+    }
+    return ruby_script_prepare(interpreter->vm, script);
+}
+
+int ruby_interpreter_invoke(RubyInterpreter* interpreter, RubyPreparedScript* prepared, const RubyArg* args, size_t count, RubyCompletionTask on_complete) {
+    if (!interpreter) {
+        ruby_completion_task_invoke(&on_complete, 1);
+        return -1;
+    }
+    return ruby_vm_invoke(prepared, args, count, on_complete);
+}
+
+int ruby_interpreter_invoke_with_result(RubyInterpreter* interpreter, RubyPreparedScript* prepared, const RubyArg* args, size_t count, RubyResultTask on_result) {
+    if (!interpreter) {
+        ruby_result_task_invoke(&on_result, 1, NULL, 0);
+        return -1;
+    }
+    return ruby_vm_invoke_with_result(prepared, args, count, on_result);
+}
+
+void ruby_interpreter_release_prepared(RubyInterpreter* interpreter, RubyPreparedScript* prepared) {
+    if (!interpreter) return;
+    ruby_prepared_script_destroy(prepared);
+}
+
+// Scripts run in processes forked by a zygote, which keep their own copy of the process-wide state
+static int runs_in_workers(const RubyInterpreter* interpreter) {
+    return interpreter->zygote != NULL || interpreter->worker_pool;
+}
+
+int ruby_interpreter_set_iseq_cache_capacity(RubyInterpreter* interpreter, size_t capacity) {
+    if (!interpreter || runs_in_workers(interpreter)) return -1;
+    ruby_iseq_cache_set_capacity(capacity);
+    return 0;
+}
+
+int ruby_interpreter_get_iseq_cache_stats(const RubyInterpreter* interpreter, RubyIseqCacheStats* out_stats) {
+    if (!interpreter || !out_stats) return -1;
+    if (runs_in_workers(interpreter)) {
+        memset(out_stats, 0, sizeof(*out_stats));
+        return -1;
+    }
+    ruby_iseq_cache_get_stats(out_stats);
+    return 0;
+}
+
+int ruby_interpreter_get_startup_profile(const RubyInterpreter* interpreter, RubyStartupProfile* out_profile) {
+    if (!interpreter || !out_profile) return -1;
+    if (runs_in_workers(interpreter)) {
+        memset(out_profile, 0, sizeof(*out_profile));
+        return -1;
+    }
+    ruby_startup_profile_get(out_profile);
+    return 0;
+}
+
 int ruby_interpreter_enable_logging(RubyInterpreter* interpreter) {
     if (!interpreter || !interpreter->vm) {
         return -1;
@@ -1,9 +1,18 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "log-listener.h"
 #include "completion-task.h"
 #include "ruby-script-location.h"
+#include "ruby-sync-eval.h"
+#include "ruby-iseq-cache.h"
+#include "ruby-prepared-script.h"
+#include "ruby-startup-profile.h"
+#include "ruby-zygote.h"
+#include "ruby-vm-pool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -21,6 +30,19 @@ struct RubyInterpreter {
     char* native_libs_location;
     RubyVM* vm;
     LogListener log_listener;
+    size_t payload_ring_capacity;
+    int embedded_stdlib;
+    size_t compile_cache_capacity;
+    int preload_profile;
+    uint32_t preload_profile_seconds;
+    uint32_t preload_profile_scripts;
+    size_t ractor_lane_size;
+    size_t io_pool_size;
+    RubyZygote* zygote;     // When set, 'vm' is a worker of its own instead of the global VM
+    int worker_pool;        // Scripts go to 'pool' instead of 'vm', which is its first worker
+    size_t worker_pool_size;
+    RubyZygote* worker_pool_zygote;    // Created for the pool when no zygote was given, destroyed with the interpreter
+    RubyVMPool* pool;
 };
 typedef struct RubyInterpreter RubyInterpreter;
 
@@ -30,6 +52,78 @@ RubyInterpreter* ruby_interpreter_create(const char* application_path,
                                        LogListener listener);
 void ruby_interpreter_destroy(RubyInterpreter* interpreter);
 int ruby_interpreter_enqueue(RubyInterpreter* interpreter, RubyScript* script, RubyCompletionTask on_complete );
+// Run the script on the worker serving 'shard_key' in a worker pool, after the scripts of the same key enqueued before
+// (see ruby_vm_pool_enqueue_sharded). Without a worker pool, same as ruby_interpreter_enqueue.
+int ruby_interpreter_enqueue_sharded(RubyInterpreter* interpreter, uint64_t shard_key, RubyScript* script, RubyCompletionTask on_complete);
+int ruby_interpreter_enqueue_sharded_with_result(RubyInterpreter* interpreter, uint64_t shard_key, RubyScript* script, RubyResultTask on_result);
+// Start the VM now, in the background, and require 'preload_requires' (can be NULL) before any script enqueued later.
+// 'on_ready' is called with 0 once the VM is up and every feature loaded, non-zero if one of them failed.
+// Scripts enqueued meanwhile, from any thread, wait for the VM instead of starting it again.
+int ruby_interpreter_prewarm(RubyInterpreter* interpreter, const char** preload_requires, size_t count, RubyCompletionTask on_ready);
+// Enqueue with a deadline, 'out_request_id' receives the id to cancel it with (see ruby_vm_enqueue_with_deadline)
+int ruby_interpreter_enqueue_with_deadline(RubyInterpreter* interpreter, RubyScript* script, uint32_t timeout_ms, RubyCompletionTask on_complete, uint64_t* out_request_id);
+// Complete a request with RUBY_VM_ERROR_CANCELLED, interrupting it if it runs (see ruby_vm_cancel)
+int ruby_interpreter_cancel(RubyInterpreter* interpreter, uint64_t request_id);
+// Also get back the value of the script, encoded in MessagePack (see ruby_vm_enqueue_with_result)
+int ruby_interpreter_enqueue_with_result(RubyInterpreter* interpreter, RubyScript* script, RubyResultTask on_result);
+// Enqueue with RubyEnqueueFlags, e.g. RUBY_ENQUEUE_RACTOR to run the script on the Ractor lane (see ruby_vm_enqueue_with_flags)
+int ruby_interpreter_enqueue_with_flags(RubyInterpreter* interpreter, RubyScript* script, uint32_t flags, RubyCompletionTask on_complete);
+int ruby_interpreter_enqueue_with_result_and_flags(RubyInterpreter* interpreter, RubyScript* script, uint32_t flags, RubyResultTask on_result);
+// Run the script on the I/O thread pool, after the scripts of the same stream enqueued before (see ruby_vm_enqueue_in_stream).
+// In a worker pool, a stream goes to the worker of its shard like a shard key, stream 0 to the next idle worker.
+int ruby_interpreter_enqueue_in_stream(RubyInterpreter* interpreter, uint32_t stream, RubyScript* script, RubyCompletionTask on_complete);
+int ruby_interpreter_enqueue_in_stream_with_result(RubyInterpreter* interpreter, uint32_t stream, RubyScript* script, RubyResultTask on_result);
+// Several scripts in one frame and one reply, 'on_complete' holds one task per script (see ruby_vm_enqueue_batch)
+int ruby_interpreter_enqueue_batch(RubyInterpreter* interpreter, RubyScript** scripts, size_t count, RubyCompletionTask* on_complete);
+// Large scripts go through a shared memory ring of 'capacity' bytes (see ruby_vm_enable_payload_ring).
+// Only effective when called before the first script starts the VM.
+void ruby_interpreter_enable_payload_ring(RubyInterpreter* interpreter, size_t capacity);
+// Require the pure Ruby standard library from memory instead of extracting it (see ruby_vm_enable_embedded_stdlib).
+// Only effective when called before the first script starts the VM.
+void ruby_interpreter_enable_embedded_stdlib(RubyInterpreter* interpreter);
+// Keep compiled sources and load path resolutions on disk, up to 'capacity' bytes (see ruby_vm_enable_compile_cache).
+// Only effective when called before the first script starts the VM.
+void ruby_interpreter_enable_compile_cache(RubyInterpreter* interpreter, size_t capacity);
+// Record the startup requires and preload them on the next starts (see ruby_vm_enable_preload_profile).
+// Only effective when called before the first script starts the VM.
+void ruby_interpreter_enable_preload_profile(RubyInterpreter* interpreter, uint32_t max_seconds, uint32_t max_scripts);
+// Number of Ractors of the Ractor lane, 0 for one per core (see ruby_vm_set_ractor_lane_size).
+// Only effective when called before the first script starts the VM.
+void ruby_interpreter_set_ractor_lane_size(RubyInterpreter* interpreter, size_t size);
+// Number of threads of the I/O thread pool, 0 for IO_POOL_DEFAULT_SIZE (see ruby_vm_set_io_pool_size).
+// Only effective when called before the first script starts the VM.
+void ruby_interpreter_set_io_pool_size(RubyInterpreter* interpreter, size_t size);
+// Fork a zygote booted with the settings of this interpreter, 'preload_requires' (can be NULL) required before
+// the first fork (see ruby_zygote_create). Linux only, to be called early: the zygote is a copy of this process.
+RubyZygote* ruby_interpreter_create_zygote(const RubyInterpreter* interpreter, const char** preload_requires, size_t count);
+// Run the scripts of this interpreter in a worker forked by 'zygote', a VM of its own destroyed with the interpreter
+// (see ruby_vm_use_zygote). Only effective when called before the first script.
+void ruby_interpreter_use_zygote(RubyInterpreter* interpreter, RubyZygote* zygote);
+// Run the scripts of this interpreter on 'size' worker processes (0: one per core), each script on the worker with the
+// fewest outstanding ones (see ruby-vm-pool.h). The workers are forked by the zygote of ruby_interpreter_use_zygote, or by
+// one created right away with the settings of this interpreter and 'preload_requires' (see ruby_interpreter_create_zygote).
+// Only effective when called before the first script. Returns 0 on success, -1 if the zygote could not be created.
+int ruby_interpreter_enable_worker_pool(RubyInterpreter* interpreter, size_t size, const char** preload_requires, size_t count);
+// Worker, queue depth and request count of each shard of the worker pool (see ruby_vm_pool_get_shard_stats).
+// Returns the number of shards, 0 before the pool starts or without a worker pool.
+size_t ruby_interpreter_get_shard_stats(const RubyInterpreter* interpreter, RubyVMPoolShardStats* out_stats, size_t capacity);
+// Blocking evaluation without going through the commands channel (see ruby_vm_eval_sync)
+int ruby_interpreter_eval_sync(RubyInterpreter* interpreter, const char* source, size_t length, RubyEvalResult* out_result);
+// Compile a script once into a callable of the VM, starting the VM if needed (see ruby_script_prepare)
+RubyPreparedScript* ruby_interpreter_prepare(RubyInterpreter* interpreter, RubyScript* script);
+// Enqueue a call of a prepared script with typed arguments (see ruby_vm_invoke)
+int ruby_interpreter_invoke(RubyInterpreter* interpreter, RubyPreparedScript* prepared, const RubyArg* args, size_t count, RubyCompletionTask on_complete);
+int ruby_interpreter_invoke_with_result(RubyInterpreter* interpreter, RubyPreparedScript* prepared, const RubyArg* args, size_t count, RubyResultTask on_result);
+// Let the VM forget a prepared script and free its handle (see ruby_prepared_script_destroy)
+void ruby_interpreter_release_prepared(RubyInterpreter* interpreter, RubyPreparedScript* prepared);
+// Compiled script cache (see ruby_vm_set_iseq_cache_capacity), process-wide so it can be tuned before the VM starts.
+// With a zygote or a worker pool, the workers inherit the capacity set before the zygote is created and keep their
+// own counters: both return -1, the stats being all zeros.
+int ruby_interpreter_set_iseq_cache_capacity(RubyInterpreter* interpreter, size_t capacity);
+int ruby_interpreter_get_iseq_cache_stats(const RubyInterpreter* interpreter, RubyIseqCacheStats* out_stats);
+// Timings of the VM startup phases (see ruby_vm_get_startup_profile), all incomplete before the VM starts.
+// Only the VM of this process is profiled: -1 and all incomplete with a zygote or a worker pool.
+int ruby_interpreter_get_startup_profile(const RubyInterpreter* interpreter, RubyStartupProfile* out_profile);
 int ruby_interpreter_enable_logging(RubyInterpreter* interpreter);
 int ruby_interpreter_disable_logging(RubyInterpreter* interpreter);
 // Error handling - delegates to underlying VM
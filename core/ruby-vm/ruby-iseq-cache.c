@@ -0,0 +1,33 @@
+#include "constants.h"
+#include "ruby-iseq-cache.h"
+
+// Written by the VM thread, read by any thread: relaxed atomics are enough for statistics
+static uint64_t g_capacity = ISEQ_CACHE_DEFAULT_CAPACITY;
+static uint64_t g_counters[4];
+static uint64_t g_entries;
+
+void ruby_iseq_cache_set_capacity(size_t capacity) {
+    __atomic_store_n(&g_capacity, (uint64_t)capacity, __ATOMIC_RELAXED);
+}
+
+size_t ruby_iseq_cache_get_capacity(void) {
+    return (size_t)__atomic_load_n(&g_capacity, __ATOMIC_RELAXED);
+}
+
+void ruby_iseq_cache_record(RubyIseqCacheEvent event, size_t entries) {
+    if ((unsigned)event < sizeof(g_counters) / sizeof(g_counters[0])) {
+        __atomic_fetch_add(&g_counters[event], 1, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&g_entries, (uint64_t)entries, __ATOMIC_RELAXED);
+}
+
+void ruby_iseq_cache_get_stats(RubyIseqCacheStats* out_stats) {
+    if (!out_stats) return;
+
+    out_stats->hits = __atomic_load_n(&g_counters[RUBY_ISEQ_CACHE_HIT], __ATOMIC_RELAXED);
+    out_stats->misses = __atomic_load_n(&g_counters[RUBY_ISEQ_CACHE_MISS], __ATOMIC_RELAXED);
+    out_stats->bypassed = __atomic_load_n(&g_counters[RUBY_ISEQ_CACHE_BYPASS], __ATOMIC_RELAXED);
+    out_stats->evictions = __atomic_load_n(&g_counters[RUBY_ISEQ_CACHE_EVICTION], __ATOMIC_RELAXED);
+    out_stats->entries = __atomic_load_n(&g_entries, __ATOMIC_RELAXED);
+    out_stats->capacity = __atomic_load_n(&g_capacity, __ATOMIC_RELAXED);
+}
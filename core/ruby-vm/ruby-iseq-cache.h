@@ -0,0 +1,48 @@
+#ifndef RUBY_ISEQ_CACHE_H
+#define RUBY_ISEQ_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Host side of the compiled script cache kept by fifo_interpreter.rb.
+ *
+ * The cache itself (an LRU of RubyVM::InstructionSequence keyed by content hash) lives in the VM;
+ * its capacity and counters are process-wide values shared through the RubyVMHost module,
+ * so that the host can tune and observe it without a round trip.
+ */
+typedef struct {
+    uint64_t hits;        // Scripts run from an already compiled instruction sequence
+    uint64_t misses;      // Scripts compiled and added to the cache
+    uint64_t bypassed;    // Scripts that must go through eval (top-level locals, cache disabled...)
+    uint64_t evictions;   // Entries dropped to stay within capacity
+    uint64_t entries;     // Current number of entries
+    uint64_t capacity;    // Maximum number of entries, 0 when disabled
+} RubyIseqCacheStats;
+
+typedef enum {
+    RUBY_ISEQ_CACHE_HIT = 0,
+    RUBY_ISEQ_CACHE_MISS = 1,
+    RUBY_ISEQ_CACHE_BYPASS = 2,
+    RUBY_ISEQ_CACHE_EVICTION = 3
+} RubyIseqCacheEvent;
+
+void ruby_iseq_cache_set_capacity(size_t capacity);
+size_t ruby_iseq_cache_get_capacity(void);
+
+/**
+ * Record a cache event, along with the number of entries once it has been handled
+ */
+void ruby_iseq_cache_record(RubyIseqCacheEvent event, size_t entries);
+
+void ruby_iseq_cache_get_stats(RubyIseqCacheStats* out_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_ISEQ_CACHE_H
@@ -0,0 +1,97 @@
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "ruby-payload-ring.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+/**
+ * memfd_create() is only exposed by recent libc versions (glibc 2.27, Android API 30),
+ * go through the raw syscall so that older ones still get the ring
+ */
+static int create_memfd(const char* name) {
+#ifdef __NR_memfd_create
+    return (int)syscall(__NR_memfd_create, name, MFD_CLOEXEC);
+#else
+    (void) name;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int ruby_payload_ring_init(RubyPayloadRing* ring, size_t capacity) {
+    if (!ring || capacity == 0) return -1;
+
+    ring->fd = create_memfd("ruby-vm-payloads");
+    if (ring->fd < 0) return -1;
+
+    if (ftruncate(ring->fd, (off_t)capacity) != 0) {
+        close(ring->fd);
+        ring->fd = -1;
+        return -1;
+    }
+
+    ring->base = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+    if (ring->base == MAP_FAILED) {
+        close(ring->fd);
+        ring->fd = -1;
+        ring->base = NULL;
+        return -1;
+    }
+
+    ring->capacity = capacity;
+    ring->head = 0;
+    ring->tail = 0;
+    pthread_mutex_init(&ring->lock, NULL);
+    return 0;
+}
+
+void ruby_payload_ring_destroy(RubyPayloadRing* ring) {
+    if (!ring || !ring->base) return;
+
+    pthread_mutex_destroy(&ring->lock);
+    munmap(ring->base, ring->capacity);
+    close(ring->fd);
+    ring->base = NULL;
+    ring->fd = -1;
+}
+
+int ruby_payload_ring_write(RubyPayloadRing* ring, const void* data, size_t length, RubyPayloadRingSlot* out_slot) {
+    if (length == 0 || length > ring->capacity) return -1;
+
+    pthread_mutex_lock(&ring->lock);
+    const uint64_t tail = ring->tail;
+    pthread_mutex_unlock(&ring->lock);
+
+    // Payloads never wrap: skip the end of the mapping when it is too small
+    uint64_t start = ring->head;
+    const uint64_t position = start % ring->capacity;
+    if (position + length > ring->capacity) {
+        start += ring->capacity - position;
+    }
+
+    const uint64_t end = start + length;
+    if (end - tail > ring->capacity) {
+        return -1;
+    }
+
+    out_slot->position = start % ring->capacity;
+    out_slot->length = length;
+    out_slot->end = end;
+    memcpy(ring->base + out_slot->position, data, length);
+    ring->head = end;
+    return 0;
+}
+
+void ruby_payload_ring_release(RubyPayloadRing* ring, uint64_t end) {
+    pthread_mutex_lock(&ring->lock);
+    if (end > ring->tail) {
+        ring->tail = end;
+    }
+    pthread_mutex_unlock(&ring->lock);
+}
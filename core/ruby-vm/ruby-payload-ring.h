@@ -0,0 +1,63 @@
+#ifndef RUBY_PAYLOAD_RING_H
+#define RUBY_PAYLOAD_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Shared memory ring holding script payloads, backed by a memfd.
+ *
+ * The dispatcher copies a script into the ring and only sends its location on the
+ * commands channel; the Ruby side maps the same memfd and reads the script from there.
+ * Payloads are stored contiguously (never split across the end of the ring) and released
+ * in order, once the reply of the request that carried them arrives.
+ *
+ * Offsets are monotonic byte counters: the position in the mapping is 'offset % capacity'.
+ */
+typedef struct {
+    int fd;
+    unsigned char* base;
+    size_t capacity;
+    uint64_t head;       // Bytes reserved so far, only touched by the dispatcher
+    uint64_t tail;       // Bytes released so far
+    pthread_mutex_t lock;
+} RubyPayloadRing;
+
+/**
+ * Where a payload has been written
+ */
+typedef struct {
+    uint64_t position;   // Byte position in the mapping
+    uint64_t length;
+    uint64_t end;        // Value to hand to ruby_payload_ring_release once consumed
+} RubyPayloadRingSlot;
+
+/**
+ * @return 0 on success, -1 if shared memory is not available on this platform or on error
+ */
+int ruby_payload_ring_init(RubyPayloadRing* ring, size_t capacity);
+
+void ruby_payload_ring_destroy(RubyPayloadRing* ring);
+
+/**
+ * Copy a payload into the ring. Never blocks.
+ *
+ * @return 0 on success, -1 if there is not enough free space right now
+ */
+int ruby_payload_ring_write(RubyPayloadRing* ring, const void* data, size_t length, RubyPayloadRingSlot* out_slot);
+
+/**
+ * Release every payload written up to 'end' (see RubyPayloadRingSlot)
+ */
+void ruby_payload_ring_release(RubyPayloadRing* ring, uint64_t end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_PAYLOAD_RING_H
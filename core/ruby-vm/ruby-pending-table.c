@@ -0,0 +1,159 @@
+#include <stdlib.h>
+
+#include "ruby-pending-table.h"
+
+int ruby_pending_table_init(RubyPendingTable* table, size_t capacity) {
+    if (!table || capacity == 0) return -1;
+
+    // Half full at most, probe sequences stay short
+    table->slots = calloc(capacity * 2, sizeof(RubyPendingRequest));
+    if (!table->slots) return -1;
+
+    table->slot_count = capacity * 2;
+    table->capacity = capacity;
+    table->count = 0;
+    table->closed = 0;
+    pthread_mutex_init(&table->lock, NULL);
+    pthread_cond_init(&table->slot_freed, NULL);
+    return 0;
+}
+
+void ruby_pending_table_destroy(RubyPendingTable* table) {
+    if (!table || !table->slots) return;
+
+    pthread_cond_destroy(&table->slot_freed);
+    pthread_mutex_destroy(&table->lock);
+    free(table->slots);
+    table->slots = NULL;
+}
+
+// Slot holding 'request_id', NULL if it is not in flight. Called with the lock held.
+static RubyPendingRequest* find_locked(RubyPendingTable* table, uint64_t request_id) {
+    size_t index = request_id % table->slot_count;
+    while (table->slots[index].in_use) {
+        if (table->slots[index].request_id == request_id) {
+            return &table->slots[index];
+        }
+        index = (index + 1) % table->slot_count;
+    }
+    return NULL;
+}
+
+// Free a slot, moving back the entries probed past it so that lookups never stop early
+static void remove_locked(RubyPendingTable* table, RubyPendingRequest* slot) {
+    size_t hole = (size_t)(slot - table->slots);
+    size_t index = hole;
+    table->slots[hole].in_use = 0;
+    table->count--;
+
+    for (;;) {
+        index = (index + 1) % table->slot_count;
+        if (!table->slots[index].in_use) break;
+
+        // An entry can fill the hole unless its home slot lies after the hole, up to itself
+        const size_t home = table->slots[index].request_id % table->slot_count;
+        const int home_after_hole = hole <= index ? (hole < home && home <= index) : (hole < home || home <= index);
+        if (home_after_hole) continue;
+
+        table->slots[hole] = table->slots[index];
+        table->slots[index].in_use = 0;
+        hole = index;
+    }
+}
+
+int ruby_pending_table_reserve(RubyPendingTable* table, uint64_t request_id, const RubyDispatchItem* item) {
+    pthread_mutex_lock(&table->lock);
+
+    while (table->count >= table->capacity && !table->closed) {
+        pthread_cond_wait(&table->slot_freed, &table->lock);
+    }
+
+    if (table->closed) {
+        pthread_mutex_unlock(&table->lock);
+        return -1;
+    }
+
+    size_t index = request_id % table->slot_count;
+    while (table->slots[index].in_use) {
+        index = (index + 1) % table->slot_count;
+    }
+
+    RubyPendingRequest* slot = &table->slots[index];
+    slot->request_id = request_id;
+    slot->item = *item;
+    slot->in_use = 1;
+    slot->cancel_requested = 0;
+    table->count++;
+
+    pthread_mutex_unlock(&table->lock);
+    return 0;
+}
+
+int ruby_pending_table_take(RubyPendingTable* table, uint64_t request_id, RubyPendingRequest* out_request) {
+    pthread_mutex_lock(&table->lock);
+
+    RubyPendingRequest* slot = find_locked(table, request_id);
+    if (!slot) {
+        pthread_mutex_unlock(&table->lock);
+        return -1;
+    }
+
+    *out_request = *slot;
+    remove_locked(table, slot);
+
+    pthread_cond_broadcast(&table->slot_freed);
+    pthread_mutex_unlock(&table->lock);
+    return 0;
+}
+
+int ruby_pending_table_get_wire_flags(RubyPendingTable* table, uint64_t request_id, uint16_t* out_flags) {
+    pthread_mutex_lock(&table->lock);
+
+    const RubyPendingRequest* slot = find_locked(table, request_id);
+    if (slot) {
+        *out_flags = slot->item.wire_flags;
+    }
+
+    pthread_mutex_unlock(&table->lock);
+    return slot ? 0 : -1;
+}
+
+int ruby_pending_table_request_cancel(RubyPendingTable* table, uint64_t request_id) {
+    pthread_mutex_lock(&table->lock);
+
+    RubyPendingRequest* slot = find_locked(table, request_id);
+    const int result = slot && !slot->cancel_requested ? 0 : -1;
+    if (result == 0) {
+        slot->cancel_requested = 1;
+    }
+
+    pthread_mutex_unlock(&table->lock);
+    return result;
+}
+
+void ruby_pending_table_close(RubyPendingTable* table, int result) {
+    pthread_mutex_lock(&table->lock);
+    table->closed = 1;
+    pthread_cond_broadcast(&table->slot_freed);
+    pthread_mutex_unlock(&table->lock);
+
+    // Once closed no reservation can succeed, so slots can be drained one by one
+    // without holding the lock while running user callbacks
+    for (size_t i = 0; i < table->slot_count; i++) {
+        RubyPendingRequest request;
+        int found = 0;
+
+        pthread_mutex_lock(&table->lock);
+        if (table->slots[i].in_use) {
+            request = table->slots[i];
+            table->slots[i].in_use = 0;
+            table->count--;
+            found = 1;
+        }
+        pthread_mutex_unlock(&table->lock);
+
+        if (found) {
+            ruby_dispatch_item_complete(&request.item, result);
+        }
+    }
+}
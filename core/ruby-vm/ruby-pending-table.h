@@ -0,0 +1,88 @@
+#ifndef RUBY_PENDING_TABLE_H
+#define RUBY_PENDING_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "ruby-dispatch-queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A request that has been written to the VM and is waiting for its reply
+ */
+typedef struct {
+    uint64_t request_id;
+    int in_use;
+    int cancel_requested;
+    RubyDispatchItem item;
+} RubyPendingRequest;
+
+/**
+ * Table of in-flight requests, keyed by request id.
+ *
+ * An open addressing hash table of twice 'capacity' slots, probed linearly from 'id % slot_count'.
+ * Up to 'capacity' requests are in flight at once whatever their ids: this bounds the amount of data
+ * buffered in the socket, while a request answered late (Ractor lane, I/O pool) does not hold back
+ * the requests sent after it.
+ */
+typedef struct {
+    RubyPendingRequest* slots;
+    size_t slot_count;
+    size_t capacity;
+    size_t count;
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t slot_freed;
+} RubyPendingTable;
+
+/**
+ * @return 0 on success, -1 on allocation failure
+ */
+int ruby_pending_table_init(RubyPendingTable* table, size_t capacity);
+
+void ruby_pending_table_destroy(RubyPendingTable* table);
+
+/**
+ * Register a request before it is sent, blocking while 'capacity' requests are in flight
+ *
+ * @return 0 on success, -1 if the table has been closed
+ */
+int ruby_pending_table_reserve(RubyPendingTable* table, uint64_t request_id, const RubyDispatchItem* item);
+
+/**
+ * Remove a request whose reply arrived
+ *
+ * @param out_request Receives the removed request
+ * @return 0 on success, -1 if no such request is in flight
+ */
+int ruby_pending_table_take(RubyPendingTable* table, uint64_t request_id, RubyPendingRequest* out_request);
+
+/**
+ * Read the extra RUBY_WIRE_FLAG_* an in-flight request was sent with (see RubyDispatchItem)
+ *
+ * @return 0 on success, -1 if no such request is in flight
+ */
+int ruby_pending_table_get_wire_flags(RubyPendingTable* table, uint64_t request_id, uint16_t* out_flags);
+
+/**
+ * Flag an in-flight request as cancelled, so that the VM is only asked once to interrupt it
+ *
+ * @return 0 if the request was flagged now, -1 if it is not in flight or already flagged
+ */
+int ruby_pending_table_request_cancel(RubyPendingTable* table, uint64_t request_id);
+
+/**
+ * Close the table and fail every request still in flight with 'result'.
+ * Blocked reservations are woken up and fail.
+ */
+void ruby_pending_table_close(RubyPendingTable* table, int result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_PENDING_TABLE_H
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "constants.h"
+#include "ruby-preload-profile.h"
+#include "ruby-cache-files.h"
+#include "debug.h"
+
+#pragma GCC diagnostic push
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#else
+#ifdef __clang__
+#pragma clang diagnostic ignored "-Wdefault-const-init-field-unsafe"
+#pragma clang diagnostic ignored "-Wunused-parameter"
+#endif
+#endif
+#include "ruby/ruby.h"
+#pragma GCC diagnostic pop
+
+// One feature per line, kept in <base directory>/PRELOAD_PROFILE_FILE
+#define PRELOAD_PROFILE_FILE ".preload-profile"
+
+static char g_profile_path[MAX_PATH_LENGTH];
+
+/**
+ * The recording stops at the first of the deadline (checked by a sleeping thread) and the last counted
+ * script, the first one to get PRELOAD_LOCK writes the profile, unless nothing was required.
+ * Requires made by the preload thread are left out, those of the application are recorded even when
+ * the preload already loaded them.
+ */
+static const char* PRELOAD_PROFILE_SCRIPT =
+        "module RubyVMHost\n"
+        "  PRELOAD_LOCK = Thread::Mutex.new\n"
+        "\n"
+        "  def self.preload_profile_start\n"
+        "    features = preload_profile_read\n"
+        "    @preload_thread = Thread.new do\n"
+        "      features.each do |feature|\n"
+        "        require(feature)\n"
+        "      rescue ScriptError, StandardError\n"
+        "        # Not available anymore, the recording drops it\n"
+        "      end\n"
+        "    end\n"
+        "    @preload_recorded = {}\n"
+        "    Thread.new { sleep(PRELOAD_PROFILE_SECONDS); preload_profile_finish } if PRELOAD_PROFILE_SECONDS > 0\n"
+        "    nil\n"
+        "  end\n"
+        "\n"
+        "  def self.preload_profile_note(feature)\n"
+        "    recorded = @preload_recorded\n"
+        "    return if recorded.nil? || Thread.current.equal?(@preload_thread) || recorded.size >= PRELOAD_PROFILE_MAX_FEATURES\n"
+        "    recorded[File.path(feature)] = true\n"
+        "  rescue TypeError\n"
+        "    # Kernel#require reports it\n"
+        "  end\n"
+        "\n"
+        "  def self.preload_profile_script_done\n"
+        "    return if PRELOAD_PROFILE_SCRIPTS == 0 || @preload_recorded.nil?\n"
+        "    @preload_scripts = (@preload_scripts || 0) + 1\n"
+        "    preload_profile_finish if @preload_scripts >= PRELOAD_PROFILE_SCRIPTS\n"
+        "  end\n"
+        "\n"
+        "  def self.preload_profile_finish\n"
+        "    recorded = PRELOAD_LOCK.synchronize do\n"
+        "      features = @preload_recorded\n"
+        "      @preload_recorded = nil\n"
+        "      features\n"
+        "    end\n"
+        "    # Nothing required yet, the previous profile stays\n"
+        "    preload_profile_write(recorded.keys) unless recorded.nil? || recorded.empty?\n"
+        "  end\n"
+        "end\n"
+        "\n"
+        "module Kernel\n"
+        "  alias_method :ruby_vm_unprofiled_require, :require\n"
+        "\n"
+        "  def require(feature)\n"
+        "    RubyVMHost.preload_profile_note(feature)\n"
+        "    ruby_vm_unprofiled_require(feature)\n"
+        "  end\n"
+        "\n"
+        "  private :require, :ruby_vm_unprofiled_require\n"
+        "end\n";
+
+static VALUE host_preload_profile_read(VALUE self) {
+    (void) self;
+    VALUE features = rb_ary_new();
+    FILE* file = fopen(g_profile_path, "rb");
+    if (!file) {
+        return features;
+    }
+
+    char line[MAX_PATH_LENGTH];
+    while (fgets(line, sizeof(line), file)) {
+        const size_t length = strcspn(line, "\n");
+        // A line longer than the buffer is not a feature the recording wrote
+        if (line[length] != '\n') {
+            break;
+        }
+        if (length > 0) {
+            rb_ary_push(features, rb_utf8_str_new(line, (long)length));
+        }
+    }
+    fclose(file);
+    return features;
+}
+
+static VALUE host_preload_profile_write(VALUE self, VALUE features) {
+    (void) self;
+
+    Check_Type(features, T_ARRAY);
+    VALUE content = rb_str_buf_new(0);
+    for (long i = 0; i < RARRAY_LEN(features); i++) {
+        VALUE feature = rb_get_path(RARRAY_AREF(features, i));
+        if (RSTRING_LEN(feature) >= MAX_PATH_LENGTH - 1 || memchr(RSTRING_PTR(feature), '\n', (size_t)RSTRING_LEN(feature))) {
+            continue;
+        }
+        rb_str_buf_append(content, feature);
+        rb_str_buf_cat(content, "\n", 1);
+    }
+
+    const int written = ruby_cache_write_file(g_profile_path, NULL, 0, RSTRING_PTR(content), (size_t)RSTRING_LEN(content)) == 0;
+    DEBUG_LOG("ruby_preload_profile: %ld features recorded%s", RARRAY_LEN(features), written ? "" : ", not written");
+    return written ? Qtrue : Qfalse;
+}
+
+int ruby_preload_profile_define(const char* base_directory, uint32_t max_seconds, uint32_t max_scripts) {
+    const int length = snprintf(g_profile_path, sizeof(g_profile_path), "%s/" PRELOAD_PROFILE_FILE, base_directory);
+    if (length <= 0 || length >= (int)sizeof(g_profile_path) || (max_seconds == 0 && max_scripts == 0)) {
+        return -1;
+    }
+
+    VALUE host_module = rb_define_module("RubyVMHost");
+    rb_define_module_function(host_module, "preload_profile_read", host_preload_profile_read, 0);
+    rb_define_module_function(host_module, "preload_profile_write", host_preload_profile_write, 1);
+    rb_const_set(host_module, rb_intern("PRELOAD_PROFILE_SECONDS"), UINT2NUM(max_seconds));
+    rb_const_set(host_module, rb_intern("PRELOAD_PROFILE_SCRIPTS"), UINT2NUM(max_scripts));
+    rb_const_set(host_module, rb_intern("PRELOAD_PROFILE_MAX_FEATURES"), INT2NUM(PRELOAD_PROFILE_MAX_FEATURES));
+
+    if (ruby_cache_eval_script(PRELOAD_PROFILE_SCRIPT, "<ruby-vm-preload-profile>") != 0) {
+        DEBUG_LOG("ruby_preload_profile_define: failed to install the recording");
+        return -1;
+    }
+
+    DEBUG_LOG("ruby_preload_profile_define: recording %u s / %u scripts to %s", max_seconds, max_scripts, g_profile_path);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef RUBY_PRELOAD_PROFILE_H
+#define RUBY_PRELOAD_PROFILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Learn what the application requires while it starts, and load it ahead of time on the next starts.
+ *
+ * Once the main script starts serving (RubyVMHost.preload_profile_start), every feature given to
+ * Kernel#require is recorded, in order, until 'max_seconds' elapsed or 'max_scripts' scripts completed,
+ * whichever comes first. The list is then written to <base_directory>/.preload-profile, replacing the
+ * one of the previous start when it is not empty.
+ * On the next start, a Ruby thread requires the features of that list while the first scripts are on
+ * their way, through the compile cache when it is enabled: a script then finds them loaded, or waits
+ * for the one being loaded. The requires of that thread are not recorded, so a feature the application
+ * stopped using leaves the profile after one start. A feature that cannot be loaded anymore is skipped.
+ * Also defines:
+ *
+ *   RubyVMHost.preload_profile_start -> nil
+ *     Start the preload thread and the recording, called by the main script before serving
+ *
+ *   RubyVMHost.preload_profile_script_done -> nil
+ *     Count a completed script towards 'max_scripts'
+ *
+ *   RubyVMHost.preload_profile_read -> Array of String
+ *   RubyVMHost.preload_profile_write(features) -> true or false
+ *     Profile of the previous start, and the recorded one (written atomically)
+ *
+ * Must be called on the VM thread, after ruby_compile_cache_define() and before ruby_options().
+ *
+ * @param base_directory Ruby base directory the profile is kept in
+ * @param max_seconds Recording time in seconds, 0 for no limit
+ * @param max_scripts Scripts recorded, 0 for no limit (not both)
+ * @return 0 on success, -1 if the profile could not be installed
+ */
+int ruby_preload_profile_define(const char* base_directory, uint32_t max_seconds, uint32_t max_scripts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_PRELOAD_PROFILE_H
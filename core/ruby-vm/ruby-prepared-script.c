@@ -0,0 +1,96 @@
+#include <string.h>
+
+#include "ruby-prepared-script.h"
+#include "ruby-wire-protocol.h"
+
+RubyArg ruby_arg_nil(void) {
+    RubyArg arg = { .type = RUBY_ARG_NIL };
+    return arg;
+}
+
+RubyArg ruby_arg_int64(int64_t value) {
+    RubyArg arg = { .type = RUBY_ARG_INT64, .value.int64 = value };
+    return arg;
+}
+
+RubyArg ruby_arg_double(double value) {
+    RubyArg arg = { .type = RUBY_ARG_DOUBLE, .value.real = value };
+    return arg;
+}
+
+RubyArg ruby_arg_bool(int value) {
+    RubyArg arg = { .type = RUBY_ARG_BOOL, .value.boolean = value != 0 };
+    return arg;
+}
+
+RubyArg ruby_arg_utf8(const char* data, size_t length) {
+    RubyArg arg = { .type = RUBY_ARG_UTF8, .value.bytes = { data, length } };
+    return arg;
+}
+
+RubyArg ruby_arg_bytes(const void* data, size_t length) {
+    RubyArg arg = { .type = RUBY_ARG_BYTES, .value.bytes = { data, length } };
+    return arg;
+}
+
+int ruby_args_encoded_size(const RubyArg* args, size_t count, size_t* out_size) {
+    if (!out_size || (count > 0 && !args)) return -1;
+
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++) {
+        switch (args[i].type) {
+            case RUBY_ARG_NIL:
+                size += 1;
+                break;
+            case RUBY_ARG_INT64:
+            case RUBY_ARG_DOUBLE:
+                size += 1 + 8;
+                break;
+            case RUBY_ARG_BOOL:
+                size += 1 + 1;
+                break;
+            case RUBY_ARG_UTF8:
+            case RUBY_ARG_BYTES:
+                if (!args[i].value.bytes.data && args[i].value.bytes.length > 0) return -1;
+                size += 1 + 8 + args[i].value.bytes.length;
+                break;
+            default:
+                return -1;
+        }
+    }
+    *out_size = size;
+    return 0;
+}
+
+void ruby_args_encode(const RubyArg* args, size_t count, unsigned char* out) {
+    for (size_t i = 0; i < count; i++) {
+        *out++ = (unsigned char)args[i].type;
+        switch (args[i].type) {
+            case RUBY_ARG_INT64:
+                ruby_wire_encode_u64(out, (uint64_t)args[i].value.int64);
+                out += 8;
+                break;
+            case RUBY_ARG_DOUBLE: {
+                uint64_t bits;
+                memcpy(&bits, &args[i].value.real, sizeof(bits));
+                ruby_wire_encode_u64(out, bits);
+                out += 8;
+                break;
+            }
+            case RUBY_ARG_BOOL:
+                *out++ = args[i].value.boolean ? 1 : 0;
+                break;
+            case RUBY_ARG_UTF8:
+            case RUBY_ARG_BYTES:
+                ruby_wire_encode_u64(out, args[i].value.bytes.length);
+                out += 8;
+                if (args[i].value.bytes.length > 0) {
+                    memcpy(out, args[i].value.bytes.data, args[i].value.bytes.length);
+                    out += args[i].value.bytes.length;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
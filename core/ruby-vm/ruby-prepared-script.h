@@ -0,0 +1,80 @@
+#ifndef RUBY_PREPARED_SCRIPT_H
+#define RUBY_PREPARED_SCRIPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct RubyVM;
+
+/**
+ * Types of the arguments given to a prepared script.
+ * The tag values are part of the wire format, fifo_interpreter.rb mirrors them.
+ */
+typedef enum {
+    RUBY_ARG_NIL = 0,
+    RUBY_ARG_INT64 = 1,
+    RUBY_ARG_DOUBLE = 2,
+    RUBY_ARG_BOOL = 3,
+    RUBY_ARG_UTF8 = 4,    // Ruby String in UTF-8
+    RUBY_ARG_BYTES = 5    // Ruby String in ASCII-8BIT
+} RubyArgType;
+
+/**
+ * A typed argument. UTF-8 and bytes arguments are only borrowed: they are copied
+ * when the invocation is queued, the caller keeps ownership of the buffer.
+ */
+typedef struct {
+    RubyArgType type;
+    union {
+        int64_t int64;
+        double real;
+        int boolean;
+        struct {
+            const void* data;
+            size_t length;
+        } bytes;
+    } value;
+} RubyArg;
+
+RubyArg ruby_arg_nil(void);
+RubyArg ruby_arg_int64(int64_t value);
+RubyArg ruby_arg_double(double value);
+RubyArg ruby_arg_bool(int value);
+RubyArg ruby_arg_utf8(const char* data, size_t length);
+RubyArg ruby_arg_bytes(const void* data, size_t length);
+
+/**
+ * Handle to a callable compiled once by the VM (see ruby_script_prepare).
+ * Only the id travels on the commands channel.
+ */
+typedef struct {
+    struct RubyVM* vm;
+    uint32_t id;
+} RubyPreparedScript;
+
+/**
+ * Size of the encoded form of 'args'
+ *
+ * Each argument is a u8 type tag followed by its value: 8 bytes for RUBY_ARG_INT64 (signed)
+ * and RUBY_ARG_DOUBLE (IEEE 754), 1 byte for RUBY_ARG_BOOL, a u64 length then the bytes
+ * for RUBY_ARG_UTF8 and RUBY_ARG_BYTES, nothing for RUBY_ARG_NIL. Everything is little-endian.
+ *
+ * @param out_size Receives the encoded size
+ * @return 0 on success, -1 if an argument has an unknown type or no data
+ */
+int ruby_args_encoded_size(const RubyArg* args, size_t count, size_t* out_size);
+
+/**
+ * Encode 'args' into 'out', which must hold the size given by ruby_args_encoded_size()
+ */
+void ruby_args_encode(const RubyArg* args, size_t count, unsigned char* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_PREPARED_SCRIPT_H
@@ -4,6 +4,7 @@
 
 #include "constants.h"
 #include "ruby-script.h"
+#include "ruby-content-hash.h"
 
 RubyScript* ruby_script_create_from_content(const char* content, const size_t content_size) {
     if (!content) return NULL;
@@ -16,6 +17,9 @@ RubyScript* ruby_script_create_from_content(const char* content, const size_t co
         free(script);
         return NULL;
     }
+    // Content stops at the first NUL byte, like the Ruby source it represents
+    script->script_length = strlen(script->script_content);
+    script->content_hash = ruby_content_hash(script->script_content, script->script_length);
 
     return script;
 }
@@ -30,3 +34,11 @@ void ruby_script_destroy(RubyScript* script) {
 const char* ruby_script_get_content(RubyScript* script) {
     return script ? script->script_content : NULL;
 }
+
+size_t ruby_script_get_length(RubyScript* script) {
+    return script ? script->script_length : 0;
+}
+
+uint64_t ruby_script_get_content_hash(RubyScript* script) {
+    return script ? script->content_hash : 0;
+}
@@ -2,6 +2,7 @@
 #define RUBY_SCRIPT_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -9,12 +10,28 @@ extern "C" {
 
 struct RubyScript {
     char* script_content;
+    size_t script_length;
+    uint64_t content_hash;
 };
 typedef struct RubyScript RubyScript;
 
 RubyScript* ruby_script_create_from_content(const char* content, size_t content_size);
 void ruby_script_destroy(RubyScript* script);
 const char* ruby_script_get_content(RubyScript* script);
+size_t ruby_script_get_length(RubyScript* script);
+// Computed once at creation, lets the VM recognize a script body it has already compiled
+uint64_t ruby_script_get_content_hash(RubyScript* script);
+
+/**
+ * How an enqueued script runs, see ruby_vm_enqueue_with_flags
+ */
+typedef enum {
+    RUBY_ENQUEUE_DEFAULT = 0,
+    // Pure computation over shareable inputs: run it in parallel on the Ractor lane of the VM
+    RUBY_ENQUEUE_RACTOR = 1 << 0,
+    // Mostly waits on files, pipes or sleep: run it concurrently on the I/O thread pool of the VM
+    RUBY_ENQUEUE_IO = 1 << 1
+} RubyEnqueueFlags;
 
 #ifdef __cplusplus
 }
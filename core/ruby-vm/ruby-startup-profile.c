@@ -0,0 +1,90 @@
+#include <stddef.h>
+#include <time.h>
+
+#include "ruby-startup-profile.h"
+
+// Written by the thread running each phase, read by any thread: relaxed atomics are enough for timings.
+// Times are absolute, 0 while not reached.
+static uint64_t g_origin;
+static uint64_t g_starts[RUBY_STARTUP_PHASE_COUNT];
+static uint64_t g_ends[RUBY_STARTUP_PHASE_COUNT];
+static uint64_t g_first_request;
+
+static const char* const PHASE_NAMES[RUBY_STARTUP_PHASE_COUNT] = {
+    "comm_channel",
+    "thread_start",
+    "install_pack",
+    "install_stdlib_ext",
+    "setup_env",
+    "ruby_sysinit",
+    "ruby_init",
+    "signals",
+    "host_setup",
+    "ruby_options",
+    "interpreter_ready",
+    "first_script"
+};
+
+uint64_t ruby_startup_profile_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void ruby_startup_profile_reset(void) {
+    for (size_t i = 0; i < RUBY_STARTUP_PHASE_COUNT; i++) {
+        __atomic_store_n(&g_starts[i], 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&g_ends[i], 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&g_first_request, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_origin, ruby_startup_profile_now(), __ATOMIC_RELAXED);
+}
+
+void ruby_startup_profile_record(RubyStartupPhase phase, uint64_t start_ns, uint64_t end_ns) {
+    if ((unsigned)phase >= RUBY_STARTUP_PHASE_COUNT) return;
+    __atomic_store_n(&g_starts[phase], start_ns, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_ends[phase], end_ns, __ATOMIC_RELAXED);
+}
+
+void ruby_startup_profile_begin(RubyStartupPhase phase) {
+    ruby_startup_profile_record(phase, ruby_startup_profile_now(), 0);
+}
+
+void ruby_startup_profile_end(RubyStartupPhase phase) {
+    if ((unsigned)phase >= RUBY_STARTUP_PHASE_COUNT) return;
+    __atomic_store_n(&g_ends[phase], ruby_startup_profile_now(), __ATOMIC_RELAXED);
+}
+
+void ruby_startup_profile_request_sent(uint64_t request_id) {
+    uint64_t none = 0;
+    if (__atomic_load_n(&g_first_request, __ATOMIC_RELAXED) == 0 &&
+        __atomic_compare_exchange_n(&g_first_request, &none, request_id, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        ruby_startup_profile_begin(RUBY_STARTUP_FIRST_SCRIPT);
+    }
+}
+
+void ruby_startup_profile_reply_received(uint64_t request_id) {
+    if (request_id != 0 && __atomic_load_n(&g_first_request, __ATOMIC_RELAXED) == request_id &&
+        __atomic_load_n(&g_ends[RUBY_STARTUP_FIRST_SCRIPT], __ATOMIC_RELAXED) == 0) {
+        ruby_startup_profile_end(RUBY_STARTUP_FIRST_SCRIPT);
+    }
+}
+
+void ruby_startup_profile_get(RubyStartupProfile* out_profile) {
+    if (!out_profile) return;
+
+    const uint64_t origin = __atomic_load_n(&g_origin, __ATOMIC_RELAXED);
+    out_profile->origin_ns = origin;
+    for (size_t i = 0; i < RUBY_STARTUP_PHASE_COUNT; i++) {
+        const uint64_t start = __atomic_load_n(&g_starts[i], __ATOMIC_RELAXED);
+        const uint64_t end = __atomic_load_n(&g_ends[i], __ATOMIC_RELAXED);
+        RubyStartupPhaseTiming* timing = &out_profile->phases[i];
+        timing->start_ns = start > origin ? start - origin : 0;
+        timing->completed = start != 0 && end >= start;
+        timing->duration_ns = timing->completed ? end - start : 0;
+    }
+}
+
+const char* ruby_startup_phase_name(RubyStartupPhase phase) {
+    return (unsigned)phase < RUBY_STARTUP_PHASE_COUNT ? PHASE_NAMES[phase] : "?";
+}
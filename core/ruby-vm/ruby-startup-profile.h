@@ -0,0 +1,88 @@
+#ifndef RUBY_STARTUP_PROFILE_H
+#define RUBY_STARTUP_PROFILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Where the time goes while the VM starts, from ruby_vm_start to the reply of the first script.
+ *
+ * Each phase is timed with CLOCK_MONOTONIC by the thread running it: the host thread, the VM thread,
+ * the dispatcher and the reply reader. Only one VM lives in a process, the timings are process-wide
+ * values read by any thread without a round trip, like the compiled script cache counters.
+ * Phases are listed in start order; they may overlap, e.g. the first script can be sent before
+ * the interpreter is ready.
+ */
+typedef enum {
+    RUBY_STARTUP_COMM_CHANNEL = 0,     // Socket pair between the host and the VM
+    RUBY_STARTUP_THREAD_START,         // From pthread_create to the VM thread running
+    RUBY_STARTUP_INSTALL_PACK,         // Embedded pack in place: Ruby standard library and fifo_interpreter.rb
+    RUBY_STARTUP_INSTALL_STDLIB_EXT,   // ruby-stdlib-ext.zip in place, extracted along with the pack
+    RUBY_STARTUP_SETUP_ENV,            // GEM_HOME, RUBYLIB... environment variables
+    RUBY_STARTUP_SYSINIT,              // ruby_sysinit
+    RUBY_STARTUP_INIT,                 // ruby_init
+    RUBY_STARTUP_SIGNALS,              // Signal handlers restored and chained after ruby_init
+    RUBY_STARTUP_HOST_SETUP,           // RubyVMHost, embedded stdlib loader, compile cache, preload profile
+    RUBY_STARTUP_OPTIONS,              // ruby_options: RubyGems and default gems prelude, parse of the main script
+    RUBY_STARTUP_INTERPRETER_READY,    // fifo_interpreter.rb running until it serves the commands channel
+    RUBY_STARTUP_FIRST_SCRIPT,         // First request sent until its reply is received
+    RUBY_STARTUP_PHASE_COUNT
+} RubyStartupPhase;
+
+typedef struct {
+    uint64_t start_ns;      // Since ruby_vm_start
+    uint64_t duration_ns;
+    int completed;          // 0 while the phase has not been reached or is still running
+} RubyStartupPhaseTiming;
+
+typedef struct {
+    uint64_t origin_ns;     // CLOCK_MONOTONIC time of ruby_vm_start, 0 if the VM was never started
+    RubyStartupPhaseTiming phases[RUBY_STARTUP_PHASE_COUNT];
+} RubyStartupProfile;
+
+/**
+ * @return CLOCK_MONOTONIC time in nanoseconds
+ */
+uint64_t ruby_startup_profile_now(void);
+
+/**
+ * Forget every timing and start the clock, called by ruby_vm_start
+ */
+void ruby_startup_profile_reset(void);
+
+void ruby_startup_profile_begin(RubyStartupPhase phase);
+void ruby_startup_profile_end(RubyStartupPhase phase);
+
+/**
+ * Time a phase that did not run on the recording thread
+ *
+ * @param start_ns CLOCK_MONOTONIC time the phase started
+ * @param end_ns CLOCK_MONOTONIC time the phase ended, 0 if it did not complete
+ */
+void ruby_startup_profile_record(RubyStartupPhase phase, uint64_t start_ns, uint64_t end_ns);
+
+/**
+ * Start RUBY_STARTUP_FIRST_SCRIPT with the request about to be sent, unless one was already sent
+ */
+void ruby_startup_profile_request_sent(uint64_t request_id);
+
+/**
+ * End RUBY_STARTUP_FIRST_SCRIPT if the reply is the one of the first request
+ */
+void ruby_startup_profile_reply_received(uint64_t request_id);
+
+void ruby_startup_profile_get(RubyStartupProfile* out_profile);
+
+/**
+ * @return Name of the phase, e.g. "ruby_init", "?" for an unknown phase
+ */
+const char* ruby_startup_phase_name(RubyStartupPhase phase);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_STARTUP_PROFILE_H
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ruby-sync-eval.h"
+
+typedef enum {
+    SYNC_EVAL_IDLE,
+    SYNC_EVAL_PENDING,
+    SYNC_EVAL_RUNNING,
+    SYNC_EVAL_DONE
+} SyncEvalState;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_request_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_state_changed = PTHREAD_COND_INITIALIZER;
+
+static SyncEvalState g_state = SYNC_EVAL_IDLE;
+static int g_closed = 1;
+static int g_interrupted = 0;
+static const char* g_source = NULL;
+static size_t g_length = 0;
+static RubyEvalResult* g_result = NULL;
+
+static void set_result(RubyEvalResult* result, int status, const char* message) {
+    result->status = status;
+    snprintf(result->message, sizeof(result->message), "%s", message ? message : "");
+}
+
+void ruby_sync_eval_open(void) {
+    pthread_mutex_lock(&g_lock);
+    g_closed = 0;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void ruby_sync_eval_close(void) {
+    pthread_mutex_lock(&g_lock);
+    g_closed = 1;
+    pthread_cond_broadcast(&g_request_ready);
+    pthread_cond_broadcast(&g_state_changed);
+    pthread_mutex_unlock(&g_lock);
+}
+
+int ruby_sync_eval_submit(const char* source, size_t length, RubyEvalResult* out_result) {
+    pthread_mutex_lock(&g_lock);
+
+    // One request at a time
+    while (g_state != SYNC_EVAL_IDLE && !g_closed) {
+        pthread_cond_wait(&g_state_changed, &g_lock);
+    }
+    if (g_closed) {
+        pthread_mutex_unlock(&g_lock);
+        set_result(out_result, -1, "Ruby VM is not running");
+        return -1;
+    }
+
+    g_source = source;
+    g_length = length;
+    g_result = out_result;
+    g_state = SYNC_EVAL_PENDING;
+    pthread_cond_signal(&g_request_ready);
+
+    // Once picked up, the request must run to completion: the Ruby side reads 'source'
+    while ((g_state == SYNC_EVAL_PENDING && !g_closed) || g_state == SYNC_EVAL_RUNNING) {
+        pthread_cond_wait(&g_state_changed, &g_lock);
+    }
+    if (g_state == SYNC_EVAL_PENDING) {
+        set_result(out_result, -1, "Ruby VM stopped before evaluating the request");
+    }
+
+    g_source = NULL;
+    g_result = NULL;
+    g_state = SYNC_EVAL_IDLE;
+    pthread_cond_broadcast(&g_state_changed);
+    pthread_mutex_unlock(&g_lock);
+    return out_result->status;
+}
+
+int ruby_sync_eval_wait_request(const char** out_source, size_t* out_length) {
+    pthread_mutex_lock(&g_lock);
+
+    while (g_state != SYNC_EVAL_PENDING && !g_closed && !g_interrupted) {
+        pthread_cond_wait(&g_request_ready, &g_lock);
+    }
+
+    int result;
+    if (g_closed) {
+        result = -1;
+    } else if (g_interrupted) {
+        g_interrupted = 0;
+        result = 1;
+    } else {
+        *out_source = g_source;
+        *out_length = g_length;
+        g_state = SYNC_EVAL_RUNNING;
+        result = 0;
+    }
+
+    pthread_mutex_unlock(&g_lock);
+    return result;
+}
+
+void ruby_sync_eval_interrupt(void) {
+    pthread_mutex_lock(&g_lock);
+    g_interrupted = 1;
+    pthread_cond_broadcast(&g_request_ready);
+    pthread_mutex_unlock(&g_lock);
+}
+
+void ruby_sync_eval_finish(int status, const char* message) {
+    pthread_mutex_lock(&g_lock);
+    if (g_state == SYNC_EVAL_RUNNING) {
+        set_result(g_result, status, message);
+        g_state = SYNC_EVAL_DONE;
+        pthread_cond_broadcast(&g_state_changed);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
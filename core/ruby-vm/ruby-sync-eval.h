@@ -0,0 +1,71 @@
+#ifndef RUBY_SYNC_EVAL_H
+#define RUBY_SYNC_EVAL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RUBY_EVAL_MESSAGE_SIZE 512
+
+/**
+ * Outcome of a synchronous evaluation
+ */
+typedef struct {
+    int status;                            // 0 = success, 1 = Ruby exception, -1 = VM not available
+    char message[RUBY_EVAL_MESSAGE_SIZE];  // "ExceptionClass: message" on failure, empty on success
+} RubyEvalResult;
+
+/**
+ * Single request slot shared by the callers of ruby_vm_eval_sync and the Ruby thread serving them.
+ *
+ * There is only one Ruby VM per process, so the slot is process-wide and statically allocated:
+ * it never has to be destroyed while the Ruby side may still be waiting on it.
+ * Callers are served one at a time, each one blocking on a condition variable until its
+ * evaluation is done.
+ */
+
+/**
+ * Accept requests (called when the VM starts)
+ */
+void ruby_sync_eval_open(void);
+
+/**
+ * Refuse new requests and fail the ones not picked up yet.
+ * A request already being evaluated is still completed normally.
+ */
+void ruby_sync_eval_close(void);
+
+/**
+ * Caller side: evaluate 'source' on the Ruby VM and block until done
+ *
+ * @param source Ruby code, does not need to be NUL-terminated
+ * @param length Length of 'source' in bytes
+ * @param out_result Receives the evaluation outcome
+ * @return out_result->status
+ */
+int ruby_sync_eval_submit(const char* source, size_t length, RubyEvalResult* out_result);
+
+/**
+ * Ruby side: wait for the next request
+ *
+ * @return 0 when a request was taken, 1 if interrupted by ruby_sync_eval_interrupt, -1 once closed
+ */
+int ruby_sync_eval_wait_request(const char** out_source, size_t* out_length);
+
+/**
+ * Ruby side: wake up ruby_sync_eval_wait_request without a request
+ */
+void ruby_sync_eval_interrupt(void);
+
+/**
+ * Ruby side: complete the request taken by ruby_sync_eval_wait_request and wake its caller
+ */
+void ruby_sync_eval_finish(int status, const char* message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_SYNC_EVAL_H
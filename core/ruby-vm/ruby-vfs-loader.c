@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#include "constants.h"
+#include "ruby-vfs-loader.h"
+#include "ruby-cache-files.h"
+#include "embedded_vfs.h"
+#include "embedded_pack.h"
+#include "debug.h"
+
+#pragma GCC diagnostic push
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#else
+#ifdef __clang__
+#pragma clang diagnostic ignored "-Wdefault-const-init-field-unsafe"
+#pragma clang diagnostic ignored "-Wunused-parameter"
+#endif
+#endif
+#include "ruby/ruby.h"
+#pragma GCC diagnostic pop
+
+#define VFS_SOURCE_EXTENSION ".rb"
+
+// Compiled sources are kept in <base directory>/VFS_ISEQ_DIRECTORY/<Ruby version>-<platform>-<pack fingerprint>
+#define VFS_ISEQ_DIRECTORY ".stdlib-iseq"
+#define VFS_ISEQ_EXTENSION ".yarb"
+
+// Expanded base directory: sources below it are looked up in the VFS, relative to it
+static char* g_vfs_root = NULL;
+static size_t g_vfs_root_length = 0;
+
+// Where the instruction sequences of this Ruby and this pack are kept, NULL if they are not
+static char* g_iseq_directory = NULL;
+
+/**
+ * Requires are checked against the VFS first, then go to the original Kernel#require.
+ * Sources of the VFS are compiled from memory and recorded in $LOADED_FEATURES as soon as they start
+ * loading: an autoload of a constant the source defines must see it provided, and a circular require
+ * returns false. A source being loaded has a lock of its own, held by the loading thread: another thread
+ * requiring it waits for it, then requires it again if the load failed. VFS_LOCK only guards that table,
+ * it is never held while a source runs, which could require a feature from disk under the lock of Ruby.
+ */
+static const char* VFS_LOADER_SCRIPT =
+        "module RubyVMHost\n"
+        "  VFS_LOCK = Thread::Mutex.new\n"
+        "  VFS_LOADING = {}\n"
+        "\n"
+        "  def self.vfs_compile(path)\n"
+        "    cache_load_or_compile(vfs_iseq_fetch(path), ->(binary) { vfs_iseq_store(path, binary) }) do\n"
+        "      RubyVM::InstructionSequence.compile(vfs_read(path), path, path)\n"
+        "    end\n"
+        "  end\n"
+        "\n"
+        "  def self.vfs_require(path)\n"
+        "    loading = nil\n"
+        "    until loading\n"
+        "      other = VFS_LOCK.synchronize do\n"
+        "        next VFS_LOADING[path] if VFS_LOADING.key?(path)\n"
+        "        return false if $LOADED_FEATURES.include?(path)\n"
+        "        $LOADED_FEATURES << path\n"
+        "        loading = VFS_LOADING[path] = Thread::Mutex.new.lock\n"
+        "        nil\n"
+        "      end\n"
+        "      next unless other\n"
+        "      return false if other.owned?\n"
+        "      other.synchronize {}\n"
+        "    end\n"
+        "    begin\n"
+        "      vfs_compile(path).eval\n"
+        "      true\n"
+        "    rescue Exception\n"
+        "      VFS_LOCK.synchronize { $LOADED_FEATURES.delete(path) }\n"
+        "      raise\n"
+        "    ensure\n"
+        "      VFS_LOCK.synchronize { VFS_LOADING.delete(path) }\n"
+        "      loading.unlock\n"
+        "    end\n"
+        "  end\n"
+        "end\n"
+        "\n"
+        "module Kernel\n"
+        "  alias_method :ruby_vm_disk_require, :require\n"
+        "\n"
+        "  def require(feature)\n"
+        "    path = RubyVMHost.vfs_resolve(feature)\n"
+        "    path ? RubyVMHost.vfs_require(path) : ruby_vm_disk_require(feature)\n"
+        "  end\n"
+        "\n"
+        "  def require_relative(feature)\n"
+        "    base = caller_locations(1, 1).first&.absolute_path\n"
+        "    feature = File.path(feature)\n"
+        "    raise LoadError, 'cannot infer basepath' unless base || feature.start_with?('/')\n"
+        "    require(File.expand_path(feature, base && File.dirname(base)))\n"
+        "  end\n"
+        "\n"
+        "  private :require, :require_relative, :ruby_vm_disk_require\n"
+        "end\n";
+
+static int has_suffix(const char* name, size_t length, const char* suffix) {
+    const size_t suffix_length = strlen(suffix);
+    return length >= suffix_length && memcmp(name + length - suffix_length, suffix, suffix_length) == 0;
+}
+
+static int file_exists(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// Path of 'path' in the VFS when it is below the base directory, NULL otherwise
+static const char* vfs_relative_path(const char* path) {
+    if (strncmp(path, g_vfs_root, g_vfs_root_length) != 0 || path[g_vfs_root_length] != '/') {
+        return NULL;
+    }
+    return path + g_vfs_root_length + 1;
+}
+
+/**
+ * Look 'source' (the feature, with its extension) up in one directory of the load path
+ *
+ * @param path Receives the full path, MAX_PATH_LENGTH bytes
+ * @return 1 if found in the VFS, -1 if the regular require would find the feature on disk there, 0 otherwise
+ */
+static int vfs_lookup(const char* directory, size_t directory_length, const char* source, int native_candidate,
+                      char* path) {
+    while (directory_length > 1 && directory[directory_length - 1] == '/') {
+        directory_length--;
+    }
+    const int length = snprintf(path, MAX_PATH_LENGTH, "%.*s/%s", (int)directory_length, directory, source);
+    if (length < 0 || length >= MAX_PATH_LENGTH) {
+        return 0;
+    }
+
+    const char* relative_path = vfs_relative_path(path);
+    if (relative_path && embedded_vfs_contains(relative_path)) {
+        return 1;
+    }
+    if (file_exists(path)) {
+        return -1;
+    }
+
+    // Like the regular require, a feature without extension may also be a native extension in that directory
+    const size_t stem_length = (size_t)length - (sizeof(VFS_SOURCE_EXTENSION) - 1);
+    if (native_candidate && stem_length + sizeof(DLEXT) <= MAX_PATH_LENGTH) {
+        memcpy(path + stem_length, DLEXT, sizeof(DLEXT));
+        const int native_found = file_exists(path);
+        memcpy(path + stem_length, VFS_SOURCE_EXTENSION, sizeof(VFS_SOURCE_EXTENSION));
+        if (native_found) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static VALUE host_vfs_resolve(VALUE self, VALUE feature) {
+    (void) self;
+    char source[MAX_PATH_LENGTH];
+    char path[MAX_PATH_LENGTH];
+
+    feature = rb_get_path(feature);
+    const char* name = RSTRING_PTR(feature);
+    const size_t name_length = (size_t)RSTRING_LEN(feature);
+
+    if (name_length == 0 || has_suffix(name, name_length, DLEXT) || has_suffix(name, name_length, ".o")) {
+        return Qnil;
+    }
+
+    const int has_extension = has_suffix(name, name_length, VFS_SOURCE_EXTENSION);
+    const int length = snprintf(source, sizeof(source), "%s%s", name, has_extension ? "" : VFS_SOURCE_EXTENSION);
+    if (length < 0 || (size_t)length >= sizeof(source)) {
+        return Qnil;
+    }
+
+    // Absolute paths are not searched, relative ones ("./", "../", "~") are resolved against the working directory
+    if (name[0] == '/') {
+        const char* relative_path = vfs_relative_path(source);
+        return relative_path && embedded_vfs_contains(relative_path) ? rb_str_new_cstr(source) : Qnil;
+    }
+    if (name[0] == '.' || name[0] == '~') {
+        return Qnil;
+    }
+
+    VALUE load_path = rb_gv_get("$LOAD_PATH");
+    for (long i = 0; i < RARRAY_LEN(load_path); i++) {
+        VALUE directory = rb_get_path(RARRAY_AREF(load_path, i));
+        const int found = vfs_lookup(RSTRING_PTR(directory), (size_t)RSTRING_LEN(directory),
+                                     source, !has_extension, path);
+        if (found > 0) {
+            return rb_str_new_cstr(path);
+        }
+        if (found < 0) {
+            break;
+        }
+    }
+    return Qnil;
+}
+
+static VALUE host_vfs_read(VALUE self, VALUE path) {
+    (void) self;
+    size_t size = 0;
+
+    const char* relative_path = vfs_relative_path(StringValueCStr(path));
+    const char* content = relative_path ? embedded_vfs_map(relative_path, &size) : NULL;
+    if (!content) {
+        rb_raise(rb_eLoadError, "cannot load such file -- %s", StringValueCStr(path));
+    }
+
+    // The content lives in the read-only data of the library, the string points to it without a copy
+    return rb_utf8_str_new_static(content, (long)size);
+}
+
+// Path of the instruction sequence of a source of the VFS, 0 if there is none
+static int vfs_iseq_path(const char* path, char* iseq_path) {
+    const char* relative_path = g_iseq_directory ? vfs_relative_path(path) : NULL;
+    if (!relative_path) {
+        return 0;
+    }
+    const int length = snprintf(iseq_path, MAX_PATH_LENGTH, "%s/%s" VFS_ISEQ_EXTENSION, g_iseq_directory, relative_path);
+    return length > 0 && length < MAX_PATH_LENGTH;
+}
+
+static VALUE host_vfs_iseq_fetch(VALUE self, VALUE path) {
+    (void) self;
+    char iseq_path[MAX_PATH_LENGTH];
+
+    if (!vfs_iseq_path(StringValueCStr(path), iseq_path)) {
+        return Qnil;
+    }
+    FILE* file = fopen(iseq_path, "rb");
+    if (!file) {
+        return Qnil;
+    }
+
+    VALUE binary = Qnil;
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0 && st.st_size > 0) {
+        binary = rb_str_new(NULL, (long)st.st_size);
+        if (fread(RSTRING_PTR(binary), 1, (size_t)st.st_size, file) != (size_t)st.st_size) {
+            binary = Qnil;
+        }
+    }
+    fclose(file);
+    return binary;
+}
+
+// Written atomically: a start running concurrently, or after an interrupted write, reads the whole binary or none
+static VALUE host_vfs_iseq_store(VALUE self, VALUE path, VALUE binary) {
+    (void) self;
+    char iseq_path[MAX_PATH_LENGTH];
+
+    StringValue(binary);
+    if (!vfs_iseq_path(StringValueCStr(path), iseq_path) || ruby_cache_make_parents(iseq_path) != 0) {
+        return Qfalse;
+    }
+    return ruby_cache_write_file(iseq_path, NULL, 0, RSTRING_PTR(binary), (size_t)RSTRING_LEN(binary)) == 0 ? Qtrue : Qfalse;
+}
+
+/**
+ * The instruction sequences depend on the Ruby that compiled them and on the sources of the pack,
+ * both name the directory they are kept in
+ */
+static void iseq_directory_define(void) {
+    char name[MAX_PATH_LENGTH];
+    char parent[MAX_PATH_LENGTH];
+    char directory[MAX_PATH_LENGTH];
+
+    VALUE version = rb_const_get(rb_cObject, rb_intern("RUBY_VERSION"));
+    VALUE platform = rb_const_get(rb_cObject, rb_intern("RUBY_PLATFORM"));
+    int length = snprintf(name, sizeof(name), "%s-%s-%016" PRIx64, StringValueCStr(version),
+                          StringValueCStr(platform), embedded_pack_fingerprint());
+    if (length <= 0 || length >= (int)sizeof(name)) {
+        return;
+    }
+    length = snprintf(parent, sizeof(parent), "%s/" VFS_ISEQ_DIRECTORY, g_vfs_root);
+    if (length <= 0 || length >= (int)sizeof(parent)) {
+        return;
+    }
+    length = snprintf(directory, sizeof(directory), "%s/%s", parent, name);
+    if (length <= 0 || length >= (int)sizeof(directory)) {
+        return;
+    }
+
+    ruby_cache_remove_stale(parent, name);
+    free(g_iseq_directory);
+    g_iseq_directory = strdup(directory);
+}
+
+int ruby_vfs_loader_define(const char* base_directory) {
+    if (embedded_vfs_init() != 0) {
+        DEBUG_LOG("ruby_vfs_loader_define: embedded standard library unavailable");
+        return -1;
+    }
+
+    // $LOAD_PATH holds expanded paths, so does the root
+    VALUE root = rb_file_expand_path(rb_str_new_cstr(base_directory), Qnil);
+    free(g_vfs_root);
+    g_vfs_root = strdup(StringValueCStr(root));
+    if (!g_vfs_root) {
+        return -1;
+    }
+    g_vfs_root_length = strlen(g_vfs_root);
+    iseq_directory_define();
+
+    VALUE host_module = rb_define_module("RubyVMHost");
+    rb_define_module_function(host_module, "vfs_resolve", host_vfs_resolve, 1);
+    rb_define_module_function(host_module, "vfs_read", host_vfs_read, 1);
+    rb_define_module_function(host_module, "vfs_iseq_fetch", host_vfs_iseq_fetch, 1);
+    rb_define_module_function(host_module, "vfs_iseq_store", host_vfs_iseq_store, 2);
+
+    if (ruby_cache_define_loader() != 0 || ruby_cache_eval_script(VFS_LOADER_SCRIPT, "<ruby-vm-vfs>") != 0) {
+        DEBUG_LOG("ruby_vfs_loader_define: failed to install the loader");
+        return -1;
+    }
+
+    DEBUG_LOG("ruby_vfs_loader_define: standard library served from memory below %s", g_vfs_root);
+    return 0;
+}
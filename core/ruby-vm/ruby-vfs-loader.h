@@ -0,0 +1,52 @@
+#ifndef RUBY_VFS_LOADER_H
+#define RUBY_VFS_LOADER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Serve the Ruby sources of the standard library from the embedded archive (see embedded_vfs.h)
+ * instead of the install directory.
+ *
+ * Kernel#require and Kernel#require_relative are replaced by versions that look the feature up
+ * along $LOAD_PATH, as the regular require does: in a directory below 'base_directory', the VFS
+ * is checked first, then the disk. A source found in the VFS is compiled from memory under its
+ * would-be installed path, which is what __FILE__, __dir__ and $LOADED_FEATURES see; anything else
+ * (native extensions, files out of the base directory) goes to the regular require.
+ *
+ * The instruction sequence of each source is kept in binary form below
+ * <base_directory>/.stdlib-iseq/<RUBY_VERSION>-<RUBY_PLATFORM>-<pack fingerprint>, written the first
+ * time the source is compiled: later starts load it instead of parsing the source again. The directories
+ * of other Ruby versions, platforms or packs are removed, and a binary this Ruby cannot load is compiled
+ * from the source again. They are built on the device rather than with the library: an instruction
+ * sequence records the absolute path of its source, which __FILE__, __dir__ and require_relative rely on.
+ * Also defines:
+ *
+ *   RubyVMHost.vfs_resolve(feature) -> String or nil
+ *     Path of the source that requiring 'feature' loads, nil when it is not in the VFS
+ *
+ *   RubyVMHost.vfs_read(path) -> String
+ *     Content of a source of the VFS, not copied from the embedded data, raises LoadError when missing
+ *
+ *   RubyVMHost.vfs_iseq_fetch(path) -> String or nil
+ *     Binary instruction sequence kept for a source of the VFS, nil when there is none
+ *
+ *   RubyVMHost.vfs_iseq_store(path, binary) -> true or false
+ *     Keep the binary instruction sequence of a source of the VFS for the next starts
+ *
+ * Kernel#load, and C extensions calling rb_require() on Ruby versions where it does not go
+ * through Kernel#require, still only see the files on disk.
+ * Must be called on the VM thread, after ruby_host_module_define() and before ruby_options(),
+ * so that RubyGems itself is loaded from memory.
+ *
+ * @param base_directory Install directory the standard library would have been extracted to
+ * @return 0 on success, -1 if the loader could not be installed
+ */
+int ruby_vfs_loader_define(const char* base_directory);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_VFS_LOADER_H
@@ -23,6 +23,10 @@ const char* ruby_vm_error_string(RubyVMErrorCode code) {
             return "Operation timed out";
         case RUBY_VM_ERROR_ALREADY_STARTED:
             return "VM already started";
+        case RUBY_VM_ERROR_CANCELLED:
+            return "Request cancelled";
+        case RUBY_VM_ERROR_RACTOR_ISOLATION:
+            return "Script not Ractor-safe";
         default:
             return "Unknown error";
     }
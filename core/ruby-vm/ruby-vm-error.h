@@ -18,6 +18,8 @@ typedef enum {
     RUBY_VM_ERROR_RUBY_EXEC = -6,
     RUBY_VM_ERROR_TIMEOUT = -7,
     RUBY_VM_ERROR_ALREADY_STARTED = -8,
+    RUBY_VM_ERROR_CANCELLED = -9,
+    RUBY_VM_ERROR_RACTOR_ISOLATION = -10,
 } RubyVMErrorCode;
 
 /**
@@ -0,0 +1,37 @@
+#ifndef RUBY_VM_POOL_STATS_H
+#define RUBY_VM_POOL_STATS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Shard keys are spread over this many shards, each one served by a single worker at a time
+#define RUBY_VM_POOL_SHARD_COUNT 256
+
+typedef struct {
+    uint32_t worker;            // Index of the worker serving the shard
+    uint32_t depth;             // Requests of the shard queued or running
+    uint64_t enqueued;          // Requests of the shard since the pool was created
+} RubyVMPoolShardStats;
+
+/**
+ * @return Shard of a key, the index of its stats
+ */
+uint32_t ruby_vm_pool_shard_of(uint64_t shard_key);
+
+/**
+ * Worker serving a shard: the running one with the highest score for it (rendezvous hashing). When a worker
+ * stops, only its own shards change hands, spread over the others.
+ *
+ * @param running_workers Bit i set while worker i runs, a pool has VM_POOL_MAX_WORKERS (64) workers at most
+ * @return Index of the worker, UINT32_MAX if none runs
+ */
+uint32_t ruby_vm_pool_shard_owner(uint32_t shard, uint64_t running_workers);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_VM_POOL_STATS_H
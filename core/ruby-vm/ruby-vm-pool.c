@@ -0,0 +1,599 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "ruby-vm-pool.h"
+#include "ruby-vm.h"
+#include "debug.h"
+
+// Request ids of a pool keep the one of the worker VM in their low bits, and the worker index + 1 above
+#define POOL_WORKER_ID_SHIFT 48
+#define POOL_REQUEST_ID_MASK ((UINT64_C(1) << POOL_WORKER_ID_SHIFT) - 1)
+
+// Shard of a request any worker can take
+#define POOL_NO_SHARD UINT32_MAX
+
+typedef enum {
+    POOL_REQUEST_SCRIPT,
+    POOL_REQUEST_RESULT,
+    POOL_REQUEST_BATCH
+} PoolRequestKind;
+
+/**
+ * Request of the pool, queued until a worker takes it, then given to the worker VM as the context of its task:
+ * its completion hands the next queued request to the same worker before calling the task of the caller.
+ */
+typedef struct PoolRequest {
+    struct PoolRequest* next;
+    PoolRequestKind kind;
+    RubyVMPool* pool;
+    RubyVMPoolWorker* worker;       // NULL until sent
+    uint32_t shard;                 // POOL_NO_SHARD unless enqueued with a shard key
+    uint64_t sequence;              // Enqueue order
+    RubyScript* script;             // NULL for a batch
+    uint32_t flags;                 // RubyEnqueueFlags of a single script
+    RubyCompletionTask on_complete;
+    RubyResultTask on_result;
+    size_t count;                   // Scripts of a batch, the arrays below are kept after the request
+    RubyScript** scripts;
+    RubyCompletionTask* tasks;      // Those of the caller
+    RubyCompletionTask* vm_tasks;   // Those given to the worker VM, all pointing to the request
+    size_t completed;               // Scripts of the batch completed, all from the reply reader of the worker
+} PoolRequest;
+
+static void send_request(PoolRequest* request);
+static void on_worker_stopped(void* user_data, int result);
+
+/**
+ * splitmix64 finalizer: shard keys are often small integers or ids, spread them over the whole range
+ */
+static uint64_t mix64(uint64_t value) {
+    value ^= value >> 30;
+    value *= UINT64_C(0xbf58476d1ce4e5b9);
+    value ^= value >> 27;
+    value *= UINT64_C(0x94d049bb133111eb);
+    value ^= value >> 31;
+    return value;
+}
+
+uint32_t ruby_vm_pool_shard_of(uint64_t shard_key) {
+    return (uint32_t)(mix64(shard_key) % RUBY_VM_POOL_SHARD_COUNT);
+}
+
+uint32_t ruby_vm_pool_shard_owner(uint32_t shard, uint64_t running_workers) {
+    uint64_t best_score = 0;
+    uint32_t best = UINT32_MAX;
+    for (uint32_t i = 0; i < 64; i++) {
+        if (!(running_workers & (UINT64_C(1) << i))) continue;
+        const uint64_t score = mix64(((uint64_t)shard << 32) | (uint64_t)i);
+        if (best == UINT32_MAX || score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+/**
+ * Give every shard to its owner among the running workers (see ruby_vm_pool_shard_owner). Called with
+ * the lock held, with at least one worker running.
+ */
+static void assign_shards_locked(RubyVMPool* pool) {
+    uint64_t running_workers = 0;
+    for (size_t i = 0; i < pool->size; i++) {
+        if (!pool->workers[i].stopped) running_workers |= UINT64_C(1) << i;
+    }
+    for (uint32_t shard = 0; shard < RUBY_VM_POOL_SHARD_COUNT; shard++) {
+        pool->shards[shard].worker = ruby_vm_pool_shard_owner(shard, running_workers);
+    }
+}
+
+static void queue_push(RubyVMPoolQueue* queue, PoolRequest* request) {
+    request->next = NULL;
+    if (queue->tail) {
+        queue->tail->next = request;
+    } else {
+        queue->head = request;
+    }
+    queue->tail = request;
+}
+
+static PoolRequest* queue_pop(RubyVMPoolQueue* queue) {
+    PoolRequest* request = queue->head;
+    if (request) {
+        queue->head = request->next;
+        if (!queue->head) queue->tail = NULL;
+        request->next = NULL;
+    }
+    return request;
+}
+
+/**
+ * Append every request of 'from' to 'to', emptying 'from'
+ */
+static void queue_append(RubyVMPoolQueue* to, RubyVMPoolQueue* from) {
+    if (!from->head) return;
+    if (to->tail) {
+        to->tail->next = from->head;
+    } else {
+        to->head = from->head;
+    }
+    to->tail = from->tail;
+    from->head = NULL;
+    from->tail = NULL;
+}
+
+size_t ruby_vm_pool_default_size(void) {
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) return 1;
+    return (size_t)cores < VM_POOL_MAX_WORKERS ? (size_t)cores : VM_POOL_MAX_WORKERS;
+}
+
+RubyVMPool* ruby_vm_pool_create(size_t size, RubyZygote* zygote, const char* application_path,
+                                const char* ruby_base_directory, const char* native_libs_location, LogListener listener) {
+    if (!zygote) return NULL;
+    if (size == 0) size = ruby_vm_pool_default_size();
+    if (size > VM_POOL_MAX_WORKERS) size = VM_POOL_MAX_WORKERS;
+
+    RubyVMPool* pool = calloc(1, sizeof(RubyVMPool));
+    if (!pool) return NULL;
+    pool->workers = calloc(size, sizeof(RubyVMPoolWorker));
+    if (!pool->workers || pthread_mutex_init(&pool->lock, NULL) != 0) {
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        RubyVM* vm = ruby_vm_create(application_path, zygote->main_script, listener);
+        if (!vm) {
+            DEBUG_LOG("ruby_vm_pool_create: ruby_vm_create() failed for worker %zu", i);
+            ruby_vm_pool_destroy(pool);
+            return NULL;
+        }
+        // Counted right away, so that a failed start still destroys it
+        RubyVMPoolWorker* worker = &pool->workers[pool->size++];
+        worker->pool = pool;
+        worker->vm = vm;
+
+        ruby_vm_use_zygote(vm, zygote);
+        ruby_vm_set_stopped_task(vm, ruby_completion_task_create(on_worker_stopped, worker));
+        const int start_result = ruby_vm_start(vm, ruby_base_directory, native_libs_location);
+        if (start_result != 0) {
+            DEBUG_LOG("ruby_vm_pool_create: worker %zu failed to start (%s)", i, ruby_vm_get_error_message(vm));
+            ruby_vm_pool_destroy(pool);
+            return NULL;
+        }
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    assign_shards_locked(pool);
+    pthread_mutex_unlock(&pool->lock);
+
+    DEBUG_LOG("ruby_vm_pool_create: %zu workers started", size);
+    return pool;
+}
+
+/**
+ * Complete every script of a request that was never sent, and free it
+ */
+static void fail_request(PoolRequest* request, int result) {
+    switch (request->kind) {
+        case POOL_REQUEST_SCRIPT:
+            ruby_completion_task_invoke(&request->on_complete, result);
+            break;
+        case POOL_REQUEST_RESULT:
+            ruby_result_task_invoke(&request->on_result, result, NULL, 0);
+            break;
+        case POOL_REQUEST_BATCH:
+            for (size_t i = 0; i < request->count; i++) {
+                ruby_completion_task_invoke(&request->tasks[i], result);
+            }
+            break;
+    }
+    free(request);
+}
+
+static void fail_requests(PoolRequest* requests, int result) {
+    while (requests) {
+        PoolRequest* next = requests->next;
+        fail_request(requests, result);
+        requests = next;
+    }
+}
+
+void ruby_vm_pool_destroy(RubyVMPool* pool) {
+    if (!pool) return;
+
+    // Completions of the workers being destroyed do not take queued requests anymore
+    pthread_mutex_lock(&pool->lock);
+    pool->closed = 1;
+    RubyVMPoolQueue queued = pool->queue;
+    pool->queue.head = NULL;
+    pool->queue.tail = NULL;
+    for (size_t i = 0; i < pool->size; i++) {
+        queue_append(&queued, &pool->workers[i].sharded);
+    }
+    memset(pool->shards, 0, sizeof(pool->shards));
+    pthread_mutex_unlock(&pool->lock);
+
+    fail_requests(queued.head, 1);
+
+    for (size_t i = 0; i < pool->size; i++) {
+        ruby_vm_destroy(pool->workers[i].vm);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+/**
+ * Running worker with the fewest outstanding requests, looking from a different worker each time so that
+ * ties are spread. Called with the lock held.
+ *
+ * @param window Outstanding requests a worker must be below to be picked, SIZE_MAX for any
+ * @return The worker, NULL if none is below 'window'
+ */
+static RubyVMPoolWorker* least_busy_worker_locked(RubyVMPool* pool, size_t window) {
+    const size_t start = pool->next++ % pool->size;
+    RubyVMPoolWorker* best = NULL;
+    for (size_t i = 0; i < pool->size; i++) {
+        RubyVMPoolWorker* worker = &pool->workers[(start + i) % pool->size];
+        if (!worker->stopped && worker->outstanding < window && (!best || worker->outstanding < best->outstanding)) {
+            best = worker;
+            if (best->outstanding == 0) break;
+        }
+    }
+    return best;
+}
+
+static RubyVMPoolWorker* acquire_least_busy_worker(RubyVMPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    RubyVMPoolWorker* worker = least_busy_worker_locked(pool, SIZE_MAX);
+    // Every worker stopped: the first one fails the request like any stopped VM
+    if (!worker) {
+        worker = &pool->workers[0];
+    }
+    worker->outstanding++;
+    pthread_mutex_unlock(&pool->lock);
+    return worker;
+}
+
+/**
+ * Oldest request the worker can take, from its shards or from the pool queue. Called with the lock held.
+ *
+ * @return The request, now counted on 'worker', NULL if none is waiting
+ */
+static PoolRequest* take_next_locked(RubyVMPool* pool, RubyVMPoolWorker* worker) {
+    PoolRequest* sharded = worker->sharded.head;
+    PoolRequest* shared = pool->queue.head;
+    PoolRequest* next = NULL;
+    if (sharded && (!shared || sharded->sequence < shared->sequence)) {
+        next = queue_pop(&worker->sharded);
+    } else if (shared) {
+        next = queue_pop(&pool->queue);
+    }
+    if (next) {
+        next->worker = worker;
+    }
+    return next;
+}
+
+/**
+ * Let a worker that completed a request take the next one waiting, or count it out if none is waiting
+ *
+ * @param shard Shard of the completed request, POOL_NO_SHARD if none
+ * @return The request to send to 'worker', NULL if none
+ */
+static PoolRequest* release_worker(RubyVMPool* pool, RubyVMPoolWorker* worker, uint32_t shard) {
+    pthread_mutex_lock(&pool->lock);
+    if (shard != POOL_NO_SHARD && pool->shards[shard].depth > 0) {
+        pool->shards[shard].depth--;
+    }
+
+    // A worker above the window because of requests sent right away does not take any more
+    PoolRequest* next = NULL;
+    if (!pool->closed && !worker->stopped && worker->outstanding <= VM_POOL_WORKER_WINDOW) {
+        next = take_next_locked(pool, worker);
+    }
+    if (!next) {
+        worker->outstanding--;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return next;
+}
+
+/**
+ * Send the request to an idle worker (the one of its shard if it has one), or queue it until that worker
+ * completes a request
+ */
+static void submit_request(RubyVMPool* pool, PoolRequest* request) {
+    pthread_mutex_lock(&pool->lock);
+    const int closed = pool->closed || pool->stopped_workers == pool->size;
+    RubyVMPoolWorker* worker = NULL;
+    if (!closed) {
+        request->sequence = pool->next_sequence++;
+        if (request->shard != POOL_NO_SHARD) {
+            RubyVMPoolShardStats* shard = &pool->shards[request->shard];
+            shard->depth++;
+            shard->enqueued++;
+            // Requests of the shard already waiting go first
+            RubyVMPoolWorker* owner = &pool->workers[shard->worker];
+            if (owner->outstanding < VM_POOL_WORKER_WINDOW && !owner->sharded.head) {
+                worker = owner;
+            } else {
+                queue_push(&owner->sharded, request);
+            }
+        } else {
+            // Nothing is queued while a worker is below the window: its next completion takes the queue head
+            worker = least_busy_worker_locked(pool, VM_POOL_WORKER_WINDOW);
+            if (!worker) {
+                queue_push(&pool->queue, request);
+            }
+        }
+        if (worker) {
+            worker->outstanding++;
+            request->worker = worker;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (closed) {
+        fail_request(request, 1);
+    } else if (worker) {
+        send_request(request);
+    }
+}
+
+/**
+ * Release the worker of a completed request, sending it the next queued request first
+ */
+static void complete_request(RubyVMPool* pool, RubyVMPoolWorker* worker, uint32_t shard) {
+    PoolRequest* next = release_worker(pool, worker, shard);
+    if (next) {
+        send_request(next);
+    }
+}
+
+static void on_pool_script_complete(void* user_data, int result) {
+    PoolRequest* request = user_data;
+    RubyCompletionTask on_complete = request->on_complete;
+    complete_request(request->pool, request->worker, request->shard);
+    free(request);
+    ruby_completion_task_invoke(&on_complete, result);
+}
+
+static void on_pool_result_complete(void* user_data, int result, const void* value, size_t length) {
+    PoolRequest* request = user_data;
+    RubyResultTask on_result = request->on_result;
+    complete_request(request->pool, request->worker, request->shard);
+    free(request);
+    ruby_result_task_invoke(&on_result, result, value, length);
+}
+
+/**
+ * Task of every script of a batch: they complete together, in order, the last one releases the worker
+ */
+static void on_pool_batch_script_complete(void* user_data, int result) {
+    PoolRequest* request = user_data;
+    const size_t index = request->completed++;
+    if (index + 1 < request->count) {
+        ruby_completion_task_invoke(&request->tasks[index], result);
+        return;
+    }
+
+    RubyCompletionTask on_complete = request->tasks[index];
+    complete_request(request->pool, request->worker, request->shard);
+    free(request);
+    ruby_completion_task_invoke(&on_complete, result);
+}
+
+/**
+ * Stopped task of a worker VM: stop giving it requests and move its shards, with their queued requests,
+ * to the running workers. Its requests in flight fail right after this returns.
+ */
+static void on_worker_stopped(void* user_data, int result) {
+    (void) result;
+    RubyVMPoolWorker* worker = user_data;
+    RubyVMPool* pool = worker->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->closed || worker->stopped) {
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+    worker->stopped = 1;
+    pool->stopped_workers++;
+    RubyVMPoolQueue orphans = worker->sharded;
+    worker->sharded.head = NULL;
+    worker->sharded.tail = NULL;
+
+    RubyVMPoolQueue failed = { NULL, NULL };
+    RubyVMPoolQueue to_send = { NULL, NULL };
+    if (pool->stopped_workers == pool->size) {
+        // Nobody left to run them
+        queue_append(&failed, &orphans);
+        queue_append(&failed, &pool->queue);
+        for (PoolRequest* request = failed.head; request; request = request->next) {
+            if (request->shard != POOL_NO_SHARD) {
+                pool->shards[request->shard].depth--;
+            }
+        }
+    } else {
+        // Requests of a shard stay in order: they all move to the same new worker, after its own
+        assign_shards_locked(pool);
+        PoolRequest* orphan;
+        while ((orphan = queue_pop(&orphans)) != NULL) {
+            queue_push(&pool->workers[pool->shards[orphan->shard].worker].sharded, orphan);
+        }
+        for (size_t i = 0; i < pool->size; i++) {
+            RubyVMPoolWorker* candidate = &pool->workers[i];
+            PoolRequest* next;
+            while (!candidate->stopped && candidate->outstanding < VM_POOL_WORKER_WINDOW &&
+                   (next = take_next_locked(pool, candidate)) != NULL) {
+                candidate->outstanding++;
+                queue_push(&to_send, next);
+            }
+        }
+    }
+    const size_t running = pool->size - pool->stopped_workers;
+    pthread_mutex_unlock(&pool->lock);
+
+    fprintf(stderr, "VM pool: worker %zu stopped, %zu still running\n", (size_t)(worker - pool->workers), running);
+    // Not sent yet: completed as if the request had run on a stopped VM
+    fail_requests(failed.head, 1);
+
+    PoolRequest* request;
+    while ((request = queue_pop(&to_send)) != NULL) {
+        send_request(request);
+    }
+}
+
+static void send_request(PoolRequest* request) {
+    RubyVM* vm = request->worker->vm;
+    switch (request->kind) {
+        case POOL_REQUEST_SCRIPT:
+            ruby_vm_enqueue_with_flags(vm, request->script, request->flags,
+                                       ruby_completion_task_create(on_pool_script_complete, request));
+            break;
+        case POOL_REQUEST_RESULT:
+            ruby_vm_enqueue_with_result_and_flags(vm, request->script, request->flags,
+                                                  ruby_result_task_create(on_pool_result_complete, request));
+            break;
+        case POOL_REQUEST_BATCH:
+            ruby_vm_enqueue_batch(vm, request->scripts, request->count, request->vm_tasks);
+            break;
+    }
+}
+
+static PoolRequest* create_request(RubyVMPool* pool, PoolRequestKind kind, RubyScript* script) {
+    PoolRequest* request = calloc(1, sizeof(PoolRequest));
+    if (request) {
+        request->kind = kind;
+        request->pool = pool;
+        request->shard = POOL_NO_SHARD;
+        request->script = script;
+    }
+    return request;
+}
+
+void ruby_vm_pool_enqueue(RubyVMPool* pool, RubyScript* script, uint32_t flags, RubyCompletionTask on_complete) {
+    PoolRequest* request = create_request(pool, POOL_REQUEST_SCRIPT, script);
+    if (!request) {
+        ruby_completion_task_invoke(&on_complete, 1);
+        return;
+    }
+    request->flags = flags;
+    request->on_complete = on_complete;
+    submit_request(pool, request);
+}
+
+void ruby_vm_pool_enqueue_sharded(RubyVMPool* pool, uint64_t shard_key, RubyScript* script, RubyCompletionTask on_complete) {
+    PoolRequest* request = create_request(pool, POOL_REQUEST_SCRIPT, script);
+    if (!request) {
+        ruby_completion_task_invoke(&on_complete, 1);
+        return;
+    }
+    request->on_complete = on_complete;
+    request->shard = ruby_vm_pool_shard_of(shard_key);
+    submit_request(pool, request);
+}
+
+uint64_t ruby_vm_pool_enqueue_with_deadline(RubyVMPool* pool, RubyScript* script, uint32_t timeout_ms, RubyCompletionTask on_complete) {
+    PoolRequest* request = create_request(pool, POOL_REQUEST_SCRIPT, script);
+    if (!request) {
+        ruby_completion_task_invoke(&on_complete, 1);
+        return 0;
+    }
+    request->on_complete = on_complete;
+    request->worker = acquire_least_busy_worker(pool);
+
+    const uint64_t index = (uint64_t)(request->worker - pool->workers);
+    const uint64_t request_id = ruby_vm_enqueue_with_deadline(request->worker->vm, script, timeout_ms,
+                                                              ruby_completion_task_create(on_pool_script_complete, request));
+    return request_id != 0 ? ((index + 1) << POOL_WORKER_ID_SHIFT) | (request_id & POOL_REQUEST_ID_MASK) : 0;
+}
+
+int ruby_vm_pool_cancel(RubyVMPool* pool, uint64_t request_id) {
+    const uint64_t index = request_id >> POOL_WORKER_ID_SHIFT;
+    if (index == 0 || index > pool->size) {
+        return -1;
+    }
+    return ruby_vm_cancel(pool->workers[index - 1].vm, request_id & POOL_REQUEST_ID_MASK);
+}
+
+void ruby_vm_pool_enqueue_with_result(RubyVMPool* pool, RubyScript* script, uint32_t flags, RubyResultTask on_result) {
+    PoolRequest* request = create_request(pool, POOL_REQUEST_RESULT, script);
+    if (!request) {
+        ruby_result_task_invoke(&on_result, 1, NULL, 0);
+        return;
+    }
+    request->flags = flags;
+    request->on_result = on_result;
+    submit_request(pool, request);
+}
+
+void ruby_vm_pool_enqueue_sharded_with_result(RubyVMPool* pool, uint64_t shard_key, RubyScript* script, RubyResultTask on_result) {
+    PoolRequest* request = create_request(pool, POOL_REQUEST_RESULT, script);
+    if (!request) {
+        ruby_result_task_invoke(&on_result, 1, NULL, 0);
+        return;
+    }
+    request->on_result = on_result;
+    request->shard = ruby_vm_pool_shard_of(shard_key);
+    submit_request(pool, request);
+}
+
+void ruby_vm_pool_enqueue_batch(RubyVMPool* pool, RubyScript** scripts, size_t count, RubyCompletionTask* on_complete) {
+    if (count == 0) return;
+
+    // The arrays of the caller can be released once this returns
+    PoolRequest* request = malloc(sizeof(PoolRequest) + count * (sizeof(RubyScript*) + 2 * sizeof(RubyCompletionTask)));
+    if (!request) {
+        for (size_t i = 0; on_complete && i < count; i++) {
+            ruby_completion_task_invoke(&on_complete[i], 1);
+        }
+        return;
+    }
+    memset(request, 0, sizeof(PoolRequest));
+    request->kind = POOL_REQUEST_BATCH;
+    request->pool = pool;
+    request->shard = POOL_NO_SHARD;
+    request->count = count;
+    request->tasks = (RubyCompletionTask*)(request + 1);
+    request->vm_tasks = request->tasks + count;
+    request->scripts = (RubyScript**)(request->vm_tasks + count);
+    memcpy(request->scripts, scripts, count * sizeof(RubyScript*));
+    for (size_t i = 0; i < count; i++) {
+        request->tasks[i] = on_complete ? on_complete[i] : ruby_completion_task_create(NULL, NULL);
+        request->vm_tasks[i] = ruby_completion_task_create(on_pool_batch_script_complete, request);
+    }
+    submit_request(pool, request);
+}
+
+size_t ruby_vm_pool_get_shard_stats(RubyVMPool* pool, RubyVMPoolShardStats* out_stats, size_t capacity) {
+    if (out_stats && capacity > 0) {
+        pthread_mutex_lock(&pool->lock);
+        memcpy(out_stats, pool->shards, (capacity < RUBY_VM_POOL_SHARD_COUNT ? capacity : RUBY_VM_POOL_SHARD_COUNT) *
+                                        sizeof(RubyVMPoolShardStats));
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return RUBY_VM_POOL_SHARD_COUNT;
+}
+
+int ruby_vm_pool_eval_sync(RubyVMPool* pool, const char* source, size_t length, RubyEvalResult* out_result) {
+    RubyVMPoolWorker* worker = acquire_least_busy_worker(pool);
+    const int result = ruby_vm_eval_sync(worker->vm, source, length, out_result);
+    // Counted like any other request: the worker may take a queued one now
+    complete_request(pool, worker, POOL_NO_SHARD);
+    return result;
+}
+
+RubyPreparedScript* ruby_vm_pool_prepare(RubyVMPool* pool, RubyScript* script) {
+    RubyVMPoolWorker* worker = acquire_least_busy_worker(pool);
+    RubyPreparedScript* prepared = ruby_script_prepare(worker->vm, script);
+    complete_request(pool, worker, POOL_NO_SHARD);
+    return prepared;
+}
@@ -0,0 +1,159 @@
+#ifndef RUBY_VM_POOL_H
+#define RUBY_VM_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "log-listener.h"
+#include "completion-task.h"
+#include "ruby-sync-eval.h"
+#include "ruby-prepared-script.h"
+#include "ruby-zygote.h"
+#include "ruby-vm-pool-stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct RubyVM;
+struct RubyScript;
+
+typedef struct RubyVM RubyVM;
+typedef struct RubyScript RubyScript;
+
+struct PoolRequest;
+struct RubyVMPool;
+
+typedef struct {
+    struct PoolRequest* head;   // Oldest first
+    struct PoolRequest* tail;
+} RubyVMPoolQueue;
+
+typedef struct {
+    struct RubyVMPool* pool;
+    RubyVM* vm;
+    size_t outstanding;         // Requests sent and not completed yet
+    RubyVMPoolQueue sharded;    // Requests of the shards of this worker, waiting for it
+    int stopped;                // Its process exited: no more requests, its shards moved to the other workers
+} RubyVMPoolWorker;
+
+/**
+ * Several VMs, each one a worker process forked by the same zygote, behind a single enqueue.
+ *
+ * Only one Ruby VM can live in a process and the GVL runs one script at a time: a pool of N workers
+ * runs up to N scripts at once, one per core. Workers pull their work: a script is sent to an idle
+ * worker, or waits in the queue of the pool until a worker replies and takes it, so a short script
+ * never waits behind a long one while another worker is free. Each worker holds VM_POOL_WORKER_WINDOW
+ * requests at most, and gets the oldest queued request as soon as its reply to one of them is read.
+ * Scripts enqueued on a pool start in order, but do not wait for each other: only the order of those
+ * sent to the same worker is kept. A batch goes to a single worker and keeps its order.
+ * A request with a deadline, a synchronous evaluation and a prepared script are sent right away to
+ * the worker with the fewest outstanding requests: they need it to be cancelled or to run at once.
+ * The invocations of a prepared script run in the worker it was compiled in and are not counted.
+ *
+ * A request with a shard key always goes to the worker serving its shard, so that the state a script
+ * keeps in Ruby globals for a key is found by the next scripts of that key, run in enqueue order.
+ * Keys are hashed into RUBY_VM_POOL_SHARD_COUNT shards, each one given to a worker by rendezvous
+ * hashing. The worker takes the requests of its shards and those of the pool queue oldest first.
+ * When a worker process exits, its requests in flight fail, and only its shards move to the other
+ * workers, queued requests included: the other keys keep their worker and their state.
+ */
+typedef struct RubyVMPool {
+    RubyVMPoolWorker* workers;
+    size_t size;
+    size_t next;                    // First worker looked at by the next request, spreads the ties
+    RubyVMPoolQueue queue;          // Requests waiting for any worker
+    uint64_t next_sequence;         // Orders the requests of the pool queue with those of the shards
+    size_t stopped_workers;
+    RubyVMPoolShardStats shards[RUBY_VM_POOL_SHARD_COUNT];
+    int closed;
+    pthread_mutex_t lock;           // Guards the queues, the outstanding counts and the shards
+} RubyVMPool;
+
+/**
+ * @return Number of cores online, between 1 and VM_POOL_MAX_WORKERS
+ */
+size_t ruby_vm_pool_default_size(void);
+
+/**
+ * Create and start 'size' VMs forked by 'zygote'. Returns without waiting for the zygote to boot:
+ * the first scripts wait for their worker in its commands channel.
+ *
+ * @param size Number of workers, 0 for ruby_vm_pool_default_size()
+ * @param zygote Zygote forking the workers, must outlive the pool
+ * @param application_path Path to the application directory
+ * @param ruby_base_directory Path to the Ruby base directory
+ * @param native_libs_location Path to the native libraries location
+ * @param listener Log listener of the workers
+ * @return The pool, NULL if a worker could not be started
+ */
+RubyVMPool* ruby_vm_pool_create(size_t size, RubyZygote* zygote, const char* application_path,
+                                const char* ruby_base_directory, const char* native_libs_location, LogListener listener);
+
+/**
+ * Destroy every worker VM, their pending scripts and those of the queue complete with an error
+ */
+void ruby_vm_pool_destroy(RubyVMPool* pool);
+
+/**
+ * Same as ruby_vm_enqueue_with_flags, on the next idle worker
+ */
+void ruby_vm_pool_enqueue(RubyVMPool* pool, RubyScript* script, uint32_t flags, RubyCompletionTask on_complete);
+
+/**
+ * Same as ruby_vm_enqueue_with_deadline, on the least busy worker. The request id also tells the worker,
+ * only ruby_vm_pool_cancel understands it.
+ */
+uint64_t ruby_vm_pool_enqueue_with_deadline(RubyVMPool* pool, RubyScript* script, uint32_t timeout_ms, RubyCompletionTask on_complete);
+
+/**
+ * Same as ruby_vm_enqueue, on the worker serving the shard of 'shard_key', after the scripts of
+ * the same key enqueued before
+ */
+void ruby_vm_pool_enqueue_sharded(RubyVMPool* pool, uint64_t shard_key, RubyScript* script, RubyCompletionTask on_complete);
+
+/**
+ * Same as ruby_vm_enqueue_with_result, on the worker serving the shard of 'shard_key'
+ */
+void ruby_vm_pool_enqueue_sharded_with_result(RubyVMPool* pool, uint64_t shard_key, RubyScript* script, RubyResultTask on_result);
+
+/**
+ * Read the worker, queue depth and request count of every shard, to spot the hot keys
+ *
+ * @param out_stats Receives up to 'capacity' shards, in shard order
+ * @return RUBY_VM_POOL_SHARD_COUNT
+ */
+size_t ruby_vm_pool_get_shard_stats(RubyVMPool* pool, RubyVMPoolShardStats* out_stats, size_t capacity);
+
+/**
+ * Same as ruby_vm_cancel, for a request id returned by ruby_vm_pool_enqueue_with_deadline.
+ * Like a deadline passing, cancelling a script already sent kills its worker: the pool goes on with the others.
+ */
+int ruby_vm_pool_cancel(RubyVMPool* pool, uint64_t request_id);
+
+/**
+ * Same as ruby_vm_enqueue_with_result_and_flags, on the next idle worker
+ */
+void ruby_vm_pool_enqueue_with_result(RubyVMPool* pool, RubyScript* script, uint32_t flags, RubyResultTask on_result);
+
+/**
+ * Same as ruby_vm_enqueue_batch, the whole batch on the next idle worker
+ */
+void ruby_vm_pool_enqueue_batch(RubyVMPool* pool, RubyScript** scripts, size_t count, RubyCompletionTask* on_complete);
+
+/**
+ * Same as ruby_vm_eval_sync, on the least busy worker
+ */
+int ruby_vm_pool_eval_sync(RubyVMPool* pool, const char* source, size_t length, RubyEvalResult* out_result);
+
+/**
+ * Same as ruby_script_prepare, on the least busy worker
+ */
+RubyPreparedScript* ruby_vm_pool_prepare(RubyVMPool* pool, RubyScript* script);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_VM_POOL_H
@@ -1,9 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include <unistd.h>
+#include <errno.h>
+#include <signal.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "constants.h"
 
@@ -11,6 +16,8 @@
 #include "ruby-script-location.h"
 #include "ruby-script.h"
 #include "ruby-vm.h"
+#include "ruby-wire-protocol.h"
+#include "ruby-cancellation.h"
 #include "exec-main-vm.h"
 #include "debug.h"
 
@@ -24,15 +31,22 @@ typedef struct {
 } RubyVMStartArgs;
 
 /**
- * Helper structure for thread communication
+ * Have the zygote fork the worker serving the commands channel, then leave it the worker side of the channel.
+ * Until the worker is there, scripts wait in the socket buffer; if it never comes, the channel closes
+ * and they fail like with a VM that stopped.
  */
-typedef struct {
-    RubyVM* vm;
-    RubyScript* script;
-    RubyCompletionTask on_complete;
-} RubyScriptEnqueueArgs;
-
+static void spawn_zygote_worker(RubyVM* vm) {
+    pid_t pid = 0;
+    if (ruby_zygote_spawn_worker(vm->zygote, vm->commands_channel.second_fd, &pid) != 0) {
+        fprintf(stderr, "Failed to get a worker from the zygote\n");
+    } else {
+        __atomic_store_n(&vm->worker_pid, pid, __ATOMIC_RELEASE);
+    }
 
+    // The worker holds its own copy: once it exits, the reply reader sees the channel close
+    close(vm->commands_channel.second_fd);
+    vm->commands_channel.second_fd = -1;
+}
 
 /**
  * Main thread function for the Ruby VM
@@ -44,17 +58,39 @@ static void* main_thread_func(void* arg) {
     RubyVMStartArgs* args = (RubyVMStartArgs*)arg;
     RubyVM* vm = args->vm;
 
+    if (vm->zygote) {
+        spawn_zygote_worker(vm);
+        free(args->native_libs_location);
+        free(args->ruby_base_directory);
+        free(args);
+        return NULL;
+    }
+    ruby_startup_profile_end(RUBY_STARTUP_THREAD_START);
+
+    const ExecMainOptions options = {
+        .embedded_stdlib = vm->embedded_stdlib,
+        .compile_cache_capacity = vm->compile_cache_capacity,
+        .preload_profile_seconds = vm->preload_profile_seconds,
+        .preload_profile_scripts = vm->preload_profile_scripts,
+        .ractor_lane_size = vm->ractor_lane_size,
+        .io_pool_size = vm->io_pool_size
+    };
     const int exitCode = ExecMainRubyVM(
         ruby_script_get_content(vm->main_script),
         vm->commands_channel.second_fd,
         args->ruby_base_directory,
-        args->native_libs_location
+        args->native_libs_location,
+        &options
     );
 
     if (exitCode != 0) {
         fprintf(stderr, "Error during VM execution: %d", exitCode);
     }
 
+    // Nothing can serve synchronous evaluations nor cancellations anymore
+    ruby_sync_eval_close();
+    ruby_cancellation_close();
+
     free(args->native_libs_location);
     free(args->ruby_base_directory);
     free(args);
@@ -62,80 +98,569 @@ static void* main_thread_func(void* arg) {
 }
 
 /**
- * Cleanup function - ALWAYS called on thread exit
+ * Send a script to the Ruby VM as a single frame
+ *
+ * @param socket_fd Socket file descriptor
+ * @param request_id Identifier echoed back by the VM in the matching reply
+ * @param script Script to send
+ * @param flags RUBY_WIRE_FLAG_RESULT to get the value of the script back, RUBY_WIRE_FLAG_NONE otherwise
+ * @param stream Stream of a RUBY_WIRE_FLAG_IO script, 0 otherwise
+ * @return 0 on success, negative on error
  */
-static void cleanup_script_args(void* arg) {
-    RubyScriptEnqueueArgs* args = (RubyScriptEnqueueArgs*)arg;
-    free(args);
+static int send_script_to_ruby(int socket_fd, uint64_t request_id, RubyScript* script, uint16_t flags, uint32_t stream) {
+    const size_t script_length = ruby_script_get_length(script);
+
+    RubyWireHeader header;
+    ruby_wire_header_init(&header, request_id, flags, script_length);
+    header.aux = stream;
+    header.content_hash = ruby_script_get_content_hash(script);
+
+    struct iovec payload = {
+            .iov_base = (void*) ruby_script_get_content(script),
+            .iov_len = script_length
+    };
+
+    // Header and content leave in a single writev()
+    if (ruby_wire_write_frame(socket_fd, &header, &payload, 1) != 0) {
+        perror("Failed to write script frame");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Send a script already copied into the payload ring: only its location goes through the socket
+ *
+ * @param socket_fd Socket file descriptor
+ * @param request_id Identifier echoed back by the VM in the matching reply
+ * @param slot Location of the script in the ring
+ * @param content_hash Content hash of the script
+ * @param flags Additional flags, see send_script_to_ruby
+ * @return 0 on success, negative on error
+ */
+static int send_ring_script_to_ruby(int socket_fd, uint64_t request_id, const RubyPayloadRingSlot* slot, uint64_t content_hash, uint16_t flags) {
+    unsigned char descriptor[16];
+    ruby_wire_encode_u64(descriptor, slot->position);
+    ruby_wire_encode_u64(descriptor + 8, slot->length);
+
+    RubyWireHeader header;
+    ruby_wire_header_init(&header, request_id, RUBY_WIRE_FLAG_RING | flags, sizeof(descriptor));
+    header.content_hash = content_hash;
+
+    struct iovec payload = {
+            .iov_base = descriptor,
+            .iov_len = sizeof(descriptor)
+    };
+    if (ruby_wire_write_frame(socket_fd, &header, &payload, 1) != 0) {
+        perror("Failed to write ring script frame");
+        return -1;
+    }
+    return 0;
+}
+
+static void on_payload_ring_attached(void* user_data, int result) {
+    RubyVM* vm = (RubyVM*)user_data;
+    if (result != 0) {
+        DEBUG_LOG("Payload ring rejected by the Ruby side (status %d), scripts stay inline", result);
+        return;
+    }
+    __atomic_store_n(&vm->payload_ring_attached, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Hand the payload ring to the Ruby side, as the first request on the commands channel.
+ * The ring is only used once the Ruby side acknowledged it (see on_payload_ring_attached).
+ *
+ * @return 0 on success, negative on error
+ */
+static int attach_payload_ring(RubyVM* vm, uint64_t request_id) {
+    RubyDispatchItem item = {
+            .request_id = 0,
+            .script = NULL,
+            .on_complete = ruby_completion_task_create(on_payload_ring_attached, vm),
+            .on_result = ruby_result_task_create(NULL, NULL),
+            .batch = NULL,
+            .call = NULL,
+            .payload_ring_end = 0,
+            .cancelled = 0
+    };
+    if (ruby_pending_table_reserve(&vm->pending_requests, request_id, &item) != 0) {
+        return -1;
+    }
+
+    unsigned char capacity[8];
+    ruby_wire_encode_u64(capacity, vm->payload_ring.capacity);
+
+    RubyWireHeader header;
+    ruby_wire_header_init(&header, request_id, RUBY_WIRE_FLAG_RING_ATTACH, sizeof(capacity));
+    header.aux = (uint32_t)vm->payload_ring.fd;
+
+    struct iovec payload = {
+            .iov_base = capacity,
+            .iov_len = sizeof(capacity)
+    };
+    if (ruby_wire_write_frame(vm->commands_channel.main_fd, &header, &payload, 1) != 0) {
+        perror("Failed to write payload ring attach frame");
+        RubyPendingRequest request;
+        ruby_pending_table_take(&vm->pending_requests, request_id, &request);
+        return -1;
+    }
+    return 0;
 }
 
 /**
- * Send a script to the Ruby VM
+ * Try to copy a script into the payload ring
+ *
+ * @return 1 if the script is in the ring, 0 if it has to be sent inline
+ */
+static int write_script_to_ring(RubyVM* vm, RubyScript* script, RubyPayloadRingSlot* out_slot) {
+    const size_t script_length = ruby_script_get_length(script);
+    if (!vm->payload_ring_enabled || script_length < PAYLOAD_RING_MIN_SCRIPT_SIZE ||
+        !__atomic_load_n(&vm->payload_ring_attached, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    return ruby_payload_ring_write(&vm->payload_ring, ruby_script_get_content(script), script_length, out_slot) == 0;
+}
+
+/**
+ * Send a batch of scripts to the Ruby VM as a single frame
+ *
+ * The payload starts with the table of script lengths and hashes, followed by the scripts themselves:
+ * everything leaves in a single writev() without copying the script contents.
  *
  * @param socket_fd Socket file descriptor
- * @param script_content Script content to send
+ * @param request_id Identifier echoed back by the VM in the matching reply
+ * @param batch Scripts to send
  * @return 0 on success, negative on error
  */
-static int send_script_to_ruby(int socket_fd, const char* script_content) {
-    size_t script_length = strlen(script_content);
-    char length_buffer[32];
-    
-    // Send length prefix: "<length>\n"
-    int written = snprintf(length_buffer, sizeof(length_buffer), "%zu\n", script_length);
-    if (write(socket_fd, length_buffer, written) != written) {
-        perror("Failed to write length prefix");
+static int send_batch_to_ruby(int socket_fd, uint64_t request_id, const RubyDispatchBatch* batch) {
+    const size_t count = batch->count;
+    struct iovec* payload = malloc(sizeof(struct iovec) * (count + 1) + 16 * count);
+    if (!payload) {
+        fprintf(stderr, "Failed to allocate batch frame of %zu scripts\n", count);
+        return -1;
+    }
+
+    unsigned char* table = (unsigned char*)(payload + count + 1);
+    uint64_t payload_length = 16 * count;
+    for (size_t i = 0; i < count; i++) {
+        const size_t script_length = ruby_script_get_length(batch->scripts[i]);
+        ruby_wire_encode_u64(table + 16 * i, script_length);
+        ruby_wire_encode_u64(table + 16 * i + 8, ruby_script_get_content_hash(batch->scripts[i]));
+        payload[i + 1].iov_base = (void*) ruby_script_get_content(batch->scripts[i]);
+        payload[i + 1].iov_len = script_length;
+        payload_length += script_length;
+    }
+    payload[0].iov_base = table;
+    payload[0].iov_len = 16 * count;
+
+    RubyWireHeader header;
+    ruby_wire_header_init(&header, request_id, RUBY_WIRE_FLAG_BATCH, payload_length);
+    header.aux = (uint32_t)count;
+
+    const int result = ruby_wire_write_frame(socket_fd, &header, payload, (int)(count + 1));
+    free(payload);
+    if (result != 0) {
+        perror("Failed to write batch frame");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Send a call built by the host (prepared script commands) as a single frame
+ *
+ * @param socket_fd Socket file descriptor
+ * @param request_id Identifier echoed back by the VM in the matching reply
+ * @param call Call to send
+ * @param flags Additional flags, see send_script_to_ruby
+ * @return 0 on success, negative on error
+ */
+static int send_call_to_ruby(int socket_fd, uint64_t request_id, const RubyDispatchCall* call, uint16_t flags) {
+    RubyWireHeader header;
+    ruby_wire_header_init(&header, request_id, call->flags | flags, call->length);
+    header.aux = call->aux;
+
+    struct iovec payload = {
+            .iov_base = call->payload,
+            .iov_len = call->length
+    };
+    if (ruby_wire_write_frame(socket_fd, &header, &payload, call->length > 0 ? 1 : 0) != 0) {
+        perror("Failed to write call frame");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Read the per-script statuses of a batch reply and complete each script with its own status
+ *
+ * @return 0 on success, -1 if the stream broke (every script is still completed)
+ */
+static int complete_batch_from_reply(RubyWireReader* reader, const RubyWireHeader* header, RubyDispatchItem* item) {
+    RubyDispatchBatch* batch = item->batch;
+
+    if (!(header->flags & RUBY_WIRE_FLAG_BATCH) || header->payload_length != 4 * (uint64_t)batch->count) {
+        // Malformed reply: the batch outcome is only known as a whole
+        fprintf(stderr, "protocol error: unexpected reply layout for batch %" PRIu64 "\n", header->request_id);
+        const int result = header->status != 0 ? header->status : 1;
+        if (ruby_wire_reader_skip(reader, header->payload_length) != 0) {
+            ruby_dispatch_item_complete(item, 1);
+            return -1;
+        }
+        ruby_dispatch_item_complete(item, result);
+        return 0;
+    }
+
+    int stream_error = 0;
+    for (size_t i = 0; i < batch->count; i++) {
+        unsigned char encoded_status[4];
+        int status = 1;
+        if (!stream_error && ruby_wire_reader_read(reader, encoded_status, sizeof(encoded_status)) == 0) {
+            status = ruby_wire_decode_i32(encoded_status);
+        } else {
+            stream_error = 1;
+        }
+        ruby_completion_task_invoke(&batch->on_complete[i], status);
+    }
+    ruby_dispatch_batch_destroy(batch);
+    item->batch = NULL;
+    return stream_error ? -1 : 0;
+}
+
+/**
+ * Buffer receiving encoded values, reused from one reply to the next by the reply reader
+ */
+typedef struct {
+    unsigned char* data;
+    size_t capacity;
+} RubyValueBuffer;
+
+/**
+ * Read the encoded value carried by a reply, then complete the item with it
+ *
+ * @return 0 on success, -1 if the stream broke (the item is still completed)
+ */
+static int complete_value_from_reply(RubyWireReader* reader, const RubyWireHeader* header, RubyDispatchItem* item,
+                                     RubyValueBuffer* buffer) {
+    if (!(header->flags & RUBY_WIRE_FLAG_RESULT) || header->payload_length == 0) {
+        if (ruby_wire_reader_skip(reader, header->payload_length) != 0) {
+            ruby_dispatch_item_complete(item, 1);
+            return -1;
+        }
+        ruby_dispatch_item_complete(item, header->status);
+        return 0;
+    }
+
+    if (header->payload_length > buffer->capacity) {
+        unsigned char* data = header->payload_length <= SIZE_MAX ? realloc(buffer->data, (size_t)header->payload_length) : NULL;
+        if (!data) {
+            // The status is still worth delivering
+            fprintf(stderr, "Failed to allocate %" PRIu64 " bytes for the value of request %" PRIu64 "\n",
+                    header->payload_length, header->request_id);
+            if (ruby_wire_reader_skip(reader, header->payload_length) != 0) {
+                ruby_dispatch_item_complete(item, 1);
+                return -1;
+            }
+            ruby_dispatch_item_complete(item, header->status);
+            return 0;
+        }
+        buffer->data = data;
+        buffer->capacity = (size_t)header->payload_length;
+    }
+
+    if (ruby_wire_reader_read(reader, buffer->data, (size_t)header->payload_length) != 0) {
+        ruby_dispatch_item_complete(item, 1);
+        return -1;
+    }
+    ruby_dispatch_item_complete_with_value(item, header->status, buffer->data, (size_t)header->payload_length);
+    return 0;
+}
+
+static uint64_t monotonic_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Invoke the task of ruby_vm_set_stopped_task, only the first time
+static void notify_stopped(RubyVM* vm) {
+    if (__atomic_exchange_n(&vm->stopped_notified, 1, __ATOMIC_ACQ_REL) == 0) {
+        ruby_completion_task_invoke(&vm->on_stopped, 1);
+    }
+}
+
+/**
+ * Complete a request already sent to the worker of a zygote with 'status', and kill the worker.
+ * The cancellation mailbox is in this process, the worker never reads it: killing it is the only way
+ * to stop the script. Its channel then closes, failing its other in-flight requests, and the VM stops.
+ *
+ * @return 0 if the request completed with 'status', -1 if it is not in flight anymore
+ */
+
+static int cancel_zygote_request(RubyVM* vm, uint64_t request_id, int status) {
+    RubyPendingRequest request;
+    if (ruby_pending_table_take(&vm->pending_requests, request_id, &request) != 0) {
+        return -1;
+    }
+
+    const pid_t pid = __atomic_load_n(&vm->worker_pid, __ATOMIC_ACQUIRE);
+    if (pid > 0 && kill(pid, SIGKILL) != 0) {
+        perror("kill");
+    }
+    // Before completing: a worker pool would otherwise hand the next request to the dying worker
+    notify_stopped(vm);
+    ruby_dispatch_item_complete(&request.item, status);
+    return 0;
+}
+
+/**
+ * Complete a request with 'status' without running it, or have the VM interrupt it if already sent
+ *
+ * @return 0 if the request completes with 'status' (unless it finishes first), -1 if it is unknown or already completed
+ */
+static int cancel_request(RubyVM* vm, uint64_t request_id, int status) {
+    RubyDispatchItem item;
+    const int queued = ruby_dispatch_queue_cancel(&vm->dispatch_queue, request_id, status, &item);
+    if (queued > 0) {
+        ruby_dispatch_item_complete(&item, status);
+        return 0;
+    }
+    if (queued == 0) {
+        // In the dispatcher's hands, it takes care of it
+        return 0;
+    }
+
+    // Already sent: only the Ruby side can stop it, the reply then carries 'status'
+    if (vm->zygote) {
+        return cancel_zygote_request(vm, request_id, status);
+    }
+    // A Ractor has no thread of the main Ractor to raise in: the script runs to completion
+    uint16_t wire_flags;
+    if (ruby_pending_table_get_wire_flags(&vm->pending_requests, request_id, &wire_flags) != 0 ||
+        (wire_flags & RUBY_WIRE_FLAG_RACTOR)) {
         return -1;
     }
-    
-    // Send script content (no trailing newline needed)
-    if (write(socket_fd, script_content, script_length) != (ssize_t)script_length) {
-        perror("Failed to write script content");
+    if (ruby_pending_table_request_cancel(&vm->pending_requests, request_id) != 0) {
+        return -1;
+    }
+    if (ruby_cancellation_post(request_id, status) != 0) {
+        DEBUG_LOG("cancel_request: unable to post the cancellation of request %" PRIu64, request_id);
         return -1;
     }
     return 0;
 }
 
 /**
- * Script thread function for the Ruby VM
+ * Deadline thread function, started with the first request that has a deadline
+ *
+ * Sleeps until the earliest deadline and cancels the request with RUBY_VM_ERROR_TIMEOUT.
  *
  * @param arg Pointer to the Ruby VM instance
  * @return NULL
  */
-static void* script_thread_func(void* arg) {
-    RubyScriptEnqueueArgs* args = (RubyScriptEnqueueArgs*)arg;
+static void* deadline_thread_func(void* arg) {
+    RubyVM* vm = (RubyVM*)arg;
 
-    pthread_cleanup_push(cleanup_script_args, args);
+    pthread_mutex_lock(&vm->deadline_lock);
+    while (!vm->deadline_thread_stopping) {
+        const RubyDeadline* next = ruby_deadline_heap_peek(&vm->deadlines);
+        if (!next) {
+            pthread_cond_wait(&vm->deadline_changed, &vm->deadline_lock);
+            continue;
+        }
 
-    RubyVM* vm = args->vm;
-    RubyCompletionTask on_complete = args->on_complete;
-    char result = 1; // Default to error
-    const char* content = ruby_script_get_content(args->script);
+        if (next->deadline_ns > monotonic_now_ns()) {
+            const struct timespec until = {
+                    .tv_sec = (time_t)(next->deadline_ns / 1000000000ULL),
+                    .tv_nsec = (long)(next->deadline_ns % 1000000000ULL)
+            };
+            pthread_cond_timedwait(&vm->deadline_changed, &vm->deadline_lock, &until);
+            continue;
+        }
 
-    // Lock for entire transaction
-    pthread_mutex_lock(&vm->socket_lock);
+        RubyDeadline expired;
+        ruby_deadline_heap_pop(&vm->deadlines, &expired);
 
-    // Write commands as VM socket input
-    send_script_to_ruby(vm->commands_channel.main_fd, content);
+        // Completion callbacks may run: never hold the lock meanwhile
+        pthread_mutex_unlock(&vm->deadline_lock);
+        if (cancel_request(vm, expired.request_id, RUBY_VM_ERROR_TIMEOUT) == 0) {
+            DEBUG_LOG("deadline_thread_func: request %" PRIu64 " timed out", expired.request_id);
+        }
+        pthread_mutex_lock(&vm->deadline_lock);
+    }
+    pthread_mutex_unlock(&vm->deadline_lock);
+    return NULL;
+}
 
-    // Read exit code + newline as confirmation
-    char read_buffer[2] = {0};
-    ssize_t bytes_read = read(vm->commands_channel.main_fd, read_buffer, 2);
+/**
+ * Have the deadline thread cancel the request at 'deadline_ns' if still running
+ *
+ * @return 0 on success, -1 if the deadline cannot be tracked
+ */
+static int schedule_deadline(RubyVM* vm, uint64_t request_id, uint64_t deadline_ns) {
+    pthread_mutex_lock(&vm->deadline_lock);
 
-    if (bytes_read == 2 && read_buffer[1] == '\n') {
-        result = read_buffer[0] - '0';
-    } else {
-        fprintf(stderr, "protocol error: expected 2 bytes, got %zd\n", bytes_read);
+    if (!vm->deadline_thread_started && !vm->deadline_thread_stopping) {
+        if (pthread_create(&vm->deadline_thread, NULL, deadline_thread_func, vm) != 0) {
+            pthread_mutex_unlock(&vm->deadline_lock);
+            return -1;
+        }
+        vm->deadline_thread_started = 1;
+    }
+
+    int result = -1;
+    if (vm->deadline_thread_started && ruby_deadline_heap_push(&vm->deadlines, deadline_ns, request_id) == 0) {
+        // Only wake the thread up when it has to sleep less than planned
+        if (ruby_deadline_heap_peek(&vm->deadlines)->request_id == request_id) {
+            pthread_cond_signal(&vm->deadline_changed);
+        }
+        result = 0;
+    }
+
+    pthread_mutex_unlock(&vm->deadline_lock);
+    return result;
+}
+
+/**
+ * Dispatcher thread function for the Ruby VM
+ *
+ * Sole writer of 'commands_channel.main_fd': drains the dispatch queue in FIFO order
+ * and streams scripts to the VM without waiting for the previous ones to finish.
+ * Exits once the queue has been closed and emptied.
+ *
+ * @param arg Pointer to the Ruby VM instance
+ * @return NULL
+ */
+static void* dispatcher_thread_func(void* arg) {
+    RubyVM* vm = (RubyVM*)arg;
+    RubyDispatchItem item;
+
+    // Queued requests are numbered from 1 by the dispatch queue, 0 is left for the ring attachment
+    // A worker forked by a zygote cannot map the ring: its fd is only valid in this process
+    if (vm->payload_ring_enabled && !vm->zygote && attach_payload_ring(vm, 0) != 0) {
+        DEBUG_LOG("dispatcher_thread_func: unable to attach the payload ring, scripts stay inline");
     }
 
-    // Now command is executed and return code queried, let the place to the next script
-    pthread_mutex_unlock(&vm->socket_lock);
+    while (ruby_dispatch_queue_pop(&vm->dispatch_queue, &item) == 0) {
+        const uint64_t request_id = item.request_id;
+
+        // Ring payloads are released in reply order: a Ractor lane or I/O pool script, answered out of order, stays inline
+        RubyPayloadRingSlot ring_slot;
+        const int through_ring = item.script && !(item.wire_flags & (RUBY_WIRE_FLAG_RACTOR | RUBY_WIRE_FLAG_IO)) &&
+                                 write_script_to_ring(vm, item.script, &ring_slot);
+        item.payload_ring_end = through_ring ? ring_slot.end : 0;
+
+        // Register before sending: the reply may arrive before 'send' even returns
+        const int reserve_result = ruby_pending_table_reserve(&vm->pending_requests, request_id, &item);
+        const int cancel_status = ruby_dispatch_queue_hand_over(&vm->dispatch_queue);
+        if (reserve_result != 0) {
+            ruby_dispatch_item_complete(&item, 1);
+            continue;
+        }
 
-    ruby_completion_task_invoke(&on_complete, result);
+        // Cancelled while waiting for its slot: drop it, unless its payload already took ring space
+        // that only its reply can release, in which case the Ruby side skips it
+        if (cancel_status != 0) {
+            if (!through_ring) {
+                RubyPendingRequest request;
+                if (ruby_pending_table_take(&vm->pending_requests, request_id, &request) == 0) {
+                    ruby_dispatch_item_complete(&request.item, cancel_status);
+                }
+                continue;
+            }
+            if (ruby_pending_table_request_cancel(&vm->pending_requests, request_id) == 0) {
+                ruby_cancellation_post(request_id, cancel_status);
+            }
+        }
 
-    // Pop and execute cleanup handler
-    // NOTE: argument '1' means EXECUTE the cleanup
-    pthread_cleanup_pop(1);
+        // Values are only encoded by the Ruby side when someone is waiting for them
+        const uint16_t result_flag = (item.on_result.callback ? RUBY_WIRE_FLAG_RESULT : RUBY_WIRE_FLAG_NONE) | item.wire_flags;
+
+        if (!vm->zygote) {
+            ruby_startup_profile_request_sent(request_id);
+        }
+
+        int send_result;
+        if (item.batch) {
+            send_result = send_batch_to_ruby(vm->commands_channel.main_fd, request_id, item.batch);
+        } else if (item.call) {
+            send_result = send_call_to_ruby(vm->commands_channel.main_fd, request_id, item.call, result_flag);
+        } else if (through_ring) {
+            send_result = send_ring_script_to_ruby(vm->commands_channel.main_fd, request_id, &ring_slot,
+                                                   ruby_script_get_content_hash(item.script), result_flag);
+        } else {
+            send_result = send_script_to_ruby(vm->commands_channel.main_fd, request_id, item.script, result_flag, item.stream);
+        }
+        if (send_result != 0) {
+            RubyPendingRequest request;
+            if (ruby_pending_table_take(&vm->pending_requests, request_id, &request) == 0) {
+                ruby_dispatch_item_complete(&request.item, 1);
+            }
+        }
+    }
 
+    DEBUG_LOG("dispatcher_thread_func: dispatch queue closed, exiting");
+    return NULL;
+}
+
+/**
+ * Reply reader thread function for the Ruby VM
+ *
+ * Sole reader of 'commands_channel.main_fd': matches every reply frame to its pending
+ * request and invokes its completion callback with the frame status. When the VM side
+ * is closed or the stream gets corrupted, all the requests still in flight are failed.
+ *
+ * @param arg Pointer to the Ruby VM instance
+ * @return NULL
+ */
+static void* reply_reader_thread_func(void* arg) {
+    RubyVM* vm = (RubyVM*)arg;
+    RubyWireReader reader;
+    RubyWireHeader header;
+    RubyValueBuffer values = { NULL, 0 };
+
+    ruby_wire_reader_init(&reader, vm->commands_channel.main_fd);
+
+    while (ruby_wire_reader_read_header(&reader, &header) == 0) {
+        RubyPendingRequest request;
+        if (ruby_pending_table_take(&vm->pending_requests, header.request_id, &request) != 0) {
+            fprintf(stderr, "protocol error: reply for unknown request %" PRIu64 "\n", header.request_id);
+            if (ruby_wire_reader_skip(&reader, header.payload_length) != 0) break;
+            continue;
+        }
+        if (!vm->zygote) {
+            ruby_startup_profile_reply_received(header.request_id);
+        }
+
+        // Only the replies of the main lane, the only scripts sent through the ring, come in order:
+        // the Ruby side is done with every ring payload up to this one
+        if (request.item.payload_ring_end) {
+            ruby_payload_ring_release(&vm->payload_ring, request.item.payload_ring_end);
+        }
+
+        if (request.item.batch) {
+            if (complete_batch_from_reply(&reader, &header, &request.item) != 0) break;
+            continue;
+        }
+
+        if (request.item.on_result.callback) {
+            if (complete_value_from_reply(&reader, &header, &request.item, &values) != 0) break;
+            continue;
+        }
+
+        // Single script replies carry no payload, tolerate one anyway for forward compatibility
+        if (ruby_wire_reader_skip(&reader, header.payload_length) != 0) {
+            ruby_dispatch_item_complete(&request.item, 1);
+            break;
+        }
+        ruby_dispatch_item_complete(&request.item, header.status);
+    }
+
+    DEBUG_LOG("reply_reader_thread_func: commands channel closed, failing in-flight requests");
+    free(values.data);
+    notify_stopped(vm);
+    ruby_pending_table_close(&vm->pending_requests, 1);
     return NULL;
 }
 
@@ -158,7 +683,43 @@ RubyVM* ruby_vm_create(const char* application_path, RubyScript* main_script, Lo
     vm->main_script = main_script;
     vm->log_listener = listener;
     vm->vm_started = 0;
-    pthread_mutex_init(&vm->socket_lock, NULL);
+    vm->dispatcher_started = 0;
+    vm->reply_reader_started = 0;
+    vm->payload_ring_enabled = 0;
+    vm->embedded_stdlib = 0;
+    vm->compile_cache_capacity = 0;
+    vm->ractor_lane_size = 0;
+    vm->io_pool_size = 0;
+    vm->preload_profile_seconds = 0;
+    vm->preload_profile_scripts = 0;
+    vm->payload_ring_attached = 0;
+    vm->next_prepared_script_id = 0;
+    vm->deadline_thread_started = 0;
+    vm->deadline_thread_stopping = 0;
+    vm->zygote = NULL;
+    vm->worker_pid = 0;
+    vm->on_stopped = ruby_completion_task_create(NULL, NULL);
+    vm->stopped_notified = 0;
+    ruby_deadline_heap_init(&vm->deadlines);
+    if (ruby_dispatch_queue_init(&vm->dispatch_queue, DISPATCH_QUEUE_CAPACITY) != 0) {
+        free(vm->application_path);
+        free(vm);
+        return NULL;
+    }
+    if (ruby_pending_table_init(&vm->pending_requests, MAX_IN_FLIGHT_REQUESTS) != 0) {
+        ruby_dispatch_queue_destroy(&vm->dispatch_queue);
+        free(vm->application_path);
+        free(vm);
+        return NULL;
+    }
+    // Deadlines are CLOCK_MONOTONIC times, immune to wall clock changes
+    pthread_condattr_t deadline_condattr;
+    pthread_condattr_init(&deadline_condattr);
+    pthread_condattr_setclock(&deadline_condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&vm->deadline_changed, &deadline_condattr);
+    pthread_condattr_destroy(&deadline_condattr);
+    pthread_mutex_init(&vm->deadline_lock, NULL);
+
     ruby_vm_error_init(&vm->last_error);
     return vm;
 }
@@ -166,8 +727,48 @@ RubyVM* ruby_vm_create(const char* application_path, RubyScript* main_script, Lo
 void ruby_vm_destroy(RubyVM* vm) {
     if (!vm) return;
 
-    // Stop the logging thread
-    ruby_vm_disable_logging(vm);
+    // Stop the logging thread, it redirects the output of this process: not the business of a worker of a zygote
+    if (!vm->zygote) {
+        ruby_vm_disable_logging(vm);
+    }
+
+    // Stop the deadline thread first, it cancels requests through the queue and the pending table
+    pthread_mutex_lock(&vm->deadline_lock);
+    vm->deadline_thread_stopping = 1;
+    pthread_cond_signal(&vm->deadline_changed);
+    pthread_mutex_unlock(&vm->deadline_lock);
+    if (vm->deadline_thread_started) {
+        pthread_join(vm->deadline_thread, NULL);
+        vm->deadline_thread_started = 0;
+    }
+
+    // Refuse new scripts, then shut the socket down to unblock both I/O threads:
+    // in-flight and still queued scripts fail fast and their callbacks are still invoked
+    ruby_dispatch_queue_close(&vm->dispatch_queue);
+    if (!vm->zygote) {
+        ruby_sync_eval_close();
+        ruby_cancellation_close();
+    }
+    if (vm->dispatcher_started || vm->reply_reader_started) {
+        shutdown(vm->commands_channel.main_fd, SHUT_RDWR);
+    }
+    if (vm->reply_reader_started) {
+        pthread_join(vm->reply_reader_thread, NULL);
+        vm->reply_reader_started = 0;
+    }
+    ruby_pending_table_close(&vm->pending_requests, 1);
+    if (vm->dispatcher_started) {
+        pthread_join(vm->dispatcher_thread, NULL);
+        vm->dispatcher_started = 0;
+    }
+    ruby_pending_table_destroy(&vm->pending_requests);
+    ruby_dispatch_queue_destroy(&vm->dispatch_queue);
+    if (vm->payload_ring_enabled) {
+        ruby_payload_ring_destroy(&vm->payload_ring);
+    }
+    ruby_deadline_heap_destroy(&vm->deadlines);
+    pthread_cond_destroy(&vm->deadline_changed);
+    pthread_mutex_destroy(&vm->deadline_lock);
 
     // Close communication channels
     close_comm_channel(&vm->commands_channel);
@@ -190,10 +791,19 @@ int ruby_vm_start(RubyVM* vm, const char* ruby_base_directory, const char* nativ
 
     // Clear any previous errors
     ruby_vm_clear_error(vm);
+    // The startup profile, synchronous evaluations and cancellations are those of the VM of this process
+    if (!vm->zygote) {
+        ruby_startup_profile_reset();
+    }
 
     DEBUG_LOG("ruby_vm_start: Creating socket pair");
     // Create socket pair for communication
-    if (create_comm_channel(&vm->commands_channel) != 0) {
+    const uint64_t channel_start = ruby_startup_profile_now();
+    const int channel_result = create_comm_channel(&vm->commands_channel);
+    if (!vm->zygote) {
+        ruby_startup_profile_record(RUBY_STARTUP_COMM_CHANNEL, channel_start, ruby_startup_profile_now());
+    }
+    if (channel_result != 0) {
         DEBUG_LOG("ruby_vm_start: Failed to create comm channel");
         ruby_vm_error_set(&vm->last_error, RUBY_VM_ERROR_COMM_CHANNEL,
                           "Failed to create communication channel (socketpair failed)");
@@ -213,12 +823,25 @@ int ruby_vm_start(RubyVM* vm, const char* ruby_base_directory, const char* nativ
     transferredMemoryArgs->ruby_base_directory = strdup(ruby_base_directory);
     transferredMemoryArgs->native_libs_location = strdup(native_libs_location);
 
+    // Accept synchronous evaluations and cancellations: they wait until the main script starts serving them
+    if (!vm->zygote) {
+        ruby_sync_eval_open();
+        ruby_cancellation_open();
+    }
+
     // Start main thread
     // "transferredMemoryArgs" is consumed and freed by the main thread
     DEBUG_LOG("ruby_vm_start: Creating main VM thread");
+    if (!vm->zygote) {
+        ruby_startup_profile_begin(RUBY_STARTUP_THREAD_START);
+    }
     int thread_result = pthread_create(&vm->main_thread, NULL, main_thread_func, transferredMemoryArgs);
     if (thread_result != 0) {
         DEBUG_LOG("ruby_vm_start: Failed to create main VM thread");
+        if (!vm->zygote) {
+            ruby_sync_eval_close();
+            ruby_cancellation_close();
+        }
         ruby_vm_error_set(&vm->last_error, RUBY_VM_ERROR_THREAD_CREATE,
                           "Failed to create Ruby VM thread (error code: %d)", thread_result);
         free(transferredMemoryArgs->ruby_base_directory);
@@ -228,11 +851,179 @@ int ruby_vm_start(RubyVM* vm, const char* ruby_base_directory, const char* nativ
     }
     DEBUG_LOG("ruby_vm_start: Main VM thread created");
 
+    // Start the reply reader thread, sole reader of the commands channel
+    DEBUG_LOG("ruby_vm_start: Creating reply reader thread");
+    thread_result = pthread_create(&vm->reply_reader_thread, NULL, reply_reader_thread_func, vm);
+    if (thread_result != 0) {
+        DEBUG_LOG("ruby_vm_start: Failed to create reply reader thread");
+        ruby_vm_error_set(&vm->last_error, RUBY_VM_ERROR_THREAD_CREATE,
+                          "Failed to create reply reader thread (error code: %d)", thread_result);
+        return RUBY_VM_ERROR_THREAD_CREATE;
+    }
+    vm->reply_reader_started = 1;
+    DEBUG_LOG("ruby_vm_start: Reply reader thread created");
+
+    // Start the dispatcher thread, sole writer of the commands channel
+    DEBUG_LOG("ruby_vm_start: Creating dispatcher thread");
+    thread_result = pthread_create(&vm->dispatcher_thread, NULL, dispatcher_thread_func, vm);
+    if (thread_result != 0) {
+        DEBUG_LOG("ruby_vm_start: Failed to create dispatcher thread");
+        ruby_vm_error_set(&vm->last_error, RUBY_VM_ERROR_THREAD_CREATE,
+                          "Failed to create dispatcher thread (error code: %d)", thread_result);
+        return RUBY_VM_ERROR_THREAD_CREATE;
+    }
+    vm->dispatcher_started = 1;
+    DEBUG_LOG("ruby_vm_start: Dispatcher thread created");
+
     vm->vm_started = 1;
     DEBUG_LOG("ruby_vm_start: VM started successfully, returning");
     return RUBY_VM_OK;
 }
 
+int ruby_vm_enable_payload_ring(RubyVM* vm, size_t capacity) {
+    if (!vm || capacity == 0) {
+        return RUBY_VM_ERROR_INVALID_PARAM;
+    }
+
+    if (vm->vm_started || vm->payload_ring_enabled) {
+        ruby_vm_error_set(&vm->last_error, RUBY_VM_ERROR_ALREADY_STARTED,
+                          "Payload ring must be enabled once, before the VM starts");
+        return RUBY_VM_ERROR_ALREADY_STARTED;
+    }
+
+    if (ruby_payload_ring_init(&vm->payload_ring, capacity) != 0) {
+        ruby_vm_error_set(&vm->last_error, RUBY_VM_ERROR_COMM_CHANNEL,
+                          "Failed to create payload ring of %zu bytes", capacity);
+        return RUBY_VM_ERROR_COMM_CHANNEL;
+    }
+    vm->payload_ring_enabled = 1;
+    DEBUG_LOG("ruby_vm_enable_payload_ring: %zu bytes ring on fd %d", capacity, vm->payload_ring.fd);
+    return 0;
+}
+
+int ruby_vm_enable_embedded_stdlib(RubyVM* vm) {
+    if (!vm) {
+        return RUBY_VM_ERROR_INVALID_PARAM;
+    }
+
+    if (vm->vm_started) {
+        ruby_vm_error_set(&vm->last_error, RUBY_VM_ERROR_ALREADY_STARTED,
+                          "Embedded standard library must be enabled before the VM starts");
+        return RUBY_VM_ERROR_ALREADY_STARTED;
+    }
+
+    vm->embedded_stdlib = 1;
+    return 0;
+}
+
+int ruby_vm_enable_compile_cache(RubyVM* vm, size_t capacity) {
+    if (!vm) {
+        return RUBY_VM_ERROR_INVALID_PARAM;
+    }
+
+    if (vm->vm_started) {
+        ruby_vm_error_set(&vm->last_error, RUBY_VM_ERROR_ALREADY_STARTED,
+                          "Compile cache must be enabled before the VM starts");
+        return RUBY_VM_ERROR_ALREADY_STARTED;
+    }
+
+    vm->compile_cache_capacity = capacity > 0 ? capacity : COMPILE_CACHE_DEFAULT_CAPACITY;
+    return 0;
+}
+
+int ruby_vm_set_ractor_lane_size(RubyVM* vm, size_t size) {
+    if (!vm) {
+        return RUBY_VM_ERROR_INVALID_PARAM;
+    }
+
+    if (vm->vm_started) {
+        ruby_vm_error_set(&vm->last_error, RUBY_VM_ERROR_ALREADY_STARTED,
+                          "Ractor lane must be sized before the VM starts");
+        return RUBY_VM_ERROR_ALREADY_STARTED;
+    }
+
+    vm->ractor_lane_size = size;
+    return 0;
+}
+
+int ruby_vm_set_io_pool_size(RubyVM* vm, size_t size) {
+    if (!vm) {
+        return RUBY_VM_ERROR_INVALID_PARAM;
+    }
+
+    if (vm->vm_started) {
+        ruby_vm_error_set(&vm->last_error, RUBY_VM_ERROR_ALREADY_STARTED,
+                          "I/O pool must be sized before the VM starts");
+        return RUBY_VM_ERROR_ALREADY_STARTED;
+    }
+
+    vm->io_pool_size = size;
+    return 0;
+}
+
+int ruby_vm_enable_preload_profile(RubyVM* vm, uint32_t max_seconds, uint32_t max_scripts) {
+    if (!vm) {
+        return RUBY_VM_ERROR_INVALID_PARAM;
+    }
+
+    if (vm->vm_started) {
+        ruby_vm_error_set(&vm->last_error, RUBY_VM_ERROR_ALREADY_STARTED,
+                          "Preload profile must be enabled before the VM starts");
+        return RUBY_VM_ERROR_ALREADY_STARTED;
+    }
+
+    const int defaults = max_seconds == 0 && max_scripts == 0;
+    vm->preload_profile_seconds = defaults ? PRELOAD_PROFILE_DEFAULT_SECONDS : max_seconds;
+    vm->preload_profile_scripts = defaults ? PRELOAD_PROFILE_DEFAULT_SCRIPTS : max_scripts;
+    return 0;
+}
+
+void ruby_vm_set_stopped_task(RubyVM* vm, RubyCompletionTask on_stopped) {
+    if (!vm || vm->vm_started) return;
+    vm->on_stopped = on_stopped;
+}
+
+int ruby_vm_use_zygote(RubyVM* vm, RubyZygote* zygote) {
+    if (!vm || !zygote) {
+        return RUBY_VM_ERROR_INVALID_PARAM;
+    }
+
+    if (vm->vm_started) {
+        ruby_vm_error_set(&vm->last_error, RUBY_VM_ERROR_ALREADY_STARTED,
+                          "Zygote must be set before the VM starts");
+        return RUBY_VM_ERROR_ALREADY_STARTED;
+    }
+
+    vm->zygote = zygote;
+    return 0;
+}
+
+int ruby_vm_set_iseq_cache_capacity(RubyVM* vm, size_t capacity) {
+    if (!vm || vm->zygote) return -1;
+    ruby_iseq_cache_set_capacity(capacity);
+    return 0;
+}
+
+int ruby_vm_get_iseq_cache_stats(const RubyVM* vm, RubyIseqCacheStats* out_stats) {
+    if (!vm || !out_stats) return -1;
+    if (vm->zygote) {
+        memset(out_stats, 0, sizeof(*out_stats));
+        return -1;
+    }
+    ruby_iseq_cache_get_stats(out_stats);
+    return 0;
+}
+
+int ruby_vm_get_startup_profile(const RubyVM* vm, RubyStartupProfile* out_profile) {
+    if (!vm || !out_profile) return -1;
+    if (vm->zygote) {
+        memset(out_profile, 0, sizeof(*out_profile));
+        return -1;
+    }
+    ruby_startup_profile_get(out_profile);
+    return 0;
+}
+
 int ruby_vm_enable_logging(RubyVM* vm) {
 
     // Setup log reading callbacks (but don't start logging thread yet)
@@ -269,16 +1060,314 @@ int ruby_vm_disable_logging(RubyVM* vm) {
 }
 
 void ruby_vm_enqueue(RubyVM* vm, RubyScript* script, RubyCompletionTask on_complete) {
-    RubyScriptEnqueueArgs* transferredMemoryArgs = malloc(sizeof(RubyScriptEnqueueArgs));
-    transferredMemoryArgs->vm = vm;
-    transferredMemoryArgs->script = script;
-    transferredMemoryArgs->on_complete = on_complete;
-
-    pthread_t script_thread;
-    // "transferredMemoryArgs" is consumed and freed by the thread
-    // TODO: implement an Async queue instead
-    pthread_create(&script_thread, NULL, script_thread_func, transferredMemoryArgs);
-    pthread_detach(script_thread);
+    ruby_vm_enqueue_with_deadline(vm, script, 0, on_complete);
+}
+
+static uint16_t wire_flags_of(uint32_t flags) {
+    uint16_t wire_flags = RUBY_WIRE_FLAG_NONE;
+    if (flags & RUBY_ENQUEUE_RACTOR) wire_flags |= RUBY_WIRE_FLAG_RACTOR;
+    if (flags & RUBY_ENQUEUE_IO) wire_flags |= RUBY_WIRE_FLAG_IO;
+    return wire_flags;
+}
+
+// Enqueue a single script sent with 'wire_flags', completing 'on_result' when it has a callback, 'on_complete' otherwise
+static void enqueue_flagged(RubyVM* vm, RubyScript* script, uint16_t wire_flags, uint32_t stream,
+                            RubyCompletionTask on_complete, RubyResultTask on_result) {
+    RubyDispatchItem item = {
+            .request_id = 0,
+            .script = script,
+            .on_complete = on_complete,
+            .on_result = on_result,
+            .wire_flags = wire_flags,
+            .stream = stream,
+            .batch = NULL,
+            .call = NULL,
+            .payload_ring_end = 0,
+            .cancelled = 0
+    };
+
+    if (ruby_dispatch_queue_push(&vm->dispatch_queue, &item, NULL) != 0) {
+        DEBUG_LOG("enqueue_flagged: dispatch queue closed, dropping script");
+        ruby_dispatch_item_complete(&item, 1);
+    }
+}
+
+void ruby_vm_enqueue_with_flags(RubyVM* vm, RubyScript* script, uint32_t flags, RubyCompletionTask on_complete) {
+    if (flags == RUBY_ENQUEUE_DEFAULT) {
+        ruby_vm_enqueue(vm, script, on_complete);
+        return;
+    }
+
+    enqueue_flagged(vm, script, wire_flags_of(flags), 0, on_complete, ruby_result_task_create(NULL, NULL));
+}
+
+void ruby_vm_enqueue_in_stream(RubyVM* vm, uint32_t stream, RubyScript* script, RubyCompletionTask on_complete) {
+    enqueue_flagged(vm, script, RUBY_WIRE_FLAG_IO, stream, on_complete, ruby_result_task_create(NULL, NULL));
+}
+
+uint64_t ruby_vm_enqueue_with_deadline(RubyVM* vm, RubyScript* script, uint32_t timeout_ms, RubyCompletionTask on_complete) {
+    // Time spent waiting for room in the queue counts
+    const uint64_t deadline_ns = timeout_ms > 0 ? monotonic_now_ns() + (uint64_t)timeout_ms * 1000000ULL : 0;
+
+    RubyDispatchItem item = {
+            .request_id = 0,
+            .script = script,
+            .on_complete = on_complete,
+            .on_result = ruby_result_task_create(NULL, NULL),
+            .batch = NULL,
+            .call = NULL,
+            .payload_ring_end = 0,
+            .cancelled = 0
+    };
+
+    // Ownership of the script stays with the caller: it must outlive the completion callback
+    uint64_t request_id;
+    if (ruby_dispatch_queue_push(&vm->dispatch_queue, &item, &request_id) != 0) {
+        DEBUG_LOG("ruby_vm_enqueue: dispatch queue closed, dropping script");
+        ruby_completion_task_invoke(&on_complete, 1);
+        return 0;
+    }
+
+    if (deadline_ns && schedule_deadline(vm, request_id, deadline_ns) != 0) {
+        DEBUG_LOG("ruby_vm_enqueue_with_deadline: unable to track the deadline of request %" PRIu64, request_id);
+    }
+    return request_id;
+}
+
+int ruby_vm_cancel(RubyVM* vm, uint64_t request_id) {
+    if (!vm || request_id == 0) return -1;
+    return cancel_request(vm, request_id, RUBY_VM_ERROR_CANCELLED);
+}
+
+void ruby_vm_enqueue_with_result(RubyVM* vm, RubyScript* script, RubyResultTask on_result) {
+    ruby_vm_enqueue_with_result_and_flags(vm, script, RUBY_ENQUEUE_DEFAULT, on_result);
+}
+
+void ruby_vm_enqueue_with_result_and_flags(RubyVM* vm, RubyScript* script, uint32_t flags, RubyResultTask on_result) {
+    enqueue_flagged(vm, script, wire_flags_of(flags), 0, ruby_completion_task_create(NULL, NULL), on_result);
+}
+
+void ruby_vm_enqueue_in_stream_with_result(RubyVM* vm, uint32_t stream, RubyScript* script, RubyResultTask on_result) {
+    enqueue_flagged(vm, script, RUBY_WIRE_FLAG_IO, stream, ruby_completion_task_create(NULL, NULL), on_result);
+}
+
+/**
+ * Evaluation waited for by the caller of ruby_vm_eval_sync, when it goes through the commands channel
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t completed;
+    int done;
+    RubyEvalResult* result;
+} ChannelEvalContext;
+
+/**
+ * Copy the MessagePack string of a failed script (its error message) into 'message', empty for anything else
+ */
+static void decode_error_message(const unsigned char* value, size_t length, char* message, size_t message_size) {
+    size_t offset = 0;
+    uint64_t string_length = 0;
+    if (length >= 1 && (value[0] & 0xe0) == 0xa0) {
+        offset = 1;
+        string_length = value[0] & 0x1f;
+    } else if (length >= 2 && value[0] == 0xd9) {
+        offset = 2;
+        string_length = value[1];
+    } else if (length >= 3 && value[0] == 0xda) {
+        offset = 3;
+        string_length = ((uint64_t)value[1] << 8) | value[2];
+    } else if (length >= 5 && value[0] == 0xdb) {
+        offset = 5;
+        string_length = ((uint64_t)value[1] << 24) | ((uint64_t)value[2] << 16) | ((uint64_t)value[3] << 8) | value[4];
+    }
+    if (offset == 0 || string_length > length - offset) {
+        message[0] = '\0';
+        return;
+    }
+    snprintf(message, message_size, "%.*s", (int)(string_length < message_size ? string_length : message_size - 1),
+             (const char*)value + offset);
+}
+
+static void on_channel_eval_result(void* user_data, int result, const void* value, size_t length) {
+    ChannelEvalContext* context = user_data;
+    RubyEvalResult* eval_result = context->result;
+
+    if (result == 0) {
+        eval_result->status = 0;
+        eval_result->message[0] = '\0';
+    } else if (value) {
+        eval_result->status = 1;
+        decode_error_message(value, length, eval_result->message, sizeof(eval_result->message));
+    } else {
+        // No reply: the worker is gone or the VM is being destroyed
+        eval_result->status = -1;
+        snprintf(eval_result->message, sizeof(eval_result->message), "Ruby VM is not running");
+    }
+
+    pthread_mutex_lock(&context->lock);
+    context->done = 1;
+    pthread_cond_signal(&context->completed);
+    pthread_mutex_unlock(&context->lock);
+}
+
+/**
+ * ruby_vm_eval_sync for a worker of a zygote, which cannot reach the request slot of this process:
+ * the code is enqueued as a script returning its result, and the caller waits for the reply
+ */
+static int eval_through_channel(RubyVM* vm, const char* source, size_t length, RubyEvalResult* out_result) {
+    RubyScript* script = ruby_script_create_from_content(source, length);
+    if (!script) {
+        out_result->status = -1;
+        snprintf(out_result->message, sizeof(out_result->message), "Out of memory");
+        return -1;
+    }
+
+    ChannelEvalContext context = { .done = 0, .result = out_result };
+    pthread_mutex_init(&context.lock, NULL);
+    pthread_cond_init(&context.completed, NULL);
+
+    ruby_vm_enqueue_with_result(vm, script, ruby_result_task_create(on_channel_eval_result, &context));
+
+    pthread_mutex_lock(&context.lock);
+    while (!context.done) {
+        pthread_cond_wait(&context.completed, &context.lock);
+    }
+    pthread_mutex_unlock(&context.lock);
+
+    pthread_cond_destroy(&context.completed);
+    pthread_mutex_destroy(&context.lock);
+    ruby_script_destroy(script);
+    return out_result->status;
+}
+
+int ruby_vm_eval_sync(RubyVM* vm, const char* source, size_t length, RubyEvalResult* out_result) {
+    if (!out_result) return -1;
+    if (!vm || !source || !vm->vm_started) {
+        out_result->status = -1;
+        snprintf(out_result->message, sizeof(out_result->message), "Ruby VM is not running");
+        return -1;
+    }
+    if (vm->zygote) {
+        return eval_through_channel(vm, source, length, out_result);
+    }
+    return ruby_sync_eval_submit(source, length, out_result);
+}
+
+void ruby_vm_enqueue_batch(RubyVM* vm, RubyScript** scripts, size_t count, RubyCompletionTask* on_complete) {
+    if (count == 0) return;
+
+    RubyDispatchBatch* batch = (uint64_t)count <= UINT32_MAX ? ruby_dispatch_batch_create(scripts, on_complete, count) : NULL;
+    if (!batch) {
+        DEBUG_LOG("ruby_vm_enqueue_batch: unable to create a batch of %zu scripts", count);
+        for (size_t i = 0; on_complete && i < count; i++) {
+            ruby_completion_task_invoke(&on_complete[i], 1);
+        }
+        return;
+    }
+
+    RubyDispatchItem item = {
+            .request_id = 0,
+            .script = NULL,
+            .on_complete = ruby_completion_task_create(NULL, NULL),
+            .on_result = ruby_result_task_create(NULL, NULL),
+            .batch = batch,
+            .call = NULL,
+            .payload_ring_end = 0,
+            .cancelled = 0
+    };
+
+    // Same ownership rule as ruby_vm_enqueue: scripts must outlive their completion callback
+    if (ruby_dispatch_queue_push(&vm->dispatch_queue, &item, NULL) != 0) {
+        DEBUG_LOG("ruby_vm_enqueue_batch: dispatch queue closed, dropping %zu scripts", count);
+        ruby_dispatch_item_complete(&item, 1);
+    }
+}
+
+/**
+ * Queue a call frame, completing it with an error if the VM does not accept it anymore
+ *
+ * @return 0 if the call was enqueued, -1 otherwise
+ */
+static int enqueue_call(RubyVM* vm, RubyDispatchCall* call, RubyCompletionTask on_complete, RubyResultTask on_result) {
+    RubyDispatchItem item = {
+            .request_id = 0,
+            .script = NULL,
+            .on_complete = on_complete,
+            .on_result = on_result,
+            .batch = NULL,
+            .call = call,
+            .payload_ring_end = 0,
+            .cancelled = 0
+    };
+
+    if (ruby_dispatch_queue_push(&vm->dispatch_queue, &item, NULL) != 0) {
+        DEBUG_LOG("enqueue_call: dispatch queue closed, dropping call 0x%x", call->flags);
+        ruby_dispatch_item_complete(&item, 1);
+        return -1;
+    }
+    return 0;
+}
+
+RubyPreparedScript* ruby_script_prepare(RubyVM* vm, RubyScript* script) {
+    if (!vm || !script) return NULL;
+
+    RubyPreparedScript* handle = malloc(sizeof(RubyPreparedScript));
+    if (!handle) return NULL;
+    handle->vm = vm;
+    handle->id = __atomic_add_fetch(&vm->next_prepared_script_id, 1, __ATOMIC_RELAXED);
+
+    const size_t script_length = ruby_script_get_length(script);
+    RubyDispatchCall* call = ruby_dispatch_call_create(RUBY_WIRE_FLAG_PREPARE, handle->id, script_length);
+    if (!call) {
+        free(handle);
+        return NULL;
+    }
+    memcpy(call->payload, ruby_script_get_content(script), script_length);
+
+    if (enqueue_call(vm, call, ruby_completion_task_create(NULL, NULL), ruby_result_task_create(NULL, NULL)) != 0) {
+        free(handle);
+        return NULL;
+    }
+    return handle;
+}
+
+/**
+ * Enqueue an invocation completed by either 'on_complete' or, when set, 'on_result'
+ */
+static int invoke_prepared_script(RubyPreparedScript* handle, const RubyArg* args, size_t count,
+                                  RubyCompletionTask on_complete, RubyResultTask on_result) {
+    size_t payload_length;
+    RubyDispatchCall* call = NULL;
+    if (handle && ruby_args_encoded_size(args, count, &payload_length) == 0) {
+        call = ruby_dispatch_call_create(RUBY_WIRE_FLAG_INVOKE, handle->id, payload_length);
+    }
+    if (!call) {
+        DEBUG_LOG("invoke_prepared_script: invalid handle or arguments");
+        RubyDispatchItem failed = { .on_complete = on_complete, .on_result = on_result };
+        ruby_dispatch_item_complete(&failed, 1);
+        return -1;
+    }
+    ruby_args_encode(args, count, call->payload);
+
+    return enqueue_call(handle->vm, call, on_complete, on_result);
+}
+
+int ruby_vm_invoke(RubyPreparedScript* handle, const RubyArg* args, size_t count, RubyCompletionTask on_complete) {
+    return invoke_prepared_script(handle, args, count, on_complete, ruby_result_task_create(NULL, NULL));
+}
+
+int ruby_vm_invoke_with_result(RubyPreparedScript* handle, const RubyArg* args, size_t count, RubyResultTask on_result) {
+    return invoke_prepared_script(handle, args, count, ruby_completion_task_create(NULL, NULL), on_result);
+}
+
+void ruby_prepared_script_destroy(RubyPreparedScript* handle) {
+    if (!handle) return;
+
+    RubyDispatchCall* call = ruby_dispatch_call_create(RUBY_WIRE_FLAG_RELEASE, handle->id, 0);
+    if (call) {
+        enqueue_call(handle->vm, call, ruby_completion_task_create(NULL, NULL), ruby_result_task_create(NULL, NULL));
+    }
+    free(handle);
 }
 
 const RubyVMError* ruby_vm_get_last_error(const RubyVM* vm) {
@@ -2,6 +2,7 @@
 #define RUBY_VM_H
 
 #include <pthread.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -11,6 +12,15 @@ extern "C" {
 #include "log-listener.h"
 #include "completion-task.h"
 #include "ruby-vm-error.h"
+#include "ruby-dispatch-queue.h"
+#include "ruby-pending-table.h"
+#include "ruby-sync-eval.h"
+#include "ruby-payload-ring.h"
+#include "ruby-iseq-cache.h"
+#include "ruby-startup-profile.h"
+#include "ruby-prepared-script.h"
+#include "ruby-deadline-heap.h"
+#include "ruby-zygote.h"
 
 struct RubyScript;
 struct RubyScriptCurrentLocation;
@@ -25,7 +35,32 @@ struct RubyVM {
     CommChannel commands_channel;
     LogListener log_listener;
     int vm_started;
-    pthread_mutex_t socket_lock;
+    RubyDispatchQueue dispatch_queue;
+    pthread_t dispatcher_thread;
+    int dispatcher_started;
+    RubyPendingTable pending_requests;
+    pthread_t reply_reader_thread;
+    int reply_reader_started;
+    int payload_ring_enabled;
+    int payload_ring_attached;  // Set by the reply reader once the Ruby side mapped the ring
+    RubyPayloadRing payload_ring;
+    int embedded_stdlib;            // Pure Ruby standard library served from memory, see ruby_vm_enable_embedded_stdlib
+    size_t compile_cache_capacity;  // 0 when disabled, see ruby_vm_enable_compile_cache
+    uint32_t preload_profile_seconds;   // Both 0 when disabled, see ruby_vm_enable_preload_profile
+    uint32_t preload_profile_scripts;
+    uint32_t next_prepared_script_id;
+    RubyDeadlineHeap deadlines;     // Guarded by deadline_lock
+    pthread_mutex_t deadline_lock;
+    pthread_cond_t deadline_changed;
+    pthread_t deadline_thread;
+    int deadline_thread_started;    // Started with the first request that has a deadline
+    int deadline_thread_stopping;
+    RubyZygote* zygote;             // NULL when the VM runs in this process, see ruby_vm_use_zygote
+    pid_t worker_pid;               // Process serving the commands channel when forked by 'zygote', 0 until then
+    RubyCompletionTask on_stopped;  // See ruby_vm_set_stopped_task
+    int stopped_notified;           // on_stopped invoked already
+    size_t ractor_lane_size;        // 0 for one Ractor per core, see ruby_vm_set_ractor_lane_size
+    size_t io_pool_size;            // 0 for IO_POOL_DEFAULT_SIZE, see ruby_vm_set_io_pool_size
     RubyVMError last_error;
 };
 typedef struct RubyVM RubyVM;
@@ -57,6 +92,152 @@ void ruby_vm_destroy(RubyVM* vm);
  */
 int ruby_vm_start(RubyVM* vm, const char* ruby_base_directory, const char* native_libs_location);
 
+/**
+ * Send large scripts through a shared memory ring instead of the commands channel
+ *
+ * Scripts of at least PAYLOAD_RING_MIN_SCRIPT_SIZE bytes are copied once into a memfd-backed
+ * ring mapped by both sides, and only their location travels on the socket.
+ * When the ring is full, or until the Ruby side has mapped it, scripts are sent inline as usual.
+ * Must be called before ruby_vm_start.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param capacity Size of the ring in bytes, bounds the largest script that can use it
+ * @return 0 on success, negative on error (shared memory not available, VM already started)
+ */
+int ruby_vm_enable_payload_ring(RubyVM* vm, size_t capacity);
+
+/**
+ * Load the Ruby sources of the standard library straight from the embedded archive
+ *
+ * Only the native extensions and data files of the standard library are extracted to the
+ * Ruby base directory, its sources are required from memory (see ruby-vfs-loader.h).
+ * Falls back to a regular install when the embedded archive cannot be read.
+ * Must be called before ruby_vm_start.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @return 0 on success, negative on error (VM already started)
+ */
+int ruby_vm_enable_embedded_stdlib(RubyVM* vm);
+
+/**
+ * Keep the compiled Ruby sources and the load path resolution of their requires across starts
+ *
+ * Sources required from disk are compiled once into binary instruction sequences kept below
+ * the Ruby base directory, and features required by name go straight to the path they were found
+ * at as long as the load path and its directories are unchanged (see ruby-compile-cache.h).
+ * Must be called before ruby_vm_start.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param capacity Bytes the compiled sources may take on disk, 0 for COMPILE_CACHE_DEFAULT_CAPACITY
+ * @return 0 on success, negative on error (VM already started)
+ */
+int ruby_vm_enable_compile_cache(RubyVM* vm, size_t capacity);
+
+/**
+ * Set the number of Ractors running the scripts enqueued with RUBY_ENQUEUE_RACTOR
+ *
+ * The Ractors are only created with the first such script. Must be called before ruby_vm_start.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param size Number of Ractors, 0 for one per core (the default)
+ * @return 0 on success, negative on error (VM already started)
+ */
+int ruby_vm_set_ractor_lane_size(RubyVM* vm, size_t size);
+
+/**
+ * Set the number of Ruby threads running the scripts enqueued with RUBY_ENQUEUE_IO or in a stream
+ *
+ * The threads are only created with the first such script. Must be called before ruby_vm_start.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param size Number of threads, 0 for IO_POOL_DEFAULT_SIZE
+ * @return 0 on success, negative on error (VM already started)
+ */
+int ruby_vm_set_io_pool_size(RubyVM* vm, size_t size);
+
+/**
+ * Learn the features required while the application starts, and preload them on the next starts
+ *
+ * The requires made during the first 'max_seconds' or the first 'max_scripts' scripts, whichever
+ * comes first, are written below the Ruby base directory. The next start requires them again from a
+ * background Ruby thread while the first scripts are sent (see ruby-preload-profile.h), through the
+ * compile cache when it is enabled.
+ * Must be called before ruby_vm_start.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param max_seconds Recording time, 0 for no limit
+ * @param max_scripts Scripts recorded, 0 for no limit. Both 0 for PRELOAD_PROFILE_DEFAULT_SECONDS
+ *                    and PRELOAD_PROFILE_DEFAULT_SCRIPTS
+ * @return 0 on success, negative on error (VM already started)
+ */
+int ruby_vm_enable_preload_profile(RubyVM* vm, uint32_t max_seconds, uint32_t max_scripts);
+
+/**
+ * Run the VM in a worker process forked by a zygote instead of this process (see ruby-zygote.h)
+ *
+ * ruby_vm_start then asks the zygote for a worker serving the commands channel, which is ready as soon
+ * as the zygote booted: every VM using a zygote is a process of its own, and several of them can run
+ * at once. The scripts, batches, prepared scripts and results work as usual. ruby_vm_eval_sync is
+ * ordered with the enqueued scripts since it goes through the commands channel, and the payload ring
+ * is not used. ruby_vm_cancel or a deadline on a request already sent kills the worker: the request
+ * completes with the cancellation status, the other requests in flight fail and the VM stops.
+ * The features enabled by the ruby_vm_enable_* functions are those the zygote was created with.
+ * Must be called before ruby_vm_start, the zygote must outlive the VM.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param zygote Zygote forking the worker
+ * @return 0 on success, negative on error (VM already started)
+ */
+int ruby_vm_use_zygote(RubyVM* vm, RubyZygote* zygote);
+
+/**
+ * Be told when the VM stops serving: the commands channel closed, because the VM (or its worker process)
+ * exited or because it is being destroyed. The task is invoked once with 1 from the reply reader thread,
+ * before the requests in flight complete with an error, or from the thread killing the worker of a zygote
+ * (see ruby_vm_cancel), before the cancelled request completes.
+ * Must be called before ruby_vm_start.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param on_stopped Task to invoke
+ */
+void ruby_vm_set_stopped_task(RubyVM* vm, RubyCompletionTask on_stopped);
+
+/**
+ * Set the number of compiled scripts kept by the VM
+ *
+ * The VM keeps an LRU of compiled instruction sequences keyed by script content, so that a
+ * script body sent again is not lexed, parsed and compiled again. Scripts that define or may
+ * read top-level local variables always go through eval, since compiled code cannot share them.
+ * Takes effect on the next script, 0 disables the cache. Defaults to ISEQ_CACHE_DEFAULT_CAPACITY.
+ * The capacity is process-wide: the worker of a zygote keeps the one set before the zygote was created.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param capacity Maximum number of entries
+ * @return 0 on success, -1 if the VM runs in the worker of a zygote (see ruby_vm_use_zygote)
+ */
+int ruby_vm_set_iseq_cache_capacity(RubyVM* vm, size_t capacity);
+
+/**
+ * Read the compiled script cache counters, without a round trip to the VM
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param out_stats Receives the counters
+ * @return 0 on success, -1 if the VM runs in the worker of a zygote, whose counters are not shared
+ *         (the stats are then all zeros)
+ */
+int ruby_vm_get_iseq_cache_stats(const RubyVM* vm, RubyIseqCacheStats* out_stats);
+
+/**
+ * Read the timings of the VM startup phases, from ruby_vm_start to the reply of the first script
+ * (see ruby-startup-profile.h), without a round trip to the VM. Phases not reached yet are not completed.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param out_profile Receives the timings
+ * @return 0 on success, -1 if the VM runs in the worker of a zygote, which is not profiled
+ *         (every phase is then incomplete)
+ */
+int ruby_vm_get_startup_profile(const RubyVM* vm, RubyStartupProfile* out_profile);
+
 /**
  * Enable logging with stdout/stderr redirection
  *
@@ -77,12 +258,192 @@ int ruby_vm_disable_logging(RubyVM* vm);
 /**
  * Enqueue a Ruby script to be executed
  *
+ * Scripts are executed in submission order. A single dispatcher thread streams them
+ * to the VM without waiting for the previous ones to complete (up to MAX_IN_FLIGHT_REQUESTS),
+ * and a reader thread invokes each completion callback when the matching reply arrives.
+ * This call only blocks when DISPATCH_QUEUE_CAPACITY scripts are already pending.
+ * If the VM is being destroyed, the completion callback is invoked immediately with an error.
+ *
  * @param vm Pointer to the Ruby VM instance
  * @param script Ruby script to enqueue
  * @param on_complete Completion callback
  */
 void ruby_vm_enqueue(RubyVM* vm, RubyScript* script, RubyCompletionTask on_complete);
 
+/**
+ * Enqueue a Ruby script that must complete within 'timeout_ms'
+ *
+ * Same as ruby_vm_enqueue, and returns the request id to use with ruby_vm_cancel.
+ * Once the deadline passes, the script completes with RUBY_VM_ERROR_TIMEOUT: dropped without
+ * being sent if it is still queued, interrupted by the VM if it is already running (see ruby_vm_cancel).
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param script Ruby script to enqueue
+ * @param timeout_ms Time allowed from now, including the time spent queued; 0 for no deadline
+ * @param on_complete Completion callback
+ * @return Request id of the script, 0 if the VM is being destroyed (on_complete has then been called)
+ */
+uint64_t ruby_vm_enqueue_with_deadline(RubyVM* vm, RubyScript* script, uint32_t timeout_ms, RubyCompletionTask on_complete);
+
+/**
+ * Cancel a request returned by ruby_vm_enqueue_with_deadline, which then completes with RUBY_VM_ERROR_CANCELLED
+ *
+ * A request that has not been sent yet is dropped and completed right away, from the calling thread.
+ * A running script is interrupted by raising an exception in it (Thread#raise), which takes effect
+ * at its next Ruby-level instruction: a script blocked inside a native call not releasing the GVL
+ * stops once that call returns, and a script rescuing Exception can swallow the cancellation.
+ * A request that finishes before the cancellation lands completes normally.
+ * With a zygote, a request already sent is completed at once and its worker killed (see ruby_vm_use_zygote).
+ * Otherwise, a script already sent to the Ractor lane cannot be interrupted (see ruby_vm_enqueue_with_flags).
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param request_id Request to cancel
+ * @return 0 if the request is being cancelled, -1 if it is unknown, already completed or on the Ractor lane
+ */
+int ruby_vm_cancel(RubyVM* vm, uint64_t request_id);
+
+/**
+ * Enqueue a Ruby script, getting back the value it evaluates to
+ *
+ * Same as ruby_vm_enqueue, except that the Ruby side encodes the value of the script in
+ * MessagePack and the task receives it along with the exit code. nil, booleans, integers
+ * (up to 64 bits), floats, strings (binary strings as 'bin'), symbols (as strings), arrays and
+ * hashes keep their structure; any other object is encoded as its #to_s string.
+ * When the script raises, the value is its error message as a string.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param script Ruby script to enqueue
+ * @param on_result Result callback, the value is only valid during the call
+ */
+void ruby_vm_enqueue_with_result(RubyVM* vm, RubyScript* script, RubyResultTask on_result);
+
+/**
+ * Enqueue a Ruby script, choosing how it runs
+ *
+ * With RUBY_ENQUEUE_RACTOR, the script is evaluated by one of the Ractors of the VM (see
+ * ruby_vm_set_ractor_lane_size) against a fresh object, in parallel with the other scripts
+ * instead of taking turns on the GVL: it starts in order, but completes whenever it is done.
+ * It can only use shareable objects: reading a Ruby global, a constant holding a mutable object
+ * or calling a C method not marked Ractor-safe (most native extensions) completes it with
+ * RUBY_VM_ERROR_RACTOR_ISOLATION, its value being the error message. Other errors complete it with 1.
+ * A script on the lane holds its in-flight slot until it completes (see MAX_IN_FLIGHT_REQUESTS).
+ * Once sent it cannot be interrupted: ruby_vm_cancel returns -1 for it.
+ *
+ * With RUBY_ENQUEUE_IO, the script is evaluated in TOPLEVEL_BINDING by one of the threads of the I/O
+ * pool of the VM (see ruby_vm_set_io_pool_size), while the next scripts are read and started: a script
+ * blocked on a file, a pipe or a sleep releases the GVL to the others instead of holding the queue.
+ * It starts in order, but completes whenever it is done, and runs concurrently with every other script,
+ * synchronous evaluations included: shared state needs its own locking. Use ruby_vm_enqueue_in_stream
+ * for scripts that must run one after the other. A cancellation interrupts it on its thread of the pool
+ * (see ruby_vm_cancel). It holds its in-flight slot until it completes. RUBY_ENQUEUE_RACTOR takes
+ * precedence over it.
+ * Otherwise the same as ruby_vm_enqueue.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param script Ruby script to enqueue
+ * @param flags RubyEnqueueFlags
+ * @param on_complete Completion callback
+ */
+void ruby_vm_enqueue_with_flags(RubyVM* vm, RubyScript* script, uint32_t flags, RubyCompletionTask on_complete);
+
+/**
+ * Same as ruby_vm_enqueue_with_result, with the RubyEnqueueFlags of ruby_vm_enqueue_with_flags
+ */
+void ruby_vm_enqueue_with_result_and_flags(RubyVM* vm, RubyScript* script, uint32_t flags, RubyResultTask on_result);
+
+/**
+ * Enqueue a Ruby script on the I/O thread pool, after the scripts of the same stream
+ *
+ * Same as ruby_vm_enqueue_with_flags with RUBY_ENQUEUE_IO, except that the scripts of 'stream' run one
+ * after the other in enqueue order, each one starting once the previous one completed. Scripts of other
+ * streams, and those without a stream, keep running concurrently with them.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param stream Stream of the script, e.g. a connection or file id, 0 for none
+ * @param script Ruby script to enqueue
+ * @param on_complete Completion callback
+ */
+void ruby_vm_enqueue_in_stream(RubyVM* vm, uint32_t stream, RubyScript* script, RubyCompletionTask on_complete);
+
+/**
+ * Same as ruby_vm_enqueue_in_stream, getting back the value of the script as in ruby_vm_enqueue_with_result
+ */
+void ruby_vm_enqueue_in_stream_with_result(RubyVM* vm, uint32_t stream, RubyScript* script, RubyResultTask on_result);
+
+/**
+ * Evaluate Ruby code synchronously, bypassing the commands channel
+ *
+ * The code is handed to a Ruby thread of the VM through an in-memory request slot and
+ * evaluated in TOPLEVEL_BINDING, while the calling thread blocks until it is done:
+ * no serialization, no socket round trip, no callback thread.
+ * Evaluations are serialized with the enqueued scripts (never run concurrently with one),
+ * but are not ordered with them: a synchronous evaluation does not wait for the queue to drain.
+ * Concurrent callers are served one at a time. Blocks until the VM is ready if it is still starting.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param source Ruby code, does not need to be NUL-terminated
+ * @param length Length of 'source' in bytes
+ * @param out_result Receives the evaluation outcome (status and error message)
+ * @return 0 on success, 1 if the code raised an error, -1 if the VM is not running
+ */
+int ruby_vm_eval_sync(RubyVM* vm, const char* source, size_t length, RubyEvalResult* out_result);
+
+/**
+ * Enqueue several Ruby scripts at once
+ *
+ * The scripts are sent to the VM in a single frame (one vectored write), executed back
+ * to back in order, and answered by a single reply holding one status per script.
+ * The whole batch takes one slot of the dispatch queue and of the in-flight window.
+ * All the completion callbacks of a batch are invoked together, in order, from the same thread.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param scripts Array of 'count' scripts, the array itself can be released once this returns
+ * @param count Number of scripts
+ * @param on_complete Array of 'count' completion callbacks, one per script (can be NULL)
+ */
+void ruby_vm_enqueue_batch(RubyVM* vm, RubyScript** scripts, size_t count, RubyCompletionTask* on_complete);
+
+/**
+ * Compile a script once into a callable kept by the VM, to be invoked many times with ruby_vm_invoke
+ *
+ * The script must evaluate to something responding to #call, typically a lambda
+ * ("->(name, count) { ... }") or a Method ("def greet(name) ... end; method(:greet)").
+ * It is evaluated in TOPLEVEL_BINDING, in order with the enqueued scripts.
+ * If it fails to evaluate, the error is logged and every invocation completes with an error.
+ *
+ * @param vm Pointer to the Ruby VM instance
+ * @param script Script to prepare, it can be destroyed as soon as this returns
+ * @return A handle to release with ruby_prepared_script_destroy before the VM is destroyed,
+ *         or NULL on failure
+ */
+RubyPreparedScript* ruby_script_prepare(RubyVM* vm, RubyScript* script);
+
+/**
+ * Enqueue a call of a prepared script with typed arguments
+ *
+ * Arguments are sent in binary form and given to the callable as Ruby objects: changing them
+ * does not produce any new source to parse. The call is ordered with the enqueued scripts.
+ *
+ * @param handle Prepared script
+ * @param args Array of 'count' arguments, copied before this returns
+ * @param count Number of arguments
+ * @param on_complete Completion callback, invoked with 0 if the call returned, non-zero if it raised
+ * @return 0 if the call was enqueued, -1 otherwise (on_complete is invoked with an error as well)
+ */
+int ruby_vm_invoke(RubyPreparedScript* handle, const RubyArg* args, size_t count, RubyCompletionTask on_complete);
+
+/**
+ * Same as ruby_vm_invoke, the task also receives the value returned by the callable
+ * (encoded as described in ruby_vm_enqueue_with_result)
+ */
+int ruby_vm_invoke_with_result(RubyPreparedScript* handle, const RubyArg* args, size_t count, RubyResultTask on_result);
+
+/**
+ * Let the VM forget a prepared script and free its handle.
+ * Invocations already enqueued still run.
+ */
+void ruby_prepared_script_destroy(RubyPreparedScript* handle);
+
 /**
  * Get the last error that occurred in the Ruby VM
  *
@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "ruby-wire-protocol.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+static void put_u16(unsigned char* out, uint16_t value) {
+    out[0] = (unsigned char)(value);
+    out[1] = (unsigned char)(value >> 8);
+}
+
+static void put_u32(unsigned char* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static void put_u64(unsigned char* out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static uint16_t get_u16(const unsigned char* in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint32_t get_u32(const unsigned char* in) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+static uint64_t get_u64(const unsigned char* in) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+void ruby_wire_header_init(RubyWireHeader* header, uint64_t request_id, uint16_t flags, uint64_t payload_length) {
+    header->magic = RUBY_WIRE_MAGIC;
+    header->version = RUBY_WIRE_VERSION;
+    header->flags = flags;
+    header->request_id = request_id;
+    header->status = 0;
+    header->aux = 0;
+    header->payload_length = payload_length;
+    header->content_hash = 0;
+}
+
+void ruby_wire_header_encode(const RubyWireHeader* header, unsigned char out[RUBY_WIRE_HEADER_SIZE]) {
+    put_u32(out + 0, header->magic);
+    put_u16(out + 4, header->version);
+    put_u16(out + 6, header->flags);
+    put_u64(out + 8, header->request_id);
+    put_u32(out + 16, (uint32_t)header->status);
+    put_u32(out + 20, header->aux);
+    put_u64(out + 24, header->payload_length);
+    put_u64(out + 32, header->content_hash);
+}
+
+void ruby_wire_encode_u64(unsigned char out[8], uint64_t value) {
+    put_u64(out, value);
+}
+
+int32_t ruby_wire_decode_i32(const unsigned char in[4]) {
+    return (int32_t)get_u32(in);
+}
+
+int ruby_wire_header_decode(const unsigned char in[RUBY_WIRE_HEADER_SIZE], RubyWireHeader* out) {
+    out->magic = get_u32(in + 0);
+    out->version = get_u16(in + 4);
+    out->flags = get_u16(in + 6);
+    out->request_id = get_u64(in + 8);
+    out->status = (int32_t)get_u32(in + 16);
+    out->aux = get_u32(in + 20);
+    out->payload_length = get_u64(in + 24);
+    out->content_hash = get_u64(in + 32);
+
+    if (out->magic != RUBY_WIRE_MAGIC || out->version != RUBY_WIRE_VERSION) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Vectored write of every buffer, resuming after partial writes.
+ * The iovec array is consumed (modified) in place.
+ * On a socket, a peer that went away (a VM process that exited) is an error, not a SIGPIPE.
+ */
+static int writev_all(int fd, struct iovec* iov, int iov_count) {
+    int is_socket = 1;
+    while (iov_count > 0) {
+        const int batch = iov_count > IOV_MAX ? IOV_MAX : iov_count;
+        ssize_t written;
+        if (is_socket) {
+            struct msghdr message = { 0 };
+            message.msg_iov = iov;
+            message.msg_iovlen = (size_t)batch;
+            written = sendmsg(fd, &message, MSG_NOSIGNAL);
+            if (written < 0 && errno == ENOTSOCK) {
+                is_socket = 0;
+                continue;
+            }
+        } else {
+            written = writev(fd, iov, batch);
+        }
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        // Skip fully written buffers, then adjust the partially written one
+        while (iov_count > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            iov_count--;
+        }
+        if (iov_count > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+    return 0;
+}
+
+int ruby_wire_write_frame(int fd, const RubyWireHeader* header, const struct iovec* payload, int payload_count) {
+    unsigned char encoded_header[RUBY_WIRE_HEADER_SIZE];
+    ruby_wire_header_encode(header, encoded_header);
+
+    struct iovec small_iov[8];
+    struct iovec* iov = small_iov;
+    const int iov_count = payload_count + 1;
+    if (iov_count > (int)(sizeof(small_iov) / sizeof(small_iov[0]))) {
+        iov = malloc(sizeof(struct iovec) * iov_count);
+        if (!iov) return -1;
+    }
+
+    iov[0].iov_base = encoded_header;
+    iov[0].iov_len = RUBY_WIRE_HEADER_SIZE;
+    if (payload_count > 0) {
+        memcpy(iov + 1, payload, sizeof(struct iovec) * payload_count);
+    }
+
+    const int result = writev_all(fd, iov, iov_count);
+    if (iov != small_iov) {
+        free(iov);
+    }
+    return result;
+}
+
+void ruby_wire_reader_init(RubyWireReader* reader, int fd) {
+    reader->fd = fd;
+    reader->start = 0;
+    reader->end = 0;
+}
+
+/**
+ * Refill the internal buffer (only called once it has been fully consumed)
+ */
+static int fill_buffer(RubyWireReader* reader) {
+    for (;;) {
+        ssize_t bytes_read = read(reader->fd, reader->buffer, sizeof(reader->buffer));
+        if (bytes_read < 0 && errno == EINTR) continue;
+        if (bytes_read <= 0) return -1;
+        reader->start = 0;
+        reader->end = (size_t)bytes_read;
+        return 0;
+    }
+}
+
+int ruby_wire_reader_read(RubyWireReader* reader, void* out, size_t size) {
+    unsigned char* dest = out;
+
+    while (size > 0) {
+        if (reader->start == reader->end) {
+            // Large reads bypass the buffer entirely
+            if (size >= sizeof(reader->buffer)) {
+                ssize_t bytes_read = read(reader->fd, dest, size);
+                if (bytes_read < 0 && errno == EINTR) continue;
+                if (bytes_read <= 0) return -1;
+                dest += bytes_read;
+                size -= (size_t)bytes_read;
+                continue;
+            }
+            if (fill_buffer(reader) != 0) return -1;
+        }
+
+        size_t available = reader->end - reader->start;
+        size_t chunk = available < size ? available : size;
+        memcpy(dest, reader->buffer + reader->start, chunk);
+        reader->start += chunk;
+        dest += chunk;
+        size -= chunk;
+    }
+    return 0;
+}
+
+int ruby_wire_reader_read_header(RubyWireReader* reader, RubyWireHeader* out) {
+    unsigned char encoded_header[RUBY_WIRE_HEADER_SIZE];
+    if (ruby_wire_reader_read(reader, encoded_header, sizeof(encoded_header)) != 0) {
+        return -1;
+    }
+    return ruby_wire_header_decode(encoded_header, out);
+}
+
+int ruby_wire_reader_skip(RubyWireReader* reader, uint64_t size) {
+    unsigned char discard[256];
+    while (size > 0) {
+        size_t chunk = size < sizeof(discard) ? (size_t)size : sizeof(discard);
+        if (ruby_wire_reader_read(reader, discard, chunk) != 0) return -1;
+        size -= chunk;
+    }
+    return 0;
+}
@@ -0,0 +1,158 @@
+#ifndef RUBY_WIRE_PROTOCOL_H
+#define RUBY_WIRE_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Binary framing used on the commands channel, in both directions.
+ *
+ * Every frame is a fixed size little-endian header followed by 'payload_length' bytes:
+ *
+ *   offset  size  field
+ *        0     4  magic           "RBVM"
+ *        4     2  version         RUBY_WIRE_VERSION
+ *        6     2  flags           RUBY_WIRE_FLAG_*
+ *        8     8  request_id      echoed back in the reply
+ *       16     4  status          signed, meaningful in replies only
+ *       20     4  aux             frame specific argument, 0 when unused
+ *       24     8  payload_length
+ *       32     8  content_hash    ruby_content_hash() of the script for single script requests, 0 otherwise
+ *
+ * The Ruby side mirrors this layout in fifo_interpreter.rb, keep both in sync.
+ */
+#define RUBY_WIRE_MAGIC 0x4D564252u /* "RBVM" once encoded in little-endian */
+#define RUBY_WIRE_VERSION 2
+#define RUBY_WIRE_HEADER_SIZE 40
+
+/**
+ * Frame flags
+ *
+ * RUBY_WIRE_FLAG_BATCH: 'aux' holds the number of scripts N.
+ *   Request payload: N (u64 script length, u64 content hash) pairs, then the N scripts back to back.
+ *   Reply payload: N i32 statuses, in submission order. The reply status is 0 only if all of them are 0.
+ *
+ * RUBY_WIRE_FLAG_RING: the script is stored in the payload ring (see ruby-payload-ring.h).
+ *   Request payload: u64 position in the ring mapping, u64 script length.
+ *
+ * RUBY_WIRE_FLAG_RING_ATTACH: 'aux' holds the memfd of the payload ring.
+ *   Request payload: u64 ring capacity. Reply status: 0 once mapped, non-zero if the ring cannot be used.
+ *
+ * RUBY_WIRE_FLAG_PREPARE: 'aux' holds a prepared script id chosen by the host.
+ *   Request payload: a script evaluating to a callable, kept by the VM under that id.
+ *
+ * RUBY_WIRE_FLAG_INVOKE: 'aux' holds a prepared script id.
+ *   Request payload: the arguments of the call, encoded by ruby_args_encode (see ruby-prepared-script.h).
+ *
+ * RUBY_WIRE_FLAG_RELEASE: 'aux' holds a prepared script id the VM can forget. No payload.
+ *
+ * RUBY_WIRE_FLAG_RESULT: combined with a single script, ring or invoke request, asks for the value
+ *   returned by the script. The reply then carries the same flag and its payload is the MessagePack
+ *   encoding of that value, or of the error message as a string when the status is not 0.
+ *
+ * RUBY_WIRE_FLAG_RACTOR: combined with a single script request, runs it on the Ractor lane of the VM,
+ *   in parallel with the other scripts. Its reply may come before those of the requests sent earlier;
+ *   the status is RUBY_VM_ERROR_RACTOR_ISOLATION when the script touched a non-shareable object.
+ *
+ * RUBY_WIRE_FLAG_IO: combined with a single script request, runs it on the I/O thread pool of the VM,
+ *   concurrently with the other scripts. 'aux' holds its stream, 0 for none: the scripts of a stream run
+ *   one after the other, in request order. Its reply may come before those of the requests sent earlier.
+ */
+#define RUBY_WIRE_FLAG_NONE 0x0000
+#define RUBY_WIRE_FLAG_BATCH 0x0001
+#define RUBY_WIRE_FLAG_RING 0x0002
+#define RUBY_WIRE_FLAG_RING_ATTACH 0x0004
+#define RUBY_WIRE_FLAG_PREPARE 0x0008
+#define RUBY_WIRE_FLAG_INVOKE 0x0010
+#define RUBY_WIRE_FLAG_RELEASE 0x0020
+#define RUBY_WIRE_FLAG_RESULT 0x0040
+#define RUBY_WIRE_FLAG_RACTOR 0x0080
+#define RUBY_WIRE_FLAG_IO 0x0100
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint64_t request_id;
+    int32_t status;
+    uint32_t aux;
+    uint64_t payload_length;
+    uint64_t content_hash;
+} RubyWireHeader;
+
+/**
+ * Initialize a header with the current magic and version, status, aux and content_hash set to 0
+ */
+void ruby_wire_header_init(RubyWireHeader* header, uint64_t request_id, uint16_t flags, uint64_t payload_length);
+
+/**
+ * Serialize a header into its little-endian wire representation
+ */
+void ruby_wire_header_encode(const RubyWireHeader* header, unsigned char out[RUBY_WIRE_HEADER_SIZE]);
+
+/**
+ * Parse a header from its wire representation
+ *
+ * @return 0 on success, -1 if the magic or version does not match
+ */
+int ruby_wire_header_decode(const unsigned char in[RUBY_WIRE_HEADER_SIZE], RubyWireHeader* out);
+
+/**
+ * Little-endian helpers for frame payloads
+ */
+void ruby_wire_encode_u64(unsigned char out[8], uint64_t value);
+int32_t ruby_wire_decode_i32(const unsigned char in[4]);
+
+/**
+ * Write a whole frame (header + payload buffers) with vectored writes.
+ * Partial writes and interruptions are retried until everything is sent.
+ *
+ * @param payload Payload buffers, sent back to back (can be NULL if payload_count is 0)
+ * @return 0 on success, -1 on error
+ */
+int ruby_wire_write_frame(int fd, const RubyWireHeader* header, const struct iovec* payload, int payload_count);
+
+/**
+ * Buffered reader over a stream socket, so that small frames don't cost a syscall each
+ */
+typedef struct {
+    int fd;
+    size_t start;
+    size_t end;
+    unsigned char buffer[4096];
+} RubyWireReader;
+
+void ruby_wire_reader_init(RubyWireReader* reader, int fd);
+
+/**
+ * Read exactly 'size' bytes
+ *
+ * @return 0 on success, -1 on error or end of stream
+ */
+int ruby_wire_reader_read(RubyWireReader* reader, void* out, size_t size);
+
+/**
+ * Read and decode the next frame header
+ *
+ * @return 0 on success, -1 on error, end of stream or invalid header
+ */
+int ruby_wire_reader_read_header(RubyWireReader* reader, RubyWireHeader* out);
+
+/**
+ * Discard 'size' bytes (e.g. the payload of a frame that is not understood)
+ *
+ * @return 0 on success, -1 on error or end of stream
+ */
+int ruby_wire_reader_skip(RubyWireReader* reader, uint64_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_WIRE_PROTOCOL_H
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "ruby-zygote.h"
+#include "ruby-script.h"
+#include "debug.h"
+
+#pragma GCC diagnostic push
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#else
+#ifdef __clang__
+#pragma clang diagnostic ignored "-Wdefault-const-init-field-unsafe"
+#pragma clang diagnostic ignored "-Wunused-parameter"
+#endif
+#endif
+#include "ruby/ruby.h"
+#include "ruby/thread.h"
+#pragma GCC diagnostic pop
+
+// Worker request: these bytes, with the commands channel attached (SCM_RIGHTS)
+static const char ZYGOTE_REQUEST[4] = { 'F', 'O', 'R', 'K' };
+
+// Worker reply: status then pid, both int32 in host order, the zygote runs on the same machine
+#define ZYGOTE_REPLY_SIZE 8
+
+// Zygote side, its end of the control socket
+static int g_control_fd = -1;
+
+// Where the zygote finds its end of the control socket, every descriptor above it is closed by the fork
+#define ZYGOTE_CONTROL_FD 3
+
+typedef struct {
+    int fd;
+    int result;     // 0 when a request was received, 1 if interrupted, -1 once the host closed the socket
+} ReceiveWorkerArgs;
+
+static int write_all(int fd, const void* data, size_t length) {
+    const char* bytes = data;
+    while (length > 0) {
+        const ssize_t written = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void* data, size_t length) {
+    char* bytes = data;
+    while (length > 0) {
+        const ssize_t received = recv(fd, bytes, length, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return -1;
+        bytes += received;
+        length -= (size_t)received;
+    }
+    return 0;
+}
+
+// Threads of this process, 0 if unknown
+static int count_threads(void) {
+    FILE* status = fopen("/proc/self/status", "re");
+    if (!status) return 0;
+    char line[128];
+    int threads = 0;
+    while (fgets(line, sizeof(line), status)) {
+        if (sscanf(line, "Threads: %d", &threads) == 1) break;
+    }
+    fclose(status);
+    return threads;
+}
+
+// Forked child: keep stdio and 'control_fd', moved to ZYGOTE_CONTROL_FD, close everything else inherited from the host.
+// Only async-signal-safe calls, the host may have other threads
+static void keep_only_control_fd(int control_fd) {
+    if (control_fd != ZYGOTE_CONTROL_FD) {
+        dup2(control_fd, ZYGOTE_CONTROL_FD);
+    }
+    fcntl(ZYGOTE_CONTROL_FD, F_SETFD, 0);
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, ZYGOTE_CONTROL_FD + 1, ~0U, 0) == 0) return;
+#endif
+    // Kernels before 5.9
+    const long max_fd = sysconf(_SC_OPEN_MAX);
+    for (long fd = ZYGOTE_CONTROL_FD + 1; fd < max_fd; fd++) {
+        close((int)fd);
+    }
+}
+
+RubyZygote* ruby_zygote_create(RubyScript* main_script, const char* ruby_base_directory, const char* native_libs_location,
+                               const ExecMainOptions* options, const char** preload_requires, size_t count) {
+    if (!main_script || !ruby_base_directory || !native_libs_location || !options) return NULL;
+
+    RubyZygote* zygote = malloc(sizeof(RubyZygote));
+    if (!zygote) return NULL;
+
+    int control[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, control) != 0) {
+        perror("Failed to create the zygote control socket");
+        free(zygote);
+        return NULL;
+    }
+
+    const int threads = count_threads();
+    if (threads > 1) {
+        fprintf(stderr, "ruby_zygote_create: forking a host running %d threads, locks they hold stay locked in the zygote\n",
+                threads);
+    }
+
+    // Pending output would otherwise be written by both processes
+    fflush(NULL);
+
+    const pid_t pid = fork();
+    if (pid < 0) {
+        perror("Failed to fork the zygote");
+        close(control[0]);
+        close(control[1]);
+        free(zygote);
+        return NULL;
+    }
+
+    if (pid == 0) {
+        // Zygote, then each worker once its main script returns: never go back to the host code
+        keep_only_control_fd(control[1]);
+        ExecMainOptions zygote_options = *options;
+        zygote_options.zygote = 1;
+        zygote_options.zygote_preload = preload_requires;
+        zygote_options.zygote_preload_count = preload_requires ? count : 0;
+        const int result = ExecMainRubyVM(ruby_script_get_content(main_script), ZYGOTE_CONTROL_FD,
+                                          ruby_base_directory, native_libs_location, &zygote_options);
+        fflush(NULL);
+        _exit(result == 0 ? 0 : 1);
+    }
+
+    close(control[1]);
+    zygote->pid = pid;
+    zygote->control_fd = control[0];
+    zygote->main_script = main_script;
+    pthread_mutex_init(&zygote->lock, NULL);
+    DEBUG_LOG("ruby_zygote_create: zygote %d booting", (int)pid);
+    return zygote;
+}
+
+int ruby_zygote_spawn_worker(RubyZygote* zygote, int commands_fd, pid_t* out_pid) {
+    if (!zygote || commands_fd < 0) return -1;
+
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct iovec request = { (void*) ZYGOTE_REQUEST, sizeof(ZYGOTE_REQUEST) };
+    struct msghdr message = { 0 };
+    message.msg_iov = &request;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr* rights = CMSG_FIRSTHDR(&message);
+    rights->cmsg_level = SOL_SOCKET;
+    rights->cmsg_type = SCM_RIGHTS;
+    rights->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(rights), &commands_fd, sizeof(int));
+
+    int32_t reply[2] = { -1, 0 };
+    pthread_mutex_lock(&zygote->lock);
+    ssize_t sent;
+    do {
+        sent = sendmsg(zygote->control_fd, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    const int result = sent == (ssize_t)sizeof(ZYGOTE_REQUEST) && read_all(zygote->control_fd, reply, ZYGOTE_REPLY_SIZE) == 0 &&
+                       reply[0] == 0 ? 0 : -1;
+    pthread_mutex_unlock(&zygote->lock);
+
+    if (result != 0) {
+        DEBUG_LOG("ruby_zygote_spawn_worker: zygote %d did not fork a worker", (int)zygote->pid);
+        return -1;
+    }
+    DEBUG_LOG("ruby_zygote_spawn_worker: worker %d forked", (int)reply[1]);
+    if (out_pid) {
+        *out_pid = (pid_t)reply[1];
+    }
+    return 0;
+}
+
+void ruby_zygote_destroy(RubyZygote* zygote) {
+    if (!zygote) return;
+
+    close(zygote->control_fd);
+    while (waitpid(zygote->pid, NULL, 0) < 0 && errno == EINTR) {
+    }
+    pthread_mutex_destroy(&zygote->lock);
+    ruby_script_destroy(zygote->main_script);
+    free(zygote);
+}
+
+static void* receive_worker_without_gvl(void* arg) {
+    ReceiveWorkerArgs* args = (ReceiveWorkerArgs*)arg;
+    char request[sizeof(ZYGOTE_REQUEST)];
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    struct iovec iov = { request, sizeof(request) };
+    struct msghdr message = { 0 };
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    const ssize_t received = recvmsg(g_control_fd, &message, 0);
+    if (received < 0 && errno == EINTR) {
+        args->result = 1;
+        return NULL;
+    }
+
+    struct cmsghdr* rights = received == (ssize_t)sizeof(request) ? CMSG_FIRSTHDR(&message) : NULL;
+    if (!rights || rights->cmsg_level != SOL_SOCKET || rights->cmsg_type != SCM_RIGHTS ||
+        memcmp(request, ZYGOTE_REQUEST, sizeof(request)) != 0) {
+        if (received != 0) {
+            fprintf(stderr, "Zygote: malformed worker request, closing the control socket\n");
+        }
+        args->result = -1;
+        return NULL;
+    }
+    memcpy(&args->fd, CMSG_DATA(rights), sizeof(int));
+    args->result = 0;
+    return NULL;
+}
+
+static VALUE host_zygote_next_worker(VALUE self) {
+    (void) self;
+
+    for (;;) {
+        ReceiveWorkerArgs args = { -1, -1 };
+        rb_thread_call_without_gvl(receive_worker_without_gvl, &args, RUBY_UBF_IO, NULL);
+
+        if (args.result < 0) {
+            return Qnil;
+        }
+        if (args.result > 0) {
+            // Woken up by Ruby itself (signal, VM shutdown...): let it act
+            rb_thread_check_ints();
+            continue;
+        }
+        // Process.fork only flushes the Ruby IOs, the worker would write the pending C output again
+        fflush(NULL);
+        return INT2NUM(args.fd);
+    }
+}
+
+static VALUE host_zygote_worker_forked(VALUE self, VALUE fd, VALUE pid) {
+    (void) self;
+
+    close(NUM2INT(fd));
+    const int32_t reply[2] = { 0, (int32_t)NUM2INT(pid) };
+    if (write_all(g_control_fd, reply, ZYGOTE_REPLY_SIZE) != 0) {
+        DEBUG_LOG("ruby_zygote: unable to report worker %d to the host", NUM2INT(pid));
+    }
+    return Qnil;
+}
+
+static VALUE host_zygote_worker_started(VALUE self) {
+    (void) self;
+
+    close(g_control_fd);
+    g_control_fd = -1;
+    return Qnil;
+}
+
+int ruby_zygote_define(int control_fd, const char** preload_requires, size_t count) {
+    if (control_fd < 0) return -1;
+    g_control_fd = control_fd;
+
+    VALUE preload = rb_ary_new_capa((long)count);
+    for (size_t i = 0; preload_requires && i < count; i++) {
+        rb_ary_push(preload, rb_obj_freeze(rb_utf8_str_new_cstr(preload_requires[i])));
+    }
+
+    VALUE host_module = rb_define_module("RubyVMHost");
+    rb_const_set(host_module, rb_intern("ZYGOTE_PRELOAD"), rb_obj_freeze(preload));
+    rb_define_module_function(host_module, "zygote_next_worker", host_zygote_next_worker, 0);
+    rb_define_module_function(host_module, "zygote_worker_forked", host_zygote_worker_forked, 2);
+    rb_define_module_function(host_module, "zygote_worker_started", host_zygote_worker_started, 0);
+
+    DEBUG_LOG("ruby_zygote_define: serving worker requests on fd %d, %zu features preloaded", control_fd, count);
+    return 0;
+}
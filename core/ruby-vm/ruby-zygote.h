@@ -0,0 +1,104 @@
+#ifndef RUBY_ZYGOTE_H
+#define RUBY_ZYGOTE_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "exec-main-vm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct RubyScript;
+typedef struct RubyScript RubyScript;
+
+/**
+ * Process booting the Ruby VM once, then forking a copy of it for each VM of the host (Linux only).
+ *
+ * The zygote is forked from the host process when created: it installs the standard library, runs
+ * ruby_init and the main script (fifo_interpreter.rb) up to the point where it would serve commands,
+ * requires the preloaded features, compacts its heap, then waits for worker requests on a control socket.
+ * Each request carries the commands channel of a RubyVM (see ruby_vm_use_zygote): the zygote forks
+ * (Process.fork), and the child serves that channel with the regular protocol, sharing the warm heap of
+ * the zygote copy-on-write. A worker is ready in a few milliseconds instead of a full start.
+ *
+ * Workers live in their own processes: ruby_vm_eval_sync goes through the commands channel,
+ * a script already running in a worker cannot be interrupted, and the payload ring is not used.
+ * Also defines, in the zygote only:
+ *
+ *   RubyVMHost::ZYGOTE_PRELOAD -> Array of String
+ *     Features to require before the first fork
+ *
+ *   RubyVMHost.zygote_next_worker -> Integer or nil
+ *     Wait outside of the GVL for the next worker request, returns its commands channel (fd),
+ *     nil once the host closed the control socket
+ *
+ *   RubyVMHost.zygote_worker_forked(fd, pid) -> nil
+ *     In the zygote: close the commands channel handed to the worker and report its pid to the host
+ *
+ *   RubyVMHost.zygote_worker_started -> nil
+ *     In the worker: close the control socket, only the zygote serves it
+ */
+typedef struct {
+    pid_t pid;
+    int control_fd;
+    RubyScript* main_script;    // Given to the RubyVMs of the workers, not run by the host
+    pthread_mutex_t lock;       // One worker request at a time on the control socket
+} RubyZygote;
+
+/**
+ * Fork the zygote and start booting it, without waiting for the boot to complete.
+ *
+ * The zygote is a copy of the calling process that only runs Ruby: create it early, before the host
+ * starts a VM of its own or any thread holding locks the zygote could need.
+ *
+ * The fork is not followed by an exec: the zygote boots Ruby, starts threads and loads extensions in that
+ * copy, which is only safe when called from a single-threaded host. From a multithreaded one (a JVM through
+ * JNI), a lock held by another thread at the fork (malloc, dlopen, stdio) stays locked in the zygote for good,
+ * a warning is printed then. The zygote and its workers only keep stdio and the control socket, every other
+ * descriptor of the host is closed in the child.
+ *
+ * @param main_script Main script of the workers (fifo_interpreter.rb), owned by the zygote from now on
+ * @param ruby_base_directory Path to the Ruby base directory
+ * @param native_libs_location Path to the native libraries location
+ * @param options Features of the VM (embedded stdlib, compile cache, preload profile), shared by every worker
+ * @param preload_requires Features required by the zygote before the first fork, can be NULL
+ * @param count Number of features in 'preload_requires'
+ * @return The zygote, NULL on failure (fork not available, out of memory)
+ */
+RubyZygote* ruby_zygote_create(RubyScript* main_script, const char* ruby_base_directory, const char* native_libs_location,
+                               const ExecMainOptions* options, const char** preload_requires, size_t count);
+
+/**
+ * Have the zygote fork a worker serving 'commands_fd'. Blocks until the zygote booted and forked.
+ * The caller keeps its copy of 'commands_fd' and may close it once this returns.
+ *
+ * @param zygote Zygote
+ * @param commands_fd Worker side of a commands channel
+ * @param out_pid Receives the process id of the worker, can be NULL
+ * @return 0 on success, -1 if the zygote is not running anymore
+ */
+int ruby_zygote_spawn_worker(RubyZygote* zygote, int commands_fd, pid_t* out_pid);
+
+/**
+ * Close the control socket, the zygote exits, and wait for it. Running workers are left alone: each one
+ * exits once its RubyVM is destroyed. Must be called after the RubyVMs using the zygote are destroyed.
+ */
+void ruby_zygote_destroy(RubyZygote* zygote);
+
+/**
+ * Zygote side: define the RubyVMHost.zygote_* functions serving 'control_fd'
+ *
+ * Must be called on the VM thread of the zygote, after ruby_host_module_define() and before ruby_options().
+ *
+ * @return 0 on success, -1 on error
+ */
+int ruby_zygote_define(int control_fd, const char** preload_requires, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUBY_ZYGOTE_H
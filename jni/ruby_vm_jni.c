@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -19,6 +20,24 @@ typedef struct {
     jmethodID invoke_method_id;
 } CompletionCallbackContext;
 
+// Batch completion context: one global ref and one Java call for the whole batch
+typedef struct BatchCompletionContext BatchCompletionContext;
+
+// Per-script completion user data, points back to its batch
+typedef struct {
+    BatchCompletionContext* batch;
+    size_t index;
+} BatchCompletionSlot;
+
+struct BatchCompletionContext {
+    JavaVM* jvm;
+    jobject callback_obj;
+    jmethodID invoke_method_id;
+    size_t count;
+    jint* results;
+    BatchCompletionSlot* slots;
+};
+
 // ============================================================================
 // JNI Environment Helpers
 // ============================================================================
@@ -68,6 +87,44 @@ static char* jstring_to_cstring(JNIEnv* env, jstring j_str) {
     return c_str;
 }
 
+/**
+ * Helper to convert a String array to C strings, NULL for an empty array.
+ * Caller must release the result with free_cstrings.
+ *
+ * @param converted Receives 0 if a string could not be converted, the result is then NULL
+ */
+static char** jstring_array_to_cstrings(JNIEnv* env, jobjectArray j_array, jsize count, int* converted) {
+    *converted = 1;
+    if (count <= 0) return NULL;
+
+    char** c_strings = calloc((size_t)count, sizeof(char*));
+    if (!c_strings) {
+        *converted = 0;
+        return NULL;
+    }
+    for (jsize i = 0; i < count && *converted; i++) {
+        jstring j_str = (jstring)(*env)->GetObjectArrayElement(env, j_array, i);
+        c_strings[i] = jstring_to_cstring(env, j_str);
+        *converted = c_strings[i] != NULL;
+        (*env)->DeleteLocalRef(env, j_str);
+    }
+    if (!*converted) {
+        for (jsize i = 0; i < count; i++) {
+            free(c_strings[i]);
+        }
+        free(c_strings);
+        return NULL;
+    }
+    return c_strings;
+}
+
+static void free_cstrings(char** c_strings, jsize count) {
+    for (jsize i = 0; c_strings && i < count; i++) {
+        free(c_strings[i]);
+    }
+    free(c_strings);
+}
+
 // ============================================================================
 // Log Callback Context Management
 // ============================================================================
@@ -236,14 +293,16 @@ static void jni_log_error_callback(LogListener* listener, const char* error_mess
 // ============================================================================
 
 /**
- * Create a completion callback context.
+ * Create a callback context for a 'complete' method of the given signature.
  *
  * @param env JNI environment
  * @param completion_callback Java callback object
+ * @param signature JNI signature of its 'complete' method
  * @param errorCode Output parameter for error code (0 = success)
  * @return CompletionCallbackContext or NULL on failure
  */
-static CompletionCallbackContext* create_completion_context(JNIEnv* env, jobject completion_callback, int* errorCode) {
+static CompletionCallbackContext* create_callback_context(JNIEnv* env, jobject completion_callback,
+                                                          const char* signature, int* errorCode) {
     if (!env || !completion_callback) {
         *errorCode = 1;
         jni_log_write(JNI_LOG_ERROR, "RubyVM", "Invalid parameters to create_completion_context");
@@ -284,9 +343,8 @@ static CompletionCallbackContext* create_completion_context(JNIEnv* env, jobject
         return NULL;
     }
 
-    // Look for complete method that takes an int parameter
     context->invoke_method_id = (*env)->GetMethodID(env, callback_class,
-                                                    "complete", "(I)V");
+                                                    "complete", signature);
 
     (*env)->DeleteLocalRef(env, callback_class);
 
@@ -302,6 +360,20 @@ static CompletionCallbackContext* create_completion_context(JNIEnv* env, jobject
     return context;
 }
 
+/**
+ * Create a completion callback context, whose 'complete' method takes the exit code
+ */
+static CompletionCallbackContext* create_completion_context(JNIEnv* env, jobject completion_callback, int* errorCode) {
+    return create_callback_context(env, completion_callback, "(I)V", errorCode);
+}
+
+/**
+ * Create a result callback context, whose 'complete' method takes the exit code and the encoded value
+ */
+static CompletionCallbackContext* create_result_context(JNIEnv* env, jobject result_callback, int* errorCode) {
+    return create_callback_context(env, result_callback, "(I[B)V", errorCode);
+}
+
 /**
  * Destroy completion callback context and clean up resources.
  * Safe to call from any thread.
@@ -371,6 +443,315 @@ static void jni_completion_callback(void* user_context, int result) {
     // No need to detach - daemon threads auto-detach
 }
 
+/**
+ * C result callback called from the reply reader thread.
+ * 'value' is only valid during the call: it is copied into a Java byte array, never wrapped.
+ *
+ * @param user_context CompletionCallbackContext created by create_result_context
+ * @param result The completion result code (0 = success, non-zero = error)
+ * @param value MessagePack encoded value, NULL when there is none
+ */
+static void jni_result_callback(void* user_context, int result, const void* value, size_t length) {
+    if (!user_context) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Result callback called with NULL context");
+        return;
+    }
+
+    CompletionCallbackContext* context = (CompletionCallbackContext*)user_context;
+
+    JNIEnv* env = get_jni_env(context->jvm);
+    if (!env) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to get JNI env in result callback");
+        destroy_completion_context(context);
+        return;
+    }
+
+    jbyteArray j_value = NULL;
+    if (value && length <= (size_t)INT32_MAX) {
+        j_value = (*env)->NewByteArray(env, (jsize)length);
+        if (j_value) {
+            (*env)->SetByteArrayRegion(env, j_value, 0, (jsize)length, (const jbyte*)value);
+        } else {
+            // Out of memory: clear the pending exception, the exit code is still delivered
+            (*env)->ExceptionClear(env);
+            jni_log_printf(JNI_LOG_ERROR, "RubyVM", "Failed to allocate %zu bytes for a script result", length);
+        }
+    }
+
+    (*env)->CallVoidMethod(env, context->callback_obj, context->invoke_method_id, (jint)result, j_value);
+
+    if ((*env)->ExceptionCheck(env)) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Exception in result callback");
+        (*env)->ExceptionDescribe(env);
+        (*env)->ExceptionClear(env);
+    }
+
+    if (j_value) {
+        (*env)->DeleteLocalRef(env, j_value);
+    }
+    destroy_completion_context(context);
+}
+
+// ============================================================================
+// Batch Completion
+// ============================================================================
+
+/**
+ * Create a batch completion context for 'count' scripts.
+ * Results and per-script slots are allocated in the same block as the context.
+ *
+ * @return BatchCompletionContext or NULL on failure
+ */
+static BatchCompletionContext* create_batch_completion_context(JNIEnv* env, jobject completion_callback, size_t count) {
+    BatchCompletionContext* context = malloc(sizeof(BatchCompletionContext) +
+                                             sizeof(BatchCompletionSlot) * count +
+                                             sizeof(jint) * count);
+    if (!context) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to allocate batch completion context");
+        return NULL;
+    }
+
+    if ((*env)->GetJavaVM(env, &context->jvm) != JNI_OK) {
+        free(context);
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to get JavaVM for batch completion");
+        return NULL;
+    }
+
+    jclass callback_class = (*env)->GetObjectClass(env, completion_callback);
+    if (!callback_class) {
+        free(context);
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to get batch completion callback class");
+        return NULL;
+    }
+
+    // Look for complete method that takes an int array parameter
+    context->invoke_method_id = (*env)->GetMethodID(env, callback_class, "complete", "([I)V");
+    (*env)->DeleteLocalRef(env, callback_class);
+    if (!context->invoke_method_id) {
+        free(context);
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to get batch complete method ID");
+        return NULL;
+    }
+
+    context->callback_obj = (*env)->NewGlobalRef(env, completion_callback);
+    if (!context->callback_obj) {
+        free(context);
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to create global ref for batch completion");
+        return NULL;
+    }
+
+    context->count = count;
+    context->slots = (BatchCompletionSlot*)(context + 1);
+    context->results = (jint*)(context->slots + count);
+    for (size_t i = 0; i < count; i++) {
+        context->slots[i].batch = context;
+        context->slots[i].index = i;
+        context->results[i] = 1;
+    }
+    return context;
+}
+
+/**
+ * Deliver the collected results to Java, then release the context
+ */
+static void finish_batch_completion(JNIEnv* env, BatchCompletionContext* context) {
+    if (env) {
+        jintArray results = (*env)->NewIntArray(env, (jsize)context->count);
+        if (results) {
+            (*env)->SetIntArrayRegion(env, results, 0, (jsize)context->count, context->results);
+            (*env)->CallVoidMethod(env, context->callback_obj, context->invoke_method_id, results);
+            (*env)->DeleteLocalRef(env, results);
+        }
+
+        if ((*env)->ExceptionCheck(env)) {
+            jni_log_write(JNI_LOG_ERROR, "RubyVM", "Exception in batch completion callback");
+            (*env)->ExceptionDescribe(env);
+            (*env)->ExceptionClear(env);
+        }
+        (*env)->DeleteGlobalRef(env, context->callback_obj);
+    } else {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to get JNI env in batch completion callback");
+    }
+    free(context);
+}
+
+/**
+ * C completion callback of each script of a batch.
+ * The VM completes all the scripts of a batch in order from the same thread,
+ * so the last one to complete can safely hand the whole result vector to Java.
+ */
+static void jni_batch_completion_callback(void* user_context, int result) {
+    BatchCompletionSlot* slot = (BatchCompletionSlot*)user_context;
+    BatchCompletionContext* context = slot->batch;
+
+    context->results[slot->index] = (jint)result;
+    if (slot->index + 1 == context->count) {
+        finish_batch_completion(get_jni_env(context->jvm), context);
+    }
+}
+
+/**
+ * Call a batch completion callback with 'count' times the same error, without any context
+ */
+static void fail_batch_immediately(JNIEnv* env, jobject completion_callback, jsize count, jint result) {
+    if (!completion_callback) return;
+
+    jclass callback_class = (*env)->GetObjectClass(env, completion_callback);
+    if (!callback_class) return;
+
+    jmethodID complete_method = (*env)->GetMethodID(env, callback_class, "complete", "([I)V");
+    jintArray results = complete_method ? (*env)->NewIntArray(env, count) : NULL;
+    if (results) {
+        jint* elements = (*env)->GetIntArrayElements(env, results, NULL);
+        if (elements) {
+            for (jsize i = 0; i < count; i++) {
+                elements[i] = result;
+            }
+            (*env)->ReleaseIntArrayElements(env, results, elements, 0);
+        }
+        (*env)->CallVoidMethod(env, completion_callback, complete_method, results);
+        (*env)->DeleteLocalRef(env, results);
+    }
+    (*env)->DeleteLocalRef(env, callback_class);
+}
+
+/**
+ * Call a completion callback with an error, without any context
+ */
+static void fail_completion_immediately(JNIEnv* env, jobject completion_callback, jint result) {
+    if (!completion_callback) return;
+
+    jclass callback_class = (*env)->GetObjectClass(env, completion_callback);
+    if (!callback_class) return;
+
+    jmethodID complete_method = (*env)->GetMethodID(env, callback_class, "complete", "(I)V");
+    if (complete_method) {
+        (*env)->CallVoidMethod(env, completion_callback, complete_method, result);
+    }
+    (*env)->DeleteLocalRef(env, callback_class);
+}
+
+/**
+ * Call a result callback with an error and no value, without any context
+ */
+static void fail_result_immediately(JNIEnv* env, jobject result_callback, jint result) {
+    if (!result_callback) return;
+
+    jclass callback_class = (*env)->GetObjectClass(env, result_callback);
+    if (!callback_class) return;
+
+    jmethodID complete_method = (*env)->GetMethodID(env, callback_class, "complete", "(I[B)V");
+    if (complete_method) {
+        (*env)->CallVoidMethod(env, result_callback, complete_method, result, (jbyteArray)NULL);
+    }
+    (*env)->DeleteLocalRef(env, callback_class);
+}
+
+// ============================================================================
+// Prepared Script Arguments
+// ============================================================================
+
+// Byte array whose elements stay pinned until the arguments are copied by the VM
+typedef struct {
+    jbyteArray array;
+    jbyte* elements;
+} PinnedBytes;
+
+/**
+ * Pin a byte array and describe it as a RubyArg of the given type
+ */
+static int pin_bytes_arg(JNIEnv* env, jbyteArray array, RubyArgType type, RubyArg* out_arg, PinnedBytes* pinned) {
+    pinned->array = array;
+    pinned->elements = (*env)->GetByteArrayElements(env, array, NULL);
+    if (!pinned->elements) return -1;
+
+    const size_t length = (size_t)(*env)->GetArrayLength(env, array);
+    *out_arg = type == RUBY_ARG_UTF8 ? ruby_arg_utf8((const char*)pinned->elements, length)
+                                     : ruby_arg_bytes(pinned->elements, length);
+    return 0;
+}
+
+/**
+ * Convert the Java arguments of a prepared script call into RubyArgs.
+ * Strings are encoded to UTF-8 byte arrays: every byte array stays pinned in 'pinned'
+ * until release_invocation_args is called.
+ *
+ * @return 0 on success, -1 on unsupported argument or JNI failure
+ */
+static int convert_invocation_args(JNIEnv* env, jobjectArray args, jsize count, RubyArg* out_args, PinnedBytes* pinned) {
+    memset(pinned, 0, sizeof(PinnedBytes) * count);
+    if ((*env)->EnsureLocalCapacity(env, count + 8) != 0) return -1;
+
+    jclass number_class = (*env)->FindClass(env, "java/lang/Number");
+    jclass float_class = (*env)->FindClass(env, "java/lang/Float");
+    jclass double_class = (*env)->FindClass(env, "java/lang/Double");
+    jclass boolean_class = (*env)->FindClass(env, "java/lang/Boolean");
+    jclass string_class = (*env)->FindClass(env, "java/lang/String");
+    jclass bytes_class = (*env)->FindClass(env, "[B");
+    jstring charset = (*env)->NewStringUTF(env, "UTF-8");
+    if (!number_class || !float_class || !double_class || !boolean_class || !string_class || !bytes_class || !charset) {
+        return -1;
+    }
+
+    jmethodID long_value = (*env)->GetMethodID(env, number_class, "longValue", "()J");
+    jmethodID double_value = (*env)->GetMethodID(env, number_class, "doubleValue", "()D");
+    jmethodID boolean_value = (*env)->GetMethodID(env, boolean_class, "booleanValue", "()Z");
+    jmethodID get_bytes = (*env)->GetMethodID(env, string_class, "getBytes", "(Ljava/lang/String;)[B");
+    if (!long_value || !double_value || !boolean_value || !get_bytes) return -1;
+
+    int result = 0;
+    for (jsize i = 0; i < count && result == 0; i++) {
+        jobject arg = (*env)->GetObjectArrayElement(env, args, i);
+        if (!arg) {
+            out_args[i] = ruby_arg_nil();
+        } else if ((*env)->IsInstanceOf(env, arg, float_class) || (*env)->IsInstanceOf(env, arg, double_class)) {
+            out_args[i] = ruby_arg_double((*env)->CallDoubleMethod(env, arg, double_value));
+        } else if ((*env)->IsInstanceOf(env, arg, number_class)) {
+            out_args[i] = ruby_arg_int64((*env)->CallLongMethod(env, arg, long_value));
+        } else if ((*env)->IsInstanceOf(env, arg, boolean_class)) {
+            out_args[i] = ruby_arg_bool((*env)->CallBooleanMethod(env, arg, boolean_value) == JNI_TRUE);
+        } else if ((*env)->IsInstanceOf(env, arg, string_class)) {
+            jbyteArray utf8 = (jbyteArray)(*env)->CallObjectMethod(env, arg, get_bytes, charset);
+            result = utf8 ? pin_bytes_arg(env, utf8, RUBY_ARG_UTF8, &out_args[i], &pinned[i]) : -1;
+        } else if ((*env)->IsInstanceOf(env, arg, bytes_class)) {
+            result = pin_bytes_arg(env, (jbyteArray)arg, RUBY_ARG_BYTES, &out_args[i], &pinned[i]);
+            // Still referenced by 'pinned'
+            arg = NULL;
+        } else {
+            jni_log_printf(JNI_LOG_ERROR, "RubyVM", "Unsupported type for prepared script argument %d", (int)i);
+            result = -1;
+        }
+
+        if (arg) {
+            (*env)->DeleteLocalRef(env, arg);
+        }
+        if ((*env)->ExceptionCheck(env)) {
+            (*env)->ExceptionDescribe(env);
+            (*env)->ExceptionClear(env);
+            result = -1;
+        }
+    }
+
+    (*env)->DeleteLocalRef(env, charset);
+    (*env)->DeleteLocalRef(env, bytes_class);
+    (*env)->DeleteLocalRef(env, string_class);
+    (*env)->DeleteLocalRef(env, boolean_class);
+    (*env)->DeleteLocalRef(env, double_class);
+    (*env)->DeleteLocalRef(env, float_class);
+    (*env)->DeleteLocalRef(env, number_class);
+    return result;
+}
+
+static void release_invocation_args(JNIEnv* env, PinnedBytes* pinned, jsize count) {
+    for (jsize i = 0; i < count; i++) {
+        if (!pinned[i].array) continue;
+        if (pinned[i].elements) {
+            (*env)->ReleaseByteArrayElements(env, pinned[i].array, pinned[i].elements, JNI_ABORT);
+        }
+        (*env)->DeleteLocalRef(env, pinned[i].array);
+    }
+}
+
 // ============================================================================
 // JNI Native Methods
 // ============================================================================
@@ -476,14 +857,20 @@ Java_com_scorbutics_rubyvm_RubyVMNative_createScript(JNIEnv *env, jclass clazz,
                                                      jstring content) {
     (void) clazz;
 
-    char* c_content = jstring_to_cstring(env, content);
+    if (!content) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to convert script content");
+        return 0;
+    }
+
+    // The script keeps its own copy: build it straight from the JVM buffer, without an intermediate one
+    const char* c_content = (*env)->GetStringUTFChars(env, content, NULL);
     if (!c_content) {
         jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to convert script content");
         return 0;
     }
 
-    RubyScript* script = ruby_script_create_from_content(c_content, strlen(c_content));
-    free(c_content);
+    RubyScript* script = ruby_script_create_from_content(c_content, (size_t)(*env)->GetStringUTFLength(env, content));
+    (*env)->ReleaseStringUTFChars(env, content, c_content);
 
     if (!script) {
         jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to create Ruby script");
@@ -508,16 +895,16 @@ Java_com_scorbutics_rubyvm_RubyVMNative_destroyScript(JNIEnv *env, jclass clazz,
     ruby_script_destroy(script);
 }
 
-JNIEXPORT void JNICALL
-Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScript(JNIEnv *env, jclass clazz,
-                                                      jlong interpreter_ptr,
-                                                      jlong script_ptr,
-                                                      jobject completion_callback) {
-    (void) clazz;
-
-    RubyInterpreter* interpreter = (RubyInterpreter*)interpreter_ptr;
-    RubyScript* script = (RubyScript*)script_ptr;
+// How a script is enqueued, and what the argument given along with it means
+typedef enum {
+    ENQUEUE_WITH_FLAGS,     // RubyEnqueueFlags
+    ENQUEUE_SHARDED,        // Shard key
+    ENQUEUE_IN_STREAM       // Stream of the I/O thread pool
+} EnqueueRoute;
 
+// Enqueue a script completing 'completion_callback'
+static void enqueue_script_with_callback(JNIEnv *env, RubyInterpreter* interpreter, RubyScript* script,
+                                         EnqueueRoute route, uint64_t argument, jobject completion_callback) {
     // Validate inputs
     if (!interpreter || !script) {
         jni_log_write(JNI_LOG_ERROR, "RubyVM", "Invalid interpreter or script pointer");
@@ -565,39 +952,486 @@ Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScript(JNIEnv *env, jclass clazz,
         }
     }
 
-    // Enqueue the script with the completion callback and context
-    // The Ruby VM will call jni_completion_callback(context, result) when done
-    const int interpreter_script_result = ruby_interpreter_enqueue(
-            interpreter,
-            script,
-            ruby_completion_task_create(c_completion_callback, context)
-    );
+    // On failure the task is still completed, the context is always released by jni_completion_callback
+    const RubyCompletionTask task = ruby_completion_task_create(c_completion_callback, context);
+    int interpreter_script_result;
+    switch (route) {
+        case ENQUEUE_SHARDED:
+            interpreter_script_result = ruby_interpreter_enqueue_sharded(interpreter, argument, script, task);
+            break;
+        case ENQUEUE_IN_STREAM:
+            interpreter_script_result = ruby_interpreter_enqueue_in_stream(interpreter, (uint32_t)argument, script, task);
+            break;
+        default:
+            interpreter_script_result = ruby_interpreter_enqueue_with_flags(interpreter, script, (uint32_t)argument, task);
+            break;
+    }
 
     if (interpreter_script_result != 0) {
         jni_log_printf(JNI_LOG_ERROR, "RubyVM",
                        "Failed to enqueue script (error %d)", interpreter_script_result);
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScript(JNIEnv *env, jclass clazz,
+                                                      jlong interpreter_ptr,
+                                                      jlong script_ptr,
+                                                      jobject completion_callback) {
+    (void) clazz;
+
+    enqueue_script_with_callback(env, (RubyInterpreter*)interpreter_ptr, (RubyScript*)script_ptr,
+                                 ENQUEUE_WITH_FLAGS, RUBY_ENQUEUE_DEFAULT, completion_callback);
+}
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptWithFlags(JNIEnv *env, jclass clazz,
+                                                               jlong interpreter_ptr,
+                                                               jlong script_ptr,
+                                                               jint flags,
+                                                               jobject completion_callback) {
+    (void) clazz;
+
+    enqueue_script_with_callback(env, (RubyInterpreter*)interpreter_ptr, (RubyScript*)script_ptr,
+                                 ENQUEUE_WITH_FLAGS, (uint32_t)flags, completion_callback);
+}
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptInStream(JNIEnv *env, jclass clazz,
+                                                              jlong interpreter_ptr,
+                                                              jint stream,
+                                                              jlong script_ptr,
+                                                              jobject completion_callback) {
+    (void) clazz;
+
+    enqueue_script_with_callback(env, (RubyInterpreter*)interpreter_ptr, (RubyScript*)script_ptr,
+                                 ENQUEUE_IN_STREAM, (uint32_t)stream, completion_callback);
+}
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptSharded(JNIEnv *env, jclass clazz,
+                                                             jlong interpreter_ptr,
+                                                             jlong shard_key,
+                                                             jlong script_ptr,
+                                                             jobject completion_callback) {
+    (void) clazz;
+
+    enqueue_script_with_callback(env, (RubyInterpreter*)interpreter_ptr, (RubyScript*)script_ptr,
+                                 ENQUEUE_SHARDED, (uint64_t)shard_key, completion_callback);
+}
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScripts(JNIEnv *env, jclass clazz,
+                                                       jlong interpreter_ptr,
+                                                       jlongArray script_ptrs,
+                                                       jobject completion_callback) {
+    (void) clazz;
+
+    RubyInterpreter* interpreter = (RubyInterpreter*)interpreter_ptr;
+    const jsize count = script_ptrs ? (*env)->GetArrayLength(env, script_ptrs) : 0;
+
+    if (!interpreter || !completion_callback) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Invalid interpreter pointer or batch callback");
+        fail_batch_immediately(env, completion_callback, count, 1);
+        return;
+    }
+
+    if (count == 0) {
+        fail_batch_immediately(env, completion_callback, 0, 0);
+        return;
+    }
 
-        // If enqueue failed immediately, clean up context and notify callback
+    BatchCompletionContext* context = create_batch_completion_context(env, completion_callback, (size_t)count);
+    RubyScript** scripts = malloc(sizeof(RubyScript*) * count);
+    RubyCompletionTask* tasks = malloc(sizeof(RubyCompletionTask) * count);
+    jlong* pointers = (*env)->GetLongArrayElements(env, script_ptrs, NULL);
+
+    int invalid_script = 0;
+    if (context && scripts && tasks && pointers) {
+        for (jsize i = 0; i < count; i++) {
+            scripts[i] = (RubyScript*)pointers[i];
+            tasks[i] = ruby_completion_task_create(jni_batch_completion_callback, &context->slots[i]);
+            invalid_script |= scripts[i] == NULL;
+        }
+    }
+    if (pointers) {
+        (*env)->ReleaseLongArrayElements(env, script_ptrs, pointers, JNI_ABORT);
+    }
+
+    if (!context || !scripts || !tasks || !pointers || invalid_script) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to prepare script batch");
         if (context) {
-            // Call the callback with error code
-            JNIEnv* callback_env = get_jni_env(context->jvm);
-            if (callback_env) {
-                (*callback_env)->CallVoidMethod(callback_env, context->callback_obj,
-                                                context->invoke_method_id, (jint)interpreter_script_result);
-
-                if ((*callback_env)->ExceptionCheck(callback_env)) {
-                    (*callback_env)->ExceptionDescribe(callback_env);
-                    (*callback_env)->ExceptionClear(callback_env);
-                }
-            }
+            (*env)->DeleteGlobalRef(env, context->callback_obj);
+            free(context);
+        }
+        free(tasks);
+        free(scripts);
+        fail_batch_immediately(env, completion_callback, count, 1);
+        return;
+    }
 
-            // Clean up the context
-            destroy_completion_context(context);
+    // On failure the interpreter still completes every task, so the context is always released
+    // by the last jni_batch_completion_callback call
+    const int interpreter_script_result = ruby_interpreter_enqueue_batch(interpreter, scripts, (size_t)count, tasks);
+    if (interpreter_script_result != 0) {
+        jni_log_printf(JNI_LOG_ERROR, "RubyVM",
+                       "Failed to enqueue script batch (error %d)", interpreter_script_result);
+    }
+
+    // The VM keeps its own copy of both arrays
+    free(tasks);
+    free(scripts);
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_prepareScript(JNIEnv *env, jclass clazz,
+                                                      jlong interpreter_ptr,
+                                                      jlong script_ptr) {
+    (void) env;
+    (void) clazz;
+
+    RubyInterpreter* interpreter = (RubyInterpreter*)interpreter_ptr;
+    RubyScript* script = (RubyScript*)script_ptr;
+    if (!interpreter || !script) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Invalid interpreter or script pointer");
+        return 0;
+    }
+
+    RubyPreparedScript* prepared = ruby_interpreter_prepare(interpreter, script);
+    if (!prepared) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to prepare Ruby script");
+        return 0;
+    }
+    return (jlong)prepared;
+}
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_invokePreparedScript(JNIEnv *env, jclass clazz,
+                                                             jlong interpreter_ptr,
+                                                             jlong prepared_ptr,
+                                                             jobjectArray args,
+                                                             jobject completion_callback) {
+    (void) clazz;
+
+    RubyInterpreter* interpreter = (RubyInterpreter*)interpreter_ptr;
+    RubyPreparedScript* prepared = (RubyPreparedScript*)prepared_ptr;
+    const jsize count = args ? (*env)->GetArrayLength(env, args) : 0;
+
+    if (!interpreter || !prepared || !completion_callback) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Invalid interpreter, prepared script or callback");
+        fail_completion_immediately(env, completion_callback, 1);
+        return;
+    }
+
+    RubyArg* c_args = malloc(sizeof(RubyArg) * (count > 0 ? count : 1));
+    PinnedBytes* pinned = malloc(sizeof(PinnedBytes) * (count > 0 ? count : 1));
+    int context_result = 0;
+    CompletionCallbackContext* context = NULL;
+    if (c_args && pinned && convert_invocation_args(env, args, count, c_args, pinned) == 0) {
+        context = create_completion_context(env, completion_callback, &context_result);
+    } else {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to convert prepared script arguments");
+    }
+
+    if (context) {
+        // Arguments are copied before this returns, on failure the task is still completed
+        // and the context released by jni_completion_callback
+        ruby_interpreter_invoke(interpreter, prepared, c_args, (size_t)count,
+                                ruby_completion_task_create(jni_completion_callback, context));
+    } else {
+        fail_completion_immediately(env, completion_callback, 1);
+    }
+
+    if (pinned) {
+        release_invocation_args(env, pinned, c_args ? count : 0);
+    }
+    free(pinned);
+    free(c_args);
+}
+
+// Enqueue a script completing 'result_callback' with its packed value, ENQUEUE_SHARDED is not supported
+static void enqueue_script_for_result(JNIEnv *env, RubyInterpreter* interpreter, RubyScript* script,
+                                      EnqueueRoute route, uint64_t argument, jobject result_callback) {
+    if (!interpreter || !script || !result_callback) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Invalid interpreter, script or result callback");
+        fail_result_immediately(env, result_callback, 1);
+        return;
+    }
+
+    int context_result;
+    CompletionCallbackContext* context = create_result_context(env, result_callback, &context_result);
+    if (!context) {
+        jni_log_printf(JNI_LOG_ERROR, "RubyVM", "Failed to create result context (error %d)", context_result);
+        fail_result_immediately(env, result_callback, 1);
+        return;
+    }
+
+    // On failure the task is still completed, the context is always released by jni_result_callback
+    const RubyResultTask task = ruby_result_task_create(jni_result_callback, context);
+    const int interpreter_script_result = route == ENQUEUE_IN_STREAM
+            ? ruby_interpreter_enqueue_in_stream_with_result(interpreter, (uint32_t)argument, script, task)
+            : ruby_interpreter_enqueue_with_result_and_flags(interpreter, script, (uint32_t)argument, task);
+    if (interpreter_script_result != 0) {
+        jni_log_printf(JNI_LOG_ERROR, "RubyVM",
+                       "Failed to enqueue script (error %d)", interpreter_script_result);
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptForResult(JNIEnv *env, jclass clazz,
+                                                               jlong interpreter_ptr,
+                                                               jlong script_ptr,
+                                                               jobject result_callback) {
+    (void) clazz;
+
+    enqueue_script_for_result(env, (RubyInterpreter*)interpreter_ptr, (RubyScript*)script_ptr,
+                              ENQUEUE_WITH_FLAGS, RUBY_ENQUEUE_DEFAULT, result_callback);
+}
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptForResultWithFlags(JNIEnv *env, jclass clazz,
+                                                                        jlong interpreter_ptr,
+                                                                        jlong script_ptr,
+                                                                        jint flags,
+                                                                        jobject result_callback) {
+    (void) clazz;
+
+    enqueue_script_for_result(env, (RubyInterpreter*)interpreter_ptr, (RubyScript*)script_ptr,
+                              ENQUEUE_WITH_FLAGS, (uint32_t)flags, result_callback);
+}
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptInStreamForResult(JNIEnv *env, jclass clazz,
+                                                                       jlong interpreter_ptr,
+                                                                       jint stream,
+                                                                       jlong script_ptr,
+                                                                       jobject result_callback) {
+    (void) clazz;
+
+    enqueue_script_for_result(env, (RubyInterpreter*)interpreter_ptr, (RubyScript*)script_ptr,
+                              ENQUEUE_IN_STREAM, (uint32_t)stream, result_callback);
+}
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_invokePreparedScriptForResult(JNIEnv *env, jclass clazz,
+                                                                      jlong interpreter_ptr,
+                                                                      jlong prepared_ptr,
+                                                                      jobjectArray args,
+                                                                      jobject result_callback) {
+    (void) clazz;
+
+    RubyInterpreter* interpreter = (RubyInterpreter*)interpreter_ptr;
+    RubyPreparedScript* prepared = (RubyPreparedScript*)prepared_ptr;
+    const jsize count = args ? (*env)->GetArrayLength(env, args) : 0;
+
+    if (!interpreter || !prepared || !result_callback) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Invalid interpreter, prepared script or result callback");
+        fail_result_immediately(env, result_callback, 1);
+        return;
+    }
+
+    RubyArg* c_args = malloc(sizeof(RubyArg) * (count > 0 ? count : 1));
+    PinnedBytes* pinned = malloc(sizeof(PinnedBytes) * (count > 0 ? count : 1));
+    int context_result = 0;
+    CompletionCallbackContext* context = NULL;
+    if (c_args && pinned && convert_invocation_args(env, args, count, c_args, pinned) == 0) {
+        context = create_result_context(env, result_callback, &context_result);
+    } else {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to convert prepared script arguments");
+    }
+
+    if (context) {
+        ruby_interpreter_invoke_with_result(interpreter, prepared, c_args, (size_t)count,
+                                            ruby_result_task_create(jni_result_callback, context));
+    } else {
+        fail_result_immediately(env, result_callback, 1);
+    }
+
+    if (pinned) {
+        release_invocation_args(env, pinned, c_args ? count : 0);
+    }
+    free(pinned);
+    free(c_args);
+}
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_releasePreparedScript(JNIEnv *env, jclass clazz,
+                                                              jlong interpreter_ptr,
+                                                              jlong prepared_ptr) {
+    (void) env;
+    (void) clazz;
+
+    if (!prepared_ptr) {
+        jni_log_write(JNI_LOG_WARN, "RubyVM", "Attempting to release NULL prepared script");
+        return;
+    }
+    ruby_interpreter_release_prepared((RubyInterpreter*)interpreter_ptr, (RubyPreparedScript*)prepared_ptr);
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptWithTimeout(JNIEnv *env, jclass clazz,
+                                                                 jlong interpreter_ptr,
+                                                                 jlong script_ptr,
+                                                                 jint timeout_millis,
+                                                                 jobject completion_callback) {
+    (void) clazz;
+
+    RubyInterpreter* interpreter = (RubyInterpreter*)interpreter_ptr;
+    RubyScript* script = (RubyScript*)script_ptr;
+
+    if (!interpreter || !script || timeout_millis < 0) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Invalid interpreter, script pointer or timeout");
+        fail_completion_immediately(env, completion_callback, 1);
+        return 0;
+    }
+
+    CompletionCallbackContext* context = NULL;
+    if (completion_callback) {
+        int context_result;
+        context = create_completion_context(env, completion_callback, &context_result);
+        if (!context) {
+            jni_log_printf(JNI_LOG_ERROR, "RubyVM", "Failed to create completion context (error %d)", context_result);
+            fail_completion_immediately(env, completion_callback, 1);
+            return 0;
+        }
+    }
+
+    // On failure the task is still completed, the context is always released by jni_completion_callback
+    uint64_t request_id = 0;
+    const int interpreter_script_result = ruby_interpreter_enqueue_with_deadline(
+            interpreter, script, (uint32_t)timeout_millis,
+            ruby_completion_task_create(context ? jni_completion_callback : NULL, context), &request_id);
+    if (interpreter_script_result != 0) {
+        jni_log_printf(JNI_LOG_ERROR, "RubyVM",
+                       "Failed to enqueue script (error %d)", interpreter_script_result);
+    }
+    return (jlong)request_id;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_prewarmInterpreter(JNIEnv *env, jclass clazz,
+                                                           jlong interpreter_ptr,
+                                                           jobjectArray preload_requires,
+                                                           jobject completion_callback) {
+    (void) clazz;
+
+    RubyInterpreter* interpreter = (RubyInterpreter*)interpreter_ptr;
+    const jsize count = preload_requires ? (*env)->GetArrayLength(env, preload_requires) : 0;
+    if (!interpreter) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Invalid interpreter pointer");
+        fail_completion_immediately(env, completion_callback, 1);
+        return -1;
+    }
+
+    int converted = 0;
+    char** features = jstring_array_to_cstrings(env, preload_requires, count, &converted);
+
+    CompletionCallbackContext* context = NULL;
+    int result = -1;
+    if (!converted) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to convert the preloaded features");
+        fail_completion_immediately(env, completion_callback, 1);
+    } else if (completion_callback && (context = create_completion_context(env, completion_callback, &result)) == NULL) {
+        jni_log_printf(JNI_LOG_ERROR, "RubyVM", "Failed to create completion context (error %d)", result);
+        fail_completion_immediately(env, completion_callback, 1);
+        result = -1;
+    } else {
+        // The features are copied into the preload script, the context is always released by jni_completion_callback
+        result = ruby_interpreter_prewarm(interpreter, (const char**)features, (size_t)count,
+                                          ruby_completion_task_create(context ? jni_completion_callback : NULL, context));
+        if (result != 0) {
+            jni_log_printf(JNI_LOG_ERROR, "RubyVM", "Failed to prewarm the VM (error %d)", result);
         }
     }
 
-    // Note: If enqueue succeeded, the context will be cleaned up in jni_completion_callback
-    // after the Ruby VM calls it
+    free_cstrings(features, count);
+    return result;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enableWorkerPool(JNIEnv *env, jclass clazz,
+                                                         jlong interpreter_ptr,
+                                                         jint size,
+                                                         jobjectArray preload_requires) {
+    (void) clazz;
+
+    RubyInterpreter* interpreter = (RubyInterpreter*)interpreter_ptr;
+    if (!interpreter || size < 0) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Invalid interpreter pointer or pool size");
+        return JNI_FALSE;
+    }
+
+    const jsize count = preload_requires ? (*env)->GetArrayLength(env, preload_requires) : 0;
+    int converted = 0;
+    char** features = jstring_array_to_cstrings(env, preload_requires, count, &converted);
+    if (!converted) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to convert the preloaded features");
+        return JNI_FALSE;
+    }
+
+    // The zygote is forked before this returns, it keeps its own copy of the features
+    const int result = ruby_interpreter_enable_worker_pool(interpreter, (size_t)size, (const char**)features, (size_t)count);
+    if (result != 0) {
+        jni_log_write(JNI_LOG_ERROR, "RubyVM", "Failed to create the zygote of the worker pool");
+    }
+    free_cstrings(features, count);
+    return result == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_cancelRequest(JNIEnv *env, jclass clazz,
+                                                      jlong interpreter_ptr,
+                                                      jlong request_id) {
+    (void) env;
+    (void) clazz;
+
+    return ruby_interpreter_cancel((RubyInterpreter*)interpreter_ptr, (uint64_t)request_id) == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jlongArray JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_getStartupProfile(JNIEnv *env, jclass clazz,
+                                                          jlong interpreter_ptr) {
+    (void) clazz;
+
+    RubyStartupProfile profile;
+    memset(&profile, 0, sizeof(profile));
+    ruby_interpreter_get_startup_profile((RubyInterpreter*)interpreter_ptr, &profile);
+
+    // Start and duration of each phase in nanoseconds, in RubyStartupPhase order, -1 for an incomplete phase
+    jlong timings[RUBY_STARTUP_PHASE_COUNT * 2];
+    for (int i = 0; i < RUBY_STARTUP_PHASE_COUNT; i++) {
+        timings[i * 2] = (jlong)profile.phases[i].start_ns;
+        timings[i * 2 + 1] = profile.phases[i].completed ? (jlong)profile.phases[i].duration_ns : -1;
+    }
+
+    jlongArray result = (*env)->NewLongArray(env, RUBY_STARTUP_PHASE_COUNT * 2);
+    if (result) {
+        (*env)->SetLongArrayRegion(env, result, 0, RUBY_STARTUP_PHASE_COUNT * 2, timings);
+    }
+    return result;
+}
+
+JNIEXPORT jlongArray JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_getShardStats(JNIEnv *env, jclass clazz,
+                                                      jlong interpreter_ptr) {
+    (void) clazz;
+
+    RubyVMPoolShardStats stats[RUBY_VM_POOL_SHARD_COUNT];
+    const size_t count = ruby_interpreter_get_shard_stats((RubyInterpreter*)interpreter_ptr, stats, RUBY_VM_POOL_SHARD_COUNT);
+
+    // Worker, depth and request count of each shard, in shard order, empty without a worker pool
+    jlong values[RUBY_VM_POOL_SHARD_COUNT * 3];
+    for (size_t i = 0; i < count; i++) {
+        values[i * 3] = (jlong)stats[i].worker;
+        values[i * 3 + 1] = (jlong)stats[i].depth;
+        values[i * 3 + 2] = (jlong)stats[i].enqueued;
+    }
+
+    jlongArray result = (*env)->NewLongArray(env, (jsize)(count * 3));
+    if (result && count > 0) {
+        (*env)->SetLongArrayRegion(env, result, 0, (jsize)(count * 3), values);
+    }
+    return result;
 }
 
 JNIEXPORT jint JNICALL
@@ -41,6 +41,109 @@ Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScript(JNIEnv *env, jclass clazz,
                                                  jlong script_ptr,
                                                  jobject completion_callback);
 
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptWithFlags(JNIEnv *env, jclass clazz,
+                                                          jlong interpreter_ptr,
+                                                          jlong script_ptr,
+                                                          jint flags,
+                                                          jobject completion_callback);
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptInStream(JNIEnv *env, jclass clazz,
+                                                         jlong interpreter_ptr,
+                                                         jint stream,
+                                                         jlong script_ptr,
+                                                         jobject completion_callback);
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptSharded(JNIEnv *env, jclass clazz,
+                                                        jlong interpreter_ptr,
+                                                        jlong shard_key,
+                                                        jlong script_ptr,
+                                                        jobject completion_callback);
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScripts(JNIEnv *env, jclass clazz,
+                                                  jlong interpreter_ptr,
+                                                  jlongArray script_ptrs,
+                                                  jobject completion_callback);
+
+JNIEXPORT jlong JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_prepareScript(JNIEnv *env, jclass clazz,
+                                                 jlong interpreter_ptr,
+                                                 jlong script_ptr);
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_invokePreparedScript(JNIEnv *env, jclass clazz,
+                                                        jlong interpreter_ptr,
+                                                        jlong prepared_ptr,
+                                                        jobjectArray args,
+                                                        jobject completion_callback);
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptForResult(JNIEnv *env, jclass clazz,
+                                                          jlong interpreter_ptr,
+                                                          jlong script_ptr,
+                                                          jobject result_callback);
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptForResultWithFlags(JNIEnv *env, jclass clazz,
+                                                                   jlong interpreter_ptr,
+                                                                   jlong script_ptr,
+                                                                   jint flags,
+                                                                   jobject result_callback);
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptInStreamForResult(JNIEnv *env, jclass clazz,
+                                                                  jlong interpreter_ptr,
+                                                                  jint stream,
+                                                                  jlong script_ptr,
+                                                                  jobject result_callback);
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_invokePreparedScriptForResult(JNIEnv *env, jclass clazz,
+                                                                 jlong interpreter_ptr,
+                                                                 jlong prepared_ptr,
+                                                                 jobjectArray args,
+                                                                 jobject result_callback);
+
+JNIEXPORT void JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_releasePreparedScript(JNIEnv *env, jclass clazz,
+                                                         jlong interpreter_ptr,
+                                                         jlong prepared_ptr);
+
+JNIEXPORT jlong JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enqueueScriptWithTimeout(JNIEnv *env, jclass clazz,
+                                                            jlong interpreter_ptr,
+                                                            jlong script_ptr,
+                                                            jint timeout_millis,
+                                                            jobject completion_callback);
+
+JNIEXPORT jint JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_prewarmInterpreter(JNIEnv *env, jclass clazz,
+                                                      jlong interpreter_ptr,
+                                                      jobjectArray preload_requires,
+                                                      jobject completion_callback);
+
+JNIEXPORT jboolean JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_cancelRequest(JNIEnv *env, jclass clazz,
+                                                 jlong interpreter_ptr,
+                                                 jlong request_id);
+
+JNIEXPORT jlongArray JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_getStartupProfile(JNIEnv *env, jclass clazz,
+                                                     jlong interpreter_ptr);
+
+JNIEXPORT jboolean JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_enableWorkerPool(JNIEnv *env, jclass clazz,
+                                                    jlong interpreter_ptr,
+                                                    jint size,
+                                                    jobjectArray preload_requires);
+
+JNIEXPORT jlongArray JNICALL
+Java_com_scorbutics_rubyvm_RubyVMNative_getShardStats(JNIEnv *env, jclass clazz,
+                                                 jlong interpreter_ptr);
+
 JNIEXPORT jint JNICALL
 Java_com_scorbutics_rubyvm_RubyVMNative_enableLogging(JNIEnv *env, jclass clazz,
                                                                 jlong interpreter_ptr);
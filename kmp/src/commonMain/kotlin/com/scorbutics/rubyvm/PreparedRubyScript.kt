@@ -0,0 +1,45 @@
+package com.scorbutics.rubyvm
+
+/**
+ * A Ruby callable compiled once by the VM, created with [RubyScript.prepare].
+ *
+ * Supported argument types: null, Byte, Short, Int, Long, Float, Double, Boolean,
+ * String (passed as an UTF-8 Ruby String) and ByteArray (passed as a binary Ruby String).
+ */
+expect class PreparedRubyScript {
+    /**
+     * Enqueue a call with the given arguments.
+     *
+     * Calls are executed in order with the scripts enqueued on the interpreter.
+     *
+     * @param args The arguments of the call
+     * @param onComplete Callback invoked with 0 if the call returned, non-zero if it raised
+     * @throws IllegalArgumentException if an argument has an unsupported type
+     * @throws IllegalStateException if the handle has been destroyed
+     */
+    fun invoke(vararg args: Any?, onComplete: (exitCode: Int) -> Unit)
+
+    /**
+     * Enqueue a call and get back the value it returns,
+     * encoded in MessagePack as described in [RubyInterpreter.enqueueForResult].
+     *
+     * @param args The arguments of the call
+     * @param onComplete Callback invoked with 0 if the call returned, non-zero if it raised,
+     * and the encoded value (the error message when it raised), null if none could be delivered
+     * @throws IllegalArgumentException if an argument has an unsupported type
+     * @throws IllegalStateException if the handle has been destroyed
+     */
+    fun invokeForResult(vararg args: Any?, onComplete: (exitCode: Int, value: ByteArray?) -> Unit)
+
+    /**
+     * Let the VM forget the callable. Calls already enqueued still run.
+     */
+    fun destroy()
+}
+
+internal fun requireSupportedArgument(arg: Any?) {
+    require(
+        arg == null || arg is Byte || arg is Short || arg is Int || arg is Long ||
+            arg is Float || arg is Double || arg is Boolean || arg is String || arg is ByteArray
+    ) { "Unsupported argument type for a prepared script: ${arg!!::class.simpleName}" }
+}
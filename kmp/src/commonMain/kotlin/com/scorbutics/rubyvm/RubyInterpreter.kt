@@ -35,6 +35,39 @@ package com.scorbutics.rubyvm
  * ```
  */
 expect class RubyInterpreter {
+    /**
+     * Start the Ruby VM now, in the background, instead of on the first enqueued script.
+     *
+     * The install of the standard library, the boot of Ruby and the features of [preloadRequires]
+     * then happen before the first real script is sent. Scripts enqueued afterwards, from any thread,
+     * wait for the preload instead of starting the VM again.
+     *
+     * @param preloadRequires Features to require once the VM is up, e.g. listOf("json", "set")
+     * @param onReady Callback invoked with 0 once the VM is up and every feature is loaded,
+     * non-zero if the VM could not start or a feature could not be loaded
+     * @throws IllegalStateException if interpreter has been destroyed
+     */
+    fun prewarm(preloadRequires: List<String> = emptyList(), onReady: (exitCode: Int) -> Unit = {})
+
+    /**
+     * Run the scripts of this interpreter on several Ruby VMs at once, one worker process each (Linux and Android).
+     *
+     * A zygote process boots Ruby once, requires [preloadRequires], then forks the workers: each
+     * enqueued script goes to an idle worker, or waits until one completes its script, so scripts
+     * use every core instead of taking turns on the global interpreter lock. Scripts still start
+     * in the order they are enqueued but run concurrently, only a batch of [enqueueAll] keeps its
+     * scripts together. State kept in Ruby globals is per worker.
+     *
+     * Must be called before the first script or [prewarm], and after the other settings:
+     * the zygote is created right away, with the settings of this interpreter.
+     *
+     * @param size Number of workers, 0 for one per core
+     * @param preloadRequires Features the zygote requires before forking, shared by every worker
+     * @return true if the workers will be used, false if the zygote could not be created
+     * @throws IllegalStateException if interpreter has been destroyed
+     */
+    fun enableWorkerPool(size: Int = 0, preloadRequires: List<String> = emptyList()): Boolean
+
     /**
      * Enqueue a script for execution on the Ruby VM.
      *
@@ -47,6 +80,143 @@ expect class RubyInterpreter {
      */
     fun enqueue(script: RubyScript, onComplete: (exitCode: Int) -> Unit)
 
+    /**
+     * Enqueue a script on the worker serving [shardKey], after the scripts of the same key enqueued before.
+     *
+     * Scripts of a key always run in the same worker, so the state they keep in Ruby globals for
+     * that key is found by the next ones. Keys are hashed into shards spread over the workers; when
+     * a worker process dies, only its shards move to the other workers, and lose their state.
+     * Without a worker pool, this is the same as [enqueue].
+     *
+     * @param shardKey Key of the script, e.g. a session or entity id
+     * @param script The script to execute
+     * @param onComplete Callback invoked with the script's exit code (0 = success)
+     * @throws IllegalStateException if interpreter has been destroyed
+     */
+    fun enqueueSharded(shardKey: Long, script: RubyScript, onComplete: (exitCode: Int) -> Unit)
+
+    /**
+     * Read the worker, queue depth and script count of every shard, to spot the hot keys. Cheap: no round trip to the VM.
+     *
+     * @return Stats of every shard in shard order, empty without a worker pool
+     */
+    fun shardStats(): List<ShardStats>
+
+    /**
+     * Enqueue a script for execution and get back the value of its last expression.
+     *
+     * The value is encoded in MessagePack by the VM: nil, booleans, integers, floats,
+     * strings (binary strings as bin), symbols (as strings), arrays and hashes.
+     * Any other object is sent as its `to_s`. When the script raises, the exit code
+     * is non-zero and the value is the error message.
+     *
+     * @param script The script to execute
+     * @param onComplete Callback invoked with the script's exit code (0 = success)
+     * and its encoded value, null if none could be delivered
+     * @throws IllegalStateException if interpreter has been destroyed
+     */
+    fun enqueueForResult(script: RubyScript, onComplete: (exitCode: Int, value: ByteArray?) -> Unit)
+
+    /**
+     * Enqueue a script on the Ractor lane of the VM, to run in parallel with the main lane and the other Ractor scripts.
+     *
+     * The script runs in a Ractor of its own and completes as soon as it is done, possibly before
+     * scripts enqueued earlier. It must be Ractor-safe: touching a global variable, a constant holding
+     * a mutable object or a C method not marked Ractor-safe fails with RUBY_VM_ERROR_RACTOR_ISOLATION (-10).
+     * Methods it defines are not seen by the other scripts.
+     *
+     * @param script The script to execute
+     * @param onComplete Callback invoked with the script's exit code (0 = success)
+     * @throws IllegalStateException if interpreter has been destroyed
+     */
+    fun enqueueInRactor(script: RubyScript, onComplete: (exitCode: Int) -> Unit)
+
+    /**
+     * Same as [enqueueInRactor], with the value of the last expression encoded as in [enqueueForResult].
+     * When the script is not Ractor-safe, the exit code is RUBY_VM_ERROR_RACTOR_ISOLATION (-10) and the value is the error message.
+     *
+     * @param script The script to execute
+     * @param onComplete Callback invoked with the script's exit code (0 = success)
+     * and its encoded value, null if none could be delivered
+     * @throws IllegalStateException if interpreter has been destroyed
+     */
+    fun enqueueInRactorForResult(script: RubyScript, onComplete: (exitCode: Int, value: ByteArray?) -> Unit)
+
+    /**
+     * Enqueue an I/O-bound script on the I/O thread pool of the VM, after the scripts of the same [stream].
+     *
+     * The VM keeps starting the next scripts while this one waits on a file, a pipe or a sleep, and
+     * completes it as soon as it is done, possibly before scripts enqueued earlier. Scripts of the same
+     * stream run one after the other in enqueue order; scripts of stream 0 are not ordered at all.
+     * They run concurrently with every other script: state they share needs its own locking.
+     * With a worker pool, a stream is sent to a worker like a shard key (see [enqueueSharded]).
+     *
+     * @param stream Stream of the script, e.g. a connection or file id, 0 for none
+     * @param script The script to execute
+     * @param onComplete Callback invoked with the script's exit code (0 = success)
+     * @throws IllegalStateException if interpreter has been destroyed
+     */
+    fun enqueueInStream(stream: Int, script: RubyScript, onComplete: (exitCode: Int) -> Unit)
+
+    /**
+     * Same as [enqueueInStream], with the value of the last expression encoded as in [enqueueForResult].
+     *
+     * @param stream Stream of the script, 0 for none
+     * @param script The script to execute
+     * @param onComplete Callback invoked with the script's exit code (0 = success)
+     * and its encoded value, null if none could be delivered
+     * @throws IllegalStateException if interpreter has been destroyed
+     */
+    fun enqueueInStreamForResult(stream: Int, script: RubyScript, onComplete: (exitCode: Int, value: ByteArray?) -> Unit)
+
+    /**
+     * Enqueue a script that must complete within a given time.
+     *
+     * Past the deadline, the script is dropped if it has not started yet or interrupted
+     * if it is running, and the exit code is RUBY_VM_ERROR_TIMEOUT (-7).
+     * A Ruby method blocked in native code is only interrupted once it returns.
+     *
+     * @param script The script to execute
+     * @param timeoutMillis Time allowed from now, 0 for no deadline
+     * @param onComplete Callback invoked with the script's exit code (0 = success)
+     * @return Id of the request to give to [cancel], 0 if it could not be enqueued
+     * @throws IllegalStateException if interpreter has been destroyed
+     */
+    fun enqueueWithTimeout(script: RubyScript, timeoutMillis: Int, onComplete: (exitCode: Int) -> Unit): Long
+
+    /**
+     * Cancel a request enqueued with [enqueueWithTimeout], the same way as when its deadline expires:
+     * its exit code is RUBY_VM_ERROR_CANCELLED (-9).
+     *
+     * @param requestId Id returned by [enqueueWithTimeout]
+     * @return true if the request is being cancelled, false if it already completed
+     */
+    fun cancel(requestId: Long): Boolean
+
+    /**
+     * Read how long each phase of the VM startup took, from the start of the VM to the
+     * reply of the first script. Cheap: no round trip to the VM.
+     *
+     * Before the VM starts (first script or [prewarm]), no phase is completed. Only a VM running in
+     * this process is profiled: with a zygote or a worker pool, no phase is ever completed.
+     *
+     * @return Timings of every [StartupPhase]
+     */
+    fun startupProfile(): StartupProfile
+
+    /**
+     * Enqueue several scripts for execution on the Ruby VM in a single call.
+     *
+     * The scripts are sent together and executed back to back, in list order,
+     * after every script previously enqueued. Much cheaper than calling [enqueue]
+     * once per script when submitting many small scripts.
+     *
+     * @param scripts The scripts to execute, they must not be destroyed before completion
+     * @param onComplete Callback invoked once with the exit code of each script, in list order
+     * @throws IllegalStateException if interpreter has been destroyed
+     */
+    fun enqueueAll(scripts: List<RubyScript>, onComplete: (exitCodes: IntArray) -> Unit)
+
     /**
      * Destroy the interpreter and free all resources.
      * Must be called when the interpreter is no longer needed.
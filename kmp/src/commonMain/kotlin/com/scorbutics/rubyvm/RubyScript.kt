@@ -12,6 +12,24 @@ expect class RubyScript {
      */
     fun destroy()
 
+    /**
+     * Compile this script once into a callable kept by the interpreter's VM.
+     *
+     * The script must evaluate to something responding to `call`, typically a lambda:
+     * ```kotlin
+     * val greet = RubyScript.fromContent("->(name, times) { times.times { puts \"Hello #{name}\" } }")
+     *     .prepare(interpreter)
+     * greet.invoke("Ruby", 3) { exitCode -> println("Done: $exitCode") }
+     * ```
+     * Arguments are passed as typed values, so calling it with new values does not
+     * produce any new source to parse. This script can be destroyed once prepared.
+     *
+     * @param interpreter The interpreter whose VM keeps the callable
+     * @return A reusable handle, to destroy when no longer needed
+     * @throws IllegalStateException if the script could not be prepared
+     */
+    fun prepare(interpreter: RubyInterpreter): PreparedRubyScript
+
     companion object {
         /**
          * Create a script from Ruby source code content.
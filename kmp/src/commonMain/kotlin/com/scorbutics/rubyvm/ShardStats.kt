@@ -0,0 +1,16 @@
+package com.scorbutics.rubyvm
+
+/**
+ * Load of one shard of the worker pool, see [RubyInterpreter.shardStats].
+ *
+ * @property shard Index of the shard, the same for every key hashed into it
+ * @property worker Index of the worker serving the shard
+ * @property depth Scripts of the shard queued or running
+ * @property enqueued Scripts of the shard since the worker pool was created
+ */
+data class ShardStats(
+    val shard: Int,
+    val worker: Int,
+    val depth: Int,
+    val enqueued: Long
+)
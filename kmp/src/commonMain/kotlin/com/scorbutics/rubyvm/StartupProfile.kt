@@ -0,0 +1,64 @@
+package com.scorbutics.rubyvm
+
+/**
+ * Phases of the VM startup, in the order they start (see ruby-startup-profile.h).
+ *
+ * Phases may overlap: both archives are installed together, and the first script
+ * is usually sent before the interpreter is ready.
+ */
+enum class StartupPhase {
+    /** Socket pair between the host and the VM */
+    COMM_CHANNEL,
+    /** Until the VM thread runs */
+    THREAD_START,
+    /** Embedded pack in place: Ruby standard library and interpreter script */
+    INSTALL_PACK,
+    /** Platform specific archive of the standard library in place */
+    INSTALL_STDLIB_EXT,
+    /** Ruby environment variables */
+    SETUP_ENV,
+    /** ruby_sysinit */
+    RUBY_SYSINIT,
+    /** ruby_init */
+    RUBY_INIT,
+    /** Signal handlers restored after ruby_init */
+    SIGNALS,
+    /** Host module, embedded standard library loader, compile cache, preload profile */
+    HOST_SETUP,
+    /** ruby_options: RubyGems prelude and parse of the main script */
+    RUBY_OPTIONS,
+    /** Main script running until it serves scripts */
+    INTERPRETER_READY,
+    /** First script sent until its reply is received */
+    FIRST_SCRIPT
+}
+
+/**
+ * Timing of one startup phase.
+ *
+ * @property phase The phase
+ * @property startNanos Time the phase started, in nanoseconds since the VM start
+ * @property durationNanos Time the phase took in nanoseconds, null while it is not reached or still running
+ */
+data class StartupPhaseTiming(
+    val phase: StartupPhase,
+    val startNanos: Long,
+    val durationNanos: Long?
+) {
+    /** Time the phase ended, in nanoseconds since the VM start, null while it is not completed */
+    val endNanos: Long?
+        get() = durationNanos?.let { startNanos + it }
+}
+
+/**
+ * Where the time went while the VM started, see [RubyInterpreter.startupProfile].
+ *
+ * @property phases Timing of every phase, in [StartupPhase] order
+ */
+data class StartupProfile(val phases: List<StartupPhaseTiming>) {
+    operator fun get(phase: StartupPhase): StartupPhaseTiming = phases[phase.ordinal]
+
+    /** Time from the VM start to the reply of the first script, null until it is received */
+    val firstScriptNanos: Long?
+        get() = this[StartupPhase.FIRST_SCRIPT].endNanos
+}
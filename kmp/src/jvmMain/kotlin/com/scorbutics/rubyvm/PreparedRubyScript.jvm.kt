@@ -0,0 +1,44 @@
+package com.scorbutics.rubyvm
+
+/**
+ * JVM implementation of PreparedRubyScript using JNI.
+ */
+actual class PreparedRubyScript internal constructor(
+    private val interpreterPtr: Long,
+    internal val preparedPtr: Long
+) {
+    private var isDestroyed = false
+
+    actual fun invoke(vararg args: Any?, onComplete: (exitCode: Int) -> Unit) {
+        check(!isDestroyed) { "Prepared script has been destroyed" }
+        args.forEach(::requireSupportedArgument)
+
+        val callback = object : CompletionCallback {
+            override fun complete(exitCode: Int) {
+                onComplete(exitCode)
+            }
+        }
+
+        RubyVMNative.invokePreparedScript(interpreterPtr, preparedPtr, args, callback)
+    }
+
+    actual fun invokeForResult(vararg args: Any?, onComplete: (exitCode: Int, value: ByteArray?) -> Unit) {
+        check(!isDestroyed) { "Prepared script has been destroyed" }
+        args.forEach(::requireSupportedArgument)
+
+        val callback = object : ResultCallback {
+            override fun complete(exitCode: Int, value: ByteArray?) {
+                onComplete(exitCode, value)
+            }
+        }
+
+        RubyVMNative.invokePreparedScriptForResult(interpreterPtr, preparedPtr, args, callback)
+    }
+
+    actual fun destroy() {
+        if (!isDestroyed) {
+            RubyVMNative.releasePreparedScript(interpreterPtr, preparedPtr)
+            isDestroyed = true
+        }
+    }
+}
@@ -7,11 +7,30 @@ package com.scorbutics.rubyvm
  * to provide a Kotlin-friendly API for both Android and Desktop platforms.
  */
 actual class RubyInterpreter private constructor(
-    private val interpreterPtr: Long,
+    internal val interpreterPtr: Long,
     private val listener: LogListener
 ) {
     private var isDestroyed = false
 
+    actual fun prewarm(preloadRequires: List<String>, onReady: (exitCode: Int) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        val callback = object : CompletionCallback {
+            override fun complete(exitCode: Int) {
+                onReady(exitCode)
+            }
+        }
+
+        RubyVMNative.prewarmInterpreter(interpreterPtr, preloadRequires.toTypedArray(), callback)
+    }
+
+    actual fun enableWorkerPool(size: Int, preloadRequires: List<String>): Boolean {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+        require(size >= 0) { "Pool size must not be negative" }
+
+        return RubyVMNative.enableWorkerPool(interpreterPtr, size, preloadRequires.toTypedArray())
+    }
+
     actual fun enqueue(script: RubyScript, onComplete: (exitCode: Int) -> Unit) {
         check(!isDestroyed) { "Interpreter has been destroyed" }
 
@@ -24,6 +43,139 @@ actual class RubyInterpreter private constructor(
         RubyVMNative.enqueueScript(interpreterPtr, script.scriptPtr, callback)
     }
 
+    actual fun enqueueSharded(shardKey: Long, script: RubyScript, onComplete: (exitCode: Int) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        val callback = object : CompletionCallback {
+            override fun complete(exitCode: Int) {
+                onComplete(exitCode)
+            }
+        }
+
+        RubyVMNative.enqueueScriptSharded(interpreterPtr, shardKey, script.scriptPtr, callback)
+    }
+
+    actual fun shardStats(): List<ShardStats> {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        // Worker, depth and script count of each shard
+        val values = RubyVMNative.getShardStats(interpreterPtr)
+        return List(values.size / 3) { shard ->
+            ShardStats(
+                shard = shard,
+                worker = values[shard * 3].toInt(),
+                depth = values[shard * 3 + 1].toInt(),
+                enqueued = values[shard * 3 + 2]
+            )
+        }
+    }
+
+    actual fun enqueueForResult(script: RubyScript, onComplete: (exitCode: Int, value: ByteArray?) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        val callback = object : ResultCallback {
+            override fun complete(exitCode: Int, value: ByteArray?) {
+                onComplete(exitCode, value)
+            }
+        }
+
+        RubyVMNative.enqueueScriptForResult(interpreterPtr, script.scriptPtr, callback)
+    }
+
+    actual fun enqueueInRactor(script: RubyScript, onComplete: (exitCode: Int) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        val callback = object : CompletionCallback {
+            override fun complete(exitCode: Int) {
+                onComplete(exitCode)
+            }
+        }
+
+        RubyVMNative.enqueueScriptWithFlags(interpreterPtr, script.scriptPtr, RubyVMNative.ENQUEUE_RACTOR, callback)
+    }
+
+    actual fun enqueueInRactorForResult(script: RubyScript, onComplete: (exitCode: Int, value: ByteArray?) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        val callback = object : ResultCallback {
+            override fun complete(exitCode: Int, value: ByteArray?) {
+                onComplete(exitCode, value)
+            }
+        }
+
+        RubyVMNative.enqueueScriptForResultWithFlags(interpreterPtr, script.scriptPtr, RubyVMNative.ENQUEUE_RACTOR, callback)
+    }
+
+    actual fun enqueueInStream(stream: Int, script: RubyScript, onComplete: (exitCode: Int) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        val callback = object : CompletionCallback {
+            override fun complete(exitCode: Int) {
+                onComplete(exitCode)
+            }
+        }
+
+        RubyVMNative.enqueueScriptInStream(interpreterPtr, stream, script.scriptPtr, callback)
+    }
+
+    actual fun enqueueInStreamForResult(stream: Int, script: RubyScript, onComplete: (exitCode: Int, value: ByteArray?) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        val callback = object : ResultCallback {
+            override fun complete(exitCode: Int, value: ByteArray?) {
+                onComplete(exitCode, value)
+            }
+        }
+
+        RubyVMNative.enqueueScriptInStreamForResult(interpreterPtr, stream, script.scriptPtr, callback)
+    }
+
+    actual fun enqueueWithTimeout(script: RubyScript, timeoutMillis: Int, onComplete: (exitCode: Int) -> Unit): Long {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+        require(timeoutMillis >= 0) { "Timeout must not be negative" }
+
+        val callback = object : CompletionCallback {
+            override fun complete(exitCode: Int) {
+                onComplete(exitCode)
+            }
+        }
+
+        return RubyVMNative.enqueueScriptWithTimeout(interpreterPtr, script.scriptPtr, timeoutMillis, callback)
+    }
+
+    actual fun cancel(requestId: Long): Boolean {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        return RubyVMNative.cancelRequest(interpreterPtr, requestId)
+    }
+
+    actual fun startupProfile(): StartupProfile {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        // Start and duration of each phase, -1 for an incomplete phase
+        val timings = RubyVMNative.getStartupProfile(interpreterPtr)
+        return StartupProfile(StartupPhase.entries.map { phase ->
+            StartupPhaseTiming(
+                phase = phase,
+                startNanos = timings[phase.ordinal * 2],
+                durationNanos = timings[phase.ordinal * 2 + 1].takeIf { it >= 0 }
+            )
+        })
+    }
+
+    actual fun enqueueAll(scripts: List<RubyScript>, onComplete: (exitCodes: IntArray) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        val callback = object : BatchCompletionCallback {
+            override fun complete(exitCodes: IntArray) {
+                onComplete(exitCodes)
+            }
+        }
+
+        val scriptPtrs = LongArray(scripts.size) { index -> scripts[index].scriptPtr }
+        RubyVMNative.enqueueScripts(interpreterPtr, scriptPtrs, callback)
+    }
+
     actual fun enableLogging() {
         check(!isDestroyed) { "Interpreter has been destroyed" }
 
@@ -15,6 +15,15 @@ actual class RubyScript internal constructor(
         }
     }
 
+    actual fun prepare(interpreter: RubyInterpreter): PreparedRubyScript {
+        check(!isDestroyed) { "Script has been destroyed" }
+
+        val preparedPtr = RubyVMNative.prepareScript(interpreter.interpreterPtr, scriptPtr)
+        check(preparedPtr != 0L) { "Failed to prepare Ruby script" }
+
+        return PreparedRubyScript(interpreter.interpreterPtr, preparedPtr)
+    }
+
     actual companion object {
         actual fun fromContent(content: String): RubyScript {
             require(content.isNotBlank()) { "Script content cannot be blank" }
@@ -5,6 +5,9 @@ package com.scorbutics.rubyvm
  * Shared between RubyInterpreter and RubyScript implementations.
  */
 internal object RubyVMNative {
+    // RubyEnqueueFlags of ruby-script.h
+    const val ENQUEUE_RACTOR = 1 shl 0
+
     external fun createInterpreter(
         appPath: String,
         rubyBaseDir: String,
@@ -24,6 +27,96 @@ internal object RubyVMNative {
         callback: CompletionCallback
     )
 
+    external fun enqueueScriptWithFlags(
+        interpreterPtr: Long,
+        scriptPtr: Long,
+        flags: Int,
+        callback: CompletionCallback
+    )
+
+    external fun enqueueScriptInStream(
+        interpreterPtr: Long,
+        stream: Int,
+        scriptPtr: Long,
+        callback: CompletionCallback
+    )
+
+    external fun enqueueScriptSharded(
+        interpreterPtr: Long,
+        shardKey: Long,
+        scriptPtr: Long,
+        callback: CompletionCallback
+    )
+
+    external fun enqueueScripts(
+        interpreterPtr: Long,
+        scriptPtrs: LongArray,
+        callback: BatchCompletionCallback
+    )
+
+    external fun enqueueScriptForResult(
+        interpreterPtr: Long,
+        scriptPtr: Long,
+        callback: ResultCallback
+    )
+
+    external fun enqueueScriptForResultWithFlags(
+        interpreterPtr: Long,
+        scriptPtr: Long,
+        flags: Int,
+        callback: ResultCallback
+    )
+
+    external fun enqueueScriptInStreamForResult(
+        interpreterPtr: Long,
+        stream: Int,
+        scriptPtr: Long,
+        callback: ResultCallback
+    )
+
+    external fun prepareScript(interpreterPtr: Long, scriptPtr: Long): Long
+
+    external fun invokePreparedScript(
+        interpreterPtr: Long,
+        preparedPtr: Long,
+        args: Array<out Any?>,
+        callback: CompletionCallback
+    )
+
+    external fun invokePreparedScriptForResult(
+        interpreterPtr: Long,
+        preparedPtr: Long,
+        args: Array<out Any?>,
+        callback: ResultCallback
+    )
+
+    external fun releasePreparedScript(interpreterPtr: Long, preparedPtr: Long)
+
+    external fun enqueueScriptWithTimeout(
+        interpreterPtr: Long,
+        scriptPtr: Long,
+        timeoutMillis: Int,
+        callback: CompletionCallback
+    ): Long
+
+    external fun cancelRequest(interpreterPtr: Long, requestId: Long): Boolean
+
+    external fun prewarmInterpreter(
+        interpreterPtr: Long,
+        preloadRequires: Array<String>,
+        callback: CompletionCallback
+    ): Int
+
+    external fun enableWorkerPool(
+        interpreterPtr: Long,
+        size: Int,
+        preloadRequires: Array<String>
+    ): Boolean
+
+    external fun getStartupProfile(interpreterPtr: Long): LongArray
+
+    external fun getShardStats(interpreterPtr: Long): LongArray
+
     external fun enableLogging(interpreterPtr: Long)
 
     init {
@@ -46,3 +139,18 @@ internal interface JNILogListener {
 internal interface CompletionCallback {
     fun complete(exitCode: Int)
 }
+
+/**
+ * JNI callback interface for script completion with a value.
+ * The value is a copy of the MessagePack bytes, null when none could be delivered
+ */
+internal interface ResultCallback {
+    fun complete(exitCode: Int, value: ByteArray?)
+}
+
+/**
+ * JNI callback interface for batch completion, called once per batch
+ */
+internal interface BatchCompletionCallback {
+    fun complete(exitCodes: IntArray)
+}
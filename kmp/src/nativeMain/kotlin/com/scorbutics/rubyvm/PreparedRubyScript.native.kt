@@ -0,0 +1,102 @@
+package com.scorbutics.rubyvm
+
+import com.scorbutics.rubyvm.native.*
+import kotlinx.cinterop.*
+
+// Type aliases to avoid naming conflicts between Kotlin classes and C structs
+@OptIn(ExperimentalForeignApi::class)
+internal typealias CRubyPreparedScript = com.scorbutics.rubyvm.native.RubyPreparedScript
+
+@OptIn(ExperimentalForeignApi::class)
+internal typealias CRubyArg = com.scorbutics.rubyvm.native.RubyArg
+
+/**
+ * Native (iOS/macOS/Linux) implementation of PreparedRubyScript using cinterop.
+ */
+@OptIn(ExperimentalForeignApi::class)
+actual class PreparedRubyScript internal constructor(
+    private val interpreterPtr: CPointer<CRubyInterpreter>?,
+    internal val preparedPtr: CPointer<CRubyPreparedScript>?
+) {
+    private var isDestroyed = false
+
+    actual fun invoke(vararg args: Any?, onComplete: (exitCode: Int) -> Unit) {
+        check(!isDestroyed) { "Prepared script has been destroyed" }
+        args.forEach(::requireSupportedArgument)
+
+        // Create stable reference for the callback
+        val callbackRef = StableRef.create(onComplete)
+
+        memScoped {
+            // Arguments are copied by the VM before ruby_interpreter_invoke returns
+            val cArgs = toCArgs(args)
+
+            val completionTask = alloc<CRubyCompletionTask>().apply {
+                this.callback = staticCFunction { userData, exitCode ->
+                    val callback = userData?.asStableRef<(Int) -> Unit>()?.get()
+                    callback?.invoke(exitCode)
+                    // Dispose the stable reference
+                    userData?.asStableRef<(Int) -> Unit>()?.dispose()
+                }
+                this.user_data = callbackRef.asCPointer()
+            }
+
+            ruby_interpreter_invoke(
+                interpreterPtr,
+                preparedPtr,
+                cArgs,
+                args.size.convert(),
+                completionTask.readValue()
+            )
+        }
+    }
+
+    actual fun invokeForResult(vararg args: Any?, onComplete: (exitCode: Int, value: ByteArray?) -> Unit) {
+        check(!isDestroyed) { "Prepared script has been destroyed" }
+        args.forEach(::requireSupportedArgument)
+
+        memScoped {
+            ruby_interpreter_invoke_with_result(
+                interpreterPtr,
+                preparedPtr,
+                toCArgs(args),
+                args.size.convert(),
+                createResultTask(onComplete).readValue()
+            )
+        }
+    }
+
+    actual fun destroy() {
+        if (!isDestroyed && preparedPtr != null) {
+            ruby_interpreter_release_prepared(interpreterPtr, preparedPtr)
+            isDestroyed = true
+        }
+    }
+}
+
+/**
+ * Convert the arguments of a call, the buffers live as long as the scope
+ */
+@OptIn(ExperimentalForeignApi::class)
+private fun MemScope.toCArgs(args: Array<out Any?>): CPointer<CRubyArg> {
+    val cArgs = allocArray<CRubyArg>(args.size)
+    args.forEachIndexed { index, arg ->
+        val value = when (arg) {
+            null -> ruby_arg_nil()
+            is Float -> ruby_arg_double(arg.toDouble())
+            is Double -> ruby_arg_double(arg)
+            is Number -> ruby_arg_int64(arg.toLong())
+            is Boolean -> ruby_arg_bool(if (arg) 1 else 0)
+            is String -> {
+                val bytes = arg.encodeToByteArray()
+                ruby_arg_utf8(allocArrayOf(bytes), bytes.size.convert())
+            }
+            else -> {
+                val bytes = arg as ByteArray
+                ruby_arg_bytes(allocArrayOf(bytes), bytes.size.convert())
+            }
+        }
+        value.place(cArgs[index].ptr)
+    }
+    return cArgs
+}
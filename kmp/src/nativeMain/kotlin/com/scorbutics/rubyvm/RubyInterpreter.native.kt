@@ -14,6 +14,9 @@ internal typealias CLogListener = com.scorbutics.rubyvm.native.LogListener
 @OptIn(ExperimentalForeignApi::class)
 internal typealias CRubyCompletionTask = com.scorbutics.rubyvm.native.RubyCompletionTask
 
+@OptIn(ExperimentalForeignApi::class)
+internal typealias CRubyResultTask = com.scorbutics.rubyvm.native.RubyResultTask
+
 /**
  * Native (iOS/macOS/Linux) implementation of RubyInterpreter using cinterop.
  *
@@ -22,33 +25,231 @@ internal typealias CRubyCompletionTask = com.scorbutics.rubyvm.native.RubyComple
  */
 @OptIn(ExperimentalForeignApi::class)
 actual class RubyInterpreter private constructor(
-    private val interpreterPtr: CPointer<CRubyInterpreter>?,
+    internal val interpreterPtr: CPointer<CRubyInterpreter>?,
     private val listener: com.scorbutics.rubyvm.LogListener,
     private val stableRefHolder: StableRefHolder
 ) {
     private var isDestroyed = false
 
+    actual fun prewarm(preloadRequires: List<String>, onReady: (exitCode: Int) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        memScoped {
+            // The features are copied into the preload script before the call returns
+            ruby_interpreter_prewarm(
+                interpreterPtr,
+                preloadRequires.toCStringArray(this),
+                preloadRequires.size.convert(),
+                createCompletionTask(onReady).readValue()
+            )
+        }
+    }
+
+    actual fun enableWorkerPool(size: Int, preloadRequires: List<String>): Boolean {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+        require(size >= 0) { "Pool size must not be negative" }
+
+        // The zygote is forked before the call returns, with its own copy of the features
+        return memScoped {
+            ruby_interpreter_enable_worker_pool(
+                interpreterPtr,
+                size.convert(),
+                preloadRequires.toCStringArray(this),
+                preloadRequires.size.convert()
+            ) == 0
+        }
+    }
+
     actual fun enqueue(script: RubyScript, onComplete: (exitCode: Int) -> Unit) {
         check(!isDestroyed) { "Interpreter has been destroyed" }
         require(script.scriptPtr != null) { "Script has been destroyed" }
 
-        // Create stable reference for the callback
-        val callbackRef = StableRef.create(onComplete)
+        memScoped {
+            ruby_interpreter_enqueue(interpreterPtr, script.scriptPtr?.reinterpret(), createCompletionTask(onComplete).readValue())
+        }
+    }
+
+    actual fun enqueueSharded(shardKey: Long, script: RubyScript, onComplete: (exitCode: Int) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+        require(script.scriptPtr != null) { "Script has been destroyed" }
+
+        memScoped {
+            ruby_interpreter_enqueue_sharded(
+                interpreterPtr,
+                shardKey.convert(),
+                script.scriptPtr?.reinterpret(),
+                createCompletionTask(onComplete).readValue()
+            )
+        }
+    }
+
+    actual fun shardStats(): List<ShardStats> {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
 
-        // Create completion task with callback
-        val completionTask = nativeHeap.alloc<CRubyCompletionTask>().apply {
-            this.callback = staticCFunction { userData, exitCode ->
-                val callback = userData?.asStableRef<(Int) -> Unit>()?.get()
-                callback?.invoke(exitCode)
-                // Dispose the stable reference
-                userData?.asStableRef<(Int) -> Unit>()?.dispose()
+        return memScoped {
+            val stats = allocArray<RubyVMPoolShardStats>(RUBY_VM_POOL_SHARD_COUNT)
+            val count = ruby_interpreter_get_shard_stats(interpreterPtr, stats, RUBY_VM_POOL_SHARD_COUNT.convert()).toInt()
+            List(count) { shard ->
+                ShardStats(
+                    shard = shard,
+                    worker = stats[shard].worker.toInt(),
+                    depth = stats[shard].depth.toInt(),
+                    enqueued = stats[shard].enqueued.toLong()
+                )
             }
-            this.user_data = callbackRef.asCPointer()
         }
+    }
+
+    actual fun enqueueForResult(script: RubyScript, onComplete: (exitCode: Int, value: ByteArray?) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+        require(script.scriptPtr != null) { "Script has been destroyed" }
+
+        memScoped {
+            ruby_interpreter_enqueue_with_result(
+                interpreterPtr,
+                script.scriptPtr?.reinterpret(),
+                createResultTask(onComplete).readValue()
+            )
+        }
+    }
+
+    actual fun enqueueInRactor(script: RubyScript, onComplete: (exitCode: Int) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+        require(script.scriptPtr != null) { "Script has been destroyed" }
+
+        memScoped {
+            ruby_interpreter_enqueue_with_flags(
+                interpreterPtr,
+                script.scriptPtr?.reinterpret(),
+                RUBY_ENQUEUE_RACTOR.convert(),
+                createCompletionTask(onComplete).readValue()
+            )
+        }
+    }
+
+    actual fun enqueueInRactorForResult(script: RubyScript, onComplete: (exitCode: Int, value: ByteArray?) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+        require(script.scriptPtr != null) { "Script has been destroyed" }
+
+        memScoped {
+            ruby_interpreter_enqueue_with_result_and_flags(
+                interpreterPtr,
+                script.scriptPtr?.reinterpret(),
+                RUBY_ENQUEUE_RACTOR.convert(),
+                createResultTask(onComplete).readValue()
+            )
+        }
+    }
 
-        ruby_interpreter_enqueue(interpreterPtr, script.scriptPtr?.reinterpret(), completionTask.readValue())
+    actual fun enqueueInStream(stream: Int, script: RubyScript, onComplete: (exitCode: Int) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+        require(script.scriptPtr != null) { "Script has been destroyed" }
 
-        nativeHeap.free(completionTask)
+        memScoped {
+            ruby_interpreter_enqueue_in_stream(
+                interpreterPtr,
+                stream.convert(),
+                script.scriptPtr?.reinterpret(),
+                createCompletionTask(onComplete).readValue()
+            )
+        }
+    }
+
+    actual fun enqueueInStreamForResult(stream: Int, script: RubyScript, onComplete: (exitCode: Int, value: ByteArray?) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+        require(script.scriptPtr != null) { "Script has been destroyed" }
+
+        memScoped {
+            ruby_interpreter_enqueue_in_stream_with_result(
+                interpreterPtr,
+                stream.convert(),
+                script.scriptPtr?.reinterpret(),
+                createResultTask(onComplete).readValue()
+            )
+        }
+    }
+
+    actual fun enqueueWithTimeout(script: RubyScript, timeoutMillis: Int, onComplete: (exitCode: Int) -> Unit): Long {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+        require(script.scriptPtr != null) { "Script has been destroyed" }
+        require(timeoutMillis >= 0) { "Timeout must not be negative" }
+
+        return memScoped {
+            val requestId = alloc<ULongVar>()
+            requestId.value = 0u
+
+            ruby_interpreter_enqueue_with_deadline(
+                interpreterPtr,
+                script.scriptPtr?.reinterpret(),
+                timeoutMillis.convert(),
+                createCompletionTask(onComplete).readValue(),
+                requestId.ptr
+            )
+            requestId.value.toLong()
+        }
+    }
+
+    actual fun cancel(requestId: Long): Boolean {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        return ruby_interpreter_cancel(interpreterPtr, requestId.toULong()) == 0
+    }
+
+    actual fun startupProfile(): StartupProfile {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+
+        return memScoped {
+            val profile = alloc<RubyStartupProfile>()
+            ruby_interpreter_get_startup_profile(interpreterPtr, profile.ptr)
+            StartupProfile(StartupPhase.entries.map { phase ->
+                val timing = profile.phases[phase.ordinal]
+                StartupPhaseTiming(
+                    phase = phase,
+                    startNanos = timing.start_ns.toLong(),
+                    durationNanos = if (timing.completed != 0) timing.duration_ns.toLong() else null
+                )
+            })
+        }
+    }
+
+    actual fun enqueueAll(scripts: List<RubyScript>, onComplete: (exitCodes: IntArray) -> Unit) {
+        check(!isDestroyed) { "Interpreter has been destroyed" }
+        require(scripts.all { it.scriptPtr != null }) { "Script has been destroyed" }
+
+        if (scripts.isEmpty()) {
+            onComplete(IntArray(0))
+            return
+        }
+
+        // The VM completes the scripts of a batch in order from the same thread:
+        // the last completion delivers the whole result vector
+        val batch = BatchCompletion(scripts.size, onComplete)
+
+        memScoped {
+            val cScripts = allocArray<COpaquePointerVar>(scripts.size)
+            val completionTasks = allocArray<CRubyCompletionTask>(scripts.size)
+
+            scripts.forEachIndexed { index, script ->
+                cScripts[index] = script.scriptPtr?.reinterpret()
+
+                // Create stable reference for the callback of this script
+                val callbackRef = StableRef.create { exitCode: Int -> batch.complete(index, exitCode) }
+                completionTasks[index].callback = staticCFunction { userData, exitCode ->
+                    val callback = userData?.asStableRef<(Int) -> Unit>()?.get()
+                    callback?.invoke(exitCode)
+                    // Dispose the stable reference
+                    userData?.asStableRef<(Int) -> Unit>()?.dispose()
+                }
+                completionTasks[index].user_data = callbackRef.asCPointer()
+            }
+
+            ruby_interpreter_enqueue_batch(
+                interpreterPtr,
+                cScripts.reinterpret(),
+                scripts.size.convert(),
+                completionTasks
+            )
+        }
     }
 
     actual fun enableLogging() {
@@ -119,6 +320,60 @@ actual class RubyInterpreter private constructor(
     }
 }
 
+/**
+ * Create a completion task calling 'onComplete' once
+ */
+@OptIn(ExperimentalForeignApi::class)
+internal fun MemScope.createCompletionTask(onComplete: (Int) -> Unit): CRubyCompletionTask {
+    // Create stable reference for the callback
+    val callbackRef = StableRef.create(onComplete)
+
+    return alloc<CRubyCompletionTask>().apply {
+        this.callback = staticCFunction { userData, exitCode ->
+            val callback = userData?.asStableRef<(Int) -> Unit>()?.get()
+            callback?.invoke(exitCode)
+            // Dispose the stable reference
+            userData?.asStableRef<(Int) -> Unit>()?.dispose()
+        }
+        this.user_data = callbackRef.asCPointer()
+    }
+}
+
+/**
+ * Create a result task calling 'onComplete' once, with a copy of the value
+ * (the C buffer is only valid during the callback)
+ */
+@OptIn(ExperimentalForeignApi::class)
+internal fun MemScope.createResultTask(onComplete: (Int, ByteArray?) -> Unit): CRubyResultTask {
+    // Create stable reference for the callback
+    val callbackRef = StableRef.create(onComplete)
+
+    return alloc<CRubyResultTask>().apply {
+        this.callback = staticCFunction { userData, exitCode, value, length ->
+            val bytes = value?.reinterpret<ByteVar>()?.readBytes(length.toInt())
+            val callback = userData?.asStableRef<(Int, ByteArray?) -> Unit>()?.get()
+            callback?.invoke(exitCode, bytes)
+            // Dispose the stable reference
+            userData?.asStableRef<(Int, ByteArray?) -> Unit>()?.dispose()
+        }
+        this.user_data = callbackRef.asCPointer()
+    }
+}
+
+/**
+ * Collects the exit codes of a batch until its last script completes
+ */
+private class BatchCompletion(size: Int, private val onComplete: (IntArray) -> Unit) {
+    private val exitCodes = IntArray(size) { 1 }
+
+    fun complete(index: Int, exitCode: Int) {
+        exitCodes[index] = exitCode
+        if (index == exitCodes.size - 1) {
+            onComplete(exitCodes)
+        }
+    }
+}
+
 /**
  * Helper class to hold stable references and dispose them together
  */
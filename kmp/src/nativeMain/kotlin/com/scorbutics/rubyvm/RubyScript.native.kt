@@ -25,6 +25,15 @@ actual class RubyScript internal constructor(
         }
     }
 
+    actual fun prepare(interpreter: RubyInterpreter): PreparedRubyScript {
+        check(!isDestroyed && scriptPtr != null) { "Script has been destroyed" }
+
+        val preparedPtr = ruby_interpreter_prepare(interpreter.interpreterPtr, scriptPtr)
+        check(preparedPtr != null) { "Failed to prepare Ruby script" }
+
+        return PreparedRubyScript(interpreter.interpreterPtr, preparedPtr)
+    }
+
     actual companion object {
         actual fun fromContent(content: String): RubyScript {
             require(content.isNotBlank()) { "Script content cannot be blank" }
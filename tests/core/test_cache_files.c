@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ruby-cache-files.h"
+
+/**
+ * Cache Files Tests
+ *
+ * Tests the file helpers of the on-disk caches (compiled sources, load path map), without starting a Ruby VM.
+ * Verifies that:
+ * 1. Cache files are written whole, with their missing parent directories, and nothing is left aside
+ * 2. The size of a cache directory counts every file below it
+ * 3. The tree modification time follows added files, but not the hidden nor the skipped directories
+ * 4. Stale caches are removed, the current one and the hidden entries are kept
+ */
+
+static int exists(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+static int write_file(const char* directory, const char* name, size_t size) {
+    char path[512];
+    char content[256];
+    memset(content, 'x', sizeof(content));
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    return ruby_cache_make_parents(path) == 0 ? ruby_cache_write_file(path, NULL, 0, content, size) : -1;
+}
+
+int main(void) {
+    int failures = 0;
+    char root[] = "/tmp/test_cache_files_XXXXXX";
+    char path[512];
+
+    printf("=== Cache Files Tests ===\n\n");
+
+    if (!mkdtemp(root)) {
+        printf("Cannot create a temporary directory\n");
+        return 1;
+    }
+
+    // Test 1: Atomic writes
+    printf("Test 1: Write a cache file\n");
+    snprintf(path, sizeof(path), "%s/a/b/entry", root);
+    const char header[] = "HEAD";
+    const char data[] = "binary";
+    char read_back[16] = {0};
+    char temp_path[600];
+    snprintf(temp_path, sizeof(temp_path), "%s.%ld.tmp", path, (long)getpid());
+    FILE* file = NULL;
+    if (ruby_cache_make_parents(path) != 0 || ruby_cache_write_file(path, header, 4, data, 6) != 0 ||
+        (file = fopen(path, "rb")) == NULL || fread(read_back, 1, sizeof(read_back), file) != 10 ||
+        memcmp(read_back, "HEADbinary", 10) != 0 || exists(temp_path)) {
+        printf("  FAIL: The file should hold the header then the data\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+    if (file) {
+        fclose(file);
+    }
+
+    // Test 2: Directory size
+    printf("\nTest 2: Size of a cache directory\n");
+    snprintf(path, sizeof(path), "%s/size", root);
+    write_file(path, "one", 100);
+    write_file(path, "sub/two", 200);
+    write_file(path, "sub/deeper/three", 56);
+    if (ruby_cache_directory_size(path) != 356) {
+        printf("  FAIL: Expected 356 bytes, got %llu\n", (unsigned long long)ruby_cache_directory_size(path));
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+    ruby_cache_remove_tree(path);
+    if (exists(path) || ruby_cache_directory_size(path) != 0) {
+        printf("  FAIL: The directory should be removed\n");
+        failures++;
+    }
+
+    // Test 3: Tree modification time
+    printf("\nTest 3: Tree modification time\n");
+    char skipped[512];
+    snprintf(path, sizeof(path), "%s/tree", root);
+    snprintf(skipped, sizeof(skipped), "%s/tree/stdlib", root);
+    write_file(path, "app/lib/feature.rb", 10);
+    write_file(path, "stdlib/set.rb", 10);
+    write_file(path, ".cache/entry", 10);
+    const int64_t before = ruby_cache_latest_mtime(path, skipped);
+    usleep(20000);
+    write_file(path, ".cache/other", 10);
+    write_file(path, "stdlib/json.rb", 10);
+    const int64_t unchanged = ruby_cache_latest_mtime(path, skipped);
+    write_file(path, "app/lib/added.rb", 10);
+    const int64_t after = ruby_cache_latest_mtime(path, skipped);
+    if (before == 0 || unchanged != before || after <= before) {
+        printf("  FAIL: Only the file added to app/lib should change the time\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 4: Stale caches
+    printf("\nTest 4: Remove the stale caches\n");
+    char kept[512];
+    char hidden[512];
+    char stale[512];
+    snprintf(path, sizeof(path), "%s/versions", root);
+    write_file(path, "3.3.0-current/entry", 10);
+    write_file(path, "3.1.0-stale/entry", 10);
+    write_file(path, ".hidden", 10);
+    snprintf(kept, sizeof(kept), "%s/versions/3.3.0-current/entry", root);
+    snprintf(hidden, sizeof(hidden), "%s/versions/.hidden", root);
+    snprintf(stale, sizeof(stale), "%s/versions/3.1.0-stale", root);
+    ruby_cache_remove_stale(path, "3.3.0-current");
+    if (!exists(kept) || !exists(hidden) || exists(stale)) {
+        printf("  FAIL: Only 3.1.0-stale should be removed\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    ruby_cache_remove_tree(root);
+
+    // Summary
+    printf("\n=== Test Summary ===\n");
+    printf("Total failures: %d\n", failures);
+
+    if (failures == 0) {
+        printf("All tests PASSED!\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED!\n");
+        return 1;
+    }
+}
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ruby-deadline-heap.h"
+#include "ruby-dispatch-queue.h"
+#include "ruby-pending-table.h"
+#include "ruby-wire-protocol.h"
+
+/**
+ * Cancellation Tests
+ *
+ * Tests the bookkeeping behind request deadlines and cancellation, without starting a Ruby VM.
+ * Verifies that:
+ * 1. Deadlines come out of the heap earliest first
+ * 2. Queued requests get consecutive ids and are cancelled in place, then skipped by the consumer
+ * 3. A request popped but not handed over yet reports its cancellation on hand over
+ * 4. An in-flight request is only flagged once, and keeps the wire flags it was sent with
+ * 5. A request left in flight does not hold back the ones reserved after it
+ */
+
+static int completed_status = 0;
+static int completed_count = 0;
+
+static void on_complete(void* userdata, int result) {
+    (void)userdata;
+    completed_status = result;
+    completed_count++;
+}
+
+static RubyDispatchItem make_item(void) {
+    RubyDispatchItem item = {
+        .request_id = 0,
+        .script = NULL,
+        .on_complete = ruby_completion_task_create(on_complete, NULL),
+        .on_result = { 0 },
+        .batch = NULL,
+        .call = NULL,
+        .payload_ring_end = 0,
+        .cancelled = 0
+    };
+    return item;
+}
+
+int main(void) {
+    int failures = 0;
+
+    printf("=== Cancellation Tests ===\n\n");
+
+    // Test 1: Deadline ordering
+    printf("Test 1: Deadlines are popped earliest first\n");
+    RubyDeadlineHeap heap;
+    ruby_deadline_heap_init(&heap);
+    const uint64_t deadlines[] = { 50, 10, 40, 30, 20, 10 };
+    int heap_ok = 1;
+    for (size_t i = 0; i < sizeof(deadlines) / sizeof(deadlines[0]); i++) {
+        heap_ok &= ruby_deadline_heap_push(&heap, deadlines[i], i + 1) == 0;
+    }
+    // Enough entries to grow the storage
+    for (uint64_t i = 0; i < 200; i++) {
+        heap_ok &= ruby_deadline_heap_push(&heap, 1000 - i, 100 + i) == 0;
+    }
+    uint64_t previous = 0;
+    size_t popped = 0;
+    RubyDeadline deadline;
+    while (ruby_deadline_heap_pop(&heap, &deadline) == 0) {
+        heap_ok &= deadline.deadline_ns >= previous;
+        previous = deadline.deadline_ns;
+        popped++;
+    }
+    heap_ok &= popped == 206 && ruby_deadline_heap_peek(&heap) == NULL;
+    ruby_deadline_heap_destroy(&heap);
+    if (!heap_ok) {
+        printf("  FAIL: Deadlines out of order or lost (%zu popped)\n", popped);
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 2: Cancelling queued requests
+    printf("\nTest 2: Queued requests are cancelled in place\n");
+    RubyDispatchQueue queue;
+    if (ruby_dispatch_queue_init(&queue, 4) != 0) {
+        printf("  FAIL: Could not create the queue\n");
+        return 1;
+    }
+    uint64_t ids[3] = { 0 };
+    const RubyDispatchItem item = make_item();
+    for (int i = 0; i < 3; i++) {
+        ruby_dispatch_queue_push(&queue, &item, &ids[i]);
+    }
+    RubyDispatchItem cancelled;
+    RubyDispatchItem out;
+    if (ids[0] != 1 || ids[1] != 2 || ids[2] != 3) {
+        printf("  FAIL: Expected ids 1 2 3, got %llu %llu %llu\n",
+               (unsigned long long)ids[0], (unsigned long long)ids[1], (unsigned long long)ids[2]);
+        failures++;
+    } else if (ruby_dispatch_queue_cancel(&queue, ids[1], -9, &cancelled) != 1 || cancelled.request_id != ids[1]) {
+        printf("  FAIL: The second request was not cancelled in the queue\n");
+        failures++;
+    } else if (ruby_dispatch_queue_cancel(&queue, ids[1], -9, &cancelled) != -1
+            || ruby_dispatch_queue_cancel(&queue, 42, -9, &cancelled) != -1) {
+        printf("  FAIL: Cancelling twice or an unknown id should fail\n");
+        failures++;
+    } else {
+        ruby_dispatch_queue_pop(&queue, &out);
+        ruby_dispatch_queue_hand_over(&queue);
+        const uint64_t first = out.request_id;
+        ruby_dispatch_queue_pop(&queue, &out);
+        ruby_dispatch_queue_hand_over(&queue);
+        if (first != ids[0] || out.request_id != ids[2]) {
+            printf("  FAIL: Expected to pop %llu then %llu, got %llu then %llu\n",
+                   (unsigned long long)ids[0], (unsigned long long)ids[2],
+                   (unsigned long long)first, (unsigned long long)out.request_id);
+            failures++;
+        } else {
+            printf("  PASS\n");
+        }
+    }
+
+    // Test 3: Cancelling a request in the consumer's hands
+    printf("\nTest 3: A popped request reports its cancellation on hand over\n");
+    uint64_t id = 0;
+    ruby_dispatch_queue_push(&queue, &item, &id);
+    ruby_dispatch_queue_pop(&queue, &out);
+    const int in_hand = ruby_dispatch_queue_cancel(&queue, id, -7, &cancelled);
+    const int status = ruby_dispatch_queue_hand_over(&queue);
+    if (in_hand != 0 || status != -7) {
+        printf("  FAIL: Expected 0 then status -7, got %d then %d\n", in_hand, status);
+        failures++;
+    } else if (ruby_dispatch_queue_cancel(&queue, id, -7, &cancelled) != -1) {
+        printf("  FAIL: A handed over request should no longer be cancelled through the queue\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+    ruby_dispatch_queue_close(&queue);
+    ruby_dispatch_queue_destroy(&queue);
+
+    // Test 4: Cancelling an in-flight request
+    printf("\nTest 4: An in-flight request is flagged once and keeps its wire flags\n");
+    RubyPendingTable table;
+    if (ruby_pending_table_init(&table, 4) != 0) {
+        printf("  FAIL: Could not create the pending table\n");
+        return 1;
+    }
+    RubyDispatchItem ractor_item = item;
+    ractor_item.wire_flags = RUBY_WIRE_FLAG_RACTOR;
+    ruby_pending_table_reserve(&table, 7, &ractor_item);
+    uint16_t wire_flags = 0;
+    const int flags_found = ruby_pending_table_get_wire_flags(&table, 7, &wire_flags);
+    const int unknown_flags = ruby_pending_table_get_wire_flags(&table, 8, &wire_flags);
+    const int first_cancel = ruby_pending_table_request_cancel(&table, 7);
+    const int second_cancel = ruby_pending_table_request_cancel(&table, 7);
+    const int unknown_cancel = ruby_pending_table_request_cancel(&table, 8);
+    if (first_cancel != 0 || second_cancel != -1 || unknown_cancel != -1) {
+        printf("  FAIL: Expected 0 -1 -1, got %d %d %d\n", first_cancel, second_cancel, unknown_cancel);
+        failures++;
+    } else if (flags_found != 0 || unknown_flags != -1 || wire_flags != RUBY_WIRE_FLAG_RACTOR) {
+        printf("  FAIL: Expected the Ractor flag, got %d %d 0x%x\n", flags_found, unknown_flags, wire_flags);
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+    ruby_pending_table_close(&table, -1);
+    ruby_pending_table_destroy(&table);
+
+    if (completed_count != 1 || completed_status != -1) {
+        printf("\nFAIL: Closing the table should have completed the in-flight request\n");
+        failures++;
+    }
+
+    // Test 5: A long request keeps its entry while many later ones come and go
+    printf("\nTest 5: A request left in flight does not hold back the later ones\n");
+    if (ruby_pending_table_init(&table, 4) != 0) {
+        printf("  FAIL: Could not create the pending table\n");
+        return 1;
+    }
+    ruby_pending_table_reserve(&table, 1, &item);
+    int lost = 0;
+    for (uint64_t id = 2; id < 100; id += 3) {
+        // Three at once, sharing probe sequences with the long request
+        ruby_pending_table_reserve(&table, id, &item);
+        ruby_pending_table_reserve(&table, id + 1, &item);
+        ruby_pending_table_reserve(&table, id + 2, &item);
+        RubyPendingRequest request;
+        lost += ruby_pending_table_take(&table, id + 1, &request) != 0;
+        lost += ruby_pending_table_take(&table, id, &request) != 0;
+        lost += ruby_pending_table_take(&table, id + 2, &request) != 0;
+    }
+    const int long_cancel = ruby_pending_table_request_cancel(&table, 1);
+    RubyPendingRequest long_request;
+    const int long_take = ruby_pending_table_take(&table, 1, &long_request);
+    if (lost != 0 || long_cancel != 0 || long_take != 0 || !long_request.cancel_requested || table.count != 0) {
+        printf("  FAIL: Expected every request found, got %d lost, cancel %d, take %d, %zu left\n",
+               lost, long_cancel, long_take, table.count);
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+    ruby_pending_table_close(&table, -1);
+    ruby_pending_table_destroy(&table);
+
+    // Summary
+    printf("\n=== Test Summary ===\n");
+    printf("Total failures: %d\n", failures);
+
+    if (failures == 0) {
+        printf("All tests PASSED!\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED!\n");
+        return 1;
+    }
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "embedded_pack.h"
+#include "use_direct_memory.h"
+
+/**
+ * Embedded Pack Tests
+ *
+ * Tests the lookup of the files packed at build time, without starting a Ruby VM.
+ * Verifies that:
+ * 1. Every entry is found by its path, at its own content
+ * 2. Unknown paths are not found, whatever slot they hash to
+ * 3. Contents are null-terminated and aligned, entries are sorted by path
+ * 4. The files of use_direct_memory.h come from the pack
+ */
+
+int main(void) {
+    int failures = 0;
+    const size_t count = embedded_pack_count();
+
+    printf("=== Embedded Pack Tests ===\n\n");
+
+    // Test 1: Every entry is found
+    printf("Test 1: Lookup of every entry\n");
+    size_t misses = 0;
+    for (size_t i = 0; i < count; i++) {
+        const char* path = NULL;
+        size_t size = 0;
+        size_t found_size = 0;
+        const char* content = embedded_pack_entry(i, &path, &size);
+        if (embedded_pack_find(path, &found_size) != content || found_size != size) {
+            if (misses++ < 5) {
+                printf("  %s is not found\n", path);
+            }
+        }
+    }
+    if (count == 0 || misses > 0) {
+        printf("  FAIL: %zu of %zu entries not found\n", misses, count);
+        failures++;
+    } else {
+        printf("  PASS (%zu entries)\n", count);
+    }
+
+    // Test 2: Unknown paths, including near misses of real ones
+    printf("\nTest 2: Unknown paths\n");
+    size_t false_hits = 0;
+    char path[1024];
+    for (size_t i = 0; i < count; i++) {
+        const char* known = NULL;
+        embedded_pack_entry(i, &known, NULL);
+        snprintf(path, sizeof(path), "%s~", known);
+        false_hits += embedded_pack_find(path, NULL) != NULL;
+        snprintf(path, sizeof(path), "x%s", known);
+        false_hits += embedded_pack_find(path, NULL) != NULL;
+    }
+    if (false_hits > 0 || embedded_pack_find("", NULL) != NULL || embedded_pack_find(NULL, NULL) != NULL ||
+        embedded_pack_entry(count, NULL, NULL) != NULL) {
+        printf("  FAIL: %zu unknown paths found\n", false_hits);
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 3: Layout
+    printf("\nTest 3: Layout of the entries\n");
+    size_t bad_entries = 0;
+    const char* previous_path = NULL;
+    for (size_t i = 0; i < count; i++) {
+        const char* entry_path = NULL;
+        size_t size = 0;
+        const char* content = embedded_pack_entry(i, &entry_path, &size);
+        if (content[size] != '\0' || ((uintptr_t)content % 16) != 0 ||
+            (previous_path && strcmp(previous_path, entry_path) >= 0)) {
+            bad_entries++;
+        }
+        previous_path = entry_path;
+    }
+    if (bad_entries > 0 || embedded_pack_fingerprint() == 0) {
+        printf("  FAIL: %zu entries are misplaced\n", bad_entries);
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 4: Direct memory access
+    printf("\nTest 4: In-memory files\n");
+    size_t size = 0;
+    const char* content = embedded_pack_find("fifo_interpreter.rb", &size);
+    if (!content || get_in_memory_file_content("fifo_interpreter.rb") != content ||
+        get_in_memory_file_size("fifo_interpreter.rb") != size || is_file_in_memory("no_such_file.rb")) {
+        printf("  FAIL: fifo_interpreter.rb should be read from the pack\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Summary
+    printf("\n=== Test Summary ===\n");
+    printf("Total failures: %d\n", failures);
+
+    if (failures == 0) {
+        printf("All tests PASSED!\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED!\n");
+        return 1;
+    }
+}
@@ -0,0 +1,146 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#include "install.h"
+#include "embedded_vfs.h"
+
+/**
+ * Embedded VFS Tests
+ *
+ * Tests the in-memory view of the embedded standard library against an extracted copy, without starting a Ruby VM.
+ * Verifies that:
+ * 1. The VFS is available, unknown paths and files out of the standard library are not found
+ * 2. Every source of the VFS has the content of the extracted file
+ * 3. An install for the VFS writes none of the served sources, and is told apart from a full install
+ */
+
+// State of the current directory walk
+static size_t g_root_length;
+static int g_served_files;
+static int g_mismatches;
+
+static int remove_entry(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    (void)st;
+    (void)type;
+    (void)ftw;
+    return remove(path);
+}
+
+// Compare each installed file held by the VFS with its in-memory copy
+static int compare_with_vfs(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    (void)ftw;
+    const char* relative_path = path + g_root_length + 1;
+    if (type != FTW_F || !embedded_vfs_contains(relative_path)) return 0;
+
+    g_served_files++;
+    size_t size = 0;
+    const char* content = embedded_vfs_map(relative_path, &size);
+    char* expected = malloc((size_t)st->st_size + 1);
+    FILE* file = fopen(path, "rb");
+    size_t bytes_read = 0;
+    if (file && expected) {
+        bytes_read = fread(expected, 1, (size_t)st->st_size, file);
+    }
+    if (file) fclose(file);
+
+    if (!content || !expected || size != bytes_read || size != (size_t)st->st_size ||
+        memcmp(content, expected, size) != 0) {
+        if (g_mismatches++ < 5) {
+            printf("  %s differs from its VFS copy\n", relative_path);
+        }
+    }
+    free(expected);
+    return 0;
+}
+
+// Count the installed files that the VFS would have served
+static int count_served(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    (void)st;
+    (void)ftw;
+    if (type == FTW_F && embedded_vfs_contains(path + g_root_length + 1)) {
+        g_served_files++;
+    }
+    return 0;
+}
+
+int main(void) {
+    int failures = 0;
+    char full_dir[] = "/tmp/ruby-vm-vfs-full-XXXXXX";
+    char vfs_dir[] = "/tmp/ruby-vm-vfs-only-XXXXXX";
+    char path[1024];
+    struct stat st;
+
+    printf("=== Embedded VFS Tests ===\n\n");
+
+    if (!mkdtemp(full_dir) || !mkdtemp(vfs_dir)) {
+        printf("FAIL: Could not create a temporary directory\n");
+        return 1;
+    }
+
+    // Test 1: Index
+    printf("Test 1: Index\n");
+    if (embedded_vfs_init() != 0) {
+        printf("  FAIL: The embedded standard library should be available\n");
+        failures++;
+    } else if (embedded_vfs_contains("no/such/file.rb") || embedded_vfs_map("no/such/file.rb", NULL) != NULL) {
+        printf("  FAIL: A missing file should not be found\n");
+        failures++;
+    } else if (embedded_vfs_contains("fifo_interpreter.rb")) {
+        printf("  FAIL: fifo_interpreter.rb is not part of the standard library\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 2: Content, against a full install
+    printf("\nTest 2: Sources match the extracted files\n");
+    g_root_length = strlen(full_dir);
+    g_served_files = 0;
+    g_mismatches = 0;
+    if (install_embedded_files(full_dir) != 0) {
+        printf("  FAIL: Full installation should succeed\n");
+        failures++;
+    } else if (nftw(full_dir, compare_with_vfs, 16, FTW_PHYS) != 0 || g_served_files == 0 || g_mismatches > 0) {
+        printf("  FAIL: %d of %d sources differ\n", g_mismatches, g_served_files);
+        failures++;
+    } else {
+        printf("  PASS (%d sources)\n", g_served_files);
+    }
+
+    // Test 3: Install leaving the sources to the VFS
+    printf("\nTest 3: Sources served by the VFS are not extracted\n");
+    g_root_length = strlen(vfs_dir);
+    g_served_files = 0;
+    snprintf(path, sizeof(path), "%s/fifo_interpreter.rb", vfs_dir);
+    if (install_embedded_files_except_vfs(vfs_dir) != 0 || stat(path, &st) != 0) {
+        printf("  FAIL: Installation for the VFS should succeed\n");
+        failures++;
+    } else if (nftw(vfs_dir, count_served, 16, FTW_PHYS) != 0 || g_served_files != 0) {
+        printf("  FAIL: %d sources were extracted\n", g_served_files);
+        failures++;
+    } else if (installation_needed(vfs_dir) != 1) {
+        printf("  FAIL: An install for the VFS should not pass for a full install\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    nftw(full_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    nftw(vfs_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+    // Summary
+    printf("\n=== Test Summary ===\n");
+    printf("Total failures: %d\n", failures);
+
+    if (failures == 0) {
+        printf("All tests PASSED!\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED!\n");
+        return 1;
+    }
+}
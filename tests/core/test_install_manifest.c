@@ -0,0 +1,189 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "install.h"
+#include "use_direct_memory.h"
+
+/**
+ * Install Manifest Tests
+ *
+ * Tests the installation of the embedded files into a temporary directory, without starting a Ruby VM.
+ * Verifies that:
+ * 1. A fresh directory needs an installation, and no longer does once installed
+ * 2. A warm start leaves the installed files untouched
+ * 3. An install without manifest (interrupted) is completed
+ * 4. A corrupted file is detected and rewritten by a repair
+ * 5. An install started in the background can be waited for, stage by stage, then reports its result
+ */
+
+static int remove_entry(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    (void)st;
+    (void)type;
+    (void)ftw;
+    return remove(path);
+}
+
+static pthread_mutex_t g_completion_lock = PTHREAD_MUTEX_INITIALIZER;
+static int g_completion_calls;
+static int g_completion_result = -2;
+
+static void on_install_complete(int result, void* user_data) {
+    (void)user_data;
+    pthread_mutex_lock(&g_completion_lock);
+    g_completion_calls++;
+    g_completion_result = result;
+    pthread_mutex_unlock(&g_completion_lock);
+}
+
+// Whether the installed FIFO interpreter is identical to the embedded one
+static int fifo_interpreter_intact(const char* install_dir) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/fifo_interpreter.rb", install_dir);
+
+    const size_t size = get_in_memory_file_size("fifo_interpreter.rb");
+    char* content = malloc(size + 1);
+    FILE* file = fopen(path, "rb");
+    size_t bytes_read = 0;
+    if (file && content) {
+        bytes_read = fread(content, 1, size + 1, file);
+    }
+    if (file) fclose(file);
+
+    const int intact = content && bytes_read == size &&
+                       memcmp(content, get_in_memory_file_content("fifo_interpreter.rb"), size) == 0;
+    free(content);
+    return intact;
+}
+
+int main(void) {
+    int failures = 0;
+    char install_dir[] = "/tmp/ruby-vm-install-XXXXXX";
+    char path[1024];
+    struct stat st;
+
+    printf("=== Install Manifest Tests ===\n\n");
+
+    if (!mkdtemp(install_dir)) {
+        printf("FAIL: Could not create a temporary directory\n");
+        return 1;
+    }
+
+    // Test 1: Fresh install
+    printf("Test 1: Fresh install\n");
+    if (installation_needed(install_dir) != 1) {
+        printf("  FAIL: An empty directory should need an installation\n");
+        failures++;
+    } else if (install_embedded_files(install_dir) != 0 || installation_needed(install_dir) != 0) {
+        printf("  FAIL: Installation should succeed and record a matching manifest\n");
+        failures++;
+    } else if (!fifo_interpreter_intact(install_dir)) {
+        printf("  FAIL: fifo_interpreter.rb differs from the embedded file\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 2: Warm start, a file removed behind the manifest's back stays removed
+    printf("\nTest 2: Warm start does not extract\n");
+    snprintf(path, sizeof(path), "%s/fifo_interpreter.rb", install_dir);
+    unlink(path);
+    if (install_embedded_files(install_dir) != 0 || stat(path, &st) == 0) {
+        printf("  FAIL: A matching manifest should skip the installation\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 3: Interrupted install, the manifest is only written at the end
+    printf("\nTest 3: An install without manifest is completed\n");
+    snprintf(path, sizeof(path), "%s/.install-manifest", install_dir);
+    unlink(path);
+    if (installation_needed(install_dir) != 1) {
+        printf("  FAIL: A directory without manifest should need an installation\n");
+        failures++;
+    } else if (install_embedded_files(install_dir) != 0 || !fifo_interpreter_intact(install_dir)) {
+        printf("  FAIL: The missing file should have been installed again\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 4: Corrupted file of the same size
+    printf("\nTest 4: A corrupted file is repaired\n");
+    snprintf(path, sizeof(path), "%s/fifo_interpreter.rb", install_dir);
+    FILE* file = fopen(path, "r+b");
+    if (file) {
+        fputc('#', file);
+        fputc('!', file);
+        fputc('X', file);
+        fclose(file);
+    }
+    if (repair_embedded_files(install_dir) != 0 || !fifo_interpreter_intact(install_dir)) {
+        printf("  FAIL: The corrupted file should have been rewritten\n");
+        failures++;
+    } else if (installation_needed(install_dir) != 0) {
+        printf("  FAIL: A repair should record the install again\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 5: Background install
+    printf("\nTest 5: An install started in the background is waited for\n");
+    snprintf(path, sizeof(path), "%s/.install-manifest", install_dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/fifo_interpreter.rb", install_dir);
+    unlink(path);
+    if (install_embedded_files_start(install_dir, 0, on_install_complete, NULL) != 0) {
+        printf("  FAIL: The install thread should start\n");
+        failures++;
+    } else if (install_wait(INSTALL_STAGE_SOURCES) != 0 || !fifo_interpreter_intact(install_dir)) {
+        printf("  FAIL: The sources should be in place once their stage is reached\n");
+        failures++;
+    } else if (install_wait_file("not/embedded.rb") != 0) {
+        printf("  FAIL: A file outside of the install should not be waited for\n");
+        failures++;
+    } else if (install_wait(INSTALL_STAGE_COMPLETE) != 0 || install_pending() || installation_needed(install_dir) != 0) {
+        printf("  FAIL: A complete install should record its manifest\n");
+        failures++;
+    } else {
+        // Called on the install thread, right after the install ends
+        int calls = 0;
+        int result = -2;
+        const struct timespec poll_interval = { 0, 10000000 };
+        for (int i = 0; i < 500 && calls == 0; i++) {
+            pthread_mutex_lock(&g_completion_lock);
+            calls = g_completion_calls;
+            result = g_completion_result;
+            pthread_mutex_unlock(&g_completion_lock);
+            if (calls == 0) nanosleep(&poll_interval, NULL);
+        }
+        if (calls != 1 || result != 0) {
+            printf("  FAIL: The completion should be called once with 0, got %d call(s) with %d\n", calls, result);
+            failures++;
+        } else {
+            printf("  PASS\n");
+        }
+    }
+
+    nftw(install_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+    // Summary
+    printf("\n=== Test Summary ===\n");
+    printf("Total failures: %d\n", failures);
+
+    if (failures == 0) {
+        printf("All tests PASSED!\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED!\n");
+        return 1;
+    }
+}
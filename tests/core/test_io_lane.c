@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "ruby-interpreter.h"
+#include "ruby-script.h"
+
+/**
+ * I/O Lane Tests
+ *
+ * Starts a Ruby VM and checks that a script answered late does not hold back the queue.
+ * Verifies that:
+ * 1. While one long script sleeps on the I/O thread pool, more than MAX_IN_FLIGHT_REQUESTS
+ *    main lane scripts sent after it all complete
+ * 2. The long script completes afterwards
+ */
+
+#define MAIN_LANE_SCRIPTS (MAX_IN_FLIGHT_REQUESTS + 44)
+
+static volatile int main_lane_completed = 0;
+static volatile int main_lane_failed = 0;
+static volatile int long_script_status = -1;
+static volatile int long_script_done = 0;
+
+static void on_main_lane_completed(void* context, int result) {
+    (void)context;
+    if (result != 0) {
+        __atomic_add_fetch(&main_lane_failed, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch(&main_lane_completed, 1, __ATOMIC_RELEASE);
+}
+
+static void on_long_script_completed(void* context, int result) {
+    (void)context;
+    long_script_status = result;
+    __atomic_store_n(&long_script_done, 1, __ATOMIC_RELEASE);
+}
+
+static void on_log(LogListener* listener, const char* line) {
+    (void)listener;
+    (void)line;
+}
+
+static void on_log_error(LogListener* listener, const char* line) {
+    (void)listener;
+    fprintf(stderr, "[Ruby Error] %s\n", line);
+}
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// Wait until 'flag' reaches 'expected', at most 'timeout' seconds
+static int wait_for(volatile int* flag, int expected, double timeout) {
+    const double deadline = now_seconds() + timeout;
+    while (__atomic_load_n(flag, __ATOMIC_ACQUIRE) < expected) {
+        if (now_seconds() > deadline) return -1;
+        usleep(1000);
+    }
+    return 0;
+}
+
+int main(void) {
+    int failures = 0;
+
+    printf("=== I/O Lane Tests ===\n\n");
+
+    LogListener listener = {
+        .context = NULL,
+        .user_data = NULL,
+        .accept = on_log,
+        .on_log_error = on_log_error
+    };
+
+    RubyInterpreter* interpreter = ruby_interpreter_create(".", "./ruby", "./lib", listener);
+    if (!interpreter) {
+        printf("FAIL: Could not create the interpreter\n");
+        return 1;
+    }
+
+    const char* long_source = "sleep 3; :done";
+    const char* short_source = "1 + 1";
+    RubyScript* long_script = ruby_script_create_from_content(long_source, strlen(long_source));
+    RubyScript* short_script = ruby_script_create_from_content(short_source, strlen(short_source));
+    if (!long_script || !short_script) {
+        printf("FAIL: Could not create the scripts\n");
+        return 1;
+    }
+
+    // Test 1: The main lane keeps flowing behind a long I/O script
+    printf("Test 1: %d main lane scripts complete behind a long I/O script\n", MAIN_LANE_SCRIPTS);
+    ruby_interpreter_enqueue_with_flags(interpreter, long_script, RUBY_ENQUEUE_IO,
+                                        ruby_completion_task_create(on_long_script_completed, NULL));
+    for (int i = 0; i < MAIN_LANE_SCRIPTS; i++) {
+        ruby_interpreter_enqueue(interpreter, short_script, ruby_completion_task_create(on_main_lane_completed, NULL));
+    }
+
+    if (wait_for(&main_lane_completed, MAIN_LANE_SCRIPTS, 30.0) != 0) {
+        printf("  FAIL: Only %d of %d scripts completed\n", main_lane_completed, MAIN_LANE_SCRIPTS);
+        failures++;
+    } else if (main_lane_failed != 0) {
+        printf("  FAIL: %d scripts failed\n", main_lane_failed);
+        failures++;
+    } else if (__atomic_load_n(&long_script_done, __ATOMIC_ACQUIRE)) {
+        printf("  FAIL: The main lane waited for the long script to complete\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 2: The long script still completes
+    printf("\nTest 2: The long I/O script completes\n");
+    if (wait_for(&long_script_done, 1, 30.0) != 0 || long_script_status != 0) {
+        printf("  FAIL: Expected status 0, got %d (done %d)\n", long_script_status, long_script_done);
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    ruby_interpreter_destroy(interpreter);
+    ruby_script_destroy(short_script);
+    ruby_script_destroy(long_script);
+
+    // Summary
+    printf("\n=== Test Summary ===\n");
+    printf("Total failures: %d\n", failures);
+
+    if (failures == 0) {
+        printf("All tests PASSED!\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED!\n");
+        return 1;
+    }
+}
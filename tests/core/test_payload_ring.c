@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ruby-payload-ring.h"
+
+/**
+ * Payload Ring Tests
+ *
+ * Tests the shared memory ring used for large script payloads, without starting a Ruby VM.
+ * Verifies that:
+ * 1. Written payloads can be read back from the mapping
+ * 2. Writes fail instead of overwriting payloads that have not been released
+ * 3. Payloads never wrap around the end of the mapping
+ * 4. Released space can be reused
+ */
+
+int main(void) {
+    int failures = 0;
+
+    printf("=== Payload Ring Tests ===\n\n");
+
+    RubyPayloadRing ring;
+    if (ruby_payload_ring_init(&ring, 4096) != 0) {
+        // memfd is not available on every platform: the VM falls back to inline payloads
+        printf("Shared memory not available, skipping\n");
+        return 0;
+    }
+
+    // Test 1: Write and read back
+    printf("Test 1: Write and read back\n");
+    RubyPayloadRingSlot first;
+    const char* content = "puts 'Hello from the ring!'";
+    if (ruby_payload_ring_write(&ring, content, strlen(content), &first) != 0) {
+        printf("  FAIL: Write into an empty ring failed\n");
+        failures++;
+    } else if (first.position != 0 || first.length != strlen(content) ||
+               memcmp(ring.base + first.position, content, first.length) != 0) {
+        printf("  FAIL: Payload not found at the returned position\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 2: Full ring
+    printf("\nTest 2: Writes fail when the ring is full\n");
+    char block[2048];
+    memset(block, 'x', sizeof(block));
+    RubyPayloadRingSlot second;
+    RubyPayloadRingSlot rejected;
+    if (ruby_payload_ring_write(&ring, block, sizeof(block), &second) != 0) {
+        printf("  FAIL: Write with enough free space failed\n");
+        failures++;
+    } else if (ruby_payload_ring_write(&ring, block, sizeof(block), &rejected) == 0) {
+        printf("  FAIL: Write overwrote a payload still in use\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 3: No wrap around
+    printf("\nTest 3: Payloads are contiguous\n");
+    ruby_payload_ring_release(&ring, second.end);
+    RubyPayloadRingSlot third;
+    if (ruby_payload_ring_write(&ring, block, sizeof(block), &third) != 0) {
+        printf("  FAIL: Write after release failed\n");
+        failures++;
+    } else if (third.position != 0) {
+        printf("  FAIL: Expected the payload to restart at position 0, got %llu\n",
+               (unsigned long long)third.position);
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 4: Reuse
+    printf("\nTest 4: Released space is reused\n");
+    ruby_payload_ring_release(&ring, third.end);
+    RubyPayloadRingSlot fourth;
+    if (ruby_payload_ring_write(&ring, block, sizeof(block), &fourth) != 0 ||
+        ruby_payload_ring_write(&ring, block, sizeof(block) - 1, &rejected) != 0) {
+        printf("  FAIL: Released space could not be reused\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    ruby_payload_ring_destroy(&ring);
+
+    // Summary
+    printf("\n=== Test Summary ===\n");
+    printf("Total failures: %d\n", failures);
+
+    if (failures == 0) {
+        printf("All tests PASSED!\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED!\n");
+        return 1;
+    }
+}
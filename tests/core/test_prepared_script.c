@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ruby-prepared-script.h"
+
+/**
+ * Prepared Script Arguments Tests
+ *
+ * Tests the binary encoding of prepared script arguments, without starting a Ruby VM.
+ * Verifies that:
+ * 1. Every argument type is encoded with its tag and little-endian value
+ * 2. Invalid arguments are rejected
+ */
+
+int main(void) {
+    int failures = 0;
+
+    printf("=== Prepared Script Arguments Tests ===\n\n");
+
+    // Test 1: Encoding
+    printf("Test 1: Argument encoding\n");
+    const RubyArg args[] = {
+        ruby_arg_nil(),
+        ruby_arg_int64(-2),
+        ruby_arg_double(1.0),
+        ruby_arg_bool(42),
+        ruby_arg_utf8("h\xC3\xA9", 3),
+        ruby_arg_bytes("\0\xFF", 2)
+    };
+    const unsigned char expected[] = {
+        RUBY_ARG_NIL,
+        RUBY_ARG_INT64, 0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        RUBY_ARG_DOUBLE, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x3F,
+        RUBY_ARG_BOOL, 0x01,
+        RUBY_ARG_UTF8, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 'h', 0xC3, 0xA9,
+        RUBY_ARG_BYTES, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF
+    };
+    const size_t count = sizeof(args) / sizeof(args[0]);
+
+    size_t size = 0;
+    unsigned char encoded[sizeof(expected)];
+    if (ruby_args_encoded_size(args, count, &size) != 0 || size != sizeof(expected)) {
+        printf("  FAIL: Expected an encoded size of %zu bytes, got %zu\n", sizeof(expected), size);
+        failures++;
+    } else {
+        ruby_args_encode(args, count, encoded);
+        if (memcmp(encoded, expected, sizeof(expected)) != 0) {
+            printf("  FAIL: Encoded arguments differ from the expected layout\n");
+            failures++;
+        } else {
+            printf("  PASS\n");
+        }
+    }
+
+    // Test 2: Invalid arguments
+    printf("\nTest 2: Invalid arguments are rejected\n");
+    RubyArg unknown = ruby_arg_nil();
+    unknown.type = (RubyArgType)42;
+    const RubyArg missing_data = ruby_arg_bytes(NULL, 4);
+    if (ruby_args_encoded_size(&unknown, 1, &size) == 0) {
+        printf("  FAIL: Unknown argument type accepted\n");
+        failures++;
+    } else if (ruby_args_encoded_size(&missing_data, 1, &size) == 0) {
+        printf("  FAIL: Bytes argument without data accepted\n");
+        failures++;
+    } else if (ruby_args_encoded_size(NULL, 0, &size) != 0 || size != 0) {
+        printf("  FAIL: Empty argument list rejected\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Summary
+    printf("\n=== Test Summary ===\n");
+    printf("Total failures: %d\n", failures);
+
+    if (failures == 0) {
+        printf("All tests PASSED!\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED!\n");
+        return 1;
+    }
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include "ruby-startup-profile.h"
+
+/**
+ * Startup Profile Tests
+ *
+ * Tests the timings of the VM startup phases, without starting a Ruby VM.
+ * Verifies that:
+ * 1. No phase is completed before the VM starts
+ * 2. A phase is completed once ended, and starts after the origin
+ * 3. A phase recorded without an end is not completed
+ * 4. Only the first request sent times the first script, until its own reply
+ */
+
+int main(void) {
+    int failures = 0;
+    RubyStartupProfile profile;
+
+    printf("=== Startup Profile Tests ===\n\n");
+
+    // Test 1: Nothing before the start
+    printf("Test 1: Profile before the VM starts\n");
+    ruby_startup_profile_get(&profile);
+    int completed = 0;
+    for (int i = 0; i < RUBY_STARTUP_PHASE_COUNT; i++) {
+        completed += profile.phases[i].completed;
+    }
+    if (profile.origin_ns != 0 || completed != 0) {
+        printf("  FAIL: No phase should be completed\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 2: Timed phase
+    printf("\nTest 2: Begin and end a phase\n");
+    ruby_startup_profile_reset();
+    usleep(2000);
+    ruby_startup_profile_begin(RUBY_STARTUP_INIT);
+    ruby_startup_profile_get(&profile);
+    const int running = profile.phases[RUBY_STARTUP_INIT].completed;
+    usleep(2000);
+    ruby_startup_profile_end(RUBY_STARTUP_INIT);
+    ruby_startup_profile_get(&profile);
+    const RubyStartupPhaseTiming* init = &profile.phases[RUBY_STARTUP_INIT];
+    if (running || !init->completed || init->start_ns < 2000000 || init->duration_ns < 2000000 ||
+        profile.phases[RUBY_STARTUP_SYSINIT].completed) {
+        printf("  FAIL: ruby_init should be completed after 2 ms, lasting 2 ms\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 3: Recorded phases
+    printf("\nTest 3: Record a phase run by another thread\n");
+    const uint64_t now = ruby_startup_profile_now();
+    ruby_startup_profile_record(RUBY_STARTUP_INSTALL_PACK, now, now + 1000);
+    ruby_startup_profile_record(RUBY_STARTUP_INSTALL_STDLIB_EXT, now, 0);
+    ruby_startup_profile_get(&profile);
+    if (!profile.phases[RUBY_STARTUP_INSTALL_PACK].completed ||
+        profile.phases[RUBY_STARTUP_INSTALL_PACK].duration_ns != 1000 ||
+        profile.phases[RUBY_STARTUP_INSTALL_STDLIB_EXT].completed) {
+        printf("  FAIL: Only the pack should be completed, in 1000 ns\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 4: First script
+    printf("\nTest 4: First script\n");
+    ruby_startup_profile_request_sent(3);
+    ruby_startup_profile_request_sent(4);
+    ruby_startup_profile_reply_received(4);
+    ruby_startup_profile_get(&profile);
+    const int early = profile.phases[RUBY_STARTUP_FIRST_SCRIPT].completed;
+    ruby_startup_profile_reply_received(3);
+    ruby_startup_profile_get(&profile);
+    const uint64_t duration = profile.phases[RUBY_STARTUP_FIRST_SCRIPT].duration_ns;
+    usleep(1000);
+    ruby_startup_profile_reply_received(3);
+    ruby_startup_profile_get(&profile);
+    if (early || !profile.phases[RUBY_STARTUP_FIRST_SCRIPT].completed ||
+        profile.phases[RUBY_STARTUP_FIRST_SCRIPT].duration_ns != duration) {
+        printf("  FAIL: Only the reply of request 3 should end the first script, once\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Summary
+    printf("\n=== Test Summary ===\n");
+    printf("Total failures: %d\n", failures);
+
+    if (failures == 0) {
+        printf("All tests PASSED!\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED!\n");
+        return 1;
+    }
+}
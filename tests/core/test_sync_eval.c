@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ruby-interpreter.h"
+
+/**
+ * Synchronous Evaluation Tests
+ *
+ * Starts a Ruby VM and evaluates code through ruby_interpreter_eval_sync.
+ * Verifies that:
+ * 1. Code that runs fine returns 0
+ * 2. A StandardError fails the evaluation with its class and message
+ * 3. exit, Interrupt and Thread#kill fail the evaluation instead of stopping the thread serving them
+ * 4. The evaluations after them are still served
+ */
+
+static void on_log(LogListener* listener, const char* line) {
+    (void)listener;
+    (void)line;
+}
+
+static void on_log_error(LogListener* listener, const char* line) {
+    (void)listener;
+    fprintf(stderr, "[Ruby Error] %s\n", line);
+}
+
+static int eval_sync(RubyInterpreter* interpreter, const char* source, RubyEvalResult* result) {
+    memset(result, 0, sizeof(*result));
+    return ruby_interpreter_eval_sync(interpreter, source, strlen(source), result);
+}
+
+int main(void) {
+    int failures = 0;
+    RubyEvalResult result;
+
+    printf("=== Synchronous Evaluation Tests ===\n\n");
+
+    LogListener listener = {
+        .context = NULL,
+        .user_data = NULL,
+        .accept = on_log,
+        .on_log_error = on_log_error
+    };
+
+    RubyInterpreter* interpreter = ruby_interpreter_create(".", "./ruby", "./lib", listener);
+    if (!interpreter) {
+        printf("FAIL: Could not create the interpreter\n");
+        return 1;
+    }
+
+    // Test 1: Plain code
+    printf("Test 1: Plain code succeeds\n");
+    int status = eval_sync(interpreter, "$sync_value = 41 + 1", &result);
+    if (status != 0) {
+        printf("  FAIL: Expected 0, got %d (%s)\n", status, result.message);
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 2: StandardError
+    printf("\nTest 2: A raised ArgumentError fails the evaluation\n");
+    status = eval_sync(interpreter, "raise ArgumentError, 'boom'", &result);
+    if (status != 1 || strcmp(result.message, "ArgumentError: boom") != 0) {
+        printf("  FAIL: Expected 1 'ArgumentError: boom', got %d '%s'\n", status, result.message);
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 3: Errors that are not StandardError
+    const char* interrupting[] = { "exit", "raise Interrupt", "Thread.current.kill" };
+    for (size_t i = 0; i < sizeof(interrupting) / sizeof(interrupting[0]); i++) {
+        printf("\nTest 3.%zu: '%s' fails the evaluation\n", i + 1, interrupting[i]);
+        status = eval_sync(interpreter, interrupting[i], &result);
+        if (status != 1) {
+            printf("  FAIL: Expected 1, got %d (%s)\n", status, result.message);
+            failures++;
+        } else {
+            printf("  PASS (%s)\n", result.message);
+        }
+    }
+
+    // Test 4: Still served afterwards
+    printf("\nTest 4: The next evaluation is still served\n");
+    status = eval_sync(interpreter, "raise 'lost' unless $sync_value == 42", &result);
+    if (status != 0) {
+        printf("  FAIL: Expected 0, got %d (%s)\n", status, result.message);
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    ruby_interpreter_destroy(interpreter);
+
+    // Summary
+    printf("\n=== Test Summary ===\n");
+    printf("Total failures: %d\n", failures);
+
+    if (failures == 0) {
+        printf("All tests PASSED!\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED!\n");
+        return 1;
+    }
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ruby-vm-pool-stats.h"
+
+/**
+ * VM Pool Tests
+ *
+ * Tests the placement of shard keys on the workers of a pool, without starting a Ruby VM.
+ * Verifies that:
+ * 1. The same key always lands on the same shard and the same worker
+ * 2. Consecutive keys spread over every shard and every worker
+ * 3. When a worker stops, only its shards move, and none of them to a stopped worker
+ * 4. No shard has an owner when no worker runs
+ */
+
+#define KEY_COUNT 65536
+#define WORKER_COUNT 8
+#define ALL_WORKERS ((UINT64_C(1) << WORKER_COUNT) - 1)
+
+int main(void) {
+    int failures = 0;
+
+    printf("=== VM Pool Tests ===\n\n");
+
+    // Test 1: Stable placement
+    printf("Test 1: A key keeps its shard and its worker\n");
+    int unstable = 0;
+    for (uint64_t key = 0; key < 1000; key++) {
+        const uint32_t shard = ruby_vm_pool_shard_of(key);
+        if (shard >= RUBY_VM_POOL_SHARD_COUNT || shard != ruby_vm_pool_shard_of(key) ||
+            ruby_vm_pool_shard_owner(shard, ALL_WORKERS) != ruby_vm_pool_shard_owner(shard, ALL_WORKERS)) {
+            unstable++;
+        }
+    }
+    if (unstable > 0) {
+        printf("  FAIL: %d keys changed shard or worker\n", unstable);
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 2: Spread
+    printf("\nTest 2: Keys spread over the shards and the workers\n");
+    unsigned keys_per_shard[RUBY_VM_POOL_SHARD_COUNT] = { 0 };
+    for (uint64_t key = 0; key < KEY_COUNT; key++) {
+        keys_per_shard[ruby_vm_pool_shard_of(key)]++;
+    }
+    // 256 keys expected per shard
+    unsigned fewest = KEY_COUNT;
+    unsigned most = 0;
+    for (uint32_t shard = 0; shard < RUBY_VM_POOL_SHARD_COUNT; shard++) {
+        if (keys_per_shard[shard] < fewest) fewest = keys_per_shard[shard];
+        if (keys_per_shard[shard] > most) most = keys_per_shard[shard];
+    }
+    // 32 shards expected per worker
+    unsigned shards_per_worker[WORKER_COUNT] = { 0 };
+    for (uint32_t shard = 0; shard < RUBY_VM_POOL_SHARD_COUNT; shard++) {
+        const uint32_t worker = ruby_vm_pool_shard_owner(shard, ALL_WORKERS);
+        if (worker < WORKER_COUNT) shards_per_worker[worker]++;
+    }
+    int idle_worker = 0;
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        if (shards_per_worker[i] < 16 || shards_per_worker[i] > 48) idle_worker = 1;
+    }
+    if (fewest < 192 || most > 320) {
+        printf("  FAIL: Between %u and %u keys per shard, expected about %d\n",
+               fewest, most, KEY_COUNT / RUBY_VM_POOL_SHARD_COUNT);
+        failures++;
+    } else if (idle_worker) {
+        printf("  FAIL: Shards per worker out of [16, 48]:");
+        for (int i = 0; i < WORKER_COUNT; i++) printf(" %u", shards_per_worker[i]);
+        printf("\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 3: Rebalance
+    printf("\nTest 3: Only the shards of a stopped worker move\n");
+    int wrong_moves = 0;
+    for (uint32_t stopped = 0; stopped < WORKER_COUNT; stopped++) {
+        const uint64_t running = ALL_WORKERS & ~(UINT64_C(1) << stopped);
+        for (uint32_t shard = 0; shard < RUBY_VM_POOL_SHARD_COUNT; shard++) {
+            const uint32_t before = ruby_vm_pool_shard_owner(shard, ALL_WORKERS);
+            const uint32_t after = ruby_vm_pool_shard_owner(shard, running);
+            if (after == stopped || after >= WORKER_COUNT || (before != stopped && after != before)) {
+                wrong_moves++;
+            }
+        }
+    }
+    // A second worker stopping does not move the shards of the first one back
+    const uint64_t two_stopped = ALL_WORKERS & ~UINT64_C(0x5);
+    for (uint32_t shard = 0; shard < RUBY_VM_POOL_SHARD_COUNT; shard++) {
+        const uint32_t before = ruby_vm_pool_shard_owner(shard, ALL_WORKERS & ~UINT64_C(0x1));
+        const uint32_t after = ruby_vm_pool_shard_owner(shard, two_stopped);
+        if (after == 0 || after == 2 || (before != 2 && after != before)) {
+            wrong_moves++;
+        }
+    }
+    if (wrong_moves > 0) {
+        printf("  FAIL: %d shards moved without their worker stopping\n", wrong_moves);
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 4: No running worker
+    printf("\nTest 4: No owner without a running worker\n");
+    if (ruby_vm_pool_shard_owner(0, 0) != UINT32_MAX) {
+        printf("  FAIL: Shard 0 owned by worker %u\n", ruby_vm_pool_shard_owner(0, 0));
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Summary
+    printf("\n=== Test Summary ===\n");
+    printf("Total failures: %d\n", failures);
+
+    if (failures == 0) {
+        printf("All tests PASSED!\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED!\n");
+        return 1;
+    }
+}
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "ruby-wire-protocol.h"
+
+/**
+ * Wire Protocol Tests
+ *
+ * Tests the binary framing of the commands channel without starting a Ruby VM.
+ * Verifies that:
+ * 1. Headers are encoded in little-endian with the documented layout
+ * 2. Encoded headers decode back to the same values
+ * 3. Bad magic numbers are rejected
+ * 4. Frames written with ruby_wire_write_frame can be read back through a socket
+ */
+
+int main(void) {
+    int failures = 0;
+
+    printf("=== Wire Protocol Tests ===\n\n");
+
+    // Test 1: Layout
+    printf("Test 1: Header layout\n");
+    RubyWireHeader header;
+    ruby_wire_header_init(&header, 0x0102030405060708ULL, 0x0A0B, 0x11223344ULL);
+    header.status = -2;
+    header.content_hash = 0x8877665544332211ULL;
+    unsigned char encoded[RUBY_WIRE_HEADER_SIZE];
+    ruby_wire_header_encode(&header, encoded);
+
+    if (memcmp(encoded, "RBVM", 4) != 0) {
+        printf("  FAIL: Expected magic 'RBVM'\n");
+        failures++;
+    } else if (encoded[6] != 0x0B || encoded[7] != 0x0A) {
+        printf("  FAIL: Flags are not little-endian\n");
+        failures++;
+    } else if (encoded[8] != 0x08 || encoded[15] != 0x01) {
+        printf("  FAIL: Request id is not little-endian\n");
+        failures++;
+    } else if (encoded[16] != 0xFE || encoded[19] != 0xFF) {
+        printf("  FAIL: Status is not a little-endian signed value\n");
+        failures++;
+    } else if (encoded[24] != 0x44 || encoded[27] != 0x11) {
+        printf("  FAIL: Payload length is not little-endian\n");
+        failures++;
+    } else if (encoded[32] != 0x11 || encoded[39] != 0x88) {
+        printf("  FAIL: Content hash is not little-endian\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 2: Round trip
+    printf("\nTest 2: Encode/decode round trip\n");
+    RubyWireHeader decoded;
+    if (ruby_wire_header_decode(encoded, &decoded) != 0) {
+        printf("  FAIL: Valid header rejected\n");
+        failures++;
+    } else if (decoded.request_id != header.request_id || decoded.flags != header.flags ||
+               decoded.status != header.status || decoded.payload_length != header.payload_length ||
+               decoded.content_hash != header.content_hash) {
+        printf("  FAIL: Decoded header differs from the original\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 3: Invalid magic
+    printf("\nTest 3: Invalid magic is rejected\n");
+    encoded[0] = 'X';
+    if (ruby_wire_header_decode(encoded, &decoded) == 0) {
+        printf("  FAIL: Header with bad magic accepted\n");
+        failures++;
+    } else {
+        printf("  PASS\n");
+    }
+
+    // Test 4: Frame through a socket pair
+    printf("\nTest 4: Frame write and buffered read\n");
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        printf("  FAIL: socketpair() failed\n");
+        failures++;
+    } else {
+        const char* part1 = "puts 'Hello";
+        const char* part2 = " from Ruby!'";
+        struct iovec payload[2] = {
+                { .iov_base = (void*) part1, .iov_len = strlen(part1) },
+                { .iov_base = (void*) part2, .iov_len = strlen(part2) }
+        };
+        ruby_wire_header_init(&header, 42, RUBY_WIRE_FLAG_NONE, strlen(part1) + strlen(part2));
+
+        RubyWireReader reader;
+        ruby_wire_reader_init(&reader, sv[1]);
+        char content[64] = {0};
+
+        if (ruby_wire_write_frame(sv[0], &header, payload, 2) != 0) {
+            printf("  FAIL: Frame write failed\n");
+            failures++;
+        } else if (ruby_wire_reader_read_header(&reader, &decoded) != 0 || decoded.request_id != 42) {
+            printf("  FAIL: Frame header could not be read back\n");
+            failures++;
+        } else if (ruby_wire_reader_read(&reader, content, decoded.payload_length) != 0 ||
+                   strcmp(content, "puts 'Hello from Ruby!'") != 0) {
+            printf("  FAIL: Expected payload \"puts 'Hello from Ruby!'\", got '%s'\n", content);
+            failures++;
+        } else {
+            printf("  PASS\n");
+        }
+        close(sv[0]);
+        close(sv[1]);
+    }
+
+    // Summary
+    printf("\n=== Test Summary ===\n");
+    printf("Total failures: %d\n", failures);
+
+    if (failures == 0) {
+        printf("All tests PASSED!\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED!\n");
+        return 1;
+    }
+}